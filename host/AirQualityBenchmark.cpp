@@ -0,0 +1,69 @@
+#include "AirQuality.h"
+
+#include <chrono>
+#include <iostream>
+
+// Per-update cost of AirQualityTracker in the host CPU time: the samples of every wake, the wakes with the missing
+// samples and the updates after the gaps expiring the whole windows
+namespace
+{
+
+constexpr int iterations = 1000000;
+constexpr time_t startTime = 1699999200;
+
+using HostClock = std::chrono::steady_clock;
+
+double nanosecondsPerCall(HostClock::duration duration)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / iterations;
+}
+
+// The tracker goes through the calls as it does in the storage, the result is kept from being optimized out
+template<typename Update>
+HostClock::duration measure(Update update)
+{
+    AirQualityTracker tracker;
+    int checksum = 0;
+    const auto start = HostClock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        checksum += update(tracker, i).usAqi;
+    }
+    const auto duration = HostClock::now() - start;
+    if (checksum == 1)
+    {
+        std::cout << checksum << std::endl;
+    }
+    return duration;
+}
+
+}
+
+int main()
+{
+    // The samples of the external unit once a minute
+    const auto periodic = measure([](AirQualityTracker& tracker, int i)
+    {
+        return tracker.update(startTime + i * 60, float(10 + i % 20), float(20 + i % 30));
+    });
+    // Every third sample missing, the windows only move
+    const auto missing = measure([](AirQualityTracker& tracker, int i)
+    {
+        if (i % 3 == 2)
+        {
+            return tracker.update(startTime + i * 60, std::nullopt, std::nullopt);
+        }
+        return tracker.update(startTime + i * 60, float(10 + i % 20), float(20 + i % 30));
+    });
+    // A day between the samples, every update expires the windows
+    const auto gaps = measure([](AirQualityTracker& tracker, int i)
+    {
+        return tracker.update(startTime + i * 24 * 60 * 60, float(10 + i % 20), float(20 + i % 30));
+    });
+
+    std::cout << "Calls:                     " << iterations << " per case\n"
+              << "Sample every minute:       " << nanosecondsPerCall(periodic) << " ns per update\n"
+              << "Every third one missing:   " << nanosecondsPerCall(missing) << " ns per update\n"
+              << "Day long gaps:             " << nanosecondsPerCall(gaps) << " ns per update" << std::endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "AirQuality.h"
+#include "HostTest.h"
+#include "RollingAverage.h"
+
+#include <cmath>
+#include <string_view>
+
+// The indices at the breakpoints of the US EPA and European tables, the expiry of the rolling windows and the
+// missing samples of the tracker
+namespace
+{
+
+// At the start of an hour, the buckets of both windows begin with it
+constexpr time_t startTime = 1699999200;
+constexpr time_t secondsInMinute = 60;
+constexpr time_t secondsInHour = 60 * secondsInMinute;
+
+struct IndexCase
+{
+    float concentration;
+    int16_t index;
+};
+
+void checkUsBreakpoints()
+{
+    using host_test::check;
+    const char* testCase = "US EPA breakpoints";
+    // Both ends of every category of the 2024 table
+    bool pm25Matched = true;
+    for (const auto& point : {IndexCase {0.f, 0}, IndexCase {9.0f, 50}, IndexCase {9.1f, 51}, IndexCase {35.4f, 100},
+                              IndexCase {35.5f, 101}, IndexCase {55.4f, 150}, IndexCase {55.5f, 151},
+                              IndexCase {125.4f, 200}, IndexCase {125.5f, 201}, IndexCase {225.4f, 300},
+                              IndexCase {225.5f, 301}, IndexCase {325.4f, 500}, IndexCase {500.f, 500}})
+    {
+        pm25Matched = pm25Matched && aqi::usIndex(point.concentration, 0.f) == point.index;
+    }
+    check(pm25Matched, testCase, "PM2.5 ends of the categories");
+    bool pm10Matched = true;
+    for (const auto& point : {IndexCase {0.f, 0}, IndexCase {54.f, 50}, IndexCase {55.f, 51}, IndexCase {154.f, 100},
+                              IndexCase {155.f, 101}, IndexCase {254.f, 150}, IndexCase {255.f, 151},
+                              IndexCase {354.f, 200}, IndexCase {355.f, 201}, IndexCase {424.f, 300},
+                              IndexCase {425.f, 301}, IndexCase {604.f, 500}, IndexCase {900.f, 500}})
+    {
+        pm10Matched = pm10Matched && aqi::usIndex(0.f, point.concentration) == point.index;
+    }
+    check(pm10Matched, testCase, "PM10 ends of the categories");
+
+    // The concentrations are truncated to 0.1 and 1 ug/m3 before the lookup
+    check(aqi::usIndex(9.09f, 0.f) == 50 && aqi::usIndex(35.49f, 0.f) == 100, testCase, "PM2.5 truncation");
+    check(aqi::usIndex(0.f, 54.9f) == 50, testCase, "PM10 truncation");
+    // The example of the technical assistance document: 35.9 ug/m3 of PM2.5
+    check(aqi::usIndex(35.9f, 0.f) == 102, testCase, "interpolation");
+    check(aqi::usIndex(20.f, 160.f) == 103, testCase, "higher of the two");
+    check(std::string_view(aqi::usCategory(50)) == "Good" && std::string_view(aqi::usCategory(51)) == "Mod"
+          && std::string_view(aqi::usCategory(-1)).empty(), testCase, "categories");
+}
+
+void checkEuBreakpoints()
+{
+    using host_test::check;
+    const char* testCase = "European breakpoints";
+    struct LevelCase
+    {
+        float concentration;
+        uint8_t level;
+    };
+    bool pm25Matched = true;
+    for (const auto& point : {LevelCase {0.f, 1}, LevelCase {10.f, 1}, LevelCase {10.1f, 2}, LevelCase {20.f, 2},
+                              LevelCase {20.1f, 3}, LevelCase {25.f, 3}, LevelCase {25.1f, 4}, LevelCase {50.f, 4},
+                              LevelCase {50.1f, 5}, LevelCase {75.f, 5}, LevelCase {75.1f, 6}})
+    {
+        pm25Matched = pm25Matched && aqi::euLevel(point.concentration, 0.f) == point.level;
+    }
+    check(pm25Matched, testCase, "PM2.5 bounds of the levels");
+    bool pm10Matched = true;
+    for (const auto& point : {LevelCase {20.f, 1}, LevelCase {20.1f, 2}, LevelCase {40.f, 2}, LevelCase {40.1f, 3},
+                              LevelCase {50.f, 3}, LevelCase {50.1f, 4}, LevelCase {100.f, 4}, LevelCase {100.1f, 5},
+                              LevelCase {150.f, 5}, LevelCase {150.1f, 6}})
+    {
+        pm10Matched = pm10Matched && aqi::euLevel(0.f, point.concentration) == point.level;
+    }
+    check(pm10Matched, testCase, "PM10 bounds of the levels");
+    check(aqi::euLevel(12.f, 120.f) == 5, testCase, "higher of the two");
+}
+
+void checkWindowExpiry()
+{
+    using host_test::check;
+    const char* testCase = "window expiry";
+    // 12 buckets of 5 minutes
+    RollingAverage<12, 5 * 60> hourly;
+    hourly.add(startTime, 10.f);
+    hourly.add(startTime + 30 * secondsInMinute, 30.f);
+    check(hourly.mean() && std::fabs(*hourly.mean() - 20.f) < 0.01f, testCase, "both in the window");
+
+    // The sparse samples are weighted by the time, not by the count
+    hourly.add(startTime + 30 * secondsInMinute + 10, 30.f);
+    check(hourly.mean() && std::fabs(*hourly.mean() - 20.f) < 0.01f, testCase, "bucket mean");
+
+    hourly.advance(startTime + 60 * secondsInMinute);
+    check(hourly.getFilledBuckets() == 1 && std::fabs(*hourly.mean() - 30.f) < 0.01f, testCase,
+          "oldest bucket expired");
+    hourly.advance(startTime + 90 * secondsInMinute);
+    check(!hourly.mean(), testCase, "all expired");
+
+    hourly.add(startTime + 100 * secondsInMinute, 12.f);
+    hourly.advance(startTime + 5 * secondsInHour);
+    check(!hourly.mean() && hourly.getFilledBuckets() == 0, testCase, "gap longer than the window");
+
+    hourly.add(startTime + 6 * secondsInHour, 12.f);
+    hourly.advance(startTime + 2 * secondsInHour);
+    check(!hourly.mean(), testCase, "clock set back");
+
+    RollingAverage<24, 60 * 60> daily;
+    for (int hour = 0; hour < 11; ++hour)
+    {
+        daily.add(startTime + hour * secondsInHour, 15.f);
+    }
+    check(!daily.mean(12) && daily.mean(), testCase, "coverage below the minimum");
+    daily.add(startTime + 11 * secondsInHour, 15.f);
+    check(daily.mean(12) && std::fabs(*daily.mean(12) - 15.f) < 0.01f, testCase, "coverage reached");
+}
+
+void checkMissingSamples()
+{
+    using host_test::check;
+    const char* testCase = "missing samples";
+    AirQualityTracker tracker;
+    check(tracker.update(startTime, std::nullopt, std::nullopt).usAqi == -1, testCase, "no data");
+    auto index = tracker.update(startTime, 20.f, 30.f);
+    // The hourly means stand for the daily ones until a half of the day is covered
+    check(index.usAqi == aqi::usIndex(20.f, 30.f) && index.euLevel == 2, testCase, "hourly estimate");
+
+    // The missing PM10 leaves the index undefined once its samples expire
+    index = tracker.update(startTime + 2 * secondsInHour, 20.f, std::nullopt);
+    check(index.usAqi == -1 && index.euLevel == 0, testCase, "one of the two missing");
+
+    // The external unit silent for longer than the hour
+    tracker.update(startTime + 3 * secondsInHour, 20.f, 30.f);
+    index = tracker.update(startTime + 4 * secondsInHour + secondsInMinute, std::nullopt, std::nullopt);
+    check(index.usAqi == -1 && !tracker.getHourlyPm25(), testCase, "expired by the missing samples");
+
+    // A day of samples every 10 minutes with every third one missing still covers the day
+    AirQualityTracker daily;
+    for (time_t elapsed = 0; elapsed < 24 * secondsInHour; elapsed += 10 * secondsInMinute)
+    {
+        const bool missing = (elapsed / (10 * secondsInMinute)) % 3 == 2;
+        const auto pm25 = elapsed < 12 * secondsInHour ? 10.f : 30.f;
+        index = missing ? daily.update(startTime + elapsed, std::nullopt, std::nullopt)
+                        : daily.update(startTime + elapsed, pm25, 40.f);
+    }
+    check(daily.getDailyPm25() && std::fabs(*daily.getDailyPm25() - 20.f) < 0.01f, testCase, "daily mean");
+    check(index.usAqi == aqi::usIndex(20.f, 40.f), testCase, "daily index");
+}
+
+}
+
+int main()
+{
+    checkUsBreakpoints();
+    checkEuBreakpoints();
+    checkWindowExpiry();
+    checkMissingSamples();
+    return host_test::result();
+}
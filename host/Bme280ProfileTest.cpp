@@ -0,0 +1,119 @@
+#include "Clock.h"
+#include "FakeBme280.h"
+#include "HostTest.h"
+#include "PTHProvider.h"
+#include "PersistentStorage.h"
+#include "VirtualKernel.h"
+
+#include "esp32-esp-idf/I2CBus.h"
+
+#include <array>
+#include <cmath>
+#include <iostream>
+
+// The BME280 profiles written by PTHProvider before the forced measurement, served by FakeBme280 on the virtual
+// kernel: the registers, the I2C transactions and the conversion time of every profile
+namespace
+{
+
+constexpr int i2cPort = 0;
+constexpr uint8_t address = 0x76;
+constexpr uint8_t humidityControlRegister = 0xF2;
+constexpr uint8_t measurementControlRegister = 0xF4;
+constexpr uint8_t configRegister = 0xF5;
+// The profile write, then the status and the data reads, each of them the register address and the read
+constexpr uint32_t transactionsPerMeasurement = 5;
+
+struct ProfileCase
+{
+    const char* name;
+    BmeProfile profile;
+    uint8_t humidityControl;
+    uint8_t config;
+    uint8_t measurementControl;
+    int64_t conversionMicroseconds;
+};
+
+const ProfileCase* currentCase = nullptr;
+bool setupDone = false;
+SensorProvider::ReadResult firstResult = SensorProvider::ReadResult::Failed;
+int64_t readyDelay = 0;
+uint32_t transactions = 0;
+float temperature = 0;
+float humidity = 0;
+float pressure = 0;
+
+void measure()
+{
+    embedded::I2CBus bus(i2cPort);
+    bus.init(0, 0, 400000);
+    embedded::I2CHelper helper(bus, address);
+    std::array<uint8_t, 256> memory {};
+    embedded::PersistentStorage storage(memory, true);
+    PTHProvider provider(helper, storage, currentCase->profile);
+    setupDone = provider.setup(false);
+
+    auto& clock = Clock::instance();
+    const auto transactionsBefore = simulation::getPlatformStatistics().i2cTransactions;
+    const auto startTime = clock.monotonicMicroseconds();
+    provider.start();
+    readyDelay = provider.readyTime() - startTime;
+    clock.sleepUntil(provider.readyTime());
+    firstResult = provider.read();
+    auto result = firstResult;
+    while (result == SensorProvider::ReadResult::Pending)
+    {
+        clock.sleepUntil(provider.readyTime());
+        result = provider.read();
+    }
+    transactions = simulation::getPlatformStatistics().i2cTransactions - transactionsBefore;
+    temperature = provider.getTemperature();
+    humidity = provider.getHumidity();
+    pressure = provider.getPressure();
+}
+
+void runCase(const ProfileCase& testCase)
+{
+    currentCase = &testCase;
+    FakeBme280 sensor([](int64_t) { return FakeBme280::Conditions {}; });
+    simulation::attachI2C(i2cPort, address, sensor);
+    auto& kernel = simulation::VirtualKernel::instance();
+    kernel.runWake(&measure, 1000000);
+    kernel.advance(1000000);
+
+    using host_test::check;
+    const auto& profile = testCase.profile;
+    check(setupDone, testCase.name, "setup");
+    check(sensor.getRegister(humidityControlRegister) == testCase.humidityControl, testCase.name, "ctrl_hum");
+    check(sensor.getRegister(configRegister) == testCase.config, testCase.name, "config");
+    // The forced mode returns to the sleep mode after the conversion
+    check((sensor.getRegister(measurementControlRegister) >> 2) == (testCase.measurementControl >> 2), testCase.name,
+          "ctrl_meas");
+    check(sensor.getMeasurementsCount() == 1, testCase.name, "one measurement");
+    check(sensor.getLastConversionMicroseconds() == testCase.conversionMicroseconds, testCase.name,
+          "conversion time of the profile");
+    check(readyDelay == PTHProvider::measurementTimeMicroseconds(profile)
+          && readyDelay >= testCase.conversionMicroseconds, testCase.name, "ready time");
+    check(firstResult == SensorProvider::ReadResult::Done, testCase.name, "read at the ready time");
+    check(transactions == transactionsPerMeasurement, testCase.name, "I2C transactions");
+    check(std::fabs(temperature - 22.0f) < 0.05f, testCase.name, "temperature");
+    check(std::fabs(pressure - 101325.0f) < 5.0f, testCase.name, "pressure");
+    if (profile.humidityOversampling != 0)
+    {
+        check(std::fabs(humidity - 45.0f) < 0.5f, testCase.name, "humidity");
+    }
+    std::cout << testCase.name << ": " << readyDelay << " us, " << transactions << " I2C transactions" << std::endl;
+}
+
+}
+
+int main()
+{
+    // The recommended profiles of the datasheet, section 3.5, and the maximum oversampling
+    runCase({"weather monitoring", PTHProvider::weatherMonitoring, 0x01, 0x00, 0x25, 9300});
+    runCase({"humidity sensing", {1, 0, 1, 0}, 0x01, 0x00, 0x21, 6425});
+    runCase({"indoor navigation", {2, 16, 1, 16}, 0x01, 0x10, 0x55, 46100});
+    runCase({"gaming", {1, 4, 0, 16}, 0x00, 0x10, 0x2D, 13325});
+    runCase({"maximum oversampling", {16, 16, 16, 0}, 0x05, 0x00, 0xB5, 112800});
+    return host_test::result();
+}
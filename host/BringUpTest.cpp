@@ -0,0 +1,118 @@
+#include "BringUp.h"
+#include "Clock.h"
+#include "HostTest.h"
+#include "VirtualKernel.h"
+
+#include <esp_sleep.h>
+#include <freertos/task.h>
+
+// Cancellation of the bring-up jobs left after the timeout on the virtual kernel
+namespace
+{
+
+constexpr int64_t microsecondsInMillisecond = 1000;
+constexpr TickType_t timeout = pdMS_TO_TICKS(100);
+
+uint32_t hungIterations = 0;
+bool dependentRan = false;
+bool runResult = true;
+bool hungAbandoned = false;
+bool dependentAbandoned = true;
+bool dependentFinished = false;
+bool slowFinished = false;
+bool slowAbandoned = true;
+bool lateCompleted = false;
+bool lateAbandoned = false;
+bool afterLateRan = false;
+bool afterLateFinished = false;
+int64_t runMicroseconds = 0;
+uint32_t iterationsAfterRun = 0;
+
+bool hungJob(void*)
+{
+    // The device never answers, the driver polls it forever
+    while (true)
+    {
+        ++hungIterations;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return true;
+}
+
+bool dependentJob(void*)
+{
+    dependentRan = true;
+    return true;
+}
+
+bool slowJob(void*)
+{
+    // Ends within the grace period after the timeout
+    vTaskDelay(timeout + pdMS_TO_TICKS(5));
+    return true;
+}
+
+bool lateJob(void*)
+{
+    // Ends after the grace period, the driver call isn't interrupted
+    vTaskDelay(timeout + pdMS_TO_TICKS(100));
+    lateCompleted = true;
+    return true;
+}
+
+bool afterLateJob(void*)
+{
+    afterLateRan = true;
+    return true;
+}
+
+void bringUpWithHang()
+{
+    auto& clock = Clock::instance();
+    BringUp bringUp(clock);
+    const auto hung = bringUp.add("hung", &hungJob, nullptr);
+    const auto dependent = bringUp.add("dependent", &dependentJob, nullptr, {hung});
+    const auto slow = bringUp.add("slow", &slowJob, nullptr);
+    const auto late = bringUp.add("late", &lateJob, nullptr);
+    const auto afterLate = bringUp.add("after_late", &afterLateJob, nullptr, {late});
+    const auto start = clock.monotonicMicroseconds();
+    runResult = bringUp.run(timeout);
+    runMicroseconds = clock.monotonicMicroseconds() - start;
+    hungAbandoned = bringUp.abandoned(hung);
+    dependentAbandoned = bringUp.abandoned(dependent);
+    dependentFinished = bringUp.finished(dependent);
+    slowFinished = bringUp.finished(slow);
+    slowAbandoned = bringUp.abandoned(slow);
+    lateAbandoned = bringUp.abandoned(late);
+    // The abandoned jobs aren't deleted, they go on in the background
+    const auto iterations = hungIterations;
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    iterationsAfterRun = hungIterations - iterations;
+    // The dependency ended after the cancellation, the job is skipped
+    afterLateFinished = bringUp.finished(afterLate);
+    esp_deep_sleep(1000000);
+}
+
+}
+
+int main()
+{
+    auto& kernel = simulation::VirtualKernel::instance();
+    const auto wake = kernel.runWake(&bringUpWithHang, 10 * 1000 * microsecondsInMillisecond);
+
+    using host_test::check;
+    const char* testCase = "hung job";
+    check(wake.sleepMicroseconds.has_value(), testCase, "deep sleep");
+    check(!runResult, testCase, "result");
+    check(runMicroseconds >= 100 * microsecondsInMillisecond && runMicroseconds < 150 * microsecondsInMillisecond,
+          testCase, "run time");
+    check(hungAbandoned, testCase, "abandoned hung job");
+    check(iterationsAfterRun != 0, testCase, "abandoned job not deleted");
+    check(!dependentRan && !dependentAbandoned && !dependentFinished, testCase, "dependent job not started");
+    check(slowFinished && !slowAbandoned, testCase, "slow job finished in the grace period");
+    check(lateAbandoned && lateCompleted, testCase, "late job abandoned and run to its end");
+    check(afterLateFinished && !afterLateRan, testCase, "job after the late one skipped");
+    std::cout << "Bring-up with a hung job returned after " << runMicroseconds / microsecondsInMillisecond << " ms"
+              << std::endl;
+    return host_test::result();
+}
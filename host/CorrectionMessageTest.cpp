@@ -0,0 +1,121 @@
+#include "EspNowTransport.h"
+#include "HostTest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Decoding of the acknowledgements of every version by the external unit
+namespace
+{
+
+using CorrectionMessage = EspNowTransport::CorrectionMessage;
+
+CorrectionMessage sentMessage()
+{
+    CorrectionMessage message {};
+    message.currentMicroseconds = 1700000000123456;
+    message.receiveMicroseconds = 1700000000100000;
+    message.channel = 6;
+    message.statusVersion = StatusReport::currentVersion;
+    message.status.temperature = 21.5f;
+    message.status.pm2p5 = 9;
+    message.status.usAqi = 37;
+    message.status.stateOfCharge = 73;
+    message.status.wakes = 1457;
+    message.status.deliveredCount = 1400;
+    message.status.lastRssi = -67;
+    return message;
+}
+
+std::vector<uint8_t> bytes(const CorrectionMessage& message, size_t size)
+{
+    // The bytes behind the message are those of a later version
+    std::vector<uint8_t> data(std::max(size, sizeof(message)), 0x5A);
+    std::memcpy(data.data(), &message, sizeof(message));
+    data.resize(size);
+    return data;
+}
+
+bool sameFirstVersion(const CorrectionMessage& decoded, const CorrectionMessage& sent)
+{
+    return decoded.currentMicroseconds == sent.currentMicroseconds
+           && decoded.receiveMicroseconds == sent.receiveMicroseconds && decoded.channel == sent.channel;
+}
+
+bool noStatus(const CorrectionMessage& decoded)
+{
+    return decoded.statusVersion == 0 && decoded.status.pm2p5 == -1 && decoded.status.wakes == 0;
+}
+
+void checkFullReport()
+{
+    using host_test::check;
+    const char* testCase = "full report";
+    const auto sent = sentMessage();
+    const auto data = bytes(sent, sizeof(sent));
+    const auto decoded = EspNowTransport::parseCorrection(data.data(), data.size());
+    check(decoded.has_value(), testCase, "decoded");
+    if (!decoded)
+    {
+        return;
+    }
+    check(sameFirstVersion(*decoded, sent), testCase, "first version fields");
+    check(decoded->statusVersion == StatusReport::currentVersion, testCase, "version");
+    check(decoded->status.temperature == 21.5f && decoded->status.pm2p5 == 9 && decoded->status.usAqi == 37,
+          testCase, "readings");
+    check(decoded->status.stateOfCharge == 73 && decoded->status.wakes == 1457, testCase, "battery and wakes");
+    check(decoded->status.deliveredCount == 1400 && decoded->status.lastRssi == -67, testCase, "link");
+
+    const auto longer = bytes(sent, sizeof(sent) + 8);
+    const auto later = EspNowTransport::parseCorrection(longer.data(), longer.size());
+    check(later && later->statusVersion == StatusReport::currentVersion && later->status.wakes == 1457, testCase,
+          "later version with appended fields");
+}
+
+void checkFirstVersion()
+{
+    using host_test::check;
+    const char* testCase = "first version";
+    const auto sent = sentMessage();
+    // The padding of the first version is indeterminate
+    auto data = bytes(sent, CorrectionMessage::firstVersionSize);
+    std::memset(data.data() + offsetof(CorrectionMessage, channel) + 1, 0xAB,
+                CorrectionMessage::firstVersionSize - offsetof(CorrectionMessage, channel) - 1);
+    const auto decoded = EspNowTransport::parseCorrection(data.data(), data.size());
+    check(decoded && sameFirstVersion(*decoded, sent), testCase, "fields");
+    check(decoded && noStatus(*decoded), testCase, "padding not taken for a report");
+
+    const auto withoutPadding = bytes(sent, offsetof(CorrectionMessage, channel) + 1);
+    const auto packed = EspNowTransport::parseCorrection(withoutPadding.data(), withoutPadding.size());
+    check(packed && sameFirstVersion(*packed, sent) && noStatus(*packed), testCase, "without the padding");
+
+    const auto withoutChannel = bytes(sent, offsetof(CorrectionMessage, channel));
+    check(!EspNowTransport::parseCorrection(withoutChannel.data(), withoutChannel.size()), testCase,
+          "channel missing");
+}
+
+void checkTruncatedReport()
+{
+    using host_test::check;
+    const char* testCase = "truncated report";
+    const auto sent = sentMessage();
+    for (const auto size : {CorrectionMessage::firstVersionSize + 4, sizeof(sent) - 1})
+    {
+        const auto data = bytes(sent, size);
+        const auto decoded = EspNowTransport::parseCorrection(data.data(), data.size());
+        check(decoded && sameFirstVersion(*decoded, sent), testCase, "fields");
+        check(decoded && noStatus(*decoded), testCase, "report dropped");
+    }
+}
+
+}
+
+int main()
+{
+    checkFullReport();
+    checkFirstVersion();
+    checkTruncatedReport();
+    return host_test::result();
+}
@@ -0,0 +1,265 @@
+#include "EnergyModel.h"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+
+constexpr double microsecondsInHour = 3600e6;
+constexpr double microsecondsInDay = 24 * microsecondsInHour;
+
+const std::pair<std::string_view, double EnergyModel::*> parameters[] = {
+        {"cpu_active_mA", &EnergyModel::cpuActiveMilliamperes},
+        {"light_sleep_mA", &EnergyModel::lightSleepMilliamperes},
+        {"wifi_mA", &EnergyModel::wifiMilliamperes},
+        {"radio_rx_mA", &EnergyModel::radioReceiveMilliamperes},
+        {"radio_tx_mA", &EnergyModel::radioTransmitMilliamperes},
+        {"radio_packet_us", &EnergyModel::radioPacketMicroseconds},
+        {"epd_busy_mA", &EnergyModel::epdBusyMilliamperes},
+        {"sps30_fan_mA", &EnergyModel::fanMilliamperes},
+        {"deep_sleep_mA", &EnergyModel::deepSleepMilliamperes},
+        {"battery_mAh", &EnergyModel::batteryCapacityMilliampereHours},
+        {"usable_fraction", &EnergyModel::usableCapacityFraction},
+        {"cutoff_V", &EnergyModel::cutoffVolts},
+};
+
+std::string trim(const std::string& text)
+{
+    const auto begin = text.find_first_not_of(" \t\r");
+    const auto end = text.find_last_not_of(" \t\r");
+    return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+bool readDischargeCurve(std::istream& input, std::vector<EnergyModel::DischargePoint>& curve)
+{
+    curve.clear();
+    EnergyModel::DischargePoint point {};
+    char separator = 0;
+    while (input >> point.volts >> separator >> point.percent)
+    {
+        if (separator != ':' || (!curve.empty() && (point.volts <= curve.back().volts
+                                                    || point.percent < curve.back().percent)))
+        {
+            return false;
+        }
+        curve.push_back(point);
+    }
+    return input.eof() && curve.size() >= 2;
+}
+
+bool readPercents(std::istream& input, std::vector<double>& percents)
+{
+    percents.clear();
+    double percent = 0.0;
+    while (input >> percent)
+    {
+        // The thresholds go down with the tiers
+        if (percent < 0.0 || percent > 100.0 || (!percents.empty() && percent >= percents.back()))
+        {
+            return false;
+        }
+        percents.push_back(percent);
+    }
+    return input.eof();
+}
+
+// Charge in mAh of the current in mA flowing for the time in microseconds
+double charge(double milliamperes, double microseconds)
+{
+    return milliamperes * microseconds / microsecondsInHour;
+}
+
+}
+
+void writeTraceHeader(std::ostream& output)
+{
+    output << "# start_us awake_us sleep_us wifi_us radio_us radio_packets epd_busy_us fan_us light_sleep_us\n";
+}
+
+void writeTraceLine(std::ostream& output, const WakePhases& phases)
+{
+    output << phases.startMicroseconds << ' ' << phases.awakeMicroseconds << ' ' << phases.sleepMicroseconds << ' '
+           << phases.wifiMicroseconds << ' ' << phases.radioMicroseconds << ' ' << phases.radioPackets << ' '
+           << phases.epdBusyMicroseconds << ' ' << phases.fanMicroseconds << ' ' << phases.lightSleepMicroseconds
+           << '\n';
+}
+
+std::optional<std::vector<WakePhases>> readTrace(std::istream& input, size_t& errorLine)
+{
+    std::vector<WakePhases> trace;
+    std::string line;
+    for (size_t number = 1; std::getline(input, line); ++number)
+    {
+        line = trim(line);
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        WakePhases phases;
+        if (!(fields >> phases.startMicroseconds >> phases.awakeMicroseconds >> phases.sleepMicroseconds
+                     >> phases.wifiMicroseconds >> phases.radioMicroseconds >> phases.radioPackets
+                     >> phases.epdBusyMicroseconds >> phases.fanMicroseconds))
+        {
+            errorLine = number;
+            return std::nullopt;
+        }
+        if (!(fields >> phases.lightSleepMicroseconds))
+        {
+            if (!fields.eof())
+            {
+                errorLine = number;
+                return std::nullopt;
+            }
+            phases.lightSleepMicroseconds = 0;
+        }
+        trace.push_back(phases);
+    }
+    return trace;
+}
+
+bool EnergyModel::set(const std::string& name, double value)
+{
+    for (const auto& [parameterName, member] : parameters)
+    {
+        if (parameterName == name)
+        {
+            this->*member = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EnergyModel::load(std::istream& input, std::string& error)
+{
+    std::string line;
+    for (size_t number = 1; std::getline(input, line); ++number)
+    {
+        line = trim(line);
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        const auto separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            error = "line " + std::to_string(number) + ": name = value expected";
+            return false;
+        }
+        const auto name = trim(line.substr(0, separator));
+        std::istringstream valueText(line.substr(separator + 1));
+        if (name == "discharge_curve" || name == "tier_enter_percent")
+        {
+            if (!(name == "discharge_curve" ? readDischargeCurve(valueText, dischargeCurve)
+                                            : readPercents(valueText, tierEnterPercents)))
+            {
+                error = "line " + std::to_string(number) + ": invalid list of " + name;
+                return false;
+            }
+            continue;
+        }
+        double value = 0.0;
+        if (!(valueText >> value))
+        {
+            error = "line " + std::to_string(number) + ": invalid value of " + name;
+            return false;
+        }
+        if (!set(name, value))
+        {
+            error = "line " + std::to_string(number) + ": unknown parameter " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+double EnergyModel::chargeAt(double volts) const
+{
+    if (volts <= dischargeCurve.front().volts)
+    {
+        return dischargeCurve.front().percent;
+    }
+    for (size_t i = 1; i < dischargeCurve.size(); ++i)
+    {
+        const auto& upper = dischargeCurve[i];
+        if (volts < upper.volts)
+        {
+            const auto& lower = dischargeCurve[i - 1];
+            return lower.percent + (volts - lower.volts) / (upper.volts - lower.volts) * (upper.percent - lower.percent);
+        }
+    }
+    return dischargeCurve.back().percent;
+}
+
+double EnergyProjection::batteryDays(const EnergyModel& model) const
+{
+    const auto perDay = total();
+    return perDay > 0.0 ? model.batteryCapacityMilliampereHours * model.usableCapacityFraction / perDay : 0.0;
+}
+
+EnergyProjection project(const EnergyModel& model, const std::vector<WakePhases>& trace)
+{
+    EnergyProjection projection;
+    double totalMicroseconds = 0.0;
+    double awakeMicroseconds = 0.0;
+    for (const auto& phases : trace)
+    {
+        totalMicroseconds += double(phases.awakeMicroseconds + phases.sleepMicroseconds);
+        awakeMicroseconds += double(phases.awakeMicroseconds);
+        const auto transmitMicroseconds = std::min(double(phases.radioMicroseconds),
+                                                   phases.radioPackets * model.radioPacketMicroseconds);
+        const auto lightSleepMicroseconds = double(std::min(phases.lightSleepMicroseconds,
+                                                            phases.awakeMicroseconds));
+        projection.cpu += charge(model.cpuActiveMilliamperes,
+                                 double(phases.awakeMicroseconds) - lightSleepMicroseconds);
+        projection.lightSleep += charge(model.lightSleepMilliamperes, lightSleepMicroseconds);
+        projection.wifi += charge(model.wifiMilliamperes, double(phases.wifiMicroseconds));
+        projection.radioTransmit += charge(model.radioTransmitMilliamperes, transmitMicroseconds);
+        projection.radioReceive += charge(model.radioReceiveMilliamperes,
+                                          double(phases.radioMicroseconds) - transmitMicroseconds);
+        projection.epd += charge(model.epdBusyMilliamperes, double(phases.epdBusyMicroseconds));
+        projection.fan += charge(model.fanMilliamperes, double(phases.fanMicroseconds));
+        projection.sleep += charge(model.deepSleepMilliamperes, double(phases.sleepMicroseconds));
+    }
+    if (totalMicroseconds <= 0.0)
+    {
+        return projection;
+    }
+    projection.days = totalMicroseconds / microsecondsInDay;
+    const auto perDay = [&projection](double value) { return value / projection.days; };
+    projection.wakesPerDay = perDay(double(trace.size()));
+    projection.awakeSecondsPerDay = perDay(awakeMicroseconds / 1e6);
+    for (auto* value : {&projection.cpu, &projection.lightSleep, &projection.wifi, &projection.radioReceive,
+                        &projection.radioTransmit, &projection.epd, &projection.fan, &projection.sleep})
+    {
+        *value = perDay(*value);
+    }
+    return projection;
+}
+
+std::vector<TierRuntime> tierRuntimes(const EnergyModel& model, const std::vector<EnergyProjection>& tierProjections)
+{
+    std::vector<TierRuntime> runtimes;
+    const auto cutoffPercent = model.chargeAt(model.cutoffVolts);
+    auto upperPercent = 100.0;
+    for (size_t tier = 0; tier < tierProjections.size() && upperPercent > cutoffPercent; ++tier)
+    {
+        TierRuntime runtime;
+        runtime.upperPercent = upperPercent;
+        const bool last = tier + 1 == tierProjections.size() || tier == model.tierEnterPercents.size();
+        runtime.lowerPercent = last ? cutoffPercent : std::max(model.tierEnterPercents[tier], cutoffPercent);
+        const auto perDay = tierProjections[tier].total();
+        const auto charge = model.batteryCapacityMilliampereHours * model.usableCapacityFraction
+                            * (runtime.upperPercent - runtime.lowerPercent) / 100.0;
+        runtime.days = perDay > 0.0 ? charge / perDay : 0.0;
+        runtimes.push_back(runtime);
+        upperPercent = runtime.lowerPercent;
+    }
+    return runtimes;
+}
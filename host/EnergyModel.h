@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Durations of the power states within one wake cycle, from the start of the wake to the start of the next one.
+// The states overlap: the radio and the display draw on top of the active CPU, the SPS30 fan may run through the sleep.
+struct WakePhases
+{
+    int64_t startMicroseconds = 0;
+    int64_t awakeMicroseconds = 0;
+    int64_t sleepMicroseconds = 0;
+    int64_t wifiMicroseconds = 0;
+    int64_t radioMicroseconds = 0;
+    uint32_t radioPackets = 0;
+    int64_t epdBusyMicroseconds = 0;
+    int64_t fanMicroseconds = 0;
+    // Part of the awake time the CPU spent in the automatic light sleep
+    int64_t lightSleepMicroseconds = 0;
+};
+
+// The trace is a text file with a wake per line, the fields go in the order of WakePhases, the lines starting
+// with # are comments. The host simulator writes it with --wake-trace. The light sleep field may be missing
+// in the traces written before it was added.
+void writeTraceHeader(std::ostream& output);
+void writeTraceLine(std::ostream& output, const WakePhases& phases);
+// Returns nothing if a line can't be parsed, the number of the line is put to errorLine
+std::optional<std::vector<WakePhases>> readTrace(std::istream& input, size_t& errorLine);
+
+// Currents drawn from the battery in every state, the radio and display currents are in addition to the active CPU
+struct EnergyModel
+{
+    double cpuActiveMilliamperes = 45.0;
+    // The light sleep of the awake CPU replaces its active current
+    double lightSleepMilliamperes = 0.8;
+    double wifiMilliamperes = 75.0;
+    double radioReceiveMilliamperes = 60.0;
+    double radioTransmitMilliamperes = 140.0;
+    // Air time of a packet with the wait for its MAC acknowledgement
+    double radioPacketMicroseconds = 600.0;
+    double epdBusyMilliamperes = 8.0;
+    // The 5 V fan through the step-up converter
+    double fanMilliamperes = 95.0;
+    double deepSleepMilliamperes = 0.12;
+    double batteryCapacityMilliampereHours = 2500.0;
+    double usableCapacityFraction = 0.85;
+
+    struct DischargePoint
+    {
+        double volts;
+        double percent;
+    };
+    // Open-circuit voltage of the cell against its charge, ascending, as in main/BatteryModel.cpp
+    std::vector<DischargePoint> dischargeCurve {
+            {3.00, 0}, {3.30, 2}, {3.45, 5}, {3.55, 10}, {3.65, 20}, {3.72, 30}, {3.78, 40}, {3.84, 50}, {3.92, 60},
+            {4.05, 80}, {4.20, 100}};
+    // The regulator of the board drops out below this voltage of the cell
+    double cutoffVolts = 3.30;
+    // Charge in percents below which the lower power tiers are entered, as in main/BatteryModel.cpp
+    std::vector<double> tierEnterPercents {30, 15, 5};
+
+    // Sets the parameter by its name in the model file, returns false for an unknown name
+    bool set(const std::string& name, double value);
+    // Reads "name = value" lines, the lines starting with # are comments. The discharge curve is a list of
+    // volts:percent pairs and the tier thresholds a list of percents.
+    bool load(std::istream& input, std::string& error);
+    // Charge in percents at the open-circuit voltage, interpolated on the discharge curve
+    [[nodiscard]] double chargeAt(double volts) const;
+};
+
+// Charge drawn per day by every state in mAh
+struct EnergyProjection
+{
+    double days = 0.0;
+    double wakesPerDay = 0.0;
+    double awakeSecondsPerDay = 0.0;
+    double cpu = 0.0;
+    double lightSleep = 0.0;
+    double wifi = 0.0;
+    double radioReceive = 0.0;
+    double radioTransmit = 0.0;
+    double epd = 0.0;
+    double fan = 0.0;
+    double sleep = 0.0;
+
+    [[nodiscard]] double total() const { return cpu + lightSleep + wifi + radioReceive + radioTransmit + epd + fan + sleep; }
+    [[nodiscard]] double batteryDays(const EnergyModel& model) const;
+};
+
+[[nodiscard]] EnergyProjection project(const EnergyModel& model, const std::vector<WakePhases>& trace);
+
+// Part of the discharge spent in a power tier, from the charge it's entered at to the one the next tier or
+// the cutoff takes over at
+struct TierRuntime
+{
+    double upperPercent = 0.0;
+    double lowerPercent = 0.0;
+    double days = 0.0;
+};
+
+// Runtime of the battery in every power tier, the projections are of the traces recorded in the tiers from
+// the highest one; the last projection runs down to the cutoff, so fewer traces than tiers stand for the lower
+// tiers behaving like the last one
+[[nodiscard]] std::vector<TierRuntime> tierRuntimes(const EnergyModel& model,
+                                                    const std::vector<EnergyProjection>& tierProjections);
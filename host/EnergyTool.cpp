@@ -0,0 +1,181 @@
+#include "EnergyModel.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Projects the battery consumption of the wake traces written by the simulator or collected from the device.
+// Every trace is a column, so the variants of the firmware policies are compared by the battery days. With --tiers
+// the traces are the power tiers from the highest one and the runtime of the battery is split among them.
+namespace
+{
+
+struct Variant
+{
+    std::string label;
+    EnergyProjection projection;
+    TierRuntime tierRuntime;
+};
+
+void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--model FILE] [--set NAME=VALUE]... [--tiers] [LABEL=]TRACE..." << std::endl;
+}
+
+bool loadVariant(const std::string& argument, const EnergyModel& model, Variant& variant)
+{
+    const auto separator = argument.find('=');
+    const auto path = separator == std::string::npos ? argument : argument.substr(separator + 1);
+    variant.label = separator == std::string::npos ? argument : argument.substr(0, separator);
+    std::ifstream input(path);
+    if (!input)
+    {
+        std::cerr << "Can't open " << path << std::endl;
+        return false;
+    }
+    size_t errorLine = 0;
+    const auto trace = readTrace(input, errorLine);
+    if (!trace)
+    {
+        std::cerr << path << ":" << errorLine << ": invalid trace line" << std::endl;
+        return false;
+    }
+    if (trace->empty())
+    {
+        std::cerr << path << ": no wakes" << std::endl;
+        return false;
+    }
+    variant.projection = project(model, *trace);
+    return true;
+}
+
+void printRow(const std::string& name, const std::vector<Variant>& variants, double (*value)(const Variant&),
+              int precision)
+{
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(precision);
+    for (const auto& variant : variants)
+    {
+        std::cout << std::setw(16) << value(variant);
+    }
+    std::cout << "\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    EnergyModel model;
+    std::vector<std::string> traces;
+    bool tiers = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        if (argument == "--model" && i + 1 < argc)
+        {
+            std::ifstream input(argv[++i]);
+            std::string error;
+            if (!input || !model.load(input, error))
+            {
+                std::cerr << argv[i] << ": " << (input ? error : "can't open") << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--set" && i + 1 < argc)
+        {
+            const std::string assignment = argv[++i];
+            const auto separator = assignment.find('=');
+            if (separator == std::string::npos
+                || !model.set(assignment.substr(0, separator), std::atof(assignment.c_str() + separator + 1)))
+            {
+                std::cerr << "Invalid parameter " << assignment << std::endl;
+                return 1;
+            }
+        }
+        else if (argument == "--tiers")
+        {
+            tiers = true;
+        }
+        else if (argument.rfind("--", 0) == 0)
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            traces.push_back(argument);
+        }
+    }
+    if (traces.empty())
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Variant> variants(traces.size());
+    for (size_t i = 0; i < traces.size(); ++i)
+    {
+        if (!loadVariant(traces[i], model, variants[i]))
+        {
+            return 1;
+        }
+    }
+
+    std::cout << std::left << std::setw(24) << "" << std::right;
+    for (const auto& variant : variants)
+    {
+        std::cout << std::setw(16) << variant.label.substr(0, 15);
+    }
+    std::cout << "\n";
+    printRow("Traced days", variants, [](const Variant& v) { return v.projection.days; }, 2);
+    printRow("Wakes per day", variants, [](const Variant& v) { return v.projection.wakesPerDay; }, 1);
+    printRow("Awake s per day", variants, [](const Variant& v) { return v.projection.awakeSecondsPerDay; }, 1);
+    printRow("CPU mAh/day", variants, [](const Variant& v) { return v.projection.cpu; }, 2);
+    printRow("Light sleep mAh/day", variants, [](const Variant& v) { return v.projection.lightSleep; }, 2);
+    printRow("Wi-Fi mAh/day", variants, [](const Variant& v) { return v.projection.wifi; }, 2);
+    printRow("Radio RX mAh/day", variants, [](const Variant& v) { return v.projection.radioReceive; }, 2);
+    printRow("Radio TX mAh/day", variants, [](const Variant& v) { return v.projection.radioTransmit; }, 2);
+    printRow("EPD mAh/day", variants, [](const Variant& v) { return v.projection.epd; }, 2);
+    printRow("SPS30 fan mAh/day", variants, [](const Variant& v) { return v.projection.fan; }, 2);
+    printRow("Deep sleep mAh/day", variants, [](const Variant& v) { return v.projection.sleep; }, 2);
+    printRow("Total mAh/day", variants, [](const Variant& v) { return v.projection.total(); }, 2);
+    const auto batteryDays = [&model](const Variant& v) { return v.projection.batteryDays(model); };
+    std::cout << std::left << std::setw(24) << "Battery days" << std::right << std::fixed << std::setprecision(1);
+    for (const auto& variant : variants)
+    {
+        std::cout << std::setw(16) << batteryDays(variant);
+    }
+    std::cout << "\n" << std::left << std::setw(24) << "Versus first" << std::right << std::showpos;
+    for (const auto& variant : variants)
+    {
+        const auto base = batteryDays(variants.front());
+        std::cout << std::setw(15) << (base > 0.0 ? (batteryDays(variant) / base - 1.0) * 100.0 : 0.0) << "%";
+    }
+    std::cout << std::noshowpos << std::endl;
+    if (!tiers)
+    {
+        return 0;
+    }
+
+    std::vector<EnergyProjection> projections;
+    for (const auto& variant : variants)
+    {
+        projections.push_back(variant.projection);
+    }
+    const auto runtimes = tierRuntimes(model, projections);
+    double runtimeDays = 0.0;
+    // The tiers entered below the cutoff have no runtime, their columns stay at zero
+    for (size_t i = 0; i < runtimes.size(); ++i)
+    {
+        variants[i].tierRuntime = runtimes[i];
+        runtimeDays += runtimes[i].days;
+    }
+    printRow("Tier from %", variants, [](const Variant& v) { return v.tierRuntime.upperPercent; }, 1);
+    printRow("Tier down to %", variants, [](const Variant& v) { return v.tierRuntime.lowerPercent; }, 1);
+    printRow("Days in tier", variants, [](const Variant& v) { return v.tierRuntime.days; }, 1);
+    std::cout << std::left << std::setw(24) << "Runtime days" << std::right << std::setprecision(1)
+              << std::setw(16) << runtimeDays << std::endl;
+    return 0;
+}
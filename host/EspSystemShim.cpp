@@ -0,0 +1,320 @@
+#include "ShimCommon.h"
+#include "VirtualKernel.h"
+
+#include <esp_pm.h>
+#include <esp_random.h>
+#include <esp_rom_sys.h>
+#include <esp_sleep.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
+#include <soc/rtc.h>
+
+#include <sys/time.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+
+using simulation::VirtualKernel;
+
+struct esp_pm_lock
+{
+    std::string name;
+    int count = 0;
+};
+
+namespace
+{
+
+constexpr int64_t slowClockHz = 32768;
+// Slow clock period in microseconds multiplied by 2^19 for the 32 kHz crystal
+constexpr uint32_t slowClockCalibration = 16000000;
+
+int64_t wallClockOffset = 0;
+uint64_t timerWakeup = 0;
+bool wokenFromDeepSleep = false;
+std::mt19937 randomGenerator(1);
+
+// The tickless idle enters the light sleep only if the idle period is longer, CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP
+constexpr int64_t idleTimeBeforeSleepMicroseconds = 3000;
+
+struct PowerManagementState
+{
+    bool lightSleepEnabled = false;
+    // Locks acquired at least once, any of them keeps the chip out of the light sleep
+    int heldLocks = 0;
+    esp_pm_light_sleep_cb_t exitCallback = nullptr;
+    void* exitArgument = nullptr;
+};
+
+PowerManagementState powerManagement;
+std::set<esp_pm_lock*> powerLocks;
+
+void onIdle(int64_t from, int64_t to)
+{
+    if (!powerManagement.lightSleepEnabled || powerManagement.heldLocks != 0 || simulation::isCpuBusy()
+        || to - from < idleTimeBeforeSleepMicroseconds)
+    {
+        return;
+    }
+    simulation::platformStatistics.lightSleepMicroseconds += to - from;
+    ++simulation::platformStatistics.lightSleeps;
+    if (powerManagement.exitCallback)
+    {
+        powerManagement.exitCallback(to - from, powerManagement.exitArgument);
+    }
+}
+
+const bool powerManagementRegistered = []
+{
+    auto& kernel = VirtualKernel::instance();
+    kernel.setIdleHandler(&onIdle);
+    kernel.addResetHandler([]
+    {
+        // The lock objects of the firmware stay in the host memory, only their state is reset
+        for (auto* lock : powerLocks)
+        {
+            lock->count = 0;
+        }
+        powerManagement = PowerManagementState {};
+    });
+    return true;
+}();
+
+}
+
+namespace simulation
+{
+
+int64_t wallClockMicroseconds()
+{
+    return VirtualKernel::instance().now() + wallClockOffset;
+}
+
+void setWallClock(int64_t microseconds)
+{
+    wallClockOffset = microseconds - VirtualKernel::instance().now();
+}
+
+void setRandomSeed(uint32_t seed)
+{
+    randomGenerator.seed(seed);
+}
+
+}
+
+extern "C" int __wrap_gettimeofday(timeval* tv, void* /*tz*/)
+{
+    if (tv)
+    {
+        const auto now = simulation::wallClockMicroseconds();
+        tv->tv_sec = static_cast<time_t>(now / 1000000);
+        tv->tv_usec = static_cast<suseconds_t>(now % 1000000);
+    }
+    return 0;
+}
+
+extern "C" int __wrap_settimeofday(const timeval* tv, const void* /*tz*/)
+{
+    if (tv)
+    {
+        simulation::setWallClock(int64_t(tv->tv_sec) * 1000000 + tv->tv_usec);
+    }
+    return 0;
+}
+
+extern "C" time_t __wrap_time(time_t* result)
+{
+    const auto now = static_cast<time_t>(simulation::wallClockMicroseconds() / 1000000);
+    if (result)
+    {
+        *result = now;
+    }
+    return now;
+}
+
+uint32_t esp_random()
+{
+    return randomGenerator();
+}
+
+void esp_fill_random(void* buf, size_t len)
+{
+    auto* bytes = static_cast<uint8_t*>(buf);
+    for (size_t i = 0; i < len; ++i)
+    {
+        bytes[i] = static_cast<uint8_t>(randomGenerator());
+    }
+}
+
+esp_reset_reason_t esp_reset_reason()
+{
+    return wokenFromDeepSleep ? ESP_RST_DEEPSLEEP : ESP_RST_POWERON;
+}
+
+void esp_restart()
+{
+    std::cerr << "esp_restart() is not supported by the simulation" << std::endl;
+    std::abort();
+}
+
+uint32_t esp_get_free_heap_size()
+{
+    return 200000;
+}
+
+int64_t esp_timer_get_time()
+{
+    auto& kernel = VirtualKernel::instance();
+    return kernel.now() - kernel.getBootTime();
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    simulation::busyFor(us);
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    timerWakeup = time_in_us;
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause()
+{
+    return wokenFromDeepSleep ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+void esp_deep_sleep_start()
+{
+    wokenFromDeepSleep = true;
+    VirtualKernel::instance().enterDeepSleep(timerWakeup);
+}
+
+void esp_deep_sleep(uint64_t time_in_us)
+{
+    esp_sleep_enable_timer_wakeup(time_in_us);
+    esp_deep_sleep_start();
+}
+
+esp_err_t esp_light_sleep_start()
+{
+    auto& kernel = VirtualKernel::instance();
+    kernel.wait(kernel.now() + int64_t(timerWakeup), [] { return false; });
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_configure(const void* config)
+{
+    if (!config)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    powerManagement.lightSleepEnabled = static_cast<const esp_pm_config_t*>(config)->light_sleep_enable;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t /*lock_type*/, int /*arg*/, const char* name,
+                             esp_pm_lock_handle_t* out_handle)
+{
+    if (!out_handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto* lock = new esp_pm_lock;
+    lock->name = name ? name : "";
+    powerLocks.insert(lock);
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    if (!handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count++ == 0)
+    {
+        ++powerManagement.heldLocks;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (!handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (--handle->count == 0)
+    {
+        --powerManagement.heldLocks;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+    if (!handle)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count != 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    powerLocks.erase(handle);
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_dump_locks(FILE* stream)
+{
+    for (const auto* lock : powerLocks)
+    {
+        fprintf(stream, "%-15s %d\n", lock->name.c_str(), lock->count);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_light_sleep_register_cbs(esp_pm_sleep_cbs_register_config_t* cbs_conf)
+{
+    if (!cbs_conf)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    powerManagement.exitCallback = cbs_conf->exit_cb;
+    powerManagement.exitArgument = cbs_conf->exit_cb_user_arg;
+    return ESP_OK;
+}
+
+uint32_t rtc_clk_cal(rtc_cal_sel_t /*cal_clk*/, uint32_t slow_clk_cycles)
+{
+    // The calibration counts the slow clock cycles against the main clock
+    simulation::busyFor(int64_t(slow_clk_cycles) * 1000000 / slowClockHz);
+    return slowClockCalibration;
+}
+
+uint64_t rtc_time_get()
+{
+    return uint64_t(VirtualKernel::instance().now()) * slowClockHz / 1000000;
+}
+
+esp_err_t nvs_flash_init()
+{
+    simulation::busyFor(simulation::initCosts.nvsFlashInitMicroseconds);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase()
+{
+    return ESP_OK;
+}
@@ -0,0 +1,573 @@
+#include "ShimCommon.h"
+#include "VirtualKernel.h"
+
+#include <esp_event.h>
+#include <esp_http_client.h>
+#include <esp_netif.h>
+#include <esp_now.h>
+#include <esp_pm.h>
+#include <esp_sntp.h>
+#include <esp_wifi.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using simulation::VirtualKernel;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+struct esp_netif_obj
+{
+};
+
+struct esp_http_client
+{
+    std::string url;
+    esp_http_client_method_t method = HTTP_METHOD_GET;
+    int timeoutMs = 5000;
+    std::vector<uint8_t> body;
+    int statusCode = 0;
+};
+
+namespace
+{
+
+struct HandlerRecord
+{
+    esp_event_base_t base = nullptr;
+    int32_t id = ESP_EVENT_ANY_ID;
+    esp_event_handler_t handler = nullptr;
+    void* argument = nullptr;
+};
+
+struct NetworkState
+{
+    std::vector<HandlerRecord> handlers;
+    bool started = false;
+    bool connected = false;
+    bool associating = false;
+    int64_t startTime = 0;
+    // Invalidates the pending events of the previous start
+    uint32_t generation = 0;
+    bool sntpEnabled = false;
+    sntp_sync_status_t sntpStatus = SNTP_SYNC_STATUS_RESET;
+    sntp_sync_time_cb_t sntpCallback = nullptr;
+    bool espNowInitialized = false;
+    esp_now_recv_cb_t receiveCallback = nullptr;
+    esp_now_send_cb_t sendCallback = nullptr;
+    std::vector<RadioInterface::MacAddress> peers;
+};
+
+simulation::NetworkParameters networkParameters;
+NetworkState state;
+simulation::HttpServer httpServer;
+RadioInterface* espNowRadio = nullptr;
+
+// The driver keeps the APB clock and the chip awake while the radio is on
+esp_pm_lock_handle_t wifiLock()
+{
+    static esp_pm_lock_handle_t lock = []
+    {
+        esp_pm_lock_handle_t handle = nullptr;
+        esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "wifi", &handle);
+        return handle;
+    }();
+    return lock;
+}
+
+RadioInterface::MacAddress toMac(const uint8_t* address)
+{
+    RadioInterface::MacAddress mac {};
+    std::copy(address, address + mac.size(), mac.begin());
+    return mac;
+}
+
+void postEvent(esp_event_base_t base, int32_t id, int64_t delay)
+{
+    const auto generation = state.generation;
+    VirtualKernel::instance().schedule(VirtualKernel::instance().now() + delay, [base, id, generation]
+    {
+        if (generation != state.generation)
+        {
+            return;
+        }
+        const auto handlers = state.handlers;
+        for (const auto& record : handlers)
+        {
+            if (record.base == base && (record.id == ESP_EVENT_ANY_ID || record.id == id))
+            {
+                record.handler(record.argument, base, id, nullptr);
+            }
+        }
+    });
+}
+
+void stopRadio()
+{
+    if (state.started)
+    {
+        const auto onTime = VirtualKernel::instance().now() - state.startTime;
+        simulation::platformStatistics.wifiOnMicroseconds += onTime;
+        if (state.associating)
+        {
+            simulation::platformStatistics.stationMicroseconds += onTime;
+        }
+        esp_pm_lock_release(wifiLock());
+        state.started = false;
+        state.connected = false;
+        state.associating = false;
+        ++state.generation;
+    }
+}
+
+void scheduleSntpRequest()
+{
+    auto& kernel = VirtualKernel::instance();
+    kernel.schedule(kernel.now() + networkParameters.sntpMicroseconds, []
+    {
+        if (!state.sntpEnabled)
+        {
+            return;
+        }
+        if (!state.connected || !networkParameters.sntpServerAvailable)
+        {
+            scheduleSntpRequest();
+            return;
+        }
+        simulation::setWallClock(simulation::realTimeMicroseconds());
+        state.sntpStatus = SNTP_SYNC_STATUS_COMPLETED;
+        ++simulation::platformStatistics.sntpSynchronizations;
+        if (state.sntpCallback)
+        {
+            timeval tv {};
+            gettimeofday(&tv, nullptr);
+            state.sntpCallback(&tv);
+        }
+    });
+}
+
+void onRadioReceive(void* /*context*/, const RadioInterface::ReceiveInfo& info, const uint8_t* data, size_t size)
+{
+    if (state.receiveCallback)
+    {
+        auto source = info.source;
+        wifi_pkt_rx_ctrl_t control {};
+        control.rssi = info.rssi;
+        control.sig_len = static_cast<unsigned>(size);
+        esp_now_recv_info_t receiveInfo { source.data(), nullptr, &control };
+        state.receiveCallback(&receiveInfo, data, static_cast<int>(size));
+    }
+}
+
+void onRadioSend(void* /*context*/, const RadioInterface::MacAddress& destination, bool delivered)
+{
+    if (state.sendCallback)
+    {
+        state.sendCallback(destination.data(), delivered ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+    }
+}
+
+const bool resetRegistered = []
+{
+    VirtualKernel::instance().addResetHandler([]
+    {
+        stopRadio();
+        if (state.espNowInitialized && espNowRadio)
+        {
+            espNowRadio->deinit();
+        }
+        // The radio starts on the default channel after the reset
+        if (espNowRadio)
+        {
+            espNowRadio->setChannel(1);
+        }
+        state = NetworkState {};
+    });
+    return true;
+}();
+
+}
+
+namespace simulation
+{
+
+void setNetworkParameters(const NetworkParameters& parameters)
+{
+    networkParameters = parameters;
+}
+
+int64_t realTimeMicroseconds()
+{
+    return networkParameters.epochAtPowerOnMicroseconds + VirtualKernel::instance().now();
+}
+
+void attachEspNowRadio(RadioInterface& radio)
+{
+    espNowRadio = &radio;
+}
+
+void setHttpServer(HttpServer server)
+{
+    httpServer = std::move(server);
+}
+
+}
+
+esp_err_t esp_event_loop_create_default()
+{
+    simulation::busyFor(simulation::initCosts.eventLoopCreateMicroseconds);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete_default()
+{
+    state.handlers.clear();
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t event_handler, void* event_handler_arg)
+{
+    state.handlers.push_back(HandlerRecord { event_base, event_id, event_handler, event_handler_arg });
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id,
+                                       esp_event_handler_t event_handler)
+{
+    auto& handlers = state.handlers;
+    handlers.erase(std::remove_if(handlers.begin(), handlers.end(), [&](const HandlerRecord& record)
+    {
+        return record.base == event_base && record.id == event_id && record.handler == event_handler;
+    }), handlers.end());
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init()
+{
+    simulation::busyFor(simulation::initCosts.netifInitMicroseconds);
+    return ESP_OK;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_sta()
+{
+    static esp_netif_obj defaultInterface;
+    return &defaultInterface;
+}
+
+void esp_netif_destroy_default_wifi(void* /*esp_netif*/)
+{
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* /*config*/)
+{
+    simulation::busyFor(simulation::initCosts.wifiInitMicroseconds);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit()
+{
+    stopRadio();
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t /*mode*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t /*storage*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t /*interface*/, wifi_config_t* /*conf*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t /*type*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start()
+{
+    if (!state.started)
+    {
+        state.started = true;
+        state.startTime = VirtualKernel::instance().now();
+        esp_pm_lock_acquire(wifiLock());
+        postEvent(WIFI_EVENT, WIFI_EVENT_STA_START, networkParameters.startMicroseconds);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop()
+{
+    if (state.started)
+    {
+        stopRadio();
+        postEvent(WIFI_EVENT, WIFI_EVENT_STA_STOP, 1000);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect()
+{
+    if (!state.started)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    state.associating = true;
+    if (networkParameters.accessPointAvailable)
+    {
+        const auto generation = state.generation;
+        auto& kernel = VirtualKernel::instance();
+        kernel.schedule(kernel.now() + networkParameters.connectMicroseconds, [generation]
+        {
+            if (generation == state.generation)
+            {
+                state.connected = true;
+                if (espNowRadio)
+                {
+                    espNowRadio->setChannel(networkParameters.accessPointChannel);
+                }
+                ++simulation::platformStatistics.wifiConnections;
+            }
+        });
+        postEvent(IP_EVENT, IP_EVENT_STA_GOT_IP, networkParameters.connectMicroseconds);
+    }
+    else
+    {
+        postEvent(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, networkParameters.failedConnectMicroseconds);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect()
+{
+    state.connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t /*second*/)
+{
+    // The connected station keeps the channel of the access point
+    if (!state.started || state.connected)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return espNowRadio && espNowRadio->setChannel(primary) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t* primary, wifi_second_chan_t* second)
+{
+    if (primary)
+    {
+        *primary = espNowRadio ? espNowRadio->getChannel() : 1;
+    }
+    if (second)
+    {
+        *second = WIFI_SECOND_CHAN_NONE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t /*ifx*/, uint8_t mac[6])
+{
+    static constexpr uint8_t defaultMac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+    std::memcpy(mac, defaultMac, sizeof(defaultMac));
+    return ESP_OK;
+}
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t /*operating_mode*/)
+{
+}
+
+void esp_sntp_setservername(uint8_t /*idx*/, const char* /*server*/)
+{
+}
+
+void esp_sntp_init()
+{
+    state.sntpEnabled = true;
+    state.sntpStatus = SNTP_SYNC_STATUS_IN_PROGRESS;
+    scheduleSntpRequest();
+}
+
+void esp_sntp_stop()
+{
+    state.sntpEnabled = false;
+}
+
+bool esp_sntp_enabled()
+{
+    return state.sntpEnabled;
+}
+
+void esp_sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+    state.sntpCallback = callback;
+}
+
+sntp_sync_status_t sntp_get_sync_status()
+{
+    return state.sntpStatus;
+}
+
+esp_err_t esp_now_init()
+{
+    if (!espNowRadio || !state.started || !espNowRadio->init())
+    {
+        return ESP_FAIL;
+    }
+    espNowRadio->setCallbacks(nullptr, &onRadioReceive, &onRadioSend);
+    state.espNowInitialized = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_deinit()
+{
+    if (state.espNowInitialized)
+    {
+        espNowRadio->deinit();
+        state.espNowInitialized = false;
+        state.peers.clear();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+    state.receiveCallback = cb;
+    return state.espNowInitialized ? ESP_OK : ESP_ERR_ESPNOW_NOT_INIT;
+}
+
+esp_err_t esp_now_unregister_recv_cb()
+{
+    state.receiveCallback = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb)
+{
+    state.sendCallback = cb;
+    return state.espNowInitialized ? ESP_OK : ESP_ERR_ESPNOW_NOT_INIT;
+}
+
+esp_err_t esp_now_unregister_send_cb()
+{
+    state.sendCallback = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer)
+{
+    if (!state.espNowInitialized)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    const auto mac = toMac(peer->peer_addr);
+    if (std::find(state.peers.begin(), state.peers.end(), mac) != state.peers.end())
+    {
+        return ESP_ERR_ESPNOW_EXIST;
+    }
+    state.peers.push_back(mac);
+    return espNowRadio->addPeer(mac) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t* peer_addr)
+{
+    const auto mac = toMac(peer_addr);
+    const auto iterator = std::find(state.peers.begin(), state.peers.end(), mac);
+    if (iterator == state.peers.end())
+    {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    state.peers.erase(iterator);
+    return ESP_OK;
+}
+
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t* peer)
+{
+    return esp_now_is_peer_exist(peer->peer_addr) ? ESP_OK : ESP_ERR_ESPNOW_NOT_FOUND;
+}
+
+bool esp_now_is_peer_exist(const uint8_t* peer_addr)
+{
+    const auto mac = toMac(peer_addr);
+    return std::find(state.peers.begin(), state.peers.end(), mac) != state.peers.end();
+}
+
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t len)
+{
+    if (!state.espNowInitialized)
+    {
+        return ESP_ERR_ESPNOW_NOT_INIT;
+    }
+    if (len > ESP_NOW_MAX_DATA_LEN)
+    {
+        return ESP_ERR_ESPNOW_ARG;
+    }
+    return espNowRadio->send(toMac(peer_addr), data, len) ? ESP_OK : ESP_FAIL;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config)
+{
+    auto* client = new esp_http_client;
+    client->url = config->url != nullptr ? config->url : "";
+    client->method = config->method;
+    if (config->timeout_ms > 0)
+    {
+        client->timeoutMs = config->timeout_ms;
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t /*client*/, const char* /*key*/, const char* /*value*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char* data, int len)
+{
+    client->body.assign(data, data + len);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    auto& kernel = VirtualKernel::instance();
+    const auto start = kernel.now();
+    const auto timeout = static_cast<int64_t>(client->timeoutMs) * 1000;
+    const auto duration = networkParameters.httpRoundTripMicroseconds
+        + static_cast<int64_t>(client->body.size()) * 1000000 / networkParameters.uplinkBytesPerSecond;
+    ++simulation::platformStatistics.httpRequests;
+    const bool reachable = state.connected && networkParameters.httpServerAvailable && httpServer;
+    // The task waits for the network, the driver holds its lock meanwhile
+    kernel.wait(start + (reachable ? std::min(duration, timeout) : timeout), [] { return false; });
+    simulation::platformStatistics.httpMicroseconds += kernel.now() - start;
+    if (!reachable || duration > timeout || !state.connected)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    simulation::platformStatistics.httpBytes += client->body.size();
+    client->statusCode = httpServer(client->url, client->body.data(), client->body.size());
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->statusCode;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    delete client;
+    return ESP_OK;
+}
@@ -0,0 +1,211 @@
+#include "FakeBme280.h"
+
+#include "VirtualKernel.h"
+
+#include <algorithm>
+
+namespace
+{
+
+constexpr uint8_t chipIdRegister = 0xD0;
+constexpr uint8_t resetRegister = 0xE0;
+constexpr uint8_t humidityControlRegister = 0xF2;
+constexpr uint8_t statusRegister = 0xF3;
+constexpr uint8_t controlMeasurementRegister = 0xF4;
+constexpr uint8_t dataRegister = 0xF7;
+constexpr uint8_t chipId = 0x60;
+constexpr uint8_t measuringBit = 0x08;
+
+// Calibration of the datasheet example and a typical humidity calibration
+constexpr uint16_t digT1 = 27504;
+constexpr int16_t digT2 = 26435;
+constexpr int16_t digT3 = -1000;
+constexpr uint16_t digP1 = 36477;
+constexpr int16_t digP2 = -10685;
+constexpr int16_t digP3 = 3024;
+constexpr int16_t digP4 = 2855;
+constexpr int16_t digP5 = 140;
+constexpr int16_t digP6 = -7;
+constexpr int16_t digP7 = 15500;
+constexpr int16_t digP8 = -14600;
+constexpr int16_t digP9 = 6000;
+constexpr uint8_t digH1 = 75;
+constexpr int16_t digH2 = 362;
+constexpr uint8_t digH3 = 0;
+constexpr int16_t digH4 = 324;
+constexpr int16_t digH5 = 50;
+constexpr int8_t digH6 = 30;
+
+double fineTemperature(int32_t adcT)
+{
+    const double var1 = (adcT / 16384.0 - digT1 / 1024.0) * digT2;
+    const double delta = adcT / 131072.0 - digT1 / 8192.0;
+    return var1 + delta * delta * digT3;
+}
+
+double compensatePressure(int32_t adcP, double tFine)
+{
+    double var1 = tFine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * digP6 / 32768.0;
+    var2 = var2 + var1 * digP5 * 2.0;
+    var2 = var2 / 4.0 + digP4 * 65536.0;
+    var1 = (digP3 * var1 * var1 / 524288.0 + digP2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * digP1;
+    double p = 1048576.0 - adcP;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = digP9 * p * p / 2147483648.0;
+    var2 = p * digP8 / 32768.0;
+    return p + (var1 + var2 + digP7) / 16.0;
+}
+
+double compensateHumidity(int32_t adcH, double tFine)
+{
+    double h = tFine - 76800.0;
+    h = (adcH - (digH4 * 64.0 + digH5 / 16384.0 * h))
+        * (digH2 / 65536.0 * (1.0 + digH6 / 67108864.0 * h * (1.0 + digH3 / 67108864.0 * h)));
+    return h * (1.0 - digH1 * h / 524288.0);
+}
+
+// Finds the raw value producing the target through the monotonic compensation function
+template<typename Function>
+int32_t invert(Function&& function, double target, int32_t low, int32_t high, bool increasing)
+{
+    while (low < high)
+    {
+        const auto middle = low + (high - low) / 2;
+        const bool below = increasing ? function(middle) < target : function(middle) > target;
+        if (below)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void putLittleEndian(uint8_t* destination, uint16_t value)
+{
+    destination[0] = static_cast<uint8_t>(value & 0xFF);
+    destination[1] = static_cast<uint8_t>(value >> 8);
+}
+
+}
+
+FakeBme280::FakeBme280(ConditionsSource source)
+    : source(std::move(source))
+{
+    registers[chipIdRegister] = chipId;
+    const uint16_t temperatureAndPressure[] = {digT1, uint16_t(digT2), uint16_t(digT3), digP1, uint16_t(digP2),
+                                               uint16_t(digP3), uint16_t(digP4), uint16_t(digP5), uint16_t(digP6),
+                                               uint16_t(digP7), uint16_t(digP8), uint16_t(digP9)};
+    for (size_t i = 0; i < std::size(temperatureAndPressure); ++i)
+    {
+        putLittleEndian(&registers[0x88 + i * 2], temperatureAndPressure[i]);
+    }
+    registers[0xA1] = digH1;
+    putLittleEndian(&registers[0xE1], uint16_t(digH2));
+    registers[0xE3] = digH3;
+    registers[0xE4] = static_cast<uint8_t>(digH4 >> 4);
+    registers[0xE5] = static_cast<uint8_t>((digH4 & 0x0F) | ((digH5 & 0x0F) << 4));
+    registers[0xE6] = static_cast<uint8_t>(digH5 >> 4);
+    registers[0xE7] = static_cast<uint8_t>(digH6);
+    storeRawData(Conditions {});
+}
+
+bool FakeBme280::write(const uint8_t* data, size_t size)
+{
+    if (size == 0)
+    {
+        return true;
+    }
+    pointer = data[0];
+    // The writes go in pairs of the register address and the value
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        const auto address = data[i];
+        const auto value = data[i + 1];
+        if (address == resetRegister)
+        {
+            continue;
+        }
+        registers[address] = value;
+        if (address == controlMeasurementRegister && (value & 0x03) != 0)
+        {
+            startMeasurement();
+        }
+    }
+    return true;
+}
+
+bool FakeBme280::read(uint8_t* data, size_t size)
+{
+    updateStatus();
+    for (size_t i = 0; i < size; ++i)
+    {
+        data[i] = registers[static_cast<uint8_t>(pointer + i)];
+    }
+    return true;
+}
+
+int64_t FakeBme280::conversionMicroseconds() const
+{
+    // Maximum time of the datasheet, section 9.1, for the oversampling of the control registers
+    const auto oversampling = [](uint8_t code) { return code == 0 ? 0 : 1 << (std::min<uint8_t>(code, 5) - 1); };
+    const auto temperature = oversampling(registers[controlMeasurementRegister] >> 5);
+    const auto pressure = oversampling((registers[controlMeasurementRegister] >> 2) & 0x07);
+    const auto humidity = oversampling(registers[humidityControlRegister] & 0x07);
+    int64_t time = 1250 + 2300 * temperature;
+    if (pressure != 0)
+    {
+        time += 2300 * pressure + 575;
+    }
+    if (humidity != 0)
+    {
+        time += 2300 * humidity + 575;
+    }
+    return time;
+}
+
+void FakeBme280::startMeasurement()
+{
+    lastConversionMicroseconds = conversionMicroseconds();
+    measurementDoneTime = simulation::VirtualKernel::instance().now() + lastConversionMicroseconds;
+    registers[statusRegister] |= measuringBit;
+    ++measurementsCount;
+}
+
+void FakeBme280::updateStatus()
+{
+    if ((registers[statusRegister] & measuringBit) != 0
+        && simulation::VirtualKernel::instance().now() >= measurementDoneTime)
+    {
+        registers[statusRegister] &= ~measuringBit;
+        // The forced mode returns to the sleep mode after the conversion
+        registers[controlMeasurementRegister] &= ~0x03;
+        storeRawData(source(simulation::realTimeMicroseconds()));
+    }
+}
+
+void FakeBme280::storeRawData(const Conditions& conditions)
+{
+    constexpr int32_t maxRaw20 = (1 << 20) - 1;
+    const auto adcT = invert([](int32_t raw) { return fineTemperature(raw) / 5120.0; },
+                             conditions.temperature, 0, maxRaw20, true);
+    const auto tFine = fineTemperature(adcT);
+    const auto adcP = invert([tFine](int32_t raw) { return compensatePressure(raw, tFine); },
+                             conditions.pressure, 0, maxRaw20, false);
+    const auto adcH = invert([tFine](int32_t raw) { return compensateHumidity(raw, tFine); },
+                             std::clamp(conditions.humidity, 0.0f, 100.0f), 0, 0xFFFF, true);
+    auto* data = &registers[dataRegister];
+    data[0] = static_cast<uint8_t>(adcP >> 12);
+    data[1] = static_cast<uint8_t>(adcP >> 4);
+    data[2] = static_cast<uint8_t>((adcP & 0x0F) << 4);
+    data[3] = static_cast<uint8_t>(adcT >> 12);
+    data[4] = static_cast<uint8_t>(adcT >> 4);
+    data[5] = static_cast<uint8_t>((adcT & 0x0F) << 4);
+    data[6] = static_cast<uint8_t>(adcH >> 8);
+    data[7] = static_cast<uint8_t>(adcH & 0xFF);
+}
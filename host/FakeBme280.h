@@ -0,0 +1,45 @@
+#pragma once
+
+#include "HostPlatform.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+// Register model of the BME280 in the forced mode. The raw readings are derived from the given conditions
+// by inverting the datasheet's compensation with the fixed calibration of a real sensor.
+class FakeBme280 : public simulation::I2CPeripheral
+{
+public:
+    struct Conditions
+    {
+        float temperature = 22.0f;
+        float humidity = 45.0f;
+        float pressure = 101325.0f;
+    };
+
+    using ConditionsSource = std::function<Conditions(int64_t realTimeMicroseconds)>;
+
+    explicit FakeBme280(ConditionsSource source);
+
+    bool write(const uint8_t* data, size_t size) override;
+    bool read(uint8_t* data, size_t size) override;
+
+    [[nodiscard]] uint32_t getMeasurementsCount() const { return measurementsCount; }
+    // Conversion time of the latest measurement, given by the oversampling written before it
+    [[nodiscard]] int64_t getLastConversionMicroseconds() const { return lastConversionMicroseconds; }
+    [[nodiscard]] uint8_t getRegister(uint8_t address) const { return registers[address]; }
+
+private:
+    [[nodiscard]] int64_t conversionMicroseconds() const;
+    void startMeasurement();
+    void updateStatus();
+    void storeRawData(const Conditions& conditions);
+
+    ConditionsSource source;
+    std::array<uint8_t, 256> registers {};
+    uint8_t pointer = 0;
+    int64_t measurementDoneTime = 0;
+    uint32_t measurementsCount = 0;
+    int64_t lastConversionMicroseconds = 0;
+};
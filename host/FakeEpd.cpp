@@ -0,0 +1,76 @@
+#include "FakeEpd.h"
+
+#include "VirtualKernel.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr uint8_t softwareResetCommand = 0x12;
+constexpr uint8_t masterActivationCommand = 0x20;
+constexpr uint8_t updateControlCommand = 0x22;
+// Display mode 2 of the update control is used for the partial refresh
+constexpr uint8_t displayMode2Bit = 0x08;
+}
+
+FakeEpd::FakeEpd(int dcPin, int busyPin, const Timing& timing)
+    : dcPin(dcPin)
+    , busyPin(busyPin)
+    , timing(timing)
+{
+    // The pending end of the refresh is dropped with the deep sleep, the panel is idle on the next wake
+    simulation::VirtualKernel::instance().addResetHandler([this]
+    {
+        busyEndTime = 0;
+        simulation::setGpioInput(this->busyPin, 0);
+    });
+}
+
+void FakeEpd::receive(const uint8_t* data, size_t size)
+{
+    const bool command = simulation::getGpioOutput(dcPin) == 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (!command)
+        {
+            if (lastCommand == updateControlCommand)
+            {
+                updateControl = data[i];
+            }
+            continue;
+        }
+        lastCommand = data[i];
+        if (lastCommand == softwareResetCommand)
+        {
+            setBusy(timing.resetMicroseconds);
+        }
+        else if (lastCommand == masterActivationCommand)
+        {
+            const bool partial = (updateControl & displayMode2Bit) != 0;
+            ++(partial ? partialRefreshes : fullRefreshes);
+            if (refreshHanging)
+            {
+                simulation::setGpioInput(busyPin, 1);
+                continue;
+            }
+            setBusy(partial ? timing.partialRefreshMicroseconds : timing.fullRefreshMicroseconds);
+        }
+    }
+}
+
+void FakeEpd::setBusy(int64_t duration)
+{
+    auto& kernel = simulation::VirtualKernel::instance();
+    const auto start = std::max(kernel.now(), busyEndTime);
+    busyEndTime = start + duration;
+    busyMicroseconds += duration;
+    simulation::setGpioInput(busyPin, 1);
+    kernel.schedule(busyEndTime, [this, endTime = busyEndTime]
+    {
+        // A later command could have extended the busy period
+        if (busyEndTime == endTime)
+        {
+            simulation::setGpioInput(busyPin, 0);
+        }
+    });
+}
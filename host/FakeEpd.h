@@ -0,0 +1,42 @@
+#pragma once
+
+#include "HostPlatform.h"
+
+#include <cstdint>
+
+// Busy signalling of the e-paper controller: the master activation keeps the BUSY pin high for the refresh time,
+// the full or the partial one depending on the display mode of the last update control, the reset for a while too.
+class FakeEpd : public simulation::SpiPeripheral
+{
+public:
+    struct Timing
+    {
+        int64_t fullRefreshMicroseconds = 3000000;
+        int64_t partialRefreshMicroseconds = 600000;
+        int64_t resetMicroseconds = 10000;
+    };
+
+    FakeEpd(int dcPin, int busyPin, const Timing& timing);
+
+    void receive(const uint8_t* data, size_t size) override;
+    // The refresh never completes and BUSY stays high until the next wake, like a panel with a failed controller
+    void setRefreshHanging(bool hanging) { refreshHanging = hanging; }
+
+    [[nodiscard]] int64_t getBusyMicroseconds() const { return busyMicroseconds; }
+    [[nodiscard]] uint32_t getFullRefreshes() const { return fullRefreshes; }
+    [[nodiscard]] uint32_t getPartialRefreshes() const { return partialRefreshes; }
+
+private:
+    void setBusy(int64_t duration);
+
+    int dcPin;
+    int busyPin;
+    Timing timing;
+    uint8_t lastCommand = 0;
+    uint8_t updateControl = 0;
+    bool refreshHanging = false;
+    int64_t busyEndTime = 0;
+    int64_t busyMicroseconds = 0;
+    uint32_t fullRefreshes = 0;
+    uint32_t partialRefreshes = 0;
+};
@@ -0,0 +1,48 @@
+#include "FakeSensorProvider.h"
+
+#include "Clock.h"
+#include "ShimCommon.h"
+
+FakeSensorProvider::FakeSensorProvider(const char* name, Bus bus, const Timing& timing)
+    : sensorName(name)
+    , sensorBus(bus)
+    , timing(timing)
+{
+}
+
+bool FakeSensorProvider::start()
+{
+    transact();
+    readyAt = Clock::instance().monotonicMicroseconds() + timing.conversionMicroseconds;
+    pollsLeft = timing.pendingPolls;
+    return true;
+}
+
+SensorProvider::ReadResult FakeSensorProvider::read()
+{
+    if (Clock::instance().monotonicMicroseconds() < readyAt)
+    {
+        ++earlyReads;
+    }
+    transact();
+    if (pollsLeft != 0)
+    {
+        --pollsLeft;
+        readyAt += timing.pollIntervalMicroseconds;
+        return ReadResult::Pending;
+    }
+    return ReadResult::Done;
+}
+
+bool FakeSensorProvider::sleep()
+{
+    transact();
+    return true;
+}
+
+void FakeSensorProvider::transact()
+{
+    ++transactions;
+    wireMicroseconds += timing.transactionMicroseconds;
+    simulation::busyFor(timing.transactionMicroseconds);
+}
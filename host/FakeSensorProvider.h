@@ -0,0 +1,46 @@
+#pragma once
+
+#include "SensorProvider.h"
+
+#include <cstdint>
+
+// Provider of a sensor without a bus model, e.g. one the firmware has no driver for yet: every transaction keeps
+// the CPU busy for its transfer time, the data is ready after the conversion and stays pending for the given number
+// of polls, like the convergence of the SPS30.
+class FakeSensorProvider final : public SensorProvider
+{
+public:
+    struct Timing
+    {
+        int64_t transactionMicroseconds = 500;
+        int64_t conversionMicroseconds = 10000;
+        uint8_t pendingPolls = 0;
+        int64_t pollIntervalMicroseconds = 1000000;
+    };
+
+    FakeSensorProvider(const char* name, Bus bus, const Timing& timing);
+
+    [[nodiscard]] const char* name() const override { return sensorName; }
+    [[nodiscard]] Bus bus() const override { return sensorBus; }
+    bool start() override;
+    [[nodiscard]] int64_t readyTime() const override { return readyAt; }
+    ReadResult read() override;
+    bool sleep() override;
+
+    [[nodiscard]] uint32_t getTransactions() const { return transactions; }
+    [[nodiscard]] int64_t getWireMicroseconds() const { return wireMicroseconds; }
+    // Reads done before the ready time, zero unless the scheduler is wrong
+    [[nodiscard]] uint32_t getEarlyReads() const { return earlyReads; }
+
+private:
+    void transact();
+
+    const char* sensorName;
+    Bus sensorBus;
+    Timing timing;
+    int64_t readyAt = 0;
+    uint8_t pollsLeft = 0;
+    uint32_t transactions = 0;
+    int64_t wireMicroseconds = 0;
+    uint32_t earlyReads = 0;
+};
@@ -0,0 +1,298 @@
+#include "FakeSps30.h"
+
+#include "VirtualKernel.h"
+
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+
+constexpr uint8_t frameBoundary = 0x7E;
+constexpr uint8_t escapeByte = 0x7D;
+
+constexpr uint8_t startMeasurementCommand = 0x00;
+constexpr uint8_t stopMeasurementCommand = 0x01;
+constexpr uint8_t readMeasuredValuesCommand = 0x03;
+constexpr uint8_t sleepCommand = 0x10;
+constexpr uint8_t wakeUpCommand = 0x11;
+constexpr uint8_t fanCleaningCommand = 0x56;
+constexpr uint8_t autoCleaningIntervalCommand = 0x80;
+constexpr uint8_t deviceInformationCommand = 0xD0;
+constexpr uint8_t versionCommand = 0xD1;
+constexpr uint8_t deviceStatusCommand = 0xD2;
+constexpr uint8_t resetCommand = 0xD3;
+
+constexpr uint8_t stateOk = 0x00;
+constexpr uint8_t stateWrongLength = 0x01;
+constexpr uint8_t stateUnknownCommand = 0x02;
+constexpr uint8_t stateNotAllowed = 0x43;
+
+constexpr uint8_t unsignedFormatCode = 0x05;
+constexpr int64_t samplePeriod = 1000000;
+constexpr int64_t responseDelay = 2000;
+
+bool needsEscape(uint8_t byte)
+{
+    return byte == 0x7E || byte == 0x7D || byte == 0x11 || byte == 0x13;
+}
+
+void appendFloat(std::vector<uint8_t>& data, float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        data.push_back(static_cast<uint8_t>(bits >> shift));
+    }
+}
+
+void appendUnsigned(std::vector<uint8_t>& data, float value)
+{
+    const auto integer = static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(value, 65535.0f))));
+    data.push_back(static_cast<uint8_t>(integer >> 8));
+    data.push_back(static_cast<uint8_t>(integer & 0xFF));
+}
+
+}
+
+FakeSps30::FakeSps30(int port, ConcentrationSource source, SupplyCheck supply)
+    : port(port)
+    , source(std::move(source))
+    , supply(std::move(supply))
+{
+}
+
+void FakeSps30::receive(const uint8_t* data, size_t size)
+{
+    checkSupply();
+    if (!supply())
+    {
+        return;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+        const auto byte = data[i];
+        if (byte == frameBoundary)
+        {
+            if (inFrame && !frame.empty())
+            {
+                processFrame(frame);
+                frame.clear();
+            }
+            inFrame = true;
+            escaped = false;
+            continue;
+        }
+        if (!inFrame)
+        {
+            // The wake-up pulse and the noise between the frames
+            continue;
+        }
+        if (byte == escapeByte)
+        {
+            escaped = true;
+            continue;
+        }
+        frame.push_back(escaped ? static_cast<uint8_t>(byte ^ 0x20) : byte);
+        escaped = false;
+    }
+}
+
+int64_t FakeSps30::getFanOnMicroseconds() const
+{
+    const auto now = simulation::VirtualKernel::instance().now();
+    return fanOnMicroseconds + (state == State::Measuring ? now - measurementStart : 0);
+}
+
+void FakeSps30::checkSupply()
+{
+    if (!supply() && state != State::Idle)
+    {
+        setState(State::Idle);
+        frame.clear();
+        inFrame = false;
+    }
+}
+
+void FakeSps30::processFrame(const std::vector<uint8_t>& received)
+{
+    // Address, command, length, data and checksum
+    if (received.size() < 4 || received[2] != received.size() - 4)
+    {
+        return;
+    }
+    uint8_t sum = 0;
+    for (size_t i = 0; i + 1 < received.size(); ++i)
+    {
+        sum += received[i];
+    }
+    if (static_cast<uint8_t>(~sum) != received.back())
+    {
+        return;
+    }
+    const auto command = received[1];
+    const std::vector<uint8_t> data(received.begin() + 3, received.end() - 1);
+    if (state == State::Sleeping && command != wakeUpCommand)
+    {
+        return;
+    }
+    switch (command)
+    {
+        case startMeasurementCommand:
+            if (data.size() != 2)
+            {
+                respond(command, stateWrongLength, {});
+                break;
+            }
+            if (state == State::Measuring)
+            {
+                respond(command, stateNotAllowed, {});
+                break;
+            }
+            unsignedFormat = data[1] == unsignedFormatCode;
+            setState(State::Measuring);
+            respond(command, stateOk, {});
+            break;
+        case stopMeasurementCommand:
+            setState(State::Idle);
+            respond(command, stateOk, {});
+            break;
+        case readMeasuredValuesCommand:
+            if (state != State::Measuring)
+            {
+                respond(command, stateNotAllowed, {});
+                break;
+            }
+            respond(command, stateOk, measuredValues());
+            break;
+        case sleepCommand:
+            if (state == State::Measuring)
+            {
+                respond(command, stateNotAllowed, {});
+                break;
+            }
+            respond(command, stateOk, {});
+            setState(State::Sleeping);
+            break;
+        case wakeUpCommand:
+            if (state == State::Sleeping)
+            {
+                setState(State::Idle);
+            }
+            respond(command, stateOk, {});
+            break;
+        case fanCleaningCommand:
+            respond(command, state == State::Measuring ? stateOk : stateNotAllowed, {});
+            break;
+        case autoCleaningIntervalCommand:
+            if (data.size() == 5)
+            {
+                autoCleaningInterval = uint32_t(data[1]) << 24 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 8
+                                       | data[4];
+                respond(command, stateOk, {});
+            }
+            else
+            {
+                respond(command, stateOk, {uint8_t(autoCleaningInterval >> 24), uint8_t(autoCleaningInterval >> 16),
+                                           uint8_t(autoCleaningInterval >> 8), uint8_t(autoCleaningInterval)});
+            }
+            break;
+        case deviceInformationCommand:
+        {
+            const std::string_view text = !data.empty() && data[0] == 0x03 ? "SIMULATED0000001" : "00080000";
+            std::vector<uint8_t> answer(text.begin(), text.end());
+            answer.push_back(0);
+            respond(command, stateOk, answer);
+            break;
+        }
+        case versionCommand:
+            respond(command, stateOk, {2, 2, 0, 7, 0, 2, 0});
+            break;
+        case deviceStatusCommand:
+            respond(command, stateOk, {0, 0, 0, 0, 0});
+            break;
+        case resetCommand:
+            setState(State::Idle);
+            respond(command, stateOk, {});
+            break;
+        default:
+            respond(command, stateUnknownCommand, {});
+            break;
+    }
+}
+
+void FakeSps30::respond(uint8_t command, uint8_t responseState, const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> content {0x00, command, responseState, static_cast<uint8_t>(data.size())};
+    content.insert(content.end(), data.begin(), data.end());
+    uint8_t sum = 0;
+    for (const auto byte : content)
+    {
+        sum += byte;
+    }
+    content.push_back(static_cast<uint8_t>(~sum));
+    std::vector<uint8_t> encoded {frameBoundary};
+    for (const auto byte : content)
+    {
+        if (needsEscape(byte))
+        {
+            encoded.push_back(escapeByte);
+            encoded.push_back(static_cast<uint8_t>(byte ^ 0x20));
+        }
+        else
+        {
+            encoded.push_back(byte);
+        }
+    }
+    encoded.push_back(frameBoundary);
+    simulation::uartInject(port, encoded.data(), encoded.size(),
+                           simulation::VirtualKernel::instance().now() + responseDelay);
+}
+
+std::vector<uint8_t> FakeSps30::measuredValues()
+{
+    const auto now = simulation::VirtualKernel::instance().now();
+    // The first sample is available one second after the start, a repeated read gets no new data
+    if (now - measurementStart < samplePeriod || now - lastSampleTime < samplePeriod)
+    {
+        return {};
+    }
+    lastSampleTime = now - (now - measurementStart) % samplePeriod;
+    ++samplesRead;
+    const auto pm25 = source(simulation::realTimeMicroseconds());
+    // Typical proportions of the urban aerosol
+    const float values[] = {pm25 * 0.9f, pm25, pm25 * 1.05f, pm25 * 1.1f, pm25 * 6.0f, pm25 * 6.9f, pm25 * 7.0f,
+                            pm25 * 7.02f, pm25 * 7.03f, 0.6f};
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < std::size(values); ++i)
+    {
+        if (unsignedFormat)
+        {
+            // The typical particle size is reported in nm by the unsigned format
+            appendUnsigned(data, i + 1 == std::size(values) ? values[i] * 1000.0f : values[i]);
+        }
+        else
+        {
+            appendFloat(data, values[i]);
+        }
+    }
+    return data;
+}
+
+void FakeSps30::setState(State newState)
+{
+    const auto now = simulation::VirtualKernel::instance().now();
+    if (state == State::Measuring && newState != State::Measuring)
+    {
+        fanOnMicroseconds += now - measurementStart;
+    }
+    if (newState == State::Measuring && state != State::Measuring)
+    {
+        measurementStart = now;
+        lastSampleTime = 0;
+        ++measurements;
+    }
+    state = newState;
+}
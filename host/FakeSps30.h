@@ -0,0 +1,49 @@
+#pragma once
+
+#include "HostPlatform.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// SHDLC protocol model of the SPS30 on the UART. The sensor is powered while the supply check returns true,
+// a power loss returns it to the idle state. New samples appear every second while measuring.
+class FakeSps30 : public simulation::UartPeripheral
+{
+public:
+    // Mass concentration PM2.5 in ug/m3 at the given real time
+    using ConcentrationSource = std::function<float(int64_t realTimeMicroseconds)>;
+    using SupplyCheck = std::function<bool()>;
+
+    FakeSps30(int port, ConcentrationSource source, SupplyCheck supply);
+
+    void receive(const uint8_t* data, size_t size) override;
+
+    [[nodiscard]] int64_t getFanOnMicroseconds() const;
+    [[nodiscard]] uint32_t getMeasurements() const { return measurements; }
+    [[nodiscard]] uint32_t getSamplesRead() const { return samplesRead; }
+
+private:
+    enum class State {Idle, Measuring, Sleeping};
+
+    void checkSupply();
+    void processFrame(const std::vector<uint8_t>& frame);
+    void respond(uint8_t command, uint8_t state, const std::vector<uint8_t>& data);
+    std::vector<uint8_t> measuredValues();
+    void setState(State newState);
+
+    int port;
+    ConcentrationSource source;
+    SupplyCheck supply;
+    State state = State::Idle;
+    bool unsignedFormat = false;
+    std::vector<uint8_t> frame;
+    bool inFrame = false;
+    bool escaped = false;
+    int64_t measurementStart = 0;
+    int64_t lastSampleTime = 0;
+    int64_t fanOnMicroseconds = 0;
+    uint32_t autoCleaningInterval = 604800;
+    uint32_t measurements = 0;
+    uint32_t samplesRead = 0;
+};
@@ -0,0 +1,44 @@
+#include "FirmwareImage.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Bounds of the sections of host/firmware-image.ld, defined by the linker
+extern "C"
+{
+extern uint8_t __start_firmware_data[];
+extern uint8_t __stop_firmware_data[];
+extern uint8_t __start_firmware_bss[];
+extern uint8_t __stop_firmware_bss[];
+using StaticConstructor = void (*)();
+extern StaticConstructor __start_firmware_init_array[];
+extern StaticConstructor __stop_firmware_init_array[];
+}
+
+namespace simulation
+{
+
+namespace
+{
+// The constructors of the image aren't run by the loader, so the data is still as loaded before the first boot
+const std::vector<uint8_t>& bootData()
+{
+    static const std::vector<uint8_t> data(__start_firmware_data, __stop_firmware_data);
+    return data;
+}
+}
+
+void bootFirmwareImage()
+{
+    const auto& data = bootData();
+    std::memcpy(__start_firmware_data, data.data(), data.size());
+    std::memset(__start_firmware_bss, 0, static_cast<size_t>(__stop_firmware_bss - __start_firmware_bss));
+    // The objects constructed by the previous wake are dropped without the destructors, like on the chip
+    for (auto* constructor = __start_firmware_init_array; constructor != __stop_firmware_init_array; ++constructor)
+    {
+        (*constructor)();
+    }
+}
+
+}
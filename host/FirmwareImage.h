@@ -0,0 +1,11 @@
+#pragma once
+
+namespace simulation
+{
+
+// Boots the firmware linked into the firmware image: the initialized data gets the values of the executable,
+// the zero-initialized memory is cleared and the static constructors run. The RTC memory is kept, so only
+// the state the chip keeps through the deep sleep carries over from the previous wake.
+void bootFirmwareImage();
+
+}
@@ -0,0 +1,974 @@
+#include "EnergyModel.h"
+#include "FakeBme280.h"
+#include "FakeEpd.h"
+#include "FakeSps30.h"
+#include "FirmwareImage.h"
+#include "HostPlatform.h"
+#include "SimulatedRadio.h"
+#include "VirtualKernel.h"
+
+#include "AppConfig.h"
+#include "BringUp.h"
+#include "BusScheduler.h"
+#include "EspNowTransport.h"
+#include "HistoryTransfer.h"
+#include "HistoryUpload.h"
+#include "WakePlanner.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+extern "C" void app_main();
+
+// Runs the unmodified firmware against the simulated peripherals, radio and network for the given number of days.
+// The virtual time skips the idle periods, so a month of operation takes seconds.
+namespace
+{
+
+constexpr int64_t microsecondsInSecond = 1000000;
+constexpr int64_t microsecondsInDay = 86400 * microsecondsInSecond;
+constexpr double pi = 3.14159265358979323846;
+// The battery voltage reaches the 12-bit ADC of 3.3 V full scale through the divider of DustMonitorController
+constexpr double batteryDividerRatio = 0.5;
+constexpr double adcFullScaleVolts = 3.3;
+constexpr int adcMaxRaw = 4095;
+
+struct Options
+{
+    double days = 30.0;
+    uint32_t seed = 1;
+    double lossProbability = 0.0;
+    bool accessPointAvailable = true;
+    int64_t externalPeriodMicroseconds = 60 * microsecondsInSecond;
+    int64_t maxAwakeMicroseconds = 600 * microsecondsInSecond;
+    // Injected hangs: the SNTP server, the external unit, the display or the upload server never answer
+    bool sntpHang = false;
+    bool peerHang = false;
+    bool displayHang = false;
+    bool uploadHang = false;
+    uint8_t accessPointChannel = 1;
+    // Period of the history pulls by the external unit, zero if it doesn't pull
+    int64_t historyPullMicroseconds = 0;
+    // The external unit listens between its messages and answers the resend requests at once
+    bool externalListening = false;
+    // Period of the restarts of the external unit, zero if it never restarts
+    int64_t externalRestartMicroseconds = 0;
+    // The access point and the external unit following it move to another channel
+    uint8_t channelChange = 0;
+    int64_t channelChangeMicroseconds = 0;
+    std::string tracePath;
+    std::string wakeTracePath;
+    // Loaded voltage of the battery, the firmware chooses its power tier by it
+    double batteryVolts = 4.0;
+};
+
+void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--days N] [--seed N] [--loss P] [--no-ap] [--external-period SECONDS]"
+              << " [--max-awake SECONDS] [--hang sntp|peer|display|upload]... [--ap-channel N]"
+              << " [--channel-change CHANNEL@SECONDS] [--history-pull HOURS] [--external-listen]"
+              << " [--external-restart SECONDS] [--trace FILE] [--wake-trace FILE] [--battery VOLTS]" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (argument == "--no-ap")
+        {
+            options.accessPointAvailable = false;
+        }
+        else if (argument == "--days" && hasValue)
+        {
+            options.days = std::atof(argv[++i]);
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--loss" && hasValue)
+        {
+            options.lossProbability = std::atof(argv[++i]);
+        }
+        else if (argument == "--external-period" && hasValue)
+        {
+            options.externalPeriodMicroseconds = static_cast<int64_t>(std::atof(argv[++i]) * microsecondsInSecond);
+        }
+        else if (argument == "--max-awake" && hasValue)
+        {
+            options.maxAwakeMicroseconds = static_cast<int64_t>(std::atof(argv[++i]) * microsecondsInSecond);
+        }
+        else if (argument == "--hang" && hasValue)
+        {
+            const std::string hang = argv[++i];
+            auto* flag = hang == "sntp" ? &options.sntpHang
+                         : hang == "peer" ? &options.peerHang
+                         : hang == "display" ? &options.displayHang
+                         : hang == "upload" ? &options.uploadHang : nullptr;
+            if (!flag)
+            {
+                return false;
+            }
+            *flag = true;
+        }
+        else if (argument == "--ap-channel" && hasValue)
+        {
+            options.accessPointChannel = static_cast<uint8_t>(std::atoi(argv[++i]));
+        }
+        else if (argument == "--channel-change" && hasValue)
+        {
+            const std::string change = argv[++i];
+            const auto separator = change.find('@');
+            if (separator == std::string::npos)
+            {
+                return false;
+            }
+            options.channelChange = static_cast<uint8_t>(std::atoi(change.c_str()));
+            options.channelChangeMicroseconds = static_cast<int64_t>(std::atof(change.c_str() + separator + 1)
+                                                                     * microsecondsInSecond);
+        }
+        else if (argument == "--history-pull" && hasValue)
+        {
+            options.historyPullMicroseconds = static_cast<int64_t>(std::atof(argv[++i]) * 3600 * microsecondsInSecond);
+        }
+        else if (argument == "--external-listen")
+        {
+            options.externalListening = true;
+        }
+        else if (argument == "--external-restart" && hasValue)
+        {
+            options.externalRestartMicroseconds = static_cast<int64_t>(std::atof(argv[++i]) * microsecondsInSecond);
+        }
+        else if (argument == "--trace" && hasValue)
+        {
+            options.tracePath = argv[++i];
+        }
+        else if (argument == "--wake-trace" && hasValue)
+        {
+            options.wakeTracePath = argv[++i];
+        }
+        else if (argument == "--battery" && hasValue)
+        {
+            options.batteryVolts = std::atof(argv[++i]);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    const auto validChannel = [](uint8_t channel) { return channel >= 1 && channel <= 13; };
+    return options.days > 0 && options.externalPeriodMicroseconds > 0 && options.maxAwakeMicroseconds > 0
+           && options.historyPullMicroseconds >= 0
+           && options.batteryVolts > 0 && options.batteryVolts * batteryDividerRatio <= adcFullScaleVolts
+           && validChannel(options.accessPointChannel)
+           && (options.channelChange == 0 || validChannel(options.channelChange));
+}
+
+// Phase of the day in radians, zero at midnight
+double dayPhase(int64_t realTime)
+{
+    return 2.0 * pi * static_cast<double>(realTime % microsecondsInDay) / microsecondsInDay;
+}
+
+FakeBme280::Conditions indoorConditions(int64_t realTime)
+{
+    const auto phase = dayPhase(realTime);
+    FakeBme280::Conditions conditions;
+    conditions.temperature = static_cast<float>(22.0 + 1.5 * std::sin(phase - pi / 2));
+    conditions.humidity = static_cast<float>(45.0 - 5.0 * std::sin(phase - pi / 2));
+    // Synoptic pressure changes with a period of several days
+    const auto synopticPhase = 2.0 * pi * static_cast<double>(realTime) / (5.0 * microsecondsInDay);
+    conditions.pressure = static_cast<float>(100500.0 + 1200.0 * std::sin(synopticPhase));
+    return conditions;
+}
+
+float indoorPm25(int64_t realTime)
+{
+    // Cooking peaks in the morning and in the evening
+    const auto phase = dayPhase(realTime);
+    return static_cast<float>(6.0 + 4.0 * std::pow(std::sin(phase), 2.0) + 8.0 * std::pow(std::max(0.0, std::sin(
+            2.0 * phase - pi / 2)), 8.0));
+}
+
+EspNowTransport::DataMessage outdoorMessage(int64_t realTime)
+{
+    const auto phase = dayPhase(realTime);
+    const auto indoor = indoorConditions(realTime);
+    EspNowTransport::DataMessage message {};
+    std::strncpy(message.spsSerial, "SIMULATED0000002", sizeof(message.spsSerial) - 1);
+    const auto pm25 = 12.0 + 8.0 * std::sin(phase + pi / 3);
+    message.pm01 = static_cast<int16_t>(std::lround(pm25 * 0.8));
+    message.pm25 = static_cast<int16_t>(std::lround(pm25));
+    message.pm10 = static_cast<int16_t>(std::lround(pm25 * 1.3));
+    message.temperature = static_cast<float>(8.0 + 6.0 * std::sin(phase - pi / 2));
+    message.humidity = static_cast<float>(75.0 - 15.0 * std::sin(phase - pi / 2));
+    message.pressure = indoor.pressure;
+    message.voltage = 4.0f;
+    message.timestamp = realTime / microsecondsInSecond;
+    message.flags = EspNowTransport::DataMessage::statusReportFlag;
+    return message;
+}
+
+// Stand-in for the server collecting the history uploads, every record shall arrive once and in the order
+class UploadServer
+{
+public:
+    int receive(std::string_view /*url*/, const uint8_t* body, size_t size)
+    {
+        if (!history_upload::parseBatch(body, size, &UploadServer::onRecord, this))
+        {
+            ++malformedBatches;
+            return 400;
+        }
+        ++batches;
+        bytes += size;
+        return 200;
+    }
+
+    [[nodiscard]] uint32_t getBatches() const { return batches; }
+    [[nodiscard]] uint32_t getMalformedBatches() const { return malformedBatches; }
+    [[nodiscard]] uint32_t getRecords() const { return records; }
+    [[nodiscard]] uint32_t getMisorderedRecords() const { return misorderedRecords; }
+    [[nodiscard]] uint64_t getBytes() const { return bytes; }
+
+private:
+    static void onRecord(void* context, const HistoryRecord& record)
+    {
+        auto* server = static_cast<UploadServer*>(context);
+        if (record.time <= server->lastTime)
+        {
+            ++server->misorderedRecords;
+        }
+        server->lastTime = record.time;
+        ++server->records;
+    }
+
+    uint32_t batches = 0;
+    uint32_t malformedBatches = 0;
+    uint32_t records = 0;
+    uint32_t misorderedRecords = 0;
+    uint64_t bytes = 0;
+    uint32_t lastTime = 0;
+};
+
+// Adapts the radio medium to the event sources of the kernel
+class MediumEvents : public simulation::EventSource
+{
+public:
+    explicit MediumEvents(SimulatedMedium& medium) : medium(medium) {}
+
+    [[nodiscard]] std::optional<int64_t> nextEventTime() const override { return medium.nextEventTime(); }
+    void runNext() override { medium.runNext(); }
+
+private:
+    SimulatedMedium& medium;
+};
+
+// The outdoor unit sends its data every period and listens shortly for the acknowledgement, the unacknowledged
+// message is repeated with the same sequence number. It moves to the channel announced by the acknowledgement before
+// its next message. The mains-powered unit keeps listening between the messages and answers the resend requests.
+// With the history pull on, the acknowledgement is followed by the request of the records since the previous pull,
+// the unit listens while the chunks come and resumes the interrupted transfer after its next message.
+class ExternalUnit : public simulation::EventSource
+{
+public:
+    ExternalUnit(SimulatedMedium& medium, const RadioInterface::MacAddress& target, int64_t period, uint8_t channel)
+        : radio(medium, {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x02})
+        , target(target)
+        , period(period)
+    {
+        radio.setChannel(channel);
+        nextTime = nextPeriodStart();
+    }
+
+    [[nodiscard]] std::optional<int64_t> nextEventTime() const override { return nextTime; }
+
+    void runNext() override
+    {
+        auto& kernel = simulation::VirtualKernel::instance();
+        if (silent)
+        {
+            nextTime = nextPeriodStart();
+            return;
+        }
+        if (!listenEnd)
+        {
+            if (announcedChannel != 0 && announcedChannel != radio.getChannel())
+            {
+                radio.setChannel(announcedChannel);
+                ++channelsFollowed;
+            }
+            announcedChannel = 0;
+            powerUp();
+            if (restartPeriod != 0 && kernel.now() >= nextRestartTime)
+            {
+                sequence = 0;
+                ++restarts;
+                nextRestartTime = kernel.now() + restartPeriod;
+            }
+            message = outdoorMessage(simulation::realTimeMicroseconds());
+            message.flags |= EspNowTransport::DataMessage::sequencedFlag;
+            message.sequence = ++sequence;
+            messageAcknowledged = false;
+            sendMessage();
+            ++messagesSent;
+            if (moveTime && !recoveryMicroseconds)
+            {
+                ++messagesSinceMove;
+            }
+            repetitions = 0;
+            listenEnd = kernel.now() + listenMicroseconds;
+            nextTime = kernel.now() + repetitionMicroseconds;
+            return;
+        }
+        if (awaitingAcknowledgement && repetitions < maxRepetitions && kernel.now() < *listenEnd)
+        {
+            sendMessage();
+            ++repetitions;
+            ++messagesRepeated;
+            nextTime = std::min(kernel.now() + repetitionMicroseconds, *listenEnd);
+            return;
+        }
+        if (pulling && kernel.now() - lastChunkTime < listenMicroseconds)
+        {
+            nextTime = lastChunkTime + listenMicroseconds;
+            return;
+        }
+        if (pulling)
+        {
+            finishPull();
+        }
+        if (kernel.now() < *listenEnd)
+        {
+            nextTime = *listenEnd;
+            return;
+        }
+        listenEnd.reset();
+        if (!alwaysListening)
+        {
+            radio.deinit();
+        }
+        nextTime = nextPeriodStart();
+    }
+
+    void setHistoryPull(int64_t periodMicroseconds) { historyPullPeriod = periodMicroseconds; }
+    // The radio stays on between the messages, like the unit powered from the mains
+    void setAlwaysListening(bool value)
+    {
+        alwaysListening = value;
+        if (alwaysListening)
+        {
+            powerUp();
+        }
+    }
+
+    // The unit stops sending, like a dead battery or a crashed firmware
+    void setSilent(bool value) { silent = value; }
+    // The unit restarts before its message once in the period, like on the brown-outs of a weak battery, and counts
+    // its messages from 1 again
+    void setRestartPeriod(int64_t value)
+    {
+        restartPeriod = value;
+        nextRestartTime = simulation::VirtualKernel::instance().now() + value;
+    }
+    // The unit is moved to another channel by itself, the chip has to find it
+    void moveTo(uint8_t channel)
+    {
+        radio.setChannel(channel);
+        announcedChannel = 0;
+        moveTime = simulation::VirtualKernel::instance().now();
+        messagesSinceMove = 0;
+        recoveryMicroseconds.reset();
+    }
+
+    [[nodiscard]] uint8_t getChannel() const { return radio.getChannel(); }
+    [[nodiscard]] uint32_t getChannelsFollowed() const { return channelsFollowed; }
+    // Time from the move to the first acknowledged message and the number of the messages sent until then
+    [[nodiscard]] std::optional<int64_t> getRecoveryMicroseconds() const { return recoveryMicroseconds; }
+    [[nodiscard]] uint32_t getMessagesSinceMove() const { return messagesSinceMove; }
+
+    [[nodiscard]] uint32_t getMessagesSent() const { return messagesSent; }
+    [[nodiscard]] uint32_t getAcknowledgements() const { return acknowledgements; }
+    // Distinct messages acknowledged at least once, the chip has to pass on each of them
+    [[nodiscard]] uint32_t getMessagesAcknowledged() const { return messagesAcknowledged; }
+    [[nodiscard]] uint32_t getRestarts() const { return restarts; }
+    // Messages sent again for the missing acknowledgement and the ones sent on the resend requests
+    [[nodiscard]] uint32_t getMessagesRepeated() const { return messagesRepeated; }
+    [[nodiscard]] uint32_t getRequestsAnswered() const { return requestsAnswered; }
+    // Status reports of the internal unit decoded from the acknowledgements and the ones inconsistent with
+    // the report before, e.g. the counters going back
+    [[nodiscard]] uint32_t getStatusReports() const { return statusReports; }
+    [[nodiscard]] uint32_t getMalformedStatusReports() const { return malformedStatusReports; }
+    [[nodiscard]] const std::optional<StatusReport>& getLastStatus() const { return lastStatus; }
+    // Difference of the reported PM2.5 from the indoor air at the time of the report, the age of the measurement
+    // shows in it
+    [[nodiscard]] double getMeanPm25Error() const { return pm25Reports != 0 ? pm25ErrorSum / pm25Reports : 0.0; }
+    [[nodiscard]] double getMaxPm25Error() const { return maxPm25Error; }
+    [[nodiscard]] int64_t getRadioOnTime() const { return radio.getRadioOnTime(); }
+    [[nodiscard]] const history_transfer::HistoryReceiver::Statistics& getHistoryStatistics() const
+    {
+        return historyReceiver.getStatistics();
+    }
+    [[nodiscard]] uint32_t getPullsCompleted() const { return pullsCompleted; }
+    [[nodiscard]] uint32_t getPullsInterrupted() const { return pullsInterrupted; }
+    // Records older than the one received before, the history has to arrive in the order
+    [[nodiscard]] uint32_t getMisorderedRecords() const { return misorderedRecords; }
+    // Time from the requests to the last chunks of the sessions
+    [[nodiscard]] int64_t getPullMicroseconds() const { return pullMicroseconds; }
+
+private:
+    static constexpr int64_t listenMicroseconds = 100000;
+    static constexpr int64_t repetitionMicroseconds = 30000;
+    static constexpr uint32_t maxRepetitions = 2;
+
+    static void onReceive(void* context, const RadioInterface::ReceiveInfo&, const uint8_t* data, size_t size)
+    {
+        auto* unit = static_cast<ExternalUnit*>(context);
+        if (history_transfer::messageType(data, size) == history_transfer::MessageType::Chunk)
+        {
+            unit->onChunk(data, size);
+            return;
+        }
+        if (EspNowTransport::isResendRequest(data, size))
+        {
+            // Nothing was measured yet to answer with
+            if (unit->sequence != 0 && !unit->silent)
+            {
+                unit->sendMessage();
+                ++unit->requestsAnswered;
+            }
+            return;
+        }
+        ++unit->acknowledgements;
+        unit->awaitingAcknowledgement = false;
+        if (!unit->messageAcknowledged)
+        {
+            unit->messageAcknowledged = true;
+            ++unit->messagesAcknowledged;
+        }
+        if (const auto message = EspNowTransport::parseCorrection(data, size))
+        {
+            unit->announcedChannel = message->channel;
+            if (message->statusVersion != 0)
+            {
+                unit->registerStatus(message->statusVersion, message->status);
+            }
+        }
+        if (unit->moveTime && !unit->recoveryMicroseconds)
+        {
+            unit->recoveryMicroseconds = simulation::VirtualKernel::instance().now() - *unit->moveTime;
+        }
+        unit->startPull();
+    }
+
+    void powerUp()
+    {
+        radio.init();
+        radio.setCallbacks(this, &ExternalUnit::onReceive, nullptr);
+        radio.addPeer(target);
+    }
+
+    void sendMessage()
+    {
+        radio.send(target, reinterpret_cast<const uint8_t*>(&message), sizeof(message));
+        awaitingAcknowledgement = true;
+    }
+
+    void startPull()
+    {
+        if (historyPullPeriod == 0 || pulling
+            || (!resumePending && simulation::realTimeMicroseconds() < nextPullRealTime))
+        {
+            return;
+        }
+        const auto request = historyReceiver.makeRequest(++session, pullFrom);
+        radio.send(target, reinterpret_cast<const uint8_t*>(&request), sizeof(request));
+        pulling = true;
+        pullStartTime = simulation::VirtualKernel::instance().now();
+        lastChunkTime = pullStartTime;
+    }
+
+    void onChunk(const uint8_t* data, size_t size)
+    {
+        if (!pulling)
+        {
+            return;
+        }
+        const auto checkOrder = [](void* context, const HistoryRecord& record)
+        {
+            auto* unit = static_cast<ExternalUnit*>(context);
+            if (record.time < unit->lastRecordTime)
+            {
+                ++unit->misorderedRecords;
+            }
+            unit->lastRecordTime = record.time;
+        };
+        const auto chunksBefore = historyReceiver.getStatistics().chunks;
+        if (historyReceiver.onChunk(data, size, checkOrder, this))
+        {
+            const auto acknowledgement = historyReceiver.makeAcknowledgement();
+            radio.send(target, reinterpret_cast<const uint8_t*>(&acknowledgement), sizeof(acknowledgement));
+        }
+        if (historyReceiver.getStatistics().chunks != chunksBefore)
+        {
+            lastChunkTime = simulation::VirtualKernel::instance().now();
+        }
+        if (historyReceiver.isComplete())
+        {
+            finishPull();
+        }
+    }
+
+    void finishPull()
+    {
+        pulling = false;
+        pullMicroseconds += lastChunkTime - pullStartTime;
+        pullFrom = historyReceiver.resumeTime();
+        resumePending = !historyReceiver.isComplete();
+        if (resumePending)
+        {
+            ++pullsInterrupted;
+        }
+        else
+        {
+            ++pullsCompleted;
+            nextPullRealTime = simulation::realTimeMicroseconds() + historyPullPeriod;
+        }
+    }
+
+    void registerStatus(uint8_t version, const StatusReport& status)
+    {
+        ++statusReports;
+        const bool consistent = version == StatusReport::currentVersion && status.stateOfCharge <= 100
+                && status.deliveryRatio <= LinkStatistics::fullDeliveryRatio
+                && (!lastStatus || (status.wakes >= lastStatus->wakes
+                                    && status.deliveredCount + status.failedCount
+                                       >= lastStatus->deliveredCount + lastStatus->failedCount));
+        if (!consistent)
+        {
+            ++malformedStatusReports;
+        }
+        if (status.pm2p5 >= 0)
+        {
+            const auto error = std::fabs(status.pm2p5 - indoorPm25(simulation::realTimeMicroseconds()));
+            pm25ErrorSum += error;
+            maxPm25Error = std::max(maxPm25Error, double(error));
+            ++pm25Reports;
+        }
+        lastStatus = status;
+    }
+
+    [[nodiscard]] int64_t nextPeriodStart() const
+    {
+        // The unit keeps its schedule by the real time, independently of the simulated chip
+        const auto now = simulation::VirtualKernel::instance().now();
+        const auto realTime = simulation::realTimeMicroseconds();
+        return now + period - realTime % period;
+    }
+
+    SimulatedRadio radio;
+    RadioInterface::MacAddress target;
+    int64_t period;
+    int64_t nextTime = 0;
+    // End of the listening after the message, none between the messages
+    std::optional<int64_t> listenEnd;
+    bool alwaysListening = false;
+    EspNowTransport::DataMessage message {};
+    uint32_t sequence = 0;
+    bool awaitingAcknowledgement = false;
+    uint32_t repetitions = 0;
+    uint32_t messagesRepeated = 0;
+    uint32_t requestsAnswered = 0;
+    uint32_t messagesSent = 0;
+    uint32_t acknowledgements = 0;
+    bool messageAcknowledged = false;
+    uint32_t messagesAcknowledged = 0;
+    int64_t restartPeriod = 0;
+    int64_t nextRestartTime = 0;
+    uint32_t restarts = 0;
+    uint32_t statusReports = 0;
+    uint32_t malformedStatusReports = 0;
+    std::optional<StatusReport> lastStatus;
+    double pm25ErrorSum = 0;
+    double maxPm25Error = 0;
+    uint32_t pm25Reports = 0;
+    bool silent = false;
+    uint8_t announcedChannel = 0;
+    uint32_t channelsFollowed = 0;
+    std::optional<int64_t> moveTime;
+    std::optional<int64_t> recoveryMicroseconds;
+    uint32_t messagesSinceMove = 0;
+    int64_t historyPullPeriod = 0;
+    history_transfer::HistoryReceiver historyReceiver;
+    uint8_t session = 0;
+    bool pulling = false;
+    bool resumePending = false;
+    uint32_t pullFrom = 0;
+    int64_t nextPullRealTime = 0;
+    int64_t pullStartTime = 0;
+    int64_t lastChunkTime = 0;
+    int64_t pullMicroseconds = 0;
+    uint32_t pullsCompleted = 0;
+    uint32_t pullsInterrupted = 0;
+    uint32_t lastRecordTime = 0;
+    uint32_t misorderedRecords = 0;
+};
+
+// Awake time of the wakes of one type, the light sleep is a part of it
+struct WakeTypeStatistics
+{
+    uint32_t count = 0;
+    int64_t awakeMicroseconds = 0;
+    int64_t lightSleepMicroseconds = 0;
+
+    void add(int64_t awake, int64_t lightSleep)
+    {
+        ++count;
+        awakeMicroseconds += awake;
+        lightSleepMicroseconds += lightSleep;
+    }
+
+    [[nodiscard]] double averageMilliseconds() const
+    {
+        return count != 0 ? static_cast<double>(awakeMicroseconds) / 1000.0 / count : 0.0;
+    }
+
+    [[nodiscard]] double averageLightSleepMilliseconds() const
+    {
+        return count != 0 ? static_cast<double>(lightSleepMicroseconds) / 1000.0 / count : 0.0;
+    }
+};
+
+// Latency of the device bring-up of the full wakes against the same jobs run one after another
+struct BringUpAverages
+{
+    uint32_t count = 0;
+    int64_t criticalPathMicroseconds = 0;
+    int64_t sequentialMicroseconds = 0;
+
+    void add(const BringUp::Statistics& statistics)
+    {
+        ++count;
+        criticalPathMicroseconds += statistics.criticalPathMicroseconds;
+        sequentialMicroseconds += statistics.sequentialMicroseconds;
+    }
+
+    [[nodiscard]] double averageMilliseconds(int64_t microseconds) const
+    {
+        return count != 0 ? static_cast<double>(microseconds) / 1000.0 / count : 0.0;
+    }
+};
+
+double toSeconds(int64_t microseconds)
+{
+    return static_cast<double>(microseconds) / microsecondsInSecond;
+}
+
+// The chip constructs the globals again on every boot, the deep sleep keeps only the RTC memory
+void bootFirmware()
+{
+    simulation::bootFirmwareImage();
+    app_main();
+}
+
+// The counters of the firmware start from zero on every wake, the totals of the run are summed up wake by wake
+struct FirmwareTotals
+{
+    BusScheduler::Statistics sensorBuses;
+    EspNowTransport::SequenceStatistics sequenced;
+
+    void add(const BusScheduler::Statistics& wakeBuses, const EspNowTransport::SequenceStatistics& wakeSequenced)
+    {
+        sensorBuses.cycles += wakeBuses.cycles;
+        sensorBuses.windows += wakeBuses.windows;
+        sensorBuses.operations += wakeBuses.operations;
+        sensorBuses.activeMicroseconds += wakeBuses.activeMicroseconds;
+        sequenced.resendRequests += wakeSequenced.resendRequests;
+        sequenced.requestsDelivered += wakeSequenced.requestsDelivered;
+        sequenced.freshMessages += wakeSequenced.freshMessages;
+        sequenced.duplicates += wakeSequenced.duplicates;
+        sequenced.earlyPowerDowns += wakeSequenced.earlyPowerDowns;
+    }
+};
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    auto& kernel = simulation::VirtualKernel::instance();
+    simulation::setRandomSeed(options.seed);
+    simulation::NetworkParameters network;
+    network.accessPointAvailable = options.accessPointAvailable;
+    network.sntpServerAvailable = !options.sntpHang;
+    network.httpServerAvailable = !options.uploadHang;
+    network.accessPointChannel = options.accessPointChannel;
+    simulation::setNetworkParameters(network);
+    simulation::setAdcRaw(static_cast<int>(std::lround(options.batteryVolts * batteryDividerRatio / adcFullScaleVolts
+                                                       * adcMaxRaw)));
+    UploadServer uploadServer;
+    simulation::setHttpServer([&uploadServer](std::string_view url, const uint8_t* body, size_t size)
+    {
+        return uploadServer.receive(url, body, size);
+    });
+
+    SimulatedMedium::Parameters mediumParameters;
+    mediumParameters.lossProbability = options.lossProbability;
+    mediumParameters.seed = options.seed;
+    SimulatedMedium medium(mediumParameters);
+    medium.setClock([&kernel] { return kernel.now(); });
+    std::ofstream trace;
+    if (!options.tracePath.empty())
+    {
+        trace.open(options.tracePath);
+        medium.startRecording(trace);
+    }
+    MediumEvents mediumEvents(medium);
+    kernel.addEventSource(mediumEvents);
+
+    const RadioInterface::MacAddress deviceAddress {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    SimulatedRadio deviceRadio(medium, deviceAddress);
+    simulation::attachEspNowRadio(deviceRadio);
+    ExternalUnit externalUnit(medium, deviceAddress, options.externalPeriodMicroseconds, options.accessPointChannel);
+    externalUnit.setSilent(options.peerHang);
+    externalUnit.setHistoryPull(options.historyPullMicroseconds);
+    externalUnit.setAlwaysListening(options.externalListening);
+    if (options.externalRestartMicroseconds != 0)
+    {
+        externalUnit.setRestartPeriod(options.externalRestartMicroseconds);
+    }
+    kernel.addEventSource(externalUnit);
+
+    FakeBme280 bme280(&indoorConditions);
+    simulation::attachI2C(0, AppConfig::bme280Address, bme280);
+    FakeSps30 sps30(2, &indoorPm25, [] { return simulation::getGpioOutput(AppConfig::stepUpPin) != 0; });
+    simulation::attachUart(2, sps30);
+    // The display is on the SPI bus 2 of AppMain
+    FakeEpd epd(AppConfig::epdDcPin, AppConfig::epdBusyPin, FakeEpd::Timing {});
+    epd.setRefreshHanging(options.displayHang);
+    simulation::attachSpi(2, epd);
+
+    std::ofstream wakeTrace;
+    if (!options.wakeTracePath.empty())
+    {
+        wakeTrace.open(options.wakeTracePath);
+        writeTraceHeader(wakeTrace);
+    }
+
+    const auto endTime = static_cast<int64_t>(options.days * microsecondsInDay);
+    const auto hostStart = std::chrono::steady_clock::now();
+    uint32_t wakes = 0;
+    int64_t awakeMicroseconds = 0;
+    int64_t maxAwakeMicroseconds = 0;
+    uint32_t wakesOverBudget = 0;
+    WakeTypeStatistics fullWakes;
+    WakeTypeStatistics measurementWakes;
+    BringUpAverages bringUp;
+    FirmwareTotals firmwareTotals;
+    int64_t fullWakeRadioMicroseconds = 0;
+    // Activities served by the wakes, each one would take its own wake without the coalescing
+    uint64_t plannedActivities = 0;
+    bool stuck = false;
+    bool channelChanged = false;
+    while (kernel.now() < endTime)
+    {
+        if (options.channelChange != 0 && !channelChanged && kernel.now() >= options.channelChangeMicroseconds)
+        {
+            network.accessPointChannel = options.channelChange;
+            simulation::setNetworkParameters(network);
+            externalUnit.moveTo(options.channelChange);
+            channelChanged = true;
+        }
+        WakePhases phases;
+        phases.startMicroseconds = kernel.now();
+        const auto platformBefore = simulation::getPlatformStatistics();
+        const auto radioBefore = deviceRadio.getRadioOnTime();
+        const auto packetsBefore = deviceRadio.getSentCount();
+        const auto epdBefore = epd.getBusyMicroseconds();
+        const auto fanBefore = sps30.getFanOnMicroseconds();
+        const auto result = kernel.runWake(&bootFirmware, options.maxAwakeMicroseconds);
+        ++wakes;
+        awakeMicroseconds += result.awakeMicroseconds;
+        maxAwakeMicroseconds = std::max(maxAwakeMicroseconds, result.awakeMicroseconds);
+        if (result.awakeMicroseconds > AppConfig::wakeBudgetSeconds * microsecondsInSecond)
+        {
+            ++wakesOverBudget;
+        }
+        if (!result.sleepMicroseconds)
+        {
+            std::cerr << "Wake " << wakes << " at " << toSeconds(kernel.now()) << " s didn't reach the deep sleep"
+                      << std::endl;
+            stuck = true;
+            break;
+        }
+        // Only the full wake reads the BME280
+        const bool fullWake = simulation::getPlatformStatistics().i2cTransactions != platformBefore.i2cTransactions;
+        const auto lightSleepMicroseconds = simulation::getPlatformStatistics().lightSleepMicroseconds
+                                            - platformBefore.lightSleepMicroseconds;
+        (fullWake ? fullWakes : measurementWakes).add(result.awakeMicroseconds, lightSleepMicroseconds);
+        if (fullWake)
+        {
+            bringUp.add(BringUp::getLastStatistics());
+            fullWakeRadioMicroseconds += deviceRadio.getRadioOnTime() - radioBefore;
+        }
+        plannedActivities += std::bitset<WakePlanner::activityCount>(WakePlanner::getLastWakeActivities()).count();
+        firmwareTotals.add(BusScheduler::getTotalStatistics(), EspNowTransport::getSequenceStatistics());
+        kernel.advance(static_cast<int64_t>(*result.sleepMicroseconds));
+        if (wakeTrace.is_open())
+        {
+            phases.awakeMicroseconds = result.awakeMicroseconds;
+            phases.sleepMicroseconds = static_cast<int64_t>(*result.sleepMicroseconds);
+            phases.wifiMicroseconds = simulation::getPlatformStatistics().wifiOnMicroseconds
+                                      - platformBefore.wifiOnMicroseconds;
+            phases.radioMicroseconds = deviceRadio.getRadioOnTime() - radioBefore;
+            phases.radioPackets = deviceRadio.getSentCount() - packetsBefore;
+            phases.epdBusyMicroseconds = epd.getBusyMicroseconds() - epdBefore;
+            phases.fanMicroseconds = sps30.getFanOnMicroseconds() - fanBefore;
+            phases.lightSleepMicroseconds = lightSleepMicroseconds;
+            writeTraceLine(wakeTrace, phases);
+        }
+    }
+    const auto hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+
+    const auto platform = simulation::getPlatformStatistics();
+    const auto& link = medium.getStatistics();
+    const auto simulatedDays = static_cast<double>(kernel.now()) / microsecondsInDay;
+    const auto& sensorBuses = firmwareTotals.sensorBuses;
+    const auto& sequenced = firmwareTotals.sequenced;
+    // A message passed on is acknowledged, the one taken for a repetition by mistake is acknowledged only
+    const auto messagesNotPassedOn = externalUnit.getMessagesAcknowledged() > sequenced.freshMessages
+                                     ? externalUnit.getMessagesAcknowledged() - sequenced.freshMessages : 0;
+    const auto perCycle = [&sensorBuses](double value)
+    {
+        return sensorBuses.cycles != 0 ? value / sensorBuses.cycles : 0.0;
+    };
+    std::cout << "Simulated days:            " << simulatedDays << "\n"
+              << "Wakes:                     " << wakes << " (" << wakes / simulatedDays << " per day)\n"
+              << "Awake time:                " << toSeconds(awakeMicroseconds) << " s, average "
+              << (wakes != 0 ? toSeconds(awakeMicroseconds) * 1000.0 / wakes : 0.0) << " ms, max "
+              << toSeconds(maxAwakeMicroseconds) * 1000.0 << " ms\n"
+              << "Wake budget:               " << wakesOverBudget << " wakes over "
+              << AppConfig::wakeBudgetSeconds << " s\n"
+              << "Boot to sleep:             " << fullWakes.count << " full wakes of "
+              << fullWakes.averageMilliseconds() << " ms, " << measurementWakes.count
+              << " measurement-only wakes of " << measurementWakes.averageMilliseconds() << " ms\n"
+              << "Light sleep:               " << toSeconds(platform.lightSleepMicroseconds) << " s in "
+              << platform.lightSleeps << " periods, " << (awakeMicroseconds != 0
+                      ? 100.0 * static_cast<double>(platform.lightSleepMicroseconds) / awakeMicroseconds : 0.0)
+              << " % of the awake time; per full wake " << fullWakes.averageLightSleepMilliseconds()
+              << " ms, per measurement-only wake " << measurementWakes.averageLightSleepMilliseconds() << " ms\n"
+              << "Wake planner:              " << plannedActivities / simulatedDays
+              << " wakes per day with every activity on its own wake, " << wakes / simulatedDays
+              << " with the activities coalesced\n"
+              << "Device bring-up:           " << bringUp.averageMilliseconds(bringUp.criticalPathMicroseconds)
+              << " ms per full wake, " << bringUp.averageMilliseconds(bringUp.sequentialMicroseconds)
+              << " ms with the devices one after another\n"
+              << "Sensor buses:              " << perCycle(sensorBuses.windows) << " windows and "
+              << perCycle(double(sensorBuses.activeMicroseconds)) / 1000.0 << " ms bus-active per measurement cycle, "
+              << perCycle(sensorBuses.operations) << " windows with every sensor operation in its own; "
+              << perCycle(double(platform.i2cMicroseconds)) / 1000.0 << " ms of I2C and "
+              << perCycle(double(platform.uartMicroseconds)) / 1000.0 << " ms of UART on the wires\n"
+              << "Wi-Fi on time:             " << toSeconds(platform.wifiOnMicroseconds) << " s, "
+              << platform.wifiConnections << " connections, " << platform.sntpSynchronizations << " SNTP syncs\n"
+              << "History upload:            " << uploadServer.getRecords() << " records in "
+              << uploadServer.getBatches() << " batches, " << platform.httpRequests << " requests, "
+              << (uploadServer.getRecords() != 0
+                      ? static_cast<double>(uploadServer.getBytes()) / uploadServer.getRecords() : 0.0)
+              << " bytes per record, "
+              << (uploadServer.getRecords() != 0 ? toSeconds(platform.stationMicroseconds) * 1000.0
+                                                   / uploadServer.getRecords() : 0.0)
+              << " ms of station on time per record, " << (uploadServer.getRecords() != 0
+                      ? toSeconds(platform.httpMicroseconds) * 1000.0 / uploadServer.getRecords() : 0.0)
+              << " ms of it the requests\n"
+              << "ESP-NOW radio on time:     " << toSeconds(deviceRadio.getRadioOnTime()) << " s, "
+              << (fullWakes.count != 0 ? toSeconds(fullWakeRadioMicroseconds) * 1000.0 / fullWakes.count : 0.0)
+              << " ms per full wake\n"
+              << "Sequenced messages:        " << sequenced.freshMessages << " fresh, " << sequenced.duplicates
+              << " duplicates acknowledged only, " << sequenced.resendRequests << " resend requests, "
+              << sequenced.requestsDelivered << " heard, " << externalUnit.getRequestsAnswered() << " answered, "
+              << sequenced.earlyPowerDowns << " radio power-downs after the delivery\n"
+              << "External unit:             " << externalUnit.getMessagesSent() << " messages, "
+              << externalUnit.getAcknowledgements() << " acknowledged, " << externalUnit.getMessagesRepeated()
+              << " repeated, " << externalUnit.getRestarts() << " restarts, " << messagesNotPassedOn
+              << " acknowledged but not passed on, channel " << int(externalUnit.getChannel())
+              << ", " << externalUnit.getChannelsFollowed() << " announced channel changes followed\n"
+              << "Status reports:            " << externalUnit.getStatusReports() << " in "
+              << sizeof(EspNowTransport::CorrectionMessage) << " byte acknowledgements, "
+              << externalUnit.getMalformedStatusReports() << " inconsistent";
+    if (const auto& status = externalUnit.getLastStatus())
+    {
+        std::cout << "; last: inner " << status->temperature << " C, PM2.5 " << status->pm2p5 << ", battery "
+                  << int(status->stateOfCharge) << " % in power tier " << int(status->powerTier)
+                  << ", wake " << status->wakes << ", the one before took "
+                  << status->lastWakeMilliseconds << " ms";
+    }
+    std::cout << "\n";
+    if (options.historyPullMicroseconds != 0)
+    {
+        const auto& history = externalUnit.getHistoryStatistics();
+        const auto rawBytes = static_cast<double>(history.records) * sizeof(HistoryRecord);
+        std::cout << "History pull:              " << externalUnit.getPullsCompleted() << " pulls, "
+                  << externalUnit.getPullsInterrupted() << " interrupted and resumed, " << history.records
+                  << " records in " << history.chunks << " chunks, " << history.duplicates << " duplicates, "
+                  << (history.payloadBytes != 0 ? rawBytes / history.payloadBytes : 0.0) << " compression, "
+                  << toSeconds(externalUnit.getPullMicroseconds()) * 1000.0 << " ms of transfers, "
+                  << (externalUnit.getPullMicroseconds() != 0
+                          ? rawBytes / toSeconds(externalUnit.getPullMicroseconds()) / 1024.0 : 0.0)
+                  << " KiB/s of records, " << externalUnit.getMisorderedRecords() << " out of order\n";
+    }
+    if (channelChanged)
+    {
+        std::cout << "Channel change recovery:   ";
+        if (const auto recovery = externalUnit.getRecoveryMicroseconds())
+        {
+            std::cout << toSeconds(*recovery) << " s, " << externalUnit.getMessagesSinceMove() - 1
+                      << " messages missed\n";
+        }
+        else
+        {
+            std::cout << "not recovered, " << externalUnit.getMessagesSinceMove() << " messages missed\n";
+        }
+    }
+    std::cout << "Medium:                    " << link.transmitted << " transmitted, " << link.delivered
+              << " delivered, " << link.lost << " lost\n"
+              << "SPS30 fan on time:         " << toSeconds(sps30.getFanOnMicroseconds()) << " s, "
+              << sps30.getMeasurements() / simulatedDays << " measurements per day, "
+              << sps30.getSamplesRead() << " samples read\n"
+              << "Reported PM2.5:            " << externalUnit.getMeanPm25Error() << " ug/m3 mean and "
+              << externalUnit.getMaxPm25Error() << " ug/m3 max difference from the indoor air\n"
+              << "BME280 measurements:       " << bme280.getMeasurementsCount() << "\n"
+              << "EPD busy time:             " << toSeconds(epd.getBusyMicroseconds()) << " s, "
+              << epd.getFullRefreshes() << " full and " << epd.getPartialRefreshes() << " partial refreshes\n"
+              << "I2C transactions:          " << platform.i2cTransactions << ", "
+              << double(platform.i2cTransactions) / std::max<uint32_t>(bme280.getMeasurementsCount(), 1)
+              << " per BME280 measurement with its setup\n"
+              << "UART bytes:                " << platform.uartBytes << "\n"
+              << "SPI:                       " << platform.spiBytes << " bytes, "
+              << toSeconds(platform.spiMicroseconds) << " s\n"
+              << "Host time:                 " << hostSeconds << " s" << std::endl;
+
+    // The firmware's globals are never destroyed on the chip and their destructors would call
+    // into the already destroyed shims, so the simulation ends without running them
+    trace.flush();
+    wakeTrace.flush();
+    std::quick_exit(stuck || wakesOverBudget != 0 || messagesNotPassedOn != 0
+                    || externalUnit.getMalformedStatusReports() != 0 || externalUnit.getMisorderedRecords() != 0
+                    || uploadServer.getMalformedBatches() != 0 || uploadServer.getMisorderedRecords() != 0 ? 1 : 0);
+}
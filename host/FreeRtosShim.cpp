@@ -0,0 +1,236 @@
+#include "VirtualKernel.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <cstring>
+#include <deque>
+#include <vector>
+
+using simulation::VirtualKernel;
+
+struct QueueDefinition
+{
+    size_t length = 0;
+    size_t itemSize = 0;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+struct EventGroupDef_t
+{
+    EventBits_t bits = 0;
+};
+
+namespace
+{
+
+constexpr int64_t microsecondsInTick = 1000000 / configTICK_RATE_HZ;
+
+int64_t deadlineAfter(TickType_t ticks)
+{
+    auto& kernel = VirtualKernel::instance();
+    return ticks == portMAX_DELAY ? simulation::infiniteTime : kernel.now() + int64_t(ticks) * microsecondsInTick;
+}
+
+BaseType_t queueSend(QueueHandle_t queue, const void* item, TickType_t ticks, bool toFront)
+{
+    const std::function<bool()> hasSpace = [queue] { return queue->items.size() < queue->length; };
+    if (!VirtualKernel::instance().wait(deadlineAfter(ticks), hasSpace))
+    {
+        return errQUEUE_FULL;
+    }
+    std::vector<uint8_t> data(queue->itemSize);
+    if (queue->itemSize > 0)
+    {
+        std::memcpy(data.data(), item, queue->itemSize);
+    }
+    if (toFront)
+    {
+        queue->items.push_front(std::move(data));
+    }
+    else
+    {
+        queue->items.push_back(std::move(data));
+    }
+    return pdPASS;
+}
+
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char* pcName, uint32_t /*usStackDepth*/, void* pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask)
+{
+    auto* handle = VirtualKernel::instance().createTask(pxTaskCode, pvParameters, pcName, int(uxPriority));
+    if (pxCreatedTask)
+    {
+        *pxCreatedTask = handle;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode, const char* pcName, uint32_t usStackDepth,
+                                   void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pxCreatedTask,
+                                   BaseType_t /*xCoreID*/)
+{
+    return xTaskCreate(pxTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    auto& kernel = VirtualKernel::instance();
+    if (!xTaskToDelete)
+    {
+        kernel.deleteCurrentTask();
+    }
+    kernel.deleteTask(xTaskToDelete);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    auto& kernel = VirtualKernel::instance();
+    if (xTicksToDelay == 0)
+    {
+        kernel.yield();
+        return;
+    }
+    kernel.wait(deadlineAfter(xTicksToDelay), [] { return false; });
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    auto& kernel = VirtualKernel::instance();
+    const auto wakeTime = *pxPreviousWakeTime + xTimeIncrement;
+    *pxPreviousWakeTime = wakeTime;
+    const auto deadline = kernel.getBootTime() + int64_t(wakeTime) * microsecondsInTick;
+    if (deadline <= kernel.now())
+    {
+        return pdFALSE;
+    }
+    kernel.wait(deadline, [] { return false; });
+    return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount()
+{
+    auto& kernel = VirtualKernel::instance();
+    return TickType_t((kernel.now() - kernel.getBootTime()) / microsecondsInTick);
+}
+
+void taskYieldShim()
+{
+    VirtualKernel::instance().yield();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    auto* queue = new QueueDefinition;
+    queue->length = uxQueueLength;
+    queue->itemSize = uxItemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    delete xQueue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queueSend(xQueue, pvItemToQueue, xTicksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait)
+{
+    return queueSend(xQueue, pvItemToQueue, xTicksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait)
+{
+    const std::function<bool()> hasItem = [xQueue] { return !xQueue->items.empty(); };
+    if (!VirtualKernel::instance().wait(deadlineAfter(xTicksToWait), hasItem))
+    {
+        return errQUEUE_EMPTY;
+    }
+    if (xQueue->itemSize > 0)
+    {
+        std::memcpy(pvBuffer, xQueue->items.front().data(), xQueue->itemSize);
+    }
+    xQueue->items.pop_front();
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue)
+{
+    xQueue->items.clear();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    return UBaseType_t(xQueue->items.size());
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    auto* semaphore = xQueueCreate(1, 0);
+    xSemaphoreGive(semaphore);
+    return semaphore;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return xQueueSend(xSemaphore, nullptr, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return xQueueReceive(xSemaphore, nullptr, xBlockTime);
+}
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new EventGroupDef_t;
+}
+
+void vEventGroupDelete(EventGroupHandle_t xEventGroup)
+{
+    delete xEventGroup;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToSet)
+{
+    xEventGroup->bits |= uxBitsToSet;
+    return xEventGroup->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToClear)
+{
+    const auto bits = xEventGroup->bits;
+    xEventGroup->bits &= ~uxBitsToClear;
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToWaitFor, BaseType_t xClearOnExit,
+                                BaseType_t xWaitForAllBits, TickType_t xTicksToWait)
+{
+    const std::function<bool()> satisfied = [=]
+    {
+        const auto bits = xEventGroup->bits & uxBitsToWaitFor;
+        return xWaitForAllBits ? bits == uxBitsToWaitFor : bits != 0;
+    };
+    const bool result = VirtualKernel::instance().wait(deadlineAfter(xTicksToWait), satisfied);
+    const auto bits = xEventGroup->bits;
+    if (result && xClearOnExit)
+    {
+        xEventGroup->bits &= ~uxBitsToWaitFor;
+    }
+    return bits;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "RadioInterface.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Control of the ESP-IDF shims from the simulation side: the peripherals behind the buses,
+// the network environment and the counters of the simulated hardware activity.
+namespace simulation
+{
+
+class I2CPeripheral
+{
+public:
+    virtual ~I2CPeripheral() = default;
+    // Returns false to NACK the transfer
+    virtual bool write(const uint8_t* data, size_t size) = 0;
+    virtual bool read(uint8_t* data, size_t size) = 0;
+};
+
+class UartPeripheral
+{
+public:
+    virtual ~UartPeripheral() = default;
+    // Called when the bytes sent by the chip arrive at the peripheral, the answer is sent with uartInject()
+    virtual void receive(const uint8_t* data, size_t size) = 0;
+};
+
+class SpiPeripheral
+{
+public:
+    virtual ~SpiPeripheral() = default;
+    // Called with the bytes sent by the chip, the level of the D/C and other pins can be read with getGpioOutput()
+    virtual void receive(const uint8_t* data, size_t size) = 0;
+};
+
+void attachI2C(int port, uint8_t address, I2CPeripheral& peripheral);
+void attachUart(int port, UartPeripheral& peripheral);
+void attachSpi(int host, SpiPeripheral& peripheral);
+// The queued SPI transactions stay on the bus and their results time out, like those of a stuck DMA
+void setSpiStalled(bool stalled);
+// Puts the bytes into the receive buffer of the port at the given virtual time
+void uartInject(int port, const uint8_t* data, size_t size, int64_t time);
+
+void setGpioInput(int pin, int level);
+[[nodiscard]] int getGpioOutput(int pin);
+void setAdcRaw(int raw);
+
+// ESP-NOW of the chip is served by this radio
+void attachEspNowRadio(RadioInterface& radio);
+
+struct NetworkParameters
+{
+    bool accessPointAvailable = true;
+    // The station drags the radio of the chip to this channel while it's connected
+    uint8_t accessPointChannel = 1;
+    int64_t startMicroseconds = 50000;
+    int64_t connectMicroseconds = 1500000;
+    int64_t failedConnectMicroseconds = 3000000;
+    int64_t sntpMicroseconds = 300000;
+    // The requests go unanswered when the server is down
+    bool sntpServerAvailable = true;
+    // The HTTP request: the connection and the response take the round trip, the body goes at the uplink rate
+    int64_t httpRoundTripMicroseconds = 40000;
+    uint32_t uplinkBytesPerSecond = 250000;
+    // The requests time out when the server is down
+    bool httpServerAvailable = true;
+    // Real time at the simulated power-on, the chip's clock starts from zero until SNTP sets it
+    int64_t epochAtPowerOnMicroseconds = 1700000000ll * 1000000;
+};
+
+void setNetworkParameters(const NetworkParameters& parameters);
+
+// Stand-in for the HTTP server of the network, gets the requests of esp_http_client and returns the status code
+using HttpServer = std::function<int(std::string_view url, const uint8_t* body, size_t size)>;
+void setHttpServer(HttpServer server);
+
+// CPU time taken by the initialization calls of ESP-IDF, typical figures of the chip at 80 MHz
+struct InitCosts
+{
+    int64_t nvsFlashInitMicroseconds = 12000;
+    int64_t netifInitMicroseconds = 8000;
+    int64_t eventLoopCreateMicroseconds = 1000;
+    int64_t wifiInitMicroseconds = 45000;
+    int64_t i2cDriverInstallMicroseconds = 300;
+    int64_t spiBusInitializeMicroseconds = 500;
+};
+
+void setInitCosts(const InitCosts& costs);
+
+struct PlatformStatistics
+{
+    int64_t wifiOnMicroseconds = 0;
+    // Part of the on time of the starts associating with the access point, the ESP-NOW only ones left out
+    int64_t stationMicroseconds = 0;
+    uint32_t wifiConnections = 0;
+    uint32_t sntpSynchronizations = 0;
+    uint32_t httpRequests = 0;
+    uint64_t httpBytes = 0;
+    int64_t httpMicroseconds = 0;
+    uint32_t i2cTransactions = 0;
+    // Time of the transfers on the wires, both directions of the UART
+    int64_t i2cMicroseconds = 0;
+    uint64_t uartBytes = 0;
+    int64_t uartMicroseconds = 0;
+    uint64_t spiBytes = 0;
+    int64_t spiMicroseconds = 0;
+    // Idle periods of the awake chip spent in the automatic light sleep
+    int64_t lightSleepMicroseconds = 0;
+    uint32_t lightSleeps = 0;
+};
+
+[[nodiscard]] PlatformStatistics getPlatformStatistics();
+
+// Real time corresponding to the virtual time
+[[nodiscard]] int64_t realTimeMicroseconds();
+// Time of the chip's clock as seen by gettimeofday()
+[[nodiscard]] int64_t wallClockMicroseconds();
+void setWallClock(int64_t microseconds);
+void setRandomSeed(uint32_t seed);
+
+}
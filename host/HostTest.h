@@ -0,0 +1,31 @@
+#pragma once
+
+#include <iostream>
+
+// Checks of the host tests: a failed check is reported with its case, the test fails if any check did
+namespace host_test
+{
+
+inline int failures = 0;
+
+inline void check(bool condition, const char* testCase, const char* what)
+{
+    if (!condition)
+    {
+        std::cerr << testCase << ": " << what << " failed" << std::endl;
+        ++failures;
+    }
+}
+
+inline int result()
+{
+    if (failures != 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
+
+}
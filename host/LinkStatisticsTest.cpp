@@ -0,0 +1,192 @@
+#include "HostTest.h"
+#include "LinkStatistics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// The delivery ratio, the attempts limit and the backoff of the acknowledgement retries under the simulated loss.
+// A delivery is retried the same way as by the transport: until the attempts limit or the retry time budget.
+namespace
+{
+
+// Same as the budget of the transport, one delivery per wake
+constexpr int64_t retryBudgetMicroseconds = 300000;
+// Time from the send to its callback, the latency of the simulated medium
+constexpr int64_t sendMicroseconds = 1000;
+constexpr int deliveries = 2000;
+
+struct LossResult
+{
+    double deliveredShare = 0;
+    double meanAttempts = 0;
+    // Time spent on a delivery, delivered or not, the radio is kept on for it
+    double meanMicroseconds = 0;
+    float finalRatio = 0;
+    int finalLimit = 0;
+    // Time from the first send to the delivery, of the delivered acknowledgements
+    int64_t medianMicroseconds = 0;
+    int64_t p99Microseconds = 0;
+    int64_t maxMicroseconds = 0;
+};
+
+LossResult simulate(double loss, int64_t budgetMicroseconds, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::bernoulli_distribution lost(loss);
+    LinkStatistics statistics;
+    std::vector<int64_t> deliveryTimes;
+    int delivered = 0;
+    int attemptsTotal = 0;
+    int64_t timeTotal = 0;
+    for (int i = 0; i < deliveries; ++i)
+    {
+        int attempts = 0;
+        int64_t elapsed = 0;
+        bool success = false;
+        while (true)
+        {
+            ++attempts;
+            elapsed += sendMicroseconds;
+            if (!lost(random))
+            {
+                success = true;
+                break;
+            }
+            if (attempts >= statistics.attemptsLimit())
+            {
+                break;
+            }
+            const auto delay = int64_t(LinkStatistics::backoffDelayMs(attempts, random())) * 1000;
+            if (elapsed + delay > budgetMicroseconds)
+            {
+                break;
+            }
+            elapsed += delay;
+        }
+        statistics.registerResult(attempts, success);
+        attemptsTotal += attempts;
+        timeTotal += elapsed;
+        if (success)
+        {
+            ++delivered;
+            deliveryTimes.push_back(elapsed);
+        }
+    }
+    LossResult result;
+    result.deliveredShare = double(delivered) / deliveries;
+    result.meanAttempts = double(attemptsTotal) / deliveries;
+    result.meanMicroseconds = double(timeTotal) / deliveries;
+    result.finalRatio = statistics.getDeliveryRatio();
+    result.finalLimit = statistics.attemptsLimit();
+    if (!deliveryTimes.empty())
+    {
+        std::sort(deliveryTimes.begin(), deliveryTimes.end());
+        result.medianMicroseconds = deliveryTimes[deliveryTimes.size() / 2];
+        result.p99Microseconds = deliveryTimes[deliveryTimes.size() * 99 / 100];
+        result.maxMicroseconds = deliveryTimes.back();
+    }
+    return result;
+}
+
+void checkAverage()
+{
+    using host_test::check;
+    const char* testCase = "moving average";
+    LinkStatistics statistics;
+    check(statistics.deliveryRatio == LinkStatistics::fullDeliveryRatio, testCase, "initial ratio");
+    statistics.registerResult(LinkStatistics::maxAttempts, false);
+    check(statistics.deliveryRatio == 223, testCase, "first failure weights 1/8");
+    statistics.registerResult(LinkStatistics::maxAttempts, false);
+    check(statistics.deliveryRatio == 195, testCase, "second failure");
+    for (int i = 0; i < 40; ++i)
+    {
+        statistics.registerResult(LinkStatistics::maxAttempts, false);
+    }
+    check(statistics.deliveryRatio == 0, testCase, "ratio after the failures");
+    for (int i = 0; i < 60; ++i)
+    {
+        statistics.registerResult(1, true);
+    }
+    // The integer average stops 7 short of the full ratio
+    check(statistics.deliveryRatio >= LinkStatistics::fullDeliveryRatio - 7, testCase, "recovered ratio");
+    check(statistics.attemptsHistogram[0] == 60 && statistics.failedCount == 42, testCase, "counts");
+}
+
+void checkLimit()
+{
+    using host_test::check;
+    const char* testCase = "attempts limit";
+    LinkStatistics statistics;
+    check(statistics.attemptsLimit() == LinkStatistics::maxAttempts, testCase, "full ratio");
+    for (int i = 0; i < 3; ++i)
+    {
+        statistics.registerResult(LinkStatistics::maxAttempts, false);
+    }
+    check(statistics.attemptsLimit() == 2, testCase, "after 3 failures in a row");
+    statistics.registerResult(2, true);
+    // 1 + 9 * ratio, the ratio is 0.69 after three failures and a delivery
+    check(statistics.attemptsLimit() == 7, testCase, "after the delivery");
+}
+
+void checkBackoff()
+{
+    using host_test::check;
+    const char* testCase = "backoff";
+    std::mt19937 random(1);
+    bool inRange = true;
+    for (int attempt = 1; attempt <= LinkStatistics::maxAttempts; ++attempt)
+    {
+        const uint32_t ceiling = std::min<uint32_t>(4u << (attempt - 1), 128);
+        for (int i = 0; i < 1000; ++i)
+        {
+            const auto delay = LinkStatistics::backoffDelayMs(attempt, random());
+            inRange = inRange && delay >= ceiling / 2 && delay <= ceiling;
+        }
+    }
+    check(inRange, testCase, "jittered delay within half and the full ceiling");
+}
+
+}
+
+int main()
+{
+    checkAverage();
+    checkLimit();
+    checkBackoff();
+
+    using host_test::check;
+    std::cout << "Loss\tDelivered\tAttempts\tRatio\tLimit\tMean ms\tMedian ms\tP99 ms\tMax ms" << std::endl;
+    for (const auto loss : {0.0, 0.1, 0.3, 0.5, 0.7, 0.9})
+    {
+        const auto result = simulate(loss, retryBudgetMicroseconds, 7);
+        std::cout << loss << "\t" << result.deliveredShare << "\t" << result.meanAttempts << "\t"
+                  << result.finalRatio << "\t" << result.finalLimit << "\t" << result.meanMicroseconds / 1000.0
+                  << "\t" << result.medianMicroseconds / 1000.0 << "\t" << result.p99Microseconds / 1000.0 << "\t"
+                  << result.maxMicroseconds / 1000.0 << std::endl;
+        // The retry planned within the budget takes one more send
+        check(result.maxMicroseconds <= retryBudgetMicroseconds + sendMicroseconds, "simulated loss",
+              "retry time within the budget");
+        if (loss <= 0.5)
+        {
+            check(result.deliveredShare > 0.95, "simulated loss", "delivered share up to 50 % loss");
+        }
+    }
+    // The link lost most of the packets is given up on after two attempts instead of spending the budget
+    const auto bad = simulate(0.9, retryBudgetMicroseconds, 7);
+    check(bad.finalLimit == 2 && bad.meanAttempts < 3, "simulated loss", "bad link limit");
+
+    // The budget against the share delivered and the time spent, on the lossy links it matters for
+    std::cout << "Budget ms\tLoss\tDelivered\tMean ms" << std::endl;
+    for (const auto budget : {100, 200, 300, 500, 1000})
+    {
+        for (const auto loss : {0.5, 0.7})
+        {
+            const auto result = simulate(loss, budget * 1000, 7);
+            std::cout << budget << "\t" << loss << "\t" << result.deliveredShare << "\t"
+                      << result.meanMicroseconds / 1000.0 << std::endl;
+        }
+    }
+    return host_test::result();
+}
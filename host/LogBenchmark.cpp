@@ -0,0 +1,93 @@
+#include "BinaryLog.h"
+#include "Debug.h"
+#include "VirtualKernel.h"
+
+#include <esp_sleep.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Per-call cost of the TRACE_LOG in both modes against the DEBUG_LOG of the same message, in the host CPU time.
+// The binary records are drained to the simulated UART0 between the batches, out of the measured time. Both the
+// UART0 and the text go to the standard output, which is sent to /dev/null during the measurement.
+namespace
+{
+
+constexpr int iterations = 100000;
+// The records of one batch fit into the ring, so none of them is dropped
+constexpr int batchSize = 64;
+
+using HostClock = std::chrono::steady_clock;
+
+double nanosecondsPerCall(HostClock::duration duration)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / iterations;
+}
+
+template<typename Call>
+HostClock::duration measure(Call call)
+{
+    const auto start = HostClock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        call(i);
+    }
+    return HostClock::now() - start;
+}
+
+void run()
+{
+    static constexpr const char benchmarkFormat[] = "Benchmark {}: {} ug/m3, {}";
+    std::fflush(stdout);
+    const int savedOutput = dup(STDOUT_FILENO);
+    const int nullOutput = open("/dev/null", O_WRONLY);
+    dup2(nullOutput, STDOUT_FILENO);
+    binary_log::init();
+
+    HostClock::duration binaryTime {};
+    for (int done = 0; done < iterations; done += batchSize)
+    {
+        const auto start = HostClock::now();
+        for (int i = done; i < std::min(done + batchSize, iterations); ++i)
+        {
+            binary_log::log(benchmarkFormat, i, 12.5f, "sensor");
+        }
+        binaryTime += HostClock::now() - start;
+        binary_log::flush();
+    }
+    const auto statistics = binary_log::getStatistics();
+
+    const auto textLineTime = measure([](int i)
+    {
+        DEBUG_LOG(binary_log::TextLine(benchmarkFormat, i, 12.5f, "sensor").c_str())
+    });
+    const auto debugLogTime = measure([](int i)
+    {
+        DEBUG_LOG("Benchmark " << i << ": " << 12.5f << " ug/m3, " << "sensor")
+    });
+    std::fflush(stdout);
+    dup2(savedOutput, STDOUT_FILENO);
+    close(nullOutput);
+    close(savedOutput);
+
+    std::cout << "Calls:                     " << iterations << ", " << statistics.written << " binary records written, "
+              << statistics.dropped << " dropped\n"
+              << "Binary TRACE_LOG:          " << nanosecondsPerCall(binaryTime) << " ns per call\n"
+              << "Text TRACE_LOG:            " << nanosecondsPerCall(textLineTime) << " ns per call\n"
+              << "DEBUG_LOG:                 " << nanosecondsPerCall(debugLogTime) << " ns per call" << std::endl;
+    esp_deep_sleep(1000000);
+}
+
+}
+
+int main()
+{
+    // The drain of the records takes about 3 ms of the virtual time per batch
+    simulation::VirtualKernel::instance().runWake(&run, 3600LL * 1000000);
+    return 0;
+}
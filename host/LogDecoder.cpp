@@ -0,0 +1,203 @@
+#include "BinaryLogFormat.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Decodes the serial output of the firmware built with BINARY_LOG. The records are found by the frame sync byte,
+// their format strings are read from the ELF of the same build, the rest of the output is passed through.
+namespace
+{
+
+struct Section
+{
+    uint32_t address;
+    uint32_t offset;
+    uint32_t size;
+};
+
+constexpr uint16_t sectionTypeNoBits = 8;
+constexpr uint32_t sectionFlagAllocated = 0x2;
+
+template<typename T>
+T read(const std::vector<uint8_t>& data, size_t offset)
+{
+    T value {};
+    if (offset + sizeof(value) <= data.size())
+    {
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+    }
+    return value;
+}
+
+void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " FIRMWARE.elf [CAPTURE]" << std::endl
+              << "The capture of the serial port is read from the standard input if it's not given" << std::endl;
+}
+
+std::vector<uint8_t> readFile(std::istream& input)
+{
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+}
+
+class FirmwareImage
+{
+public:
+    // The firmware is the 32-bit little-endian ELF of Xtensa or RISC-V
+    bool load(std::vector<uint8_t> data, std::string& error)
+    {
+        image = std::move(data);
+        if (image.size() < 52 || std::memcmp(image.data(), "\x7F" "ELF", 4) != 0)
+        {
+            error = "not an ELF file";
+            return false;
+        }
+        if (image[4] != 1 || image[5] != 1)
+        {
+            error = "not a 32-bit little-endian ELF file";
+            return false;
+        }
+        const auto sectionTable = read<uint32_t>(image, 32);
+        const auto entrySize = read<uint16_t>(image, 46);
+        const auto count = read<uint16_t>(image, 48);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto entry = sectionTable + i * entrySize;
+            const auto type = read<uint32_t>(image, entry + 4);
+            const auto flags = read<uint32_t>(image, entry + 8);
+            const Section section {read<uint32_t>(image, entry + 12), read<uint32_t>(image, entry + 16),
+                                   read<uint32_t>(image, entry + 20)};
+            if ((flags & sectionFlagAllocated) != 0 && type != sectionTypeNoBits
+                && uint64_t(section.offset) + section.size <= image.size())
+            {
+                sections.push_back(section);
+            }
+        }
+        if (sections.empty())
+        {
+            error = "no loadable sections";
+            return false;
+        }
+        return true;
+    }
+
+    // The null-terminated string at the address of the firmware
+    [[nodiscard]] std::optional<std::string> stringAt(uint32_t address) const
+    {
+        for (const auto& section : sections)
+        {
+            if (address < section.address || address - section.address >= section.size)
+            {
+                continue;
+            }
+            const auto* begin = reinterpret_cast<const char*>(image.data() + section.offset
+                                                              + (address - section.address));
+            const auto available = section.size - (address - section.address);
+            const auto length = strnlen(begin, available);
+            if (length == available)
+            {
+                return std::nullopt;
+            }
+            return std::string(begin, length);
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::vector<uint8_t> image;
+    std::vector<Section> sections;
+};
+
+// Returns the size of the frame at the position or 0 if there's no valid record
+size_t decodeFrame(const FirmwareImage& firmware, const std::vector<uint8_t>& capture, size_t position)
+{
+    const auto start = position + 1;
+    if (start + sizeof(binary_log::RecordHeader) > capture.size())
+    {
+        return 0;
+    }
+    binary_log::RecordHeader header {};
+    std::memcpy(&header, capture.data() + start, sizeof(header));
+    if (header.size < sizeof(header) || header.size > binary_log::maxRecordSize || header.size % 4 != 0
+        || start + header.size > capture.size())
+    {
+        return 0;
+    }
+    const auto format = firmware.stringAt(header.format);
+    if (!format)
+    {
+        return 0;
+    }
+    char text[binary_log::maxRecordSize * 4];
+    binary_log::formatRecord(format->c_str(), capture.data() + start + sizeof(header), header.size - sizeof(header),
+                             text, sizeof(text));
+    std::cout << "[" << header.timestamp / 1000 << "." << std::setw(3) << std::setfill('0')
+              << header.timestamp % 1000 << std::setfill(' ') << "] " << text << "\n";
+    return 1 + header.size;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+    std::ifstream elf(argv[1], std::ios::binary);
+    if (!elf)
+    {
+        std::cerr << "Can't open " << argv[1] << std::endl;
+        return 1;
+    }
+    FirmwareImage firmware;
+    std::string error;
+    if (!firmware.load(readFile(elf), error))
+    {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> capture;
+    if (argc == 3)
+    {
+        std::ifstream input(argv[2], std::ios::binary);
+        if (!input)
+        {
+            std::cerr << "Can't open " << argv[2] << std::endl;
+            return 1;
+        }
+        capture = readFile(input);
+    }
+    else
+    {
+        capture = readFile(std::cin);
+    }
+
+    size_t records = 0;
+    for (size_t position = 0; position < capture.size();)
+    {
+        if (capture[position] == binary_log::frameSync)
+        {
+            if (const auto size = decodeFrame(firmware, capture, position); size != 0)
+            {
+                position += size;
+                ++records;
+                continue;
+            }
+        }
+        // The text of DEBUG_LOG and the boot messages
+        std::cout.put(static_cast<char>(capture[position++]));
+    }
+    std::cout.flush();
+    std::cerr << records << " records decoded" << std::endl;
+    return 0;
+}
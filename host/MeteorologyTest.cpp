@@ -0,0 +1,180 @@
+#include "HostTest.h"
+#include "Meteorology.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Derived values of the PTH readings against the reference formulas in double and the tabulated values
+namespace
+{
+
+constexpr time_t startTime = 1700000000;
+constexpr time_t secondsInHour = 60 * 60;
+
+// Saturation vapour pressure over water in hPa by the Buck equation (1996), the reference of the Magnus formula
+double buckPressure(double temperature)
+{
+    return 6.1121 * std::exp((18.678 - temperature / 234.5) * (temperature / (257.14 + temperature)));
+}
+
+// Temperature of the saturation at the actual vapour pressure, found by the bisection
+double referenceDewPoint(double temperature, double relativeHumidity)
+{
+    const auto vaporPressure = relativeHumidity / 100.0 * buckPressure(temperature);
+    double low = -90.0;
+    double high = temperature;
+    for (int i = 0; i < 60; ++i)
+    {
+        const auto middle = (low + high) / 2;
+        if (buckPressure(middle) < vaporPressure)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Ideal gas law of the water vapour, in g/m3
+double referenceAbsoluteHumidity(double temperature, double relativeHumidity)
+{
+    constexpr double waterMolarMass = 18.01528;
+    constexpr double gasConstant = 8.314462618;
+    const auto vaporPressurePa = relativeHumidity / 100.0 * buckPressure(temperature) * 100.0;
+    return vaporPressurePa * waterMolarMass / (gasConstant * (temperature + 273.15));
+}
+
+void checkDewPoint()
+{
+    using host_test::check;
+    const char* testCase = "dew point";
+    bool withinTolerance = true;
+    for (int temperature = -40; temperature <= 50; temperature += 5)
+    {
+        for (int humidity = 5; humidity <= 100; humidity += 5)
+        {
+            const auto error = std::fabs(meteorology::dewPoint(float(temperature), float(humidity))
+                                         - referenceDewPoint(temperature, humidity));
+            withinTolerance = withinTolerance && error < (temperature >= -30 ? 0.1 : 0.16);
+        }
+    }
+    check(withinTolerance, testCase, "Magnus against Buck");
+    check(std::fabs(meteorology::dewPoint(20.f, 50.f) - 9.27f) < 0.05f, testCase, "20 C at 50 %");
+    check(std::fabs(meteorology::dewPoint(30.f, 80.f) - 26.17f) < 0.05f, testCase, "30 C at 80 %");
+    check(std::fabs(meteorology::dewPoint(-10.f, 80.f) - -12.79f) < 0.05f, testCase, "-10 C at 80 %");
+    check(std::fabs(meteorology::dewPoint(15.f, 100.f) - 15.f) < 0.01f, testCase, "saturated air");
+    check(std::isfinite(meteorology::dewPoint(20.f, 0.f)), testCase, "dry air");
+}
+
+void checkAbsoluteHumidity()
+{
+    using host_test::check;
+    const char* testCase = "absolute humidity";
+    bool withinTolerance = true;
+    for (int temperature = -20; temperature <= 45; temperature += 5)
+    {
+        for (int humidity = 10; humidity <= 100; humidity += 10)
+        {
+            const auto reference = referenceAbsoluteHumidity(temperature, humidity);
+            const auto value = meteorology::absoluteHumidity(float(temperature), float(humidity));
+            withinTolerance = withinTolerance && std::fabs(value - reference) < reference * 0.005;
+        }
+    }
+    check(withinTolerance, testCase, "ideal gas of the water vapour");
+    // Saturated air of the tables: 4.85 g/m3 at 0 C, 17.3 g/m3 at 20 C and 30.4 g/m3 at 30 C
+    check(std::fabs(meteorology::absoluteHumidity(0.f, 100.f) - 4.85f) < 0.05f, testCase, "0 C saturated");
+    check(std::fabs(meteorology::absoluteHumidity(20.f, 100.f) - 17.3f) < 0.1f, testCase, "20 C saturated");
+    check(std::fabs(meteorology::absoluteHumidity(30.f, 100.f) - 30.4f) < 0.2f, testCase, "30 C saturated");
+    check(meteorology::absoluteHumidity(20.f, 0.f) == 0.f, testCase, "dry air");
+}
+
+void checkSeaLevelPressure()
+{
+    using host_test::check;
+    const char* testCase = "sea level pressure";
+    // The international standard atmosphere: the altitude, the temperature and the pressure of the level
+    struct Level
+    {
+        float altitude;
+        float temperature;
+        float pressure;
+    };
+    for (const auto& level : {Level {0.f, 15.f, 1013.25f}, Level {500.f, 11.75f, 954.61f},
+                              Level {1000.f, 8.5f, 898.76f}, Level {2000.f, 2.f, 795.01f}})
+    {
+        const auto reduced = meteorology::seaLevelPressure(level.pressure, level.temperature, level.altitude);
+        check(std::fabs(reduced - 1013.25f) < 0.3f, testCase, "standard atmosphere");
+    }
+    // The units of the station pressure are kept
+    check(std::fabs(meteorology::seaLevelPressure(95461.f, 11.75f, 500.f) - 101325.f) < 30.f, testCase, "pascals");
+    // The warmer air column is lighter, so the same station pressure is reduced to a lower one
+    check(meteorology::seaLevelPressure(954.61f, 30.f, 500.f) < meteorology::seaLevelPressure(954.61f, 0.f, 500.f),
+          testCase, "temperature of the air column");
+}
+
+// Samples every minute over the hours, the pressure in Pa given by the function of the elapsed seconds
+template<typename Pressure>
+PressureTrend sampled(time_t start, time_t seconds, Pressure&& pressure)
+{
+    PressureTrend trend;
+    for (time_t elapsed = 0; elapsed <= seconds; elapsed += 60)
+    {
+        trend.update(start + elapsed, pressure(elapsed));
+    }
+    return trend;
+}
+
+void checkTendency()
+{
+    using host_test::check;
+    const char* testCase = "pressure tendency";
+    constexpr double paPer3Hours = 1.0 / (3 * secondsInHour);
+
+    // The WMO tendency is the change over the last 3 hours, the same as the slope of the linear change
+    auto rising = sampled(startTime, 3 * secondsInHour,
+                          [=](time_t t) { return float(100000 + 200 * t * paPer3Hours); });
+    check(rising.getTendency() && std::fabs(*rising.getTendency() - 2.f) < 0.05f, testCase, "rising 2 hPa");
+    check(PressureTrend::classify(*rising.getTendency()) == PressureTrend::Tendency::Rising, testCase,
+          "rising classified");
+
+    auto falling = sampled(startTime, 5 * secondsInHour,
+                           [=](time_t t) { return float(101000 - 350 * t * paPer3Hours); });
+    check(falling.getTendency() && std::fabs(*falling.getTendency() + 3.5f) < 0.05f, testCase, "falling 3.5 hPa");
+    check(PressureTrend::classify(*falling.getTendency()) == PressureTrend::Tendency::Falling, testCase,
+          "falling classified");
+
+    // The noise of the readings within the 2 Pa steps of the trend
+    auto steady = sampled(startTime, 4 * secondsInHour, [](time_t t) { return 98000.f + float(t % 7) * 0.5f; });
+    check(steady.getTendency() && std::fabs(*steady.getTendency()) < 0.05f, testCase, "steady");
+    check(PressureTrend::classify(0.99f) == PressureTrend::Tendency::Steady
+          && PressureTrend::classify(-0.99f) == PressureTrend::Tendency::Steady, testCase, "steady classified");
+
+    // The rise ended 3 hours ago is out of the window
+    auto settled = sampled(startTime, 6 * secondsInHour, [=](time_t t) {
+        return float(100000 + 300 * std::min<double>(t, 3 * secondsInHour) * paPer3Hours);
+    });
+    check(settled.getTendency() && std::fabs(*settled.getTendency()) < 0.1f, testCase, "old change expired");
+
+    auto brief = sampled(startTime, secondsInHour / 2, [](time_t) { return 100000.f; });
+    check(!brief.getTendency(), testCase, "less than an hour");
+
+    // A gap longer than the window starts the trend again
+    auto resumed = sampled(startTime, 3 * secondsInHour,
+                           [=](time_t t) { return float(100000 + 500 * t * paPer3Hours); });
+    resumed.update(startTime + 8 * secondsInHour, 99000.f);
+    check(!resumed.getTendency(), testCase, "restarted after the gap");
+}
+
+}
+
+int main()
+{
+    checkDewPoint();
+    checkAbsoluteHumidity();
+    checkSeaLevelPressure();
+    checkTendency();
+    return host_test::result();
+}
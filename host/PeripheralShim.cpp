@@ -0,0 +1,716 @@
+#include "ShimCommon.h"
+#include "VirtualKernel.h"
+
+#include <driver/adc.h>
+#include <driver/gpio.h>
+#include <driver/i2c.h>
+#include <driver/rtc_io.h>
+#include <driver/spi_master.h>
+#include <driver/uart.h>
+
+#include <array>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+using simulation::VirtualKernel;
+
+struct spi_device_t
+{
+    spi_host_device_t host = SPI2_HOST;
+    int clockHz = 1000000;
+    transaction_cb_t preCallback = nullptr;
+    transaction_cb_t postCallback = nullptr;
+    std::deque<spi_transaction_t*> pending;
+};
+
+namespace simulation
+{
+PlatformStatistics platformStatistics;
+InitCosts initCosts;
+
+namespace
+{
+int busyTasks = 0;
+
+// The wait unwinds the task terminated by the deep sleep
+struct BusyScope
+{
+    BusyScope() { ++busyTasks; }
+    ~BusyScope() { --busyTasks; }
+};
+}
+
+void busyFor(int64_t microseconds)
+{
+    auto& kernel = VirtualKernel::instance();
+    const BusyScope scope;
+    kernel.wait(kernel.now() + microseconds, [] { return false; });
+}
+
+bool isCpuBusy()
+{
+    return busyTasks != 0;
+}
+}
+
+using simulation::busyFor;
+
+namespace
+{
+
+struct I2COperation
+{
+    enum class Type {Start, Write, Read, Stop};
+    Type type = Type::Start;
+    std::vector<uint8_t> data;
+    uint8_t* destination = nullptr;
+    size_t size = 0;
+};
+
+struct I2CCommand
+{
+    std::vector<I2COperation> operations;
+};
+
+struct UartPort
+{
+    bool installed = false;
+    int baudRate = 115200;
+    std::deque<uint8_t> received;
+    int64_t transmitDoneTime = 0;
+    simulation::UartPeripheral* peripheral = nullptr;
+};
+
+constexpr int adcChannelPins[ADC1_CHANNEL_MAX] = {36, 37, 38, 39, 32, 33, 34, 35};
+// 2 V on the pin: the battery of 4 V behind the divider
+constexpr int defaultAdcRaw = 2482;
+
+std::map<int, int> gpioOutputs;
+std::map<int, int> gpioInputs;
+std::set<int> heldPins;
+std::map<std::pair<int, uint8_t>, simulation::I2CPeripheral*> i2cPeripherals;
+std::array<uint32_t, I2C_NUM_MAX> i2cClock {100000, 100000};
+std::array<UartPort, UART_NUM_MAX> uartPorts;
+std::array<simulation::SpiPeripheral*, SPI_HOST_MAX> spiPeripherals {};
+bool spiStalled = false;
+int adcRaw = defaultAdcRaw;
+
+bool runI2CSegment(i2c_port_t port, const std::vector<uint8_t>& written,
+                   const std::vector<std::pair<uint8_t*, size_t>>& reads)
+{
+    if (written.empty())
+    {
+        return false;
+    }
+    const auto address = static_cast<uint8_t>(written.front() >> 1);
+    const bool isRead = (written.front() & 1) != 0;
+    const auto iterator = i2cPeripherals.find({port, address});
+    if (iterator == i2cPeripherals.end())
+    {
+        return false;
+    }
+    ++simulation::platformStatistics.i2cTransactions;
+    if (!isRead)
+    {
+        return iterator->second->write(written.data() + 1, written.size() - 1);
+    }
+    size_t total = 0;
+    for (const auto& read : reads)
+    {
+        total += read.second;
+    }
+    std::vector<uint8_t> buffer(total);
+    if (!iterator->second->read(buffer.data(), buffer.size()))
+    {
+        return false;
+    }
+    size_t offset = 0;
+    for (const auto& read : reads)
+    {
+        std::copy(buffer.begin() + offset, buffer.begin() + offset + read.second, read.first);
+        offset += read.second;
+    }
+    return true;
+}
+
+void transferSpi(spi_device_t* device, spi_transaction_t* transaction)
+{
+    const auto bits = transaction->length;
+    const auto rxBits = std::max(transaction->rxlength, bits);
+    auto* rx = (transaction->flags & SPI_TRANS_USE_RXDATA) ? transaction->rx_data
+                                                             : static_cast<uint8_t*>(transaction->rx_buffer);
+    if (rx)
+    {
+        std::fill(rx, rx + (rxBits + 7) / 8, 0);
+    }
+    if (device->preCallback)
+    {
+        device->preCallback(transaction);
+    }
+    const auto* tx = (transaction->flags & SPI_TRANS_USE_TXDATA) ? transaction->tx_data
+                                                                   : static_cast<const uint8_t*>(transaction->tx_buffer);
+    if (auto* peripheral = spiPeripherals.at(device->host); peripheral && tx && bits != 0)
+    {
+        peripheral->receive(tx, (bits + 7) / 8);
+    }
+    const auto duration = int64_t(bits) * 1000000 / std::max(device->clockHz, 1);
+    simulation::platformStatistics.spiBytes += (bits + 7) / 8;
+    simulation::platformStatistics.spiMicroseconds += duration;
+    busyFor(duration);
+    if (device->postCallback)
+    {
+        device->postCallback(transaction);
+    }
+}
+
+const bool resetRegistered = []
+{
+    VirtualKernel::instance().addResetHandler([]
+    {
+        // Only the pins held by the RTC domain keep their level through the deep sleep
+        for (auto iterator = gpioOutputs.begin(); iterator != gpioOutputs.end();)
+        {
+            iterator = heldPins.count(iterator->first) ? std::next(iterator) : gpioOutputs.erase(iterator);
+        }
+        for (auto& port : uartPorts)
+        {
+            port.installed = false;
+            port.received.clear();
+            port.transmitDoneTime = 0;
+        }
+    });
+    return true;
+}();
+
+}
+
+namespace simulation
+{
+
+void attachI2C(int port, uint8_t address, I2CPeripheral& peripheral)
+{
+    i2cPeripherals[{port, address}] = &peripheral;
+}
+
+void attachUart(int port, UartPeripheral& peripheral)
+{
+    uartPorts.at(port).peripheral = &peripheral;
+}
+
+void uartInject(int port, const uint8_t* data, size_t size, int64_t time)
+{
+    std::vector<uint8_t> bytes(data, data + size);
+    VirtualKernel::instance().schedule(time, [port, bytes]
+    {
+        auto& received = uartPorts.at(port).received;
+        received.insert(received.end(), bytes.begin(), bytes.end());
+    });
+}
+
+void attachSpi(int host, SpiPeripheral& peripheral)
+{
+    spiPeripherals.at(host) = &peripheral;
+}
+
+void setSpiStalled(bool stalled)
+{
+    spiStalled = stalled;
+}
+
+void setInitCosts(const InitCosts& costs)
+{
+    initCosts = costs;
+}
+
+void setGpioInput(int pin, int level)
+{
+    gpioInputs[pin] = level;
+}
+
+int getGpioOutput(int pin)
+{
+    const auto iterator = gpioOutputs.find(pin);
+    return iterator != gpioOutputs.end() ? iterator->second : 0;
+}
+
+void setAdcRaw(int raw)
+{
+    adcRaw = raw;
+}
+
+PlatformStatistics getPlatformStatistics()
+{
+    return platformStatistics;
+}
+
+}
+
+esp_err_t gpio_config(const gpio_config_t* /*pGPIOConfig*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    gpioOutputs.erase(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t /*gpio_num*/, gpio_mode_t /*mode*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t /*gpio_num*/, gpio_pull_mode_t /*pull*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pullup_en(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pullup_dis(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pulldown_en(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_pulldown_dis(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!heldPins.count(gpio_num))
+    {
+        gpioOutputs[gpio_num] = level ? 1 : 0;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (const auto iterator = gpioInputs.find(gpio_num); iterator != gpioInputs.end())
+    {
+        return iterator->second;
+    }
+    return simulation::getGpioOutput(gpio_num);
+}
+
+esp_err_t gpio_hold_en(gpio_num_t gpio_num)
+{
+    heldPins.insert(gpio_num);
+    return ESP_OK;
+}
+
+esp_err_t gpio_hold_dis(gpio_num_t gpio_num)
+{
+    heldPins.erase(gpio_num);
+    return ESP_OK;
+}
+
+void gpio_deep_sleep_hold_en()
+{
+}
+
+void gpio_deep_sleep_hold_dis()
+{
+}
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num)
+{
+    return gpio_num >= GPIO_NUM_0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t rtc_gpio_init(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_deinit(gpio_num_t /*gpio_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_set_direction(gpio_num_t /*gpio_num*/, rtc_gpio_mode_t /*mode*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    return gpio_set_level(gpio_num, level);
+}
+
+uint32_t rtc_gpio_get_level(gpio_num_t gpio_num)
+{
+    return static_cast<uint32_t>(gpio_get_level(gpio_num));
+}
+
+esp_err_t rtc_gpio_hold_en(gpio_num_t gpio_num)
+{
+    return gpio_hold_en(gpio_num);
+}
+
+esp_err_t rtc_gpio_hold_dis(gpio_num_t gpio_num)
+{
+    return gpio_hold_dis(gpio_num);
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t /*width_bit*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t /*channel*/, adc_atten_t /*atten*/)
+{
+    return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t /*channel*/)
+{
+    busyFor(10);
+    return adcRaw;
+}
+
+esp_err_t adc1_pad_get_io_num(adc1_channel_t channel, int* gpio_num)
+{
+    if (channel < ADC1_CHANNEL_0 || channel >= ADC1_CHANNEL_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *gpio_num = adcChannelPins[channel];
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t* i2c_conf)
+{
+    if (i2c_conf->mode == I2C_MODE_MASTER && i2c_conf->master.clk_speed > 0)
+    {
+        i2cClock.at(i2c_num) = i2c_conf->master.clk_speed;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t /*i2c_num*/, i2c_mode_t /*mode*/, size_t /*slv_rx_buf_len*/,
+                             size_t /*slv_tx_buf_len*/, int /*intr_alloc_flags*/)
+{
+    busyFor(simulation::initCosts.i2cDriverInstallMicroseconds);
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t /*i2c_num*/)
+{
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create()
+{
+    return new I2CCommand;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    delete static_cast<I2CCommand*>(cmd_handle);
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    static_cast<I2CCommand*>(cmd_handle)->operations.push_back({I2COperation::Type::Start, {}, nullptr, 0});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    return i2c_master_write(cmd_handle, &data, 1, ack_en);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t* data, size_t data_len, bool /*ack_en*/)
+{
+    static_cast<I2CCommand*>(cmd_handle)->operations.push_back(
+            {I2COperation::Type::Write, std::vector<uint8_t>(data, data + data_len), nullptr, 0});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t* data, i2c_ack_type_t ack)
+{
+    return i2c_master_read(cmd_handle, data, 1, ack);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t* data, size_t data_len, i2c_ack_type_t /*ack*/)
+{
+    static_cast<I2CCommand*>(cmd_handle)->operations.push_back({I2COperation::Type::Read, {}, data, data_len});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    static_cast<I2CCommand*>(cmd_handle)->operations.push_back({I2COperation::Type::Stop, {}, nullptr, 0});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t /*ticks_to_wait*/)
+{
+    const auto& operations = static_cast<I2CCommand*>(cmd_handle)->operations;
+    std::vector<uint8_t> written;
+    std::vector<std::pair<uint8_t*, size_t>> reads;
+    size_t transferredBytes = 0;
+    bool success = true;
+    const auto flush = [&]
+    {
+        if (!written.empty())
+        {
+            success = runI2CSegment(i2c_num, written, reads) && success;
+        }
+        written.clear();
+        reads.clear();
+    };
+    for (const auto& operation : operations)
+    {
+        switch (operation.type)
+        {
+            case I2COperation::Type::Start:
+            case I2COperation::Type::Stop:
+                flush();
+                break;
+            case I2COperation::Type::Write:
+                written.insert(written.end(), operation.data.begin(), operation.data.end());
+                transferredBytes += operation.data.size();
+                break;
+            case I2COperation::Type::Read:
+                reads.emplace_back(operation.destination, operation.size);
+                transferredBytes += operation.size;
+                break;
+        }
+    }
+    flush();
+    // 9 clocks per byte including the acknowledgement
+    const auto duration = int64_t(transferredBytes) * 9 * 1000000 / i2cClock.at(i2c_num);
+    simulation::platformStatistics.i2cMicroseconds += duration;
+    busyFor(duration);
+    return success ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t i2c_master_write_to_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t* write_buffer,
+                                     size_t write_size, TickType_t ticks_to_wait)
+{
+    return i2c_master_write_read_device(i2c_num, device_address, write_buffer, write_size, nullptr, 0,
+                                        ticks_to_wait);
+}
+
+esp_err_t i2c_master_read_from_device(i2c_port_t i2c_num, uint8_t device_address, uint8_t* read_buffer,
+                                      size_t read_size, TickType_t ticks_to_wait)
+{
+    return i2c_master_write_read_device(i2c_num, device_address, nullptr, 0, read_buffer, read_size,
+                                        ticks_to_wait);
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t i2c_num, uint8_t device_address, const uint8_t* write_buffer,
+                                       size_t write_size, uint8_t* read_buffer, size_t read_size,
+                                       TickType_t ticks_to_wait)
+{
+    auto* command = i2c_cmd_link_create();
+    if (write_size > 0)
+    {
+        i2c_master_start(command);
+        i2c_master_write_byte(command, static_cast<uint8_t>(device_address << 1 | I2C_MASTER_WRITE), true);
+        i2c_master_write(command, write_buffer, write_size, true);
+    }
+    if (read_size > 0)
+    {
+        i2c_master_start(command);
+        i2c_master_write_byte(command, static_cast<uint8_t>(device_address << 1 | I2C_MASTER_READ), true);
+        i2c_master_read(command, read_buffer, read_size, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(command);
+    const auto result = i2c_master_cmd_begin(i2c_num, command, ticks_to_wait);
+    i2c_cmd_link_delete(command);
+    return result;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t* uart_config)
+{
+    uartPorts.at(uart_num).baudRate = uart_config->baud_rate;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t /*uart_num*/, int /*tx_io_num*/, int /*rx_io_num*/, int /*rts_io_num*/,
+                       int /*cts_io_num*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int /*rx_buffer_size*/, int /*tx_buffer_size*/,
+                              int /*queue_size*/, QueueHandle_t* uart_queue, int /*intr_alloc_flags*/)
+{
+    uartPorts.at(uart_num).installed = true;
+    if (uart_queue)
+    {
+        *uart_queue = nullptr;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    uartPorts.at(uart_num).installed = false;
+    return ESP_OK;
+}
+
+bool uart_is_driver_installed(uart_port_t uart_num)
+{
+    return uartPorts.at(uart_num).installed;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void* src, size_t size)
+{
+    auto& port = uartPorts.at(uart_num);
+    const auto* bytes = static_cast<const uint8_t*>(src);
+    auto& kernel = VirtualKernel::instance();
+    // 10 bits per byte with the start and stop bits
+    const auto duration = int64_t(size) * 10 * 1000000 / std::max(port.baudRate, 1);
+    port.transmitDoneTime = std::max(port.transmitDoneTime, kernel.now()) + duration;
+    simulation::platformStatistics.uartBytes += size;
+    simulation::platformStatistics.uartMicroseconds += duration;
+    if (port.peripheral)
+    {
+        std::vector<uint8_t> data(bytes, bytes + size);
+        auto* peripheral = port.peripheral;
+        kernel.schedule(port.transmitDoneTime, [peripheral, data]
+        {
+            peripheral->receive(data.data(), data.size());
+        });
+    }
+    else if (uart_num == UART_NUM_0)
+    {
+        std::cout.write(reinterpret_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+    }
+    return static_cast<int>(size);
+}
+
+int uart_read_bytes(uart_port_t uart_num, void* buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    auto& port = uartPorts.at(uart_num);
+    auto& kernel = VirtualKernel::instance();
+    const auto deadline = ticks_to_wait == portMAX_DELAY ? simulation::infiniteTime
+                                                         : kernel.now() + int64_t(ticks_to_wait) * 1000 * portTICK_PERIOD_MS;
+    kernel.wait(deadline, [&port, length] { return port.received.size() >= length; });
+    const auto count = std::min<size_t>(length, port.received.size());
+    auto* bytes = static_cast<uint8_t*>(buf);
+    for (size_t i = 0; i < count; ++i)
+    {
+        bytes[i] = port.received.front();
+        port.received.pop_front();
+    }
+    // The answers of the peripheral take the wire as long as the bytes sent
+    simulation::platformStatistics.uartMicroseconds += int64_t(count) * 10 * 1000000 / std::max(port.baudRate, 1);
+    return static_cast<int>(count);
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t /*ticks_to_wait*/)
+{
+    auto& kernel = VirtualKernel::instance();
+    const auto doneTime = uartPorts.at(uart_num).transmitDoneTime;
+    if (doneTime > kernel.now())
+    {
+        busyFor(doneTime - kernel.now());
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_flush(uart_port_t uart_num)
+{
+    return uart_flush_input(uart_num);
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    uartPorts.at(uart_num).received.clear();
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t* size)
+{
+    *size = uartPorts.at(uart_num).received.size();
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t /*host_id*/, const spi_bus_config_t* /*bus_config*/, int /*dma_chan*/)
+{
+    busyFor(simulation::initCosts.spiBusInitializeMicroseconds);
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t /*host_id*/)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle)
+{
+    auto* device = new spi_device_t;
+    device->host = host_id;
+    device->clockHz = dev_config->clock_speed_hz;
+    device->preCallback = dev_config->pre_cb;
+    device->postCallback = dev_config->post_cb;
+    *handle = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc)
+{
+    transferSpi(handle, trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc)
+{
+    transferSpi(handle, trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc,
+                                 TickType_t /*ticks_to_wait*/)
+{
+    handle->pending.push_back(trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc,
+                                      TickType_t /*ticks_to_wait*/)
+{
+    if (handle->pending.empty() || spiStalled)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+    *trans_desc = handle->pending.front();
+    handle->pending.pop_front();
+    transferSpi(handle, *trans_desc);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t /*device*/, TickType_t /*wait*/)
+{
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t /*dev*/)
+{
+}
@@ -0,0 +1,83 @@
+#include "HostTest.h"
+#include "SampleAggregation.h"
+
+#include <cmath>
+
+// Robustness of the SPS30 sample aggregation to the outliers: single spikes and dropouts shall not move the result
+namespace
+{
+
+bool near(float value, float expected)
+{
+    return std::fabs(value - expected) < 0.01f;
+}
+
+void checkMedian()
+{
+    using host_test::check;
+    const char* testCase = "median";
+    std::array<float, 8> values {3.f, 1.f, 2.f};
+    check(near(aggregation::median(values, 3), 2.f), testCase, "odd count");
+    values = {4.f, 1.f, 3.f, 2.f};
+    check(near(aggregation::median(values, 4), 2.5f), testCase, "even count");
+    check(aggregation::median(values, 0) == 0.f, testCase, "no values");
+    values = {12.f, 12.f, 500.f, 12.f, 0.f, 12.f, 12.f};
+    check(near(aggregation::median(values, 7), 12.f), testCase, "spike and dropout");
+}
+
+void checkTrimmedMean()
+{
+    using host_test::check;
+    const char* testCase = "trimmed mean";
+    // The plain mean of these is 71.25
+    std::array<float, 8> values {10.f, 10.f, 500.f, 10.f, 10.f, 10.f, 10.f, 10.f};
+    check(near(aggregation::trimmedMean(values, 8, 2), 10.f), testCase, "one spike");
+    values = {10.f, 0.f, 11.f, 500.f, 9.f, 10.f, 12.f, 450.f};
+    check(near(aggregation::trimmedMean(values, 8, 2), 10.75f), testCase, "two spikes and a dropout");
+    values = {1.f, 2.f, 3.f, 4.f};
+    check(near(aggregation::trimmedMean(values, 4, 2), 2.5f), testCase, "trimmed to the median");
+    values = {1.f, 2.f, 3.f, 4.f, 100.f};
+    check(near(aggregation::trimmedMean(values, 5, 0), 22.f), testCase, "no trimming");
+}
+
+ParticleData sample(float pm25, float size)
+{
+    ParticleData data;
+    data[ParticleData::Mc2p5] = pm25;
+    data[ParticleData::TypicalSize] = size;
+    return data;
+}
+
+void checkSamples()
+{
+    using host_test::check;
+    const char* testCase = "particle samples";
+    aggregation::ParticleSamples<8> samples;
+    for (int i = 0; i < 10; ++i)
+    {
+        // The first two samples are dropped by the buffer
+        samples.add(sample(i < 2 ? 80.f : 12.f, 0.5f));
+    }
+    check(samples.size() == 8, testCase, "latest samples kept");
+    auto result = samples.aggregate();
+    check(near(result[ParticleData::Mc2p5], 12.f), testCase, "old samples dropped");
+
+    samples.add(sample(300.f, 3.f));
+    samples.add(sample(0.f, 0.3f));
+    result = samples.aggregate();
+    check(near(result[ParticleData::Mc2p5], 12.f), testCase, "spike and dropout trimmed");
+    check(near(result[ParticleData::TypicalSize], 0.5f), testCase, "size median");
+
+    samples.clear();
+    check(samples.size() == 0 && samples.aggregate()[ParticleData::Mc2p5] == 0.f, testCase, "cleared");
+}
+
+}
+
+int main()
+{
+    checkMedian();
+    checkTrimmedMean();
+    checkSamples();
+    return host_test::result();
+}
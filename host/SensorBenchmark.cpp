@@ -0,0 +1,109 @@
+#include "BusScheduler.h"
+#include "Clock.h"
+#include "FakeSensorProvider.h"
+#include "VirtualKernel.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Bus windows and bus-active time of the measurement cycle of BusScheduler with the sensors of the unit and the
+// ones it may get, every sensor served by FakeSensorProvider. Each cycle is a wake of the virtual kernel, so the
+// waits for the conversions are the virtual time.
+namespace
+{
+
+using Bus = SensorProvider::Bus;
+
+constexpr int64_t microsecondsInSecond = 1000000;
+constexpr int64_t cyclePeriodMicroseconds = 60 * microsecondsInSecond;
+
+// Typical transfer times at the bus speeds of the unit and the conversion times from the datasheets
+FakeSensorProvider bme280("bme280", Bus::I2C, {600, 9300});
+FakeSensorProvider sht4x("sht4x", Bus::I2C, {600, 8300});
+FakeSensorProvider scd41("scd41", Bus::I2C, {1500, 5000000});
+FakeSensorProvider sps30("sps30", Bus::Uart, {5000, 10000000, 2, microsecondsInSecond});
+FakeSensorProvider* const allSensors[] = {&bme280, &sht4x, &scd41, &sps30};
+
+SensorRegistry registry;
+
+void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [--cycles N] [--without bme280|sht4x|scd41|sps30]..." << std::endl;
+}
+
+void runCycle()
+{
+    BusScheduler scheduler(registry, Clock::instance());
+    const auto started = scheduler.start(registry.all());
+    scheduler.read(started);
+    scheduler.sleep(started);
+    scheduler.finishCycle();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t cycles = 10;
+    std::string without;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        if (argument == "--cycles" && i + 1 < argc)
+        {
+            cycles = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--without" && i + 1 < argc)
+        {
+            without += std::string(" ") + argv[++i] + " ";
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    std::cout << "Sensors:            ";
+    for (auto* sensor : allSensors)
+    {
+        if (without.find(std::string(" ") + sensor->name() + " ") == std::string::npos)
+        {
+            registry.add(*sensor);
+            std::cout << " " << sensor->name() << (sensor->bus() == Bus::I2C ? " (I2C)" : " (UART)");
+        }
+    }
+    std::cout << "\n";
+    if (cycles == 0 || registry.size() == 0)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    auto& kernel = simulation::VirtualKernel::instance();
+    int64_t awakeMicroseconds = 0;
+    for (uint32_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        const auto result = kernel.runWake(&runCycle, simulation::infiniteTime);
+        awakeMicroseconds += result.awakeMicroseconds;
+        kernel.advance(cyclePeriodMicroseconds - result.awakeMicroseconds);
+    }
+
+    const auto statistics = BusScheduler::getTotalStatistics();
+    int64_t wireMicroseconds = 0;
+    uint32_t earlyReads = 0;
+    for (size_t id = 0; id < registry.size(); ++id)
+    {
+        const auto& sensor = static_cast<const FakeSensorProvider&>(registry[id]);
+        wireMicroseconds += sensor.getWireMicroseconds();
+        earlyReads += sensor.getEarlyReads();
+    }
+    const auto perCycle = [&statistics](double value) { return value / statistics.cycles; };
+    std::cout << "Bus windows:         " << perCycle(statistics.windows) << " per cycle, "
+              << perCycle(statistics.operations) << " with every sensor operation in its own window\n"
+              << "Bus-active time:     " << perCycle(double(statistics.activeMicroseconds)) / 1000.0
+              << " ms per cycle, " << perCycle(double(wireMicroseconds)) / 1000.0 << " ms of it on the wires\n"
+              << "Cycle time:          " << perCycle(double(awakeMicroseconds)) / 1000.0 << " ms\n"
+              << "Early reads:         " << earlyReads << std::endl;
+    return earlyReads != 0 ? 1 : 0;
+}
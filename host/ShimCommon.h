@@ -0,0 +1,17 @@
+#pragma once
+
+#include "HostPlatform.h"
+
+namespace simulation
+{
+
+// Counters shared by the shim implementations
+extern PlatformStatistics platformStatistics;
+extern InitCosts initCosts;
+
+// Keeps the calling task running for the given time
+void busyFor(int64_t microseconds);
+// True while a task is in busyFor, the CPU doesn't idle then
+[[nodiscard]] bool isCpuBusy();
+
+}
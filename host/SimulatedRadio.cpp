@@ -0,0 +1,302 @@
+#include "SimulatedRadio.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+namespace
+{
+using MacAddress = RadioInterface::MacAddress;
+
+void writeHex(std::ostream& output, const uint8_t* data, size_t size)
+{
+    const auto flags = output.flags();
+    output << std::hex << std::setfill('0');
+    for (size_t i = 0; i < size; ++i)
+    {
+        output << std::setw(2) << static_cast<int>(data[i]);
+    }
+    output.flags(flags);
+}
+
+bool readHex(const std::string& text, std::vector<uint8_t>& result)
+{
+    if (text.size() % 2 != 0)
+    {
+        return false;
+    }
+    const auto isHexDigit = [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; };
+    if (!std::all_of(text.begin(), text.end(), isHexDigit))
+    {
+        return false;
+    }
+    result.clear();
+    for (size_t i = 0; i < text.size(); i += 2)
+    {
+        const auto byte = std::stoul(text.substr(i, 2), nullptr, 16);
+        result.push_back(static_cast<uint8_t>(byte));
+    }
+    return true;
+}
+
+bool readMac(const std::string& text, MacAddress& mac)
+{
+    std::vector<uint8_t> bytes;
+    if (!readHex(text, bytes) || bytes.size() != mac.size())
+    {
+        return false;
+    }
+    std::copy(bytes.begin(), bytes.end(), mac.begin());
+    return true;
+}
+}
+
+bool SimulatedMedium::runNext()
+{
+    if (events.empty())
+    {
+        return false;
+    }
+    const auto event = events.top();
+    events.pop();
+    currentTime = std::max(currentTime, event.time);
+    deliver(event);
+    return true;
+}
+
+std::optional<int64_t> SimulatedMedium::nextEventTime() const
+{
+    if (events.empty())
+    {
+        return std::nullopt;
+    }
+    return events.top().time;
+}
+
+void SimulatedMedium::runUntil(int64_t time)
+{
+    while (!events.empty() && events.top().time <= time)
+    {
+        runNext();
+    }
+    currentTime = std::max(currentTime, time);
+}
+
+std::optional<size_t> SimulatedMedium::replay(std::istream& input, size_t& errorLine)
+{
+    std::vector<Event> recorded;
+    std::string line;
+    size_t number = 0;
+    while (std::getline(input, line))
+    {
+        ++number;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        std::istringstream stream(line);
+        int64_t time = 0;
+        std::string source;
+        std::string destination;
+        int delivered = 0;
+        std::string payload;
+        std::string rest;
+        Event event;
+        if (!(stream >> time >> source >> destination >> delivered >> payload) || (stream >> rest)
+            || (delivered != 0 && delivered != 1)
+            || !readMac(source, event.source) || !readMac(destination, event.destination)
+            || !readHex(payload, event.payload))
+        {
+            errorLine = number;
+            return std::nullopt;
+        }
+        event.time = time;
+        event.lost = delivered == 0;
+        recorded.push_back(std::move(event));
+    }
+    // Nothing is scheduled from a trace with an invalid line
+    const int64_t firstTime = recorded.empty() ? 0 : recorded.front().time;
+    for (auto& event : recorded)
+    {
+        event.time = now() + event.time - firstTime;
+        event.sendTime = event.time;
+        event.reportToSender = false;
+        schedule(std::move(event));
+    }
+    return recorded.size();
+}
+
+void SimulatedMedium::attach(SimulatedRadio* radio)
+{
+    radios.push_back(radio);
+}
+
+void SimulatedMedium::detach(SimulatedRadio* radio)
+{
+    radios.erase(std::remove(radios.begin(), radios.end(), radio), radios.end());
+}
+
+void SimulatedMedium::transmit(const SimulatedRadio& sender, const MacAddress& destination, const uint8_t* data,
+                               size_t size)
+{
+    std::uniform_real_distribution<double> probability(0.0, 1.0);
+    Event event;
+    event.source = sender.getAddress();
+    event.destination = destination;
+    event.payload.assign(data, data + size);
+    event.sendTime = now();
+    event.channel = sender.getChannel();
+    event.lost = probability(generator) < parameters.lossProbability;
+    event.time = event.sendTime + randomDelay();
+    ++statistics.transmitted;
+    if (!event.lost && probability(generator) < parameters.duplicationProbability)
+    {
+        Event duplicate = event;
+        duplicate.time = event.time + randomDelay();
+        duplicate.reportToSender = false;
+        ++statistics.duplicated;
+        schedule(std::move(duplicate));
+    }
+    schedule(std::move(event));
+}
+
+void SimulatedMedium::schedule(Event event)
+{
+    event.sequence = sequenceCounter++;
+    events.push(std::move(event));
+}
+
+void SimulatedMedium::deliver(const Event& event)
+{
+    auto* receiver = findRadio(event.destination);
+    const bool delivered = !event.lost && receiver && receiver->isPowered()
+                           && (event.channel == 0 || event.channel == receiver->getChannel());
+    if (recordStream)
+    {
+        *recordStream << event.time << ' ';
+        writeHex(*recordStream, event.source.data(), event.source.size());
+        *recordStream << ' ';
+        writeHex(*recordStream, event.destination.data(), event.destination.size());
+        *recordStream << ' ' << (delivered ? 1 : 0) << ' ';
+        writeHex(*recordStream, event.payload.data(), event.payload.size());
+        *recordStream << '\n';
+    }
+    if (delivered)
+    {
+        ++statistics.delivered;
+        statistics.totalLatencyMicroseconds += event.time - event.sendTime;
+        ++receiver->receivedCount;
+        if (receiver->receiveCallback)
+        {
+            RadioInterface::ReceiveInfo info { event.source, parameters.rssi };
+            receiver->receiveCallback(receiver->callbackContext, info, event.payload.data(), event.payload.size());
+        }
+    }
+    else
+    {
+        ++statistics.lost;
+    }
+    if (event.reportToSender)
+    {
+        if (auto* sender = findRadio(event.source); sender && sender->isPowered() && sender->sendCallback)
+        {
+            sender->sendCallback(sender->callbackContext, event.destination, delivered);
+        }
+    }
+}
+
+SimulatedRadio* SimulatedMedium::findRadio(const MacAddress& address) const
+{
+    const auto it = std::find_if(radios.begin(), radios.end(),
+                                 [&address](const SimulatedRadio* radio) { return radio->getAddress() == address; });
+    return it != radios.end() ? *it : nullptr;
+}
+
+int64_t SimulatedMedium::randomDelay()
+{
+    if (parameters.jitterMicroseconds <= 0)
+    {
+        return parameters.latencyMicroseconds;
+    }
+    std::uniform_int_distribution<int64_t> jitter(0, parameters.jitterMicroseconds);
+    return parameters.latencyMicroseconds + jitter(generator);
+}
+
+SimulatedRadio::SimulatedRadio(SimulatedMedium& medium, const MacAddress& address)
+    : medium(medium)
+    , address(address)
+{
+    medium.attach(this);
+}
+
+SimulatedRadio::~SimulatedRadio()
+{
+    medium.detach(this);
+}
+
+bool SimulatedRadio::init()
+{
+    if (!powered)
+    {
+        powered = true;
+        powerOnTime = medium.now();
+    }
+    return true;
+}
+
+void SimulatedRadio::deinit()
+{
+    if (powered)
+    {
+        accumulatedOnTime += medium.now() - powerOnTime;
+        powered = false;
+    }
+    peers.clear();
+}
+
+bool SimulatedRadio::addPeer(const MacAddress& macAddress)
+{
+    if (std::find(peers.begin(), peers.end(), macAddress) != peers.end())
+    {
+        return false;
+    }
+    peers.push_back(macAddress);
+    return true;
+}
+
+bool SimulatedRadio::send(const MacAddress& destination, const uint8_t* data, size_t size)
+{
+    if (!powered || size > maxPayloadSize || std::find(peers.begin(), peers.end(), destination) == peers.end())
+    {
+        return false;
+    }
+    ++sentCount;
+    medium.transmit(*this, destination, data, size);
+    return true;
+}
+
+bool SimulatedRadio::setCallbacks(void* context, ReceiveCallback onReceive, SendCallback onSend)
+{
+    callbackContext = context;
+    receiveCallback = onReceive;
+    sendCallback = onSend;
+    return true;
+}
+
+bool SimulatedRadio::setChannel(uint8_t newChannel)
+{
+    if (newChannel < 1 || newChannel > 14)
+    {
+        return false;
+    }
+    channel = newChannel;
+    return true;
+}
+
+int64_t SimulatedRadio::getRadioOnTime() const
+{
+    return accumulatedOnTime + (powered ? medium.now() - powerOnTime : 0);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "RadioInterface.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <queue>
+#include <random>
+#include <vector>
+
+class SimulatedRadio;
+
+// Shared medium for the simulated radios driven by the virtual time.
+// All the packets are delivered in the order of the virtual time, so the simulation is deterministic for a given seed.
+class SimulatedMedium
+{
+public:
+    using MacAddress = RadioInterface::MacAddress;
+
+    struct Parameters
+    {
+        double lossProbability = 0.0;
+        double duplicationProbability = 0.0;
+        int64_t latencyMicroseconds = 1000;
+        int64_t jitterMicroseconds = 0;
+        int8_t rssi = -60;
+        uint32_t seed = 1;
+    };
+
+    struct Statistics
+    {
+        uint32_t transmitted = 0;
+        uint32_t delivered = 0;
+        uint32_t lost = 0;
+        uint32_t duplicated = 0;
+        int64_t totalLatencyMicroseconds = 0;
+    };
+
+    explicit SimulatedMedium(const Parameters& parameters) : parameters(parameters), generator(parameters.seed) {}
+
+    void setParameters(const Parameters& newParameters) { parameters = newParameters; }
+    // Makes the medium follow an external virtual clock instead of its own event time
+    void setClock(std::function<int64_t()> newClock) { clock = std::move(newClock); }
+    [[nodiscard]] int64_t now() const { return clock ? std::max(clock(), currentTime) : currentTime; }
+    [[nodiscard]] std::optional<int64_t> nextEventTime() const;
+    [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
+    // Processes the next pending event, returns false if there are no events left
+    bool runNext();
+    // Processes all the events up to the given time and moves the virtual time there
+    void runUntil(int64_t time);
+    void runFor(int64_t microseconds) { runUntil(currentTime + microseconds); }
+
+    // Every delivery attempt is written to the stream as a line: time source destination delivered payload
+    void startRecording(std::ostream& output) { recordStream = &output; }
+    void stopRecording() { recordStream = nullptr; }
+    // Schedules the recorded deliveries relative to the current time, returns the number of packets scheduled;
+    // returns nothing if a line can't be parsed, the number of the line is put to errorLine
+    std::optional<size_t> replay(std::istream& input, size_t& errorLine);
+
+private:
+    friend class SimulatedRadio;
+
+    struct Event
+    {
+        int64_t time = 0;
+        uint64_t sequence = 0;
+        MacAddress source {};
+        MacAddress destination {};
+        std::vector<uint8_t> payload;
+        int64_t sendTime = 0;
+        bool lost = false;
+        bool reportToSender = true;
+        // The replayed packets have no channel and reach the receiver on any one
+        uint8_t channel = 0;
+
+        bool operator>(const Event& other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    void attach(SimulatedRadio* radio);
+    void detach(SimulatedRadio* radio);
+    void transmit(const SimulatedRadio& sender, const MacAddress& destination, const uint8_t* data, size_t size);
+    void schedule(Event event);
+    void deliver(const Event& event);
+    SimulatedRadio* findRadio(const MacAddress& address) const;
+    int64_t randomDelay();
+
+    Parameters parameters;
+    Statistics statistics;
+    std::mt19937 generator;
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events;
+    std::vector<SimulatedRadio*> radios;
+    std::ostream* recordStream = nullptr;
+    std::function<int64_t()> clock;
+    int64_t currentTime = 0;
+    uint64_t sequenceCounter = 0;
+};
+
+// Radio node attached to the simulated medium. The radio is considered as powered between init() and deinit(),
+// it receives only the packets sent on its channel.
+class SimulatedRadio : public RadioInterface
+{
+public:
+    SimulatedRadio(SimulatedMedium& medium, const MacAddress& address);
+    ~SimulatedRadio() override;
+
+    bool init() override;
+    void deinit() override;
+    bool addPeer(const MacAddress& macAddress) override;
+    bool send(const MacAddress& destination, const uint8_t* data, size_t size) override;
+    bool setCallbacks(void* context, ReceiveCallback onReceive, SendCallback onSend) override;
+    bool setChannel(uint8_t newChannel) override;
+    [[nodiscard]] uint8_t getChannel() const override { return channel; }
+
+    [[nodiscard]] const MacAddress& getAddress() const { return address; }
+    [[nodiscard]] bool isPowered() const { return powered; }
+    [[nodiscard]] int64_t getRadioOnTime() const;
+    [[nodiscard]] uint32_t getSentCount() const { return sentCount; }
+    [[nodiscard]] uint32_t getReceivedCount() const { return receivedCount; }
+
+private:
+    friend class SimulatedMedium;
+
+    SimulatedMedium& medium;
+    MacAddress address;
+    std::vector<MacAddress> peers;
+    void* callbackContext = nullptr;
+    ReceiveCallback receiveCallback = nullptr;
+    SendCallback sendCallback = nullptr;
+    bool powered = false;
+    uint8_t channel = 1;
+    int64_t powerOnTime = 0;
+    int64_t accumulatedOnTime = 0;
+    uint32_t sentCount = 0;
+    uint32_t receivedCount = 0;
+};
@@ -0,0 +1,182 @@
+#include "HostPlatform.h"
+#include "HostTest.h"
+#include "SpiDmaStream.h"
+#include "VirtualKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The ping-pong chunks of SpiDmaStream on the spi_master shim, which runs a queued transfer when its result is
+// taken: the order of the bytes on the bus, the statistics of the writes and the buffers kept by a stalled bus
+namespace
+{
+
+constexpr auto host = SPI2_HOST;
+constexpr int clockHz = 10000000;
+// The frame of the 3.7 inch panel, 4 full chunks and a part of one
+constexpr size_t frameSize = 280 * 480 / 8;
+
+class BusRecorder : public simulation::SpiPeripheral
+{
+public:
+    void receive(const uint8_t* data, size_t size) override
+    {
+        bytes.insert(bytes.end(), data, data + size);
+        chunks.push_back(size);
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> chunks;
+};
+
+BusRecorder recorder;
+bool queued = true;
+int frames = 1;
+bool initialized = false;
+bool written = false;
+size_t receivedWhileStalled = 0;
+size_t receivedAfterStall = 0;
+bool writtenAfterStall = false;
+SpiDmaStream::Statistics statistics;
+
+uint8_t patternByte(size_t offset)
+{
+    // Differs between the chunks at the same position, a chunk overwritten before its transfer is told apart
+    return static_cast<uint8_t>(offset * 7 + offset / SpiDmaStream::chunkSize * 61);
+}
+
+size_t producePattern(void* /*context*/, size_t offset, uint8_t* buffer, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        buffer[i] = patternByte(offset + i);
+    }
+    return size;
+}
+
+bool matchesPattern(const uint8_t* bytes, size_t size)
+{
+    for (size_t offset = 0; offset < size; ++offset)
+    {
+        if (bytes[offset] != patternByte(offset))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Time of the chunks of a write on the bus, each one rounded down to the microsecond as by the shim
+int64_t busMicroseconds(size_t size)
+{
+    int64_t total = 0;
+    for (size_t offset = 0; offset < size; offset += SpiDmaStream::chunkSize)
+    {
+        const auto chunk = std::min(SpiDmaStream::chunkSize, size - offset);
+        total += int64_t(chunk) * 8 * 1000000 / clockHz;
+    }
+    return total;
+}
+
+void writeFrames()
+{
+    SpiDmaStream stream(host, clockHz, queued);
+    initialized = stream.init();
+    written = true;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        written = stream.write(frameSize, &producePattern, nullptr) && written;
+    }
+    statistics = stream.getStatistics();
+}
+
+void runWrites(bool queuedMode, int frameCount)
+{
+    recorder = {};
+    queued = queuedMode;
+    frames = frameCount;
+    simulation::VirtualKernel::instance().runWake(&writeFrames, 1000000);
+}
+
+void checkQueued()
+{
+    using host_test::check;
+    const char* testCase = "queued chunks";
+    runWrites(true, 1);
+    check(initialized && written, testCase, "written");
+    check(recorder.bytes.size() == frameSize && matchesPattern(recorder.bytes.data(), frameSize), testCase,
+          "ping-pong order of the bytes");
+    check(recorder.chunks == std::vector<size_t> {4092, 4092, 4092, 4092, frameSize - 4 * 4092}, testCase,
+          "chunks of a DMA descriptor");
+    check(statistics.bytes == frameSize, testCase, "bytes");
+    check(statistics.totalMicroseconds == busMicroseconds(frameSize), testCase, "time on the bus");
+    // The producer takes no virtual time, the whole write is the wait for the transfers
+    check(statistics.cpuBusyMicroseconds == 0, testCase, "CPU idle while the chunks are sent");
+    check(std::fabs(statistics.getThroughput() - float(clockHz) / 8 / 1000) < 1.f, testCase, "throughput");
+}
+
+void checkStatisticsAccumulated()
+{
+    using host_test::check;
+    const char* testCase = "statistics of the writes";
+    runWrites(true, 3);
+    check(written && recorder.bytes.size() == 3 * frameSize, testCase, "all frames sent");
+    check(statistics.bytes == 3 * frameSize, testCase, "bytes");
+    check(statistics.totalMicroseconds == 3 * busMicroseconds(frameSize), testCase, "time on the bus");
+}
+
+void checkPolling()
+{
+    using host_test::check;
+    const char* testCase = "polling transmits";
+    runWrites(false, 1);
+    check(written && recorder.bytes.size() == frameSize && matchesPattern(recorder.bytes.data(), frameSize),
+          testCase, "order of the bytes");
+    check(statistics.totalMicroseconds == busMicroseconds(frameSize), testCase, "time on the bus");
+    // The CPU spins in every transfer
+    check(statistics.cpuBusyMicroseconds == statistics.totalMicroseconds, testCase, "CPU busy");
+}
+
+void writeOnStalledBus()
+{
+    SpiDmaStream stream(host, clockHz, true);
+    initialized = stream.init();
+    simulation::setSpiStalled(true);
+    // Both chunks are queued, the wait for the first one fails
+    written = stream.write(frameSize, &producePattern, nullptr);
+    stream.deinit();
+    receivedWhileStalled = recorder.bytes.size();
+    simulation::setSpiStalled(false);
+    // The chunks queued before the stall are sent from the kept buffers
+    stream.deinit();
+    receivedAfterStall = recorder.bytes.size();
+    writtenAfterStall = stream.init() && stream.write(frameSize, &producePattern, nullptr);
+}
+
+void checkStalledBus()
+{
+    using host_test::check;
+    const char* testCase = "stalled bus";
+    recorder = {};
+    simulation::VirtualKernel::instance().runWake(&writeOnStalledBus, 1000000);
+    constexpr size_t queuedSize = 2 * SpiDmaStream::chunkSize;
+    check(initialized && !written, testCase, "write failed");
+    check(receivedWhileStalled == 0, testCase, "nothing sent while stalled");
+    check(receivedAfterStall == queuedSize && matchesPattern(recorder.bytes.data(), queuedSize), testCase,
+          "queued chunks sent intact");
+    check(writtenAfterStall && recorder.bytes.size() == queuedSize + frameSize
+          && matchesPattern(recorder.bytes.data() + queuedSize, frameSize), testCase, "written after the stall");
+}
+
+}
+
+int main()
+{
+    simulation::attachSpi(host, recorder);
+    checkQueued();
+    checkStatisticsAccumulated();
+    checkPolling();
+    checkStalledBus();
+    return host_test::result();
+}
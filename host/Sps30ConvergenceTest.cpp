@@ -0,0 +1,131 @@
+#include "Clock.h"
+#include "FakeSps30.h"
+#include "HostTest.h"
+#include "SPS30DataProvider.h"
+#include "VirtualKernel.h"
+
+#include "esp32-esp-idf/PacketUartImpl.h"
+
+#include <cmath>
+#include <vector>
+
+// Convergence of the adaptive SPS30 measurement on the traces of PM2.5, one value per second since the start of
+// the measurement, served by FakeSps30 on the virtual kernel
+namespace
+{
+
+constexpr int uartPort = 2;
+constexpr int64_t microsecondsInSecond = 1000000;
+
+struct TraceCase
+{
+    const char* name;
+    std::vector<float> pm25;
+    bool powered;
+    SensorProvider::ReadResult expectedResult;
+    bool converges;
+    uint32_t minFanOnSeconds;
+    uint32_t maxFanOnSeconds;
+    float expectedPm25;
+};
+
+const TraceCase* currentCase = nullptr;
+int64_t traceStart = 0;
+bool supplied = true;
+SensorProvider::ReadResult readResult = SensorProvider::ReadResult::Failed;
+std::optional<ParticleData> particleData;
+uint32_t fanOnSeconds = 0;
+
+float tracePm25(int64_t realTimeMicroseconds)
+{
+    const auto& trace = currentCase->pm25;
+    const auto index = static_cast<size_t>(std::max<int64_t>(0, realTimeMicroseconds - traceStart)
+                                           / microsecondsInSecond);
+    return trace[std::min(index, trace.size() - 1)];
+}
+
+void measure()
+{
+    embedded::PacketUart::UartDevice::init(uartPort, 0, 0, 115200);
+    embedded::PacketUart::UartDevice uartDevice(uartPort);
+    embedded::PacketUart packetUart(uartDevice);
+    SPS30DataProvider provider(packetUart);
+    auto& clock = Clock::instance();
+    traceStart = simulation::realTimeMicroseconds();
+    supplied = true;
+    provider.start();
+    supplied = currentCase->powered;
+    do
+    {
+        clock.sleepUntil(provider.readyTime());
+        readResult = provider.read();
+    }
+    while (readResult == SensorProvider::ReadResult::Pending);
+    particleData = provider.getParticleData();
+    fanOnSeconds = provider.getLastFanOnSeconds();
+    provider.sleep();
+}
+
+void runCase(const TraceCase& testCase)
+{
+    currentCase = &testCase;
+    FakeSps30 sensor(uartPort, &tracePm25, [] { return supplied; });
+    simulation::attachUart(uartPort, sensor);
+    const auto convergedBefore = SPS30DataProvider::getConvergedMeasurements();
+    const auto cappedBefore = SPS30DataProvider::getCappedMeasurements();
+    auto& kernel = simulation::VirtualKernel::instance();
+    kernel.runWake(&measure, 60 * microsecondsInSecond);
+    kernel.advance(60 * microsecondsInSecond);
+
+    using host_test::check;
+    check(readResult == testCase.expectedResult, testCase.name, "result");
+    check(fanOnSeconds >= testCase.minFanOnSeconds && fanOnSeconds <= testCase.maxFanOnSeconds, testCase.name,
+          "fan-on time");
+    check(SPS30DataProvider::getConvergedMeasurements() - convergedBefore == (testCase.converges ? 1u : 0u),
+          testCase.name, "converged count");
+    check(SPS30DataProvider::getCappedMeasurements() - cappedBefore == (testCase.converges ? 0u : 1u),
+          testCase.name, "capped count");
+    if (testCase.expectedResult == SensorProvider::ReadResult::Done)
+    {
+        check(particleData && std::fabs((*particleData)[ParticleData::Mc2p5] - testCase.expectedPm25) < 0.5f,
+              testCase.name, "aggregated PM2.5");
+    }
+    std::cout << testCase.name << ": fan on for " << fanOnSeconds << " s" << std::endl;
+}
+
+}
+
+int main()
+{
+    using ReadResult = SensorProvider::ReadResult;
+    const auto& settings = SPS30DataProvider::convergenceSettings;
+    const auto warmUp = settings.warmUpSeconds;
+    const auto stable = static_cast<uint32_t>(settings.stableSamples);
+
+    // The first sample comes with the end of the warm-up, the stable ones follow every second
+    runCase({"steady air", std::vector<float>(40, 12.0f), true, ReadResult::Done, true, warmUp + stable - 1,
+             warmUp + stable, 12.0f});
+
+    // The chamber is flushed after the fan starts, the readings jump until they settle at 10 ug/m3 after 16 s;
+    // the aggregate is taken over the latest samples, the trimmed mean still holds some of the unsettled ones
+    std::vector<float> flushed;
+    for (int second = 0; second < 40; ++second)
+    {
+        flushed.push_back(second < 16 && second % 2 ? 16.0f : 10.0f);
+    }
+    runCase({"settling", flushed, true, ReadResult::Done, true, 16 + stable - 1, 16 + stable, 11.5f});
+
+    // Gusts never let the readings settle, the hard cap stops the fan with the aggregate of the last samples
+    std::vector<float> gusty;
+    for (int second = 0; second < 40; ++second)
+    {
+        gusty.push_back(second % 2 ? 30.0f : 20.0f);
+    }
+    runCase({"gusty", gusty, true, ReadResult::Done, false, settings.maxSeconds - 1, settings.maxSeconds + 1, 25.0f});
+
+    // The supply fails after the start, the sensor never answers and it's polled once a second until the hard cap
+    runCase({"supply failure", std::vector<float>(40, 12.0f), false, ReadResult::Failed, false,
+             settings.maxSeconds - 1, settings.maxSeconds + 1, 0.0f});
+
+    return host_test::result();
+}
@@ -0,0 +1,42 @@
+#include "VirtualClock.h"
+
+#include <algorithm>
+
+VirtualClock::VirtualClock(int64_t wallStartMicroseconds, double rtcFrequency, double rtcErrorPpm)
+    : wallOffset(wallStartMicroseconds)
+    , rtcFrequency(rtcFrequency)
+    , rtcErrorPpm(rtcErrorPpm)
+{
+}
+
+int64_t VirtualClock::wallMicroseconds() const
+{
+    return wallOffset + elapsedMicroseconds();
+}
+
+void VirtualClock::setWallMicroseconds(int64_t microseconds)
+{
+    wallOffset = microseconds - elapsedMicroseconds();
+}
+
+uint64_t VirtualClock::rtcTicks() const
+{
+    const auto frequency = rtcFrequency * (1.0 + rtcErrorPpm / 1e6);
+    return static_cast<uint64_t>(static_cast<double>(elapsedMicroseconds()) * frequency / 1e6);
+}
+
+void VirtualClock::sleepUntil(int64_t monotonicDeadline)
+{
+    sinceBoot = std::max(sinceBoot, monotonicDeadline);
+}
+
+void VirtualClock::advance(int64_t microseconds)
+{
+    sinceBoot += std::max<int64_t>(microseconds, 0);
+}
+
+void VirtualClock::deepSleep(int64_t microseconds)
+{
+    beforeBoot += sinceBoot + std::max<int64_t>(microseconds, 0);
+    sinceBoot = 0;
+}
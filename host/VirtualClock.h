@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Clock.h"
+
+#include <cstdint>
+
+// Deterministic clock for running the timing logic of the firmware on the build machine without the simulated
+// kernel. The time moves only by advance() and by the waits, which return at once with the time at their deadline.
+// The RTC counter runs with the given frequency error, so the correction after the deep sleep can be checked.
+class VirtualClock : public Clock
+{
+public:
+    explicit VirtualClock(int64_t wallStartMicroseconds = 0, double rtcFrequency = 32768.0, double rtcErrorPpm = 0.0);
+
+    [[nodiscard]] int64_t wallMicroseconds() const override;
+    void setWallMicroseconds(int64_t microseconds) override;
+    [[nodiscard]] int64_t monotonicMicroseconds() const override { return sinceBoot; }
+    [[nodiscard]] uint64_t rtcTicks() const override;
+    void sleepUntil(int64_t monotonicDeadline) override;
+
+    void advance(int64_t microseconds);
+    // Simulates the deep sleep: the monotonic time restarts from zero, the wall clock and the RTC keep running
+    void deepSleep(int64_t microseconds);
+    // Time passed since the creation of the clock
+    [[nodiscard]] int64_t elapsedMicroseconds() const { return beforeBoot + sinceBoot; }
+
+private:
+    int64_t wallOffset;
+    double rtcFrequency;
+    double rtcErrorPpm;
+    int64_t beforeBoot = 0;
+    int64_t sinceBoot = 0;
+};
@@ -0,0 +1,410 @@
+#include "VirtualKernel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+namespace simulation
+{
+
+thread_local VirtualKernel::Task* VirtualKernel::currentTask = nullptr;
+
+VirtualKernel& VirtualKernel::instance()
+{
+    static VirtualKernel kernel;
+    return kernel;
+}
+
+void VirtualKernel::addEventSource(EventSource& source)
+{
+    sources.push_back(&source);
+}
+
+void VirtualKernel::addResetHandler(std::function<void()> handler)
+{
+    resetHandlers.push_back(std::move(handler));
+}
+
+void VirtualKernel::setIdleHandler(std::function<void(int64_t from, int64_t to)> handler)
+{
+    idleHandler = std::move(handler);
+}
+
+void VirtualKernel::schedule(int64_t time, std::function<void()> action)
+{
+    actions.push(Action { std::max(time, currentTime), sequenceCounter++, std::move(action) });
+}
+
+WakeResult VirtualKernel::runWake(void (*entry)(), int64_t maxAwakeMicroseconds)
+{
+    bootTime = currentTime;
+    wakeDeadline = maxAwakeMicroseconds == infiniteTime ? infiniteTime : currentTime + maxAwakeMicroseconds;
+    sleepRequest.reset();
+    contextSwitches = 0;
+    wakeCompleted = false;
+    createTask([](void* parameter) { reinterpret_cast<void (*)()>(parameter)(); },
+               reinterpret_cast<void*>(entry), "main", 1);
+    dispatch(nullptr);
+    {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this] { return wakeCompleted; });
+    }
+    for (auto& task : tasks)
+    {
+        task->thread.join();
+    }
+    tasks.clear();
+    // The pending actions of the chip don't survive the reset
+    actions = {};
+    for (const auto& handler : resetHandlers)
+    {
+        handler();
+    }
+    return WakeResult { sleepRequest, currentTime - bootTime, contextSwitches };
+}
+
+void VirtualKernel::advance(int64_t microseconds)
+{
+    const auto target = currentTime + microseconds;
+    for (auto next = nextEventTime(); next && *next <= target; next = nextEventTime())
+    {
+        currentTime = std::max(currentTime, *next);
+        runDueEvents();
+    }
+    currentTime = std::max(currentTime, target);
+}
+
+void* VirtualKernel::createTask(TaskFunction function, void* parameter, const char* name, int priority)
+{
+    auto task = std::make_unique<Task>();
+    task->name = name ? name : "";
+    task->priority = priority;
+    task->function = function;
+    task->parameter = parameter;
+    auto* pointer = task.get();
+    tasks.push_back(std::move(task));
+    pointer->thread = std::thread(&VirtualKernel::threadBody, this, pointer);
+    return pointer;
+}
+
+void VirtualKernel::deleteCurrentTask()
+{
+    if (!currentTask)
+    {
+        std::cerr << "Task deletion outside of a task" << std::endl;
+        std::abort();
+    }
+    throw TaskExit {};
+}
+
+void VirtualKernel::deleteTask(void* handle)
+{
+    auto* task = static_cast<Task*>(handle);
+    auto* self = currentTask;
+    if (!self || inEventContext)
+    {
+        std::cerr << "Task deletion outside of a task" << std::endl;
+        std::abort();
+    }
+    if (task == self)
+    {
+        deleteCurrentTask();
+    }
+    if (task->state == TaskState::Finished)
+    {
+        return;
+    }
+    // The task throws at its wait, its thread ends and switches back to the killer
+    killer = self;
+    task->killed = true;
+    switchTo(task);
+    park(self);
+    killer = nullptr;
+}
+
+bool VirtualKernel::wait(int64_t deadline, const std::function<bool()>& ready)
+{
+    if (ready())
+    {
+        return true;
+    }
+    auto* task = currentTask;
+    if (!task || inEventContext || deadline <= currentTime)
+    {
+        return false;
+    }
+    if (task->killed)
+    {
+        // A task being unwound shall not block again
+        if (std::uncaught_exceptions() == 0)
+        {
+            throw TaskExit {};
+        }
+        return false;
+    }
+    task->state = TaskState::Blocked;
+    task->deadline = deadline;
+    task->ready = &ready;
+    dispatch(task);
+    park(task);
+    task->ready = nullptr;
+    task->deadline = infiniteTime;
+    if (task->killed)
+    {
+        if (std::uncaught_exceptions() == 0)
+        {
+            throw TaskExit {};
+        }
+        return false;
+    }
+    return ready();
+}
+
+void VirtualKernel::yield()
+{
+    auto* task = currentTask;
+    if (!task || inEventContext || task->killed)
+    {
+        return;
+    }
+    task->state = TaskState::Ready;
+    dispatch(task);
+    park(task);
+    if (task->killed && std::uncaught_exceptions() == 0)
+    {
+        throw TaskExit {};
+    }
+}
+
+void VirtualKernel::enterDeepSleep(uint64_t microseconds)
+{
+    if (!currentTask)
+    {
+        std::cerr << "Deep sleep requested outside of a task" << std::endl;
+        std::abort();
+    }
+    sleepRequest = microseconds;
+    terminateOthers(currentTask);
+    throw TaskExit {};
+}
+
+bool VirtualKernel::isTaskContext() const
+{
+    return currentTask != nullptr && !inEventContext;
+}
+
+const char* VirtualKernel::currentTaskName() const
+{
+    return currentTask ? currentTask->name.c_str() : "";
+}
+
+void VirtualKernel::threadBody(Task* task)
+{
+    currentTask = task;
+    park(task);
+    try
+    {
+        if (!task->killed)
+        {
+            task->function(task->parameter);
+        }
+    }
+    catch (const TaskExit&)
+    {
+    }
+    finish(task);
+}
+
+void VirtualKernel::finish(Task* task)
+{
+    task->state = TaskState::Finished;
+    if (killer)
+    {
+        switchTo(killer);
+        return;
+    }
+    dispatch(task);
+}
+
+void VirtualKernel::dispatch(Task* self)
+{
+    while (true)
+    {
+        if (auto* task = findReady())
+        {
+            if (task != self)
+            {
+                ++contextSwitches;
+            }
+            switchTo(task);
+            return;
+        }
+        const bool allFinished = std::all_of(tasks.begin(), tasks.end(), [](const auto& task)
+        {
+            return task->state == TaskState::Finished;
+        });
+        if (allFinished)
+        {
+            std::lock_guard lock(mutex);
+            running = nullptr;
+            wakeCompleted = true;
+            condition.notify_all();
+            return;
+        }
+        const auto next = nextEventTime();
+        if (!next || *next > wakeDeadline)
+        {
+            if (wakeDeadline != infiniteTime)
+            {
+                currentTime = std::max(currentTime, wakeDeadline);
+            }
+            std::cerr << "Wake abandoned at " << currentTime << " us, blocked tasks:";
+            for (const auto& task : tasks)
+            {
+                if (task->state == TaskState::Blocked)
+                {
+                    std::cerr << ' ' << task->name;
+                }
+            }
+            std::cerr << std::endl;
+            terminateOthers(self);
+            if (self && self->state != TaskState::Finished)
+            {
+                self->killed = true;
+                self->state = TaskState::Ready;
+            }
+            continue;
+        }
+        if (idleHandler && *next > currentTime)
+        {
+            idleHandler(currentTime, *next);
+        }
+        currentTime = std::max(currentTime, *next);
+        runDueEvents();
+    }
+}
+
+VirtualKernel::Task* VirtualKernel::findReady()
+{
+    Task* best = nullptr;
+    size_t bestIndex = 0;
+    const auto count = tasks.size();
+    for (size_t offset = 1; offset <= count; ++offset)
+    {
+        const auto index = (lastRunIndex + offset) % count;
+        auto* task = tasks[index].get();
+        if (task->state == TaskState::Blocked
+            && (task->deadline <= currentTime || (task->ready && (*task->ready)())))
+        {
+            task->state = TaskState::Ready;
+        }
+        if (task->state == TaskState::Ready && (!best || task->priority > best->priority))
+        {
+            best = task;
+            bestIndex = index;
+        }
+    }
+    if (best)
+    {
+        lastRunIndex = bestIndex;
+    }
+    return best;
+}
+
+std::optional<int64_t> VirtualKernel::nextEventTime() const
+{
+    std::optional<int64_t> result;
+    const auto consider = [&result](int64_t time)
+    {
+        if (!result || time < *result)
+        {
+            result = time;
+        }
+    };
+    for (const auto& task : tasks)
+    {
+        if (task->state == TaskState::Blocked && task->deadline != infiniteTime)
+        {
+            consider(task->deadline);
+        }
+    }
+    if (!actions.empty())
+    {
+        consider(actions.top().time);
+    }
+    for (const auto* source : sources)
+    {
+        if (const auto time = source->nextEventTime())
+        {
+            consider(*time);
+        }
+    }
+    return result;
+}
+
+void VirtualKernel::runDueEvents()
+{
+    inEventContext = true;
+    while (true)
+    {
+        EventSource* dueSource = nullptr;
+        int64_t dueTime = currentTime + 1;
+        for (auto* source : sources)
+        {
+            if (const auto time = source->nextEventTime(); time && *time < dueTime)
+            {
+                dueSource = source;
+                dueTime = *time;
+            }
+        }
+        if (!actions.empty() && actions.top().time < dueTime)
+        {
+            auto action = actions.top().action;
+            actions.pop();
+            action();
+        }
+        else if (dueSource)
+        {
+            dueSource->runNext();
+        }
+        else
+        {
+            break;
+        }
+    }
+    inEventContext = false;
+}
+
+void VirtualKernel::terminateOthers(Task* self)
+{
+    killer = self;
+    for (size_t index = 0; index < tasks.size(); ++index)
+    {
+        auto* task = tasks[index].get();
+        if (task != self && task->state != TaskState::Finished)
+        {
+            task->killed = true;
+            switchTo(task);
+            park(self);
+        }
+    }
+    killer = nullptr;
+}
+
+void VirtualKernel::switchTo(Task* task)
+{
+    {
+        std::lock_guard lock(mutex);
+        running = task;
+    }
+    condition.notify_all();
+}
+
+void VirtualKernel::park(Task* task)
+{
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this, task] { return running == task; });
+}
+
+}
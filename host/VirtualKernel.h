@@ -0,0 +1,147 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simulation
+{
+
+constexpr int64_t infiniteTime = std::numeric_limits<int64_t>::max();
+
+// Source of the events living outside of the simulated chip (peer units, radio medium),
+// they are kept across the deep sleep of the chip.
+class EventSource
+{
+public:
+    virtual ~EventSource() = default;
+    [[nodiscard]] virtual std::optional<int64_t> nextEventTime() const = 0;
+    virtual void runNext() = 0;
+};
+
+struct WakeResult
+{
+    // Empty if the wake was abandoned because no task could progress before the time limit
+    std::optional<uint64_t> sleepMicroseconds;
+    int64_t awakeMicroseconds = 0;
+    uint32_t contextSwitches = 0;
+};
+
+// Deterministic replacement of the FreeRTOS scheduler driven by the virtual time.
+// Every task is a thread, but only one of them runs at a time: a task runs until it blocks,
+// then the ready task with the highest priority takes over. If all the tasks are blocked,
+// the virtual time jumps to the nearest deadline or event, so the idle time costs nothing.
+class VirtualKernel
+{
+public:
+    using TaskFunction = void (*)(void*);
+
+    static VirtualKernel& instance();
+
+    // Virtual time in microseconds since the simulated power-on
+    [[nodiscard]] int64_t now() const { return currentTime; }
+    // Virtual time of the beginning of the current wake
+    [[nodiscard]] int64_t getBootTime() const { return bootTime; }
+
+    void addEventSource(EventSource& source);
+    // The handlers restore the power-on state of the simulated peripherals when the chip enters the deep sleep
+    void addResetHandler(std::function<void()> handler);
+    // Called with the interval the virtual time jumps through while all the tasks of the chip are blocked
+    void setIdleHandler(std::function<void(int64_t from, int64_t to)> handler);
+    // Schedules an action of the simulated chip, the pending actions are dropped on the deep sleep
+    void schedule(int64_t time, std::function<void()> action);
+
+    // Runs the entry function as the main task until the deep sleep is requested
+    // or no task can progress within the given awake time
+    WakeResult runWake(void (*entry)(), int64_t maxAwakeMicroseconds);
+    // Moves the virtual time forward while the chip sleeps, the external events are processed on the way
+    void advance(int64_t microseconds);
+
+    void* createTask(TaskFunction function, void* parameter, const char* name, int priority);
+    // Deletes the calling task
+    [[noreturn]] void deleteCurrentTask();
+    // Deletes another task, it's unwound at once and never runs again
+    void deleteTask(void* handle);
+    // Blocks the calling task until the condition is met or the deadline passes, returns the final condition.
+    // Outside of a task (e.g. from the radio callbacks) it never blocks.
+    bool wait(int64_t deadline, const std::function<bool()>& ready);
+    void yield();
+    [[noreturn]] void enterDeepSleep(uint64_t microseconds);
+
+    [[nodiscard]] bool isTaskContext() const;
+    [[nodiscard]] const char* currentTaskName() const;
+
+private:
+    enum class TaskState {Ready, Blocked, Finished};
+
+    struct Task
+    {
+        std::string name;
+        int priority = 0;
+        TaskFunction function = nullptr;
+        void* parameter = nullptr;
+        TaskState state = TaskState::Ready;
+        int64_t deadline = infiniteTime;
+        const std::function<bool()>* ready = nullptr;
+        bool killed = false;
+        std::thread thread;
+    };
+
+    struct Action
+    {
+        int64_t time = 0;
+        uint64_t sequence = 0;
+        std::function<void()> action;
+
+        bool operator>(const Action& other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct TaskExit {};
+
+    VirtualKernel() = default;
+
+    static thread_local Task* currentTask;
+
+    void threadBody(Task* task);
+    void finish(Task* task);
+    void dispatch(Task* self);
+    Task* findReady();
+    std::optional<int64_t> nextEventTime() const;
+    void runDueEvents();
+    void terminateOthers(Task* self);
+    void switchTo(Task* task);
+    void park(Task* task);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    Task* running = nullptr;
+    bool wakeCompleted = false;
+
+    std::vector<std::unique_ptr<Task>> tasks;
+    std::priority_queue<Action, std::vector<Action>, std::greater<>> actions;
+    std::vector<EventSource*> sources;
+    std::vector<std::function<void()>> resetHandlers;
+    std::function<void(int64_t, int64_t)> idleHandler;
+    Task* killer = nullptr;
+    size_t lastRunIndex = 0;
+    int64_t currentTime = 0;
+    int64_t bootTime = 0;
+    int64_t wakeDeadline = infiniteTime;
+    uint64_t sequenceCounter = 0;
+    uint32_t contextSwitches = 0;
+    bool inEventContext = false;
+    std::optional<uint64_t> sleepRequest;
+};
+
+}
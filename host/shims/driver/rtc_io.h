@@ -0,0 +1,27 @@
+#pragma once
+
+#include "driver/gpio.h"
+
+typedef enum {
+    RTC_GPIO_MODE_INPUT_ONLY,
+    RTC_GPIO_MODE_OUTPUT_ONLY,
+    RTC_GPIO_MODE_INPUT_OUTPUT,
+    RTC_GPIO_MODE_DISABLED,
+} rtc_gpio_mode_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_init(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_deinit(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_set_direction(gpio_num_t gpio_num, rtc_gpio_mode_t mode);
+esp_err_t rtc_gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+uint32_t rtc_gpio_get_level(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_hold_en(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_hold_dis(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// The RTC memory survives the simulated deep sleep, the rest of the firmware's memory is restored to its boot state
+// by every wake (see FirmwareImage.h), so the variables of the RTC memory get their own sections
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR __attribute__((section(".rtc.data")))
+#define RTC_RODATA_ATTR
+#define RTC_NOINIT_ATTR __attribute__((section(".rtc_noinit")))
+#define RTC_FAST_ATTR __attribute__((section(".rtc.force_fast")))
+#define RTC_SLOW_ATTR __attribute__((section(".rtc.force_slow")))
+#define RTC_IRAM_ATTR
+#define EXT_RAM_ATTR
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// The host memory has no capabilities, every allocation is suitable for the simulated DMA
+static inline void* heap_caps_malloc(size_t size, uint32_t /*caps*/)
+{
+    return malloc(size);
+}
+
+static inline void heap_caps_free(void* pointer)
+{
+    free(pointer);
+}
+
+static inline size_t heap_caps_get_free_size(uint32_t /*caps*/)
+{
+    return 256 * 1024;
+}
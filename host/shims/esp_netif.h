@@ -0,0 +1,17 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_netif_init(void);
+esp_netif_t* esp_netif_create_default_wifi_sta(void);
+void esp_netif_destroy_default_wifi(void* esp_netif);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_err.h"
+
+// The simulated chip is built with the power management and the light sleep callbacks
+#define CONFIG_PM_ENABLE 1
+#define CONFIG_PM_LIGHT_SLEEP_CALLBACKS 1
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+typedef struct esp_pm_lock* esp_pm_lock_handle_t;
+
+typedef esp_err_t (*esp_pm_light_sleep_cb_t)(int64_t sleep_time_us, void* arg);
+
+typedef struct {
+    esp_pm_light_sleep_cb_t enter_cb;
+    esp_pm_light_sleep_cb_t exit_cb;
+    void* enter_cb_user_arg;
+    void* exit_cb_user_arg;
+    uint32_t enter_cb_prior;
+    uint32_t exit_cb_prior;
+} esp_pm_sleep_cbs_register_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_pm_configure(const void* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char* name, esp_pm_lock_handle_t* out_handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_dump_locks(FILE* stream);
+esp_err_t esp_pm_light_sleep_register_cbs(esp_pm_sleep_cbs_register_config_t* cbs_conf);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+typedef enum {
+    ESP_SNTP_OPMODE_POLL,
+    ESP_SNTP_OPMODE_LISTENONLY,
+} esp_sntp_operatingmode_t;
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval* tv);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_sntp_setoperatingmode(esp_sntp_operatingmode_t operating_mode);
+void esp_sntp_setservername(uint8_t idx, const char* server);
+void esp_sntp_init(void);
+void esp_sntp_stop(void);
+bool esp_sntp_enabled(void);
+void esp_sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+sntp_sync_status_t sntp_get_sync_status(void);
+
+#ifdef __cplusplus
+}
+#endif
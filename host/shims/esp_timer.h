@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Microseconds since the beginning of the current wake, as the timer restarts after the deep sleep
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
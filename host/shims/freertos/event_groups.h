@@ -0,0 +1,26 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+// The FreeRTOS headers bring the task API along
+#include "freertos/task.h"
+
+typedef struct EventGroupDef_t* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t xEventGroup);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToSet);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToClear);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t xEventGroup, EventBits_t uxBitsToWaitFor, BaseType_t xClearOnExit,
+                                BaseType_t xWaitForAllBits, TickType_t xTicksToWait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define xEventGroupGetBits(xEventGroup) xEventGroupClearBits(xEventGroup, 0)
+#define xEventGroupSetBitsFromISR(xEventGroup, uxBitsToSet, pxHigherPriorityTaskWoken) xEventGroupSetBits(xEventGroup, uxBitsToSet)
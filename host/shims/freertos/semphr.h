@@ -0,0 +1,21 @@
+#pragma once
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define vSemaphoreDelete(xSemaphore) vQueueDelete(xSemaphore)
+#define xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken) xSemaphoreGive(xSemaphore)
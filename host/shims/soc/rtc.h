@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    RTC_CAL_RTC_MUX = 0,
+    RTC_CAL_8MD256 = 1,
+    RTC_CAL_32K_XTAL = 2,
+} rtc_cal_sel_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Period of the slow clock in microseconds multiplied by 2^19
+uint32_t rtc_clk_cal(rtc_cal_sel_t cal_clk, uint32_t slow_clk_cycles);
+// Ticks of the slow clock since the power-on, they continue through the deep sleep
+uint64_t rtc_time_get(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+#include "AirQuality.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+// Concentration range of the index range, the concentrations between the ranges are cut by the truncation
+struct Breakpoint
+{
+    float low;
+    float high;
+    int16_t indexLow;
+    int16_t indexHigh;
+};
+
+// US EPA breakpoints, the PM2.5 ones are from the 2024 revision
+constexpr std::array<Breakpoint, 6> usPm25 {{
+    { 0.f, 9.0f, 0, 50 }, { 9.1f, 35.4f, 51, 100 }, { 35.5f, 55.4f, 101, 150 }, { 55.5f, 125.4f, 151, 200 },
+    { 125.5f, 225.4f, 201, 300 }, { 225.5f, 325.4f, 301, 500 }
+}};
+constexpr std::array<Breakpoint, 6> usPm10 {{
+    { 0.f, 54.f, 0, 50 }, { 55.f, 154.f, 51, 100 }, { 155.f, 254.f, 101, 150 }, { 255.f, 354.f, 151, 200 },
+    { 355.f, 424.f, 201, 300 }, { 425.f, 604.f, 301, 500 }
+}};
+
+// Upper bounds of the European AQI levels 1..5, level 6 is above the last one
+constexpr std::array<float, 5> euPm25 { 10.f, 20.f, 25.f, 50.f, 75.f };
+constexpr std::array<float, 5> euPm10 { 20.f, 40.f, 50.f, 100.f, 150.f };
+
+struct Category
+{
+    int16_t maxIndex;
+    const char* name;
+};
+
+// Good, Moderate, Unhealthy for Sensitive Groups, Unhealthy, Very Unhealthy, Hazardous
+constexpr std::array<Category, 6> usCategories {{
+    { 50, "Good" }, { 100, "Mod" }, { 150, "USG" }, { 200, "Unh" }, { 300, "VUH" }, { 500, "Haz" }
+}};
+
+template<size_t N>
+int16_t interpolateIndex(const std::array<Breakpoint, N>& breakpoints, float concentration)
+{
+    for (const auto& breakpoint : breakpoints)
+    {
+        if (concentration <= breakpoint.high)
+        {
+            const auto ratio = std::max(0.f, concentration - breakpoint.low) / (breakpoint.high - breakpoint.low);
+            return static_cast<int16_t>(std::lround(breakpoint.indexLow
+                                                    + ratio * float(breakpoint.indexHigh - breakpoint.indexLow)));
+        }
+    }
+    return breakpoints.back().indexHigh;
+}
+
+template<size_t N>
+uint8_t findLevel(const std::array<float, N>& bounds, float concentration)
+{
+    uint8_t level = 1;
+    for (auto bound : bounds)
+    {
+        if (concentration <= bound)
+        {
+            break;
+        }
+        ++level;
+    }
+    return level;
+}
+}
+
+namespace aqi
+{
+int16_t usIndex(float pm25, float pm10)
+{
+    // Concentrations are truncated as required by the EPA technical assistance document
+    const auto pm25Truncated = std::floor(pm25 * 10.f) / 10.f;
+    const auto pm10Truncated = std::floor(pm10);
+    return std::max(interpolateIndex(usPm25, pm25Truncated), interpolateIndex(usPm10, pm10Truncated));
+}
+
+uint8_t euLevel(float pm25, float pm10)
+{
+    return std::max(findLevel(euPm25, pm25), findLevel(euPm10, pm10));
+}
+
+const char* usCategory(int16_t index)
+{
+    if (index < 0)
+    {
+        return "";
+    }
+    for (const auto& category : usCategories)
+    {
+        if (index <= category.maxIndex)
+        {
+            return category.name;
+        }
+    }
+    return usCategories.back().name;
+}
+}
+
+AirQualityIndex AirQualityTracker::update(time_t now, std::optional<float> pm25, std::optional<float> pm10)
+{
+    pm25Hourly.advance(now);
+    pm10Hourly.advance(now);
+    pm25Daily.advance(now);
+    pm10Daily.advance(now);
+    if (pm25)
+    {
+        pm25Hourly.add(now, *pm25);
+        pm25Daily.add(now, *pm25);
+    }
+    if (pm10)
+    {
+        pm10Hourly.add(now, *pm10);
+        pm10Daily.add(now, *pm10);
+    }
+
+    // The 24 h means are used when the coverage is sufficient, otherwise the index is estimated from the hourly ones
+    auto pm25Mean = pm25Daily.mean(dailyMinBuckets);
+    auto pm10Mean = pm10Daily.mean(dailyMinBuckets);
+    if (!pm25Mean || !pm10Mean)
+    {
+        pm25Mean = pm25Hourly.mean();
+        pm10Mean = pm10Hourly.mean();
+    }
+    if (!pm25Mean || !pm10Mean)
+    {
+        return {};
+    }
+    return { aqi::usIndex(*pm25Mean, *pm10Mean), aqi::euLevel(*pm25Mean, *pm10Mean) };
+}
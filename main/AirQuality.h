@@ -0,0 +1,44 @@
+#pragma once
+
+#include "RollingAverage.h"
+
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+struct AirQualityIndex
+{
+    // US EPA AQI 0..500, -1 if there is no data
+    int16_t usAqi = -1;
+    // European AQI level 1 (good) .. 6 (extremely poor), 0 if there is no data
+    uint8_t euLevel = 0;
+};
+
+namespace aqi
+{
+[[nodiscard]] int16_t usIndex(float pm25, float pm10);
+[[nodiscard]] uint8_t euLevel(float pm25, float pm10);
+// Short name of the US EPA category of the index for the display, empty if there is no data
+[[nodiscard]] const char* usCategory(int16_t index);
+}
+
+// Keeps the 1 h and 24 h rolling means of PM2.5 and PM10 and computes the indices on every update.
+// The object is trivially copyable and is kept in the persistent storage.
+class AirQualityTracker
+{
+public:
+    // Missing samples are passed as nullopt, they only move the windows
+    AirQualityIndex update(time_t now, std::optional<float> pm25, std::optional<float> pm10);
+
+    [[nodiscard]] std::optional<float> getHourlyPm25() const { return pm25Hourly.mean(); }
+    [[nodiscard]] std::optional<float> getDailyPm25() const { return pm25Daily.mean(dailyMinBuckets); }
+
+private:
+    // 24 h means are considered valid when at least half of the hours have the data
+    static constexpr size_t dailyMinBuckets = 12;
+
+    RollingAverage<12, 5 * 60> pm25Hourly;
+    RollingAverage<12, 5 * 60> pm10Hourly;
+    RollingAverage<24, 60 * 60> pm25Daily;
+    RollingAverage<24, 60 * 60> pm10Daily;
+};
@@ -34,4 +34,12 @@ struct AppConfig
     static const uint8_t epdSckPin;
     static const uint8_t epdMisoPin;
     static const uint8_t epdMosiPin;
+    // Altitude of the unit above the sea level in meters, used to reduce the pressure
+    static const float altitude;
+    // Time from the boot to the deep sleep the wake never exceeds, the jobs still running by then are abandoned
+    static const uint32_t wakeBudgetSeconds;
+    // Interval of the reception of the external unit's data, never shorter than the display update interval
+    static const uint32_t outerDataIntervalMinutes;
+    // Endpoint receiving the buffered readings by HTTP POST while the Wi-Fi is up, empty to keep them on the unit
+    static const std::string_view uploadUrl;
 };
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "DustMonitorController.h"
+#include "EpdFrameWriter.h"
+#include "EspNowRadio.h"
 #include "PersistentStorage.h"
+#include "PowerManagement.h"
 #include "TimeFunctions.h"
 #include "AppConfig.h"
+#include "BinaryLog.h"
 
 #include "SpiDevice.h"
 #include "display/EpdInterface.h"
@@ -15,7 +19,6 @@
 #include <esp_sleep.h>
 #include <esp_system.h>
 #include <soc/rtc.h>
-#include <nvs_flash.h>
 
 #include "Debug.h"
 
@@ -25,7 +28,17 @@ constexpr uint32_t rtcCalibrationFactor = (1 << 19);
 
 constexpr uint32_t wakeupDelay = 870000;
 
-RTC_DATA_ATTR std::array<uint8_t, 2048> persistentArray;
+// The frame is streamed at the clock of the SpiDevice sending the EPD commands
+constexpr int epdClockHz = 10000000;
+
+// The RTC slow memory has 8 KB, the reserve is left for the counters of the other modules
+constexpr size_t rtcSlowMemorySize = 8192;
+constexpr size_t rtcSlowMemoryReserve = 1024;
+
+RTC_DATA_ATTR std::array<uint8_t, 4096> persistentArray;
+RTC_DATA_ATTR ReadingHistory readingHistory;
+static_assert(sizeof(persistentArray) + sizeof(readingHistory) + rtcSlowMemoryReserve <= rtcSlowMemorySize,
+              "The data kept over the deep sleep doesn't fit in the RTC slow memory");
 std::optional<embedded::PersistentStorage> persistentStorage;
 
 struct MainData
@@ -36,7 +49,7 @@ struct MainData
     uint64_t rtcSlowTicksBeforeDeepSleep = 0;
 };
 
-class ControllersHolder
+class ControllersHolder : public PeripheralBuses
 {
 public:
     ControllersHolder(embedded::PersistentStorage &storage, int spiBusNum,
@@ -48,13 +61,24 @@ public:
               , spiBus(spiBusNum)
               , spiDevice(spiBus)
               , epdHAL(spiDevice, rstPin, dcPin, csPin, busyPin)
-              , controller(storage, sps30Uart, i2CDevice, epdHAL)
+              , frameStream(static_cast<spi_host_device_t>(spiBusNum), epdClockHz, true)
+              , frameWriter(epdHAL, frameStream, dcPin, csPin)
+              , controller(storage, sps30Uart, i2CDevice, epdHAL, frameWriter, radio, readingHistory, *this)
     {
-        i2CBus.init(AppConfig::SDA, AppConfig::SCL, 400000);
-        spiBus.init(sckPin, misoPin, mosiPin);
     }
     DustMonitorController& getController() { return controller; }
+
+    void init() override
+    {
+        if (!busesInitialized)
+        {
+            i2CBus.init(AppConfig::SDA, AppConfig::SCL, 400000);
+            spiBus.init(sckPin, misoPin, mosiPin);
+            busesInitialized = true;
+        }
+    }
 private:
+    bool busesInitialized = false;
     embedded::I2CBus i2CBus;
     embedded::I2CHelper i2CDevice;
     embedded::PacketUart::UartDevice uartDevice;
@@ -69,33 +93,28 @@ private:
     embedded::GpioPinDefinition misoPin{AppConfig::epdMisoPin};
     embedded::GpioPinDefinition mosiPin{AppConfig::epdMosiPin};
     embedded::EpdInterface epdHAL;
+    SpiDmaStream frameStream;
+    EpdFrameWriter frameWriter;
+    EspNowRadio radio;
     DustMonitorController controller;
 };
 
 std::optional<ControllersHolder> controllersHolder;
 
-auto getMicrosecondsTillNextMinute()
+uint64_t calculateHibernationDelay(const Clock& clock, const DustMonitorController& controller)
 {
-    const int64_t microSeconds = microsecondsNow();
-    const int64_t wholeMinutePast = (microSeconds / microsecondsInMinute) * microsecondsInMinute;
-    return wholeMinutePast + microsecondsInMinute - microSeconds;
-}
-
-uint32_t calculateHibernationDelay()
-{
-    const auto timeTillNextMinute = getMicrosecondsTillNextMinute();
-    DEBUG_LOG("Time till next minute:" << timeTillNextMinute)
-    uint32_t delayTime;
-    if (timeTillNextMinute <= wakeupDelay)
+    const int64_t microSeconds = clock.wallMicroseconds();
+    // The wake starts by wakeupDelay before its planned time, the time too close is skipped
+    const auto earliest = static_cast<time_t>((microSeconds + wakeupDelay + microsecondsInSecond - 1)
+                                              / microsecondsInSecond);
+    const auto wake = controller.planNextWake(earliest);
+    if (!wake)
     {
-        DEBUG_LOG("Too short delay " << timeTillNextMinute << " (" << wakeupDelay << "), skipping next wakeup")
-        delayTime = microsecondsInMinute + timeTillNextMinute - wakeupDelay;
+        DEBUG_LOG("No activity is planned, waking in a minute")
+        return microsecondsInMinute;
     }
-    else
-    {
-        delayTime = timeTillNextMinute - wakeupDelay;
-    }
-    return delayTime;
+    DEBUG_LOG("Next wake at " << wake->time << " for the activities " << static_cast<int>(wake->activities))
+    return static_cast<uint64_t>(wake->time * microsecondsInSecond - wakeupDelay - microSeconds);
 }
 
 uint32_t calibrateRtcOscillator()
@@ -106,26 +125,23 @@ uint32_t calibrateRtcOscillator()
     for (int i = 0; i < 5; ++i)
     {
         caliVal = rtc_clk_cal(RTC_CAL_32K_XTAL, calCount);
-        DEBUG_LOG("Calibration " << i << ": " << embedded::BufferedOut::precision { 3 } << rtcCalibrationFactor * 1000.0f / (float)caliVal << " kHz")
+        TRACE_LOG("Calibration {}: {} kHz", i, rtcCalibrationFactor * 1000.0f / (float)caliVal)
     }
     return caliVal;
 }
 
-void adjustClock(MainData &mainData)
+void adjustClock(MainData &mainData, Clock& clock)
 {
     if (mainData.rtcCalibrationResult != 0)
     {
-        auto newCircles = rtc_time_get();
+        auto newCircles = clock.rtcTicks();
         uint64_t diffTicks = newCircles - mainData.rtcSlowTicksBeforeDeepSleep;
         auto diffMicroseconds = diffTicks * mainData.rtcCalibrationResult / rtcCalibrationFactor;
         auto timeMicroseconds =
                 mainData.rtcTimeBeforeDeepSleep.tv_sec * 1000000ull +
                 mainData.rtcTimeBeforeDeepSleep.tv_usec;
         timeMicroseconds += diffMicroseconds;
-        const uint32_t seconds = timeMicroseconds / 1000000;
-        const uint32_t microseconds = timeMicroseconds - seconds * 1000000;
-        timeval timeVal { .tv_sec = static_cast<time_t>(seconds), .tv_usec= static_cast<suseconds_t>(microseconds) };
-        settimeofday(&timeVal, nullptr);
+        clock.setWallMicroseconds(static_cast<int64_t>(timeMicroseconds));
         DEBUG_LOG("Calculated sleep time : " << diffMicroseconds)
     }
 }
@@ -140,6 +156,8 @@ void setup()
     if (!mainData)
     {
         mainData.emplace();
+        // The reinitialized storage forgets the uploaded part of the history
+        readingHistory.clear();
     }
 
     setenv("TZ", AppConfig::timeZone.begin(), 1);
@@ -150,6 +168,10 @@ void setup()
     embedded::PacketUart::UartDevice::init(0, AppConfig::serial1RxPin, AppConfig::serial1TxPin, 115200);
 #endif
     embedded::PacketUart::UartDevice::init(2, AppConfig::serial2RxPin, AppConfig::serial2TxPin, 115200);
+#ifdef BINARY_LOG
+    binary_log::init();
+#endif
+    power_management::init();
     embedded::GpioPinDefinition ledPinDefinition { AppConfig::ledPin };
     embedded::GpioDigitalPin ledPin(ledPinDefinition);
     ledPin.init();
@@ -162,7 +184,7 @@ void setup()
     }
     else
     {
-        adjustClock(*mainData);
+        adjustClock(*mainData, Clock::instance());
     }
     if (!controllersHolder->getController().setup(!initialSetup))
     {
@@ -174,29 +196,30 @@ void setup()
 [[noreturn]] void process()
 {
     auto& controller = controllersHolder->getController();
+    auto& clock = Clock::instance();
     auto mainData = persistentStorage->get<MainData>("main");
     controller.process();
     controller.hibernate();
-    auto delayTime = calculateHibernationDelay();
-    if (controller.isMeasuring())
-    {
-        delayTime = std::min(delayTime, decltype(delayTime)(30 * microsecondsInSecond));
-    }
+    const auto delayTime = calculateHibernationDelay(clock, controller);
     DEBUG_LOG("Next wakeup in " << delayTime / 1000 << " ms")
-    gettimeofday(&mainData->rtcTimeBeforeDeepSleep, nullptr);
-    mainData->rtcSlowTicksBeforeDeepSleep = rtc_time_get();
+    DEBUG_LOG((controller.isFullWake() ? "Full" : "Measurement-only") << " wake took "
+              << clock.monotonicMicroseconds() << " us from boot to sleep")
+    power_management::report();
+    const auto timeBeforeDeepSleep = clock.wallMicroseconds();
+    mainData->rtcTimeBeforeDeepSleep = { .tv_sec = static_cast<time_t>(timeBeforeDeepSleep / microsecondsInSecond),
+                                         .tv_usec = static_cast<suseconds_t>(timeBeforeDeepSleep % microsecondsInSecond) };
+    mainData->rtcSlowTicksBeforeDeepSleep = clock.rtcTicks();
     persistentStorage->set("main", *mainData);
+#ifdef BINARY_LOG
+    const auto logStatistics = binary_log::getStatistics();
+    TRACE_LOG("Binary log: {} records, {} dropped", logStatistics.written, logStatistics.dropped)
+    binary_log::flush();
+#endif
     esp_deep_sleep(delayTime);
 }
 
 extern "C" void app_main()
 {
-    if (const auto ret = nvs_flash_init();
-        ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-    {
-        ESP_ERROR_CHECK(nvs_flash_erase() );
-        ESP_ERROR_CHECK(nvs_flash_init());
-    }
     setup();
     process();
 }
@@ -0,0 +1,95 @@
+#include "BatteryModel.h"
+
+#include <array>
+#include <cstddef>
+
+namespace
+{
+struct DischargePoint
+{
+    float voltage;
+    uint8_t charge;
+};
+
+// Typical open-circuit voltage of the Li-ion NMC cell at room temperature
+constexpr std::array<DischargePoint, 11> dischargeCurve {{
+    { 3.00f, 0 },
+    { 3.30f, 2 },
+    { 3.45f, 5 },
+    { 3.55f, 10 },
+    { 3.65f, 20 },
+    { 3.72f, 30 },
+    { 3.78f, 40 },
+    { 3.84f, 50 },
+    { 3.92f, 60 },
+    { 4.05f, 80 },
+    { 4.20f, 100 },
+}};
+
+struct TierSettings
+{
+    uint8_t enterCharge;
+    uint32_t displayIntervalMinutes;
+    uint32_t measurementIntervalScale;
+    uint32_t timeSyncIntervalHours;
+};
+
+constexpr std::array<TierSettings, 4> tiers {{
+    { 100, 1, 1, 12 },
+    { 30, 2, 2, 48 },
+    { 15, 5, 4, 168 },
+    { 5, 15, 8, 0 },
+}};
+
+constexpr uint8_t tierHysteresis = 5;
+}
+
+uint8_t BatteryModel::stateOfCharge(float openCircuitVoltage)
+{
+    if (openCircuitVoltage <= dischargeCurve.front().voltage)
+    {
+        return 0;
+    }
+    for (size_t i = 1; i < dischargeCurve.size(); ++i)
+    {
+        const auto& upper = dischargeCurve[i];
+        if (openCircuitVoltage < upper.voltage)
+        {
+            const auto& lower = dischargeCurve[i - 1];
+            const auto ratio = (openCircuitVoltage - lower.voltage) / (upper.voltage - lower.voltage);
+            return static_cast<uint8_t>(lower.charge + ratio * float(upper.charge - lower.charge));
+        }
+    }
+    return 100;
+}
+
+PowerTier BatteryModel::powerTier(uint8_t stateOfCharge, PowerTier currentTier)
+{
+    auto tier = PowerTier::Normal;
+    for (size_t i = 1; i < tiers.size(); ++i)
+    {
+        // A tier is entered below its threshold and left only when the charge is back at the threshold plus
+        // the hysteresis, e.g. Saving below 30 % and Normal again from 35 %
+        const auto threshold = tiers[i].enterCharge + (static_cast<size_t>(currentTier) >= i ? tierHysteresis : 0);
+        if (stateOfCharge < threshold)
+        {
+            tier = static_cast<PowerTier>(i);
+        }
+    }
+    return tier;
+}
+
+uint32_t BatteryModel::displayIntervalMinutes(PowerTier tier)
+{
+    return tiers[static_cast<size_t>(tier)].displayIntervalMinutes;
+}
+
+uint32_t BatteryModel::measurementIntervalScale(PowerTier tier)
+{
+    return tiers[static_cast<size_t>(tier)].measurementIntervalScale;
+}
+
+uint32_t BatteryModel::timeSyncIntervalHours(PowerTier tier)
+{
+    return tiers[static_cast<size_t>(tier)].timeSyncIntervalHours;
+}
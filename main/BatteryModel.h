@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PowerTier : uint8_t
+{
+    Normal,
+    Saving,
+    Low,
+    Critical,
+};
+
+// State-of-charge model of the 18650 Li-ion cell and the power tiers derived from it
+class BatteryModel
+{
+public:
+    // Estimated internal resistance of the cell, the holder and the switch, Ohm
+    static constexpr float internalResistance = 0.15f;
+
+    [[nodiscard]] static float openCircuitVoltage(float loadedVoltage, float loadCurrent)
+    {
+        return loadedVoltage + loadCurrent * internalResistance;
+    }
+
+    // State of charge in percents from the open-circuit voltage
+    [[nodiscard]] static uint8_t stateOfCharge(float openCircuitVoltage);
+    // The tier is raised with a hysteresis to avoid toggling on the voltage noise
+    [[nodiscard]] static PowerTier powerTier(uint8_t stateOfCharge, PowerTier currentTier);
+
+    [[nodiscard]] static uint32_t displayIntervalMinutes(PowerTier tier);
+    [[nodiscard]] static uint32_t measurementIntervalScale(PowerTier tier);
+    // Zero means the time synchronization is disabled
+    [[nodiscard]] static uint32_t timeSyncIntervalHours(PowerTier tier);
+};
@@ -0,0 +1,177 @@
+#include "BinaryLog.h"
+
+#include "Clock.h"
+#include "PowerManagement.h"
+
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+
+namespace binary_log
+{
+
+namespace
+{
+
+// Power of two, so the monotonic positions wrap together with the ring. Plain RAM, the atomic instructions of the
+// ESP32 aren't supported on the RTC memory, the ring is drained before the deep sleep instead.
+constexpr uint32_t ringSize = 4096;
+constexpr uart_port_t outputPort = UART_NUM_0;
+constexpr int drainPeriodMs = 50;
+
+uint32_t ringWords[ringSize / sizeof(uint32_t)] {};
+uint8_t* const ring = reinterpret_cast<uint8_t*>(ringWords);
+// Positions since the boot, the writers reserve at the head and the drain consumes at the tail
+uint32_t head = 0;
+uint32_t tail = 0;
+Statistics statistics;
+SemaphoreHandle_t drainMutex = nullptr;
+// The UART stops with its clock in the light sleep, the chip stays awake until the sent records are out
+PowerLock uartLock {"binary_log"};
+
+void copyToRing(uint32_t position, const uint8_t* data, uint32_t size)
+{
+    const auto offset = position % ringSize;
+    const auto first = std::min(size, ringSize - offset);
+    std::memcpy(ring + offset, data, first);
+    std::memcpy(ring, data + first, size - first);
+}
+
+void copyFromRing(uint32_t position, uint8_t* data, uint32_t size)
+{
+    const auto offset = position % ringSize;
+    const auto first = std::min(size, ringSize - offset);
+    std::memcpy(data, ring + offset, first);
+    std::memcpy(data + first, ring, size - first);
+}
+
+void clearRing(uint32_t position, uint32_t size)
+{
+    const auto offset = position % ringSize;
+    const auto first = std::min(size, ringSize - offset);
+    std::memset(ring + offset, 0, first);
+    std::memset(ring, 0, size - first);
+}
+
+uint32_t* sizeWordAt(uint32_t position)
+{
+    return &ringWords[(position % ringSize) / sizeof(uint32_t)];
+}
+
+// Sends the complete records in the order of the reservation, stops at the first one still being written.
+// Returns false if nothing was sent.
+bool drain()
+{
+    if (!uart_is_driver_installed(outputPort))
+    {
+        return false;
+    }
+    const auto start = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    auto position = start;
+    const auto end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    while (position != end)
+    {
+        const auto size = __atomic_load_n(sizeWordAt(position), __ATOMIC_ACQUIRE);
+        if (size == 0)
+        {
+            break;
+        }
+        uint8_t frame[maxRecordSize + 1];
+        frame[0] = frameSync;
+        copyFromRing(position, frame + 1, size);
+        uart_write_bytes(outputPort, frame, size + 1);
+        // The free space shall read as zero, so the next writer's record isn't seen before it's complete
+        clearRing(position, size);
+        position += size;
+        __atomic_store_n(&tail, position, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&statistics.sent, 1, __ATOMIC_RELAXED);
+    }
+    return position != start;
+}
+
+void drainLocked()
+{
+    if (drainMutex)
+    {
+        xSemaphoreTake(drainMutex, portMAX_DELAY);
+        if (drain())
+        {
+            const PowerLock::Guard uartGuard(uartLock);
+            uart_wait_tx_done(outputPort, pdMS_TO_TICKS(drainPeriodMs));
+        }
+        xSemaphoreGive(drainMutex);
+    }
+}
+
+void drainTask(void*)
+{
+    while (true)
+    {
+        drainLocked();
+        vTaskDelay(pdMS_TO_TICKS(drainPeriodMs));
+    }
+}
+
+}
+
+void init()
+{
+    if (drainMutex)
+    {
+        return;
+    }
+    if (!uart_is_driver_installed(outputPort))
+    {
+        // The console keeps the configuration of the bootloader
+        uart_driver_install(outputPort, 256, 1024, 0, nullptr, 0);
+    }
+    drainMutex = xSemaphoreCreateMutex();
+    xTaskCreate(drainTask, "log_drain", 2048, nullptr, 1, nullptr);
+}
+
+void flush()
+{
+    drainLocked();
+    if (uart_is_driver_installed(outputPort))
+    {
+        uart_wait_tx_done(outputPort, portMAX_DELAY);
+    }
+}
+
+bool write(const uint8_t* record, uint32_t size)
+{
+    auto position = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    do
+    {
+        if (position + size - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) > ringSize)
+        {
+            __atomic_fetch_add(&statistics.dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&head, &position, position + size, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    // The body first, the size word last publishes the record to the drain
+    copyToRing(position + sizeof(uint32_t), record + sizeof(uint32_t), size - sizeof(uint32_t));
+    uint32_t recordSize = 0;
+    std::memcpy(&recordSize, record, sizeof(recordSize));
+    __atomic_store_n(sizeWordAt(position), recordSize, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&statistics.written, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+uint32_t timestamp()
+{
+    return static_cast<uint32_t>(Clock::instance().monotonicMicroseconds());
+}
+
+Statistics getStatistics()
+{
+    return {__atomic_load_n(&statistics.written, __ATOMIC_RELAXED),
+            __atomic_load_n(&statistics.dropped, __ATOMIC_RELAXED),
+            __atomic_load_n(&statistics.sent, __ATOMIC_RELAXED)};
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "BinaryLogFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Logging of the timing-sensitive paths. With BINARY_LOG defined the call only copies the address of the format
+// and the raw arguments into a lock-free RAM ring, a low priority task sends the records to UART0 when the CPU is
+// idle, and the host LogDecoder makes the text with the strings of the firmware ELF. Without it the call formats
+// the same text and passes it to DEBUG_LOG. The format takes the arguments in place of {}.
+namespace binary_log
+{
+
+struct Statistics
+{
+    uint32_t written = 0;
+    uint32_t dropped = 0;
+    uint32_t sent = 0;
+};
+
+// Starts the drain task, the records written before are kept
+void init();
+// Sends all the complete records, called before the deep sleep
+void flush();
+// Puts the record into the ring, returns false if the ring is full
+bool write(const uint8_t* record, uint32_t size);
+[[nodiscard]] uint32_t timestamp();
+[[nodiscard]] Statistics getStatistics();
+
+template<typename... Args>
+void log(const char* format, const Args&... args)
+{
+    auto record = makeRecord(format, timestamp(), args...);
+    write(record.finish(), record.size());
+}
+
+// Text of the record for the text mode of the log
+class TextLine
+{
+public:
+    template<typename... Args>
+    explicit TextLine(const char* format, const Args&... args)
+    {
+        auto record = makeRecord(format, 0, args...);
+        formatRecord(format, record.finish() + sizeof(RecordHeader), record.size() - sizeof(RecordHeader),
+                     text, sizeof(text));
+    }
+
+    [[nodiscard]] const char* c_str() const { return text; }
+
+private:
+    char text[maxRecordSize * 2] {};
+};
+
+}
+
+// The format shall be a string literal, its address in the image is the identifier of the message
+#ifdef BINARY_LOG
+#define TRACE_LOG(format, ...) { static constexpr const char traceLogFormat[] = format; \
+    binary_log::log(traceLogFormat, ##__VA_ARGS__); }
+#else
+#define TRACE_LOG(format, ...) DEBUG_LOG(binary_log::TextLine(format, ##__VA_ARGS__).c_str())
+#endif
@@ -0,0 +1,165 @@
+#include "BinaryLogFormat.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace binary_log
+{
+
+namespace
+{
+
+template<typename T>
+T read(const uint8_t* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+size_t argumentSize(ArgumentType type, const uint8_t* data, size_t available)
+{
+    switch (type)
+    {
+        case ArgumentType::Bool:
+            return 1;
+        case ArgumentType::Int32:
+        case ArgumentType::UInt32:
+        case ArgumentType::Float:
+            return 4;
+        case ArgumentType::Int64:
+        case ArgumentType::UInt64:
+        case ArgumentType::Double:
+            return 8;
+        case ArgumentType::String:
+        case ArgumentType::Bytes:
+            return available != 0 ? 1 + data[0] : 1;
+    }
+    return available + 1;
+}
+
+// Appends the text of one argument, returns the number of characters it would take
+int formatArgument(ArgumentType type, const uint8_t* data, char* output, size_t outputSize)
+{
+    switch (type)
+    {
+        case ArgumentType::Bool:
+            return std::snprintf(output, outputSize, "%s", data[0] != 0 ? "true" : "false");
+        case ArgumentType::Int32:
+            return std::snprintf(output, outputSize, "%" PRId32, read<int32_t>(data));
+        case ArgumentType::Int64:
+            return std::snprintf(output, outputSize, "%" PRId64, read<int64_t>(data));
+        case ArgumentType::UInt32:
+            return std::snprintf(output, outputSize, "%" PRIu32, read<uint32_t>(data));
+        case ArgumentType::UInt64:
+            return std::snprintf(output, outputSize, "%" PRIu64, read<uint64_t>(data));
+        case ArgumentType::Float:
+            return std::snprintf(output, outputSize, "%g", double(read<float>(data)));
+        case ArgumentType::Double:
+            return std::snprintf(output, outputSize, "%g", read<double>(data));
+        case ArgumentType::String:
+            return std::snprintf(output, outputSize, "%.*s", int(data[0]), reinterpret_cast<const char*>(data + 1));
+        case ArgumentType::Bytes:
+        {
+            int total = 0;
+            for (size_t i = 0; i < data[0]; ++i)
+            {
+                const auto offset = std::min(size_t(total), outputSize);
+                total += std::snprintf(output + offset, outputSize - offset, i == 0 ? "%02X" : ":%02X", data[1 + i]);
+            }
+            return total;
+        }
+    }
+    return std::snprintf(output, outputSize, "?");
+}
+
+}
+
+RecordWriter::RecordWriter(const char* format, uint32_t timestamp)
+{
+    RecordHeader header {0, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(format)), timestamp};
+    std::memcpy(buffer.data(), &header, sizeof(header));
+}
+
+const uint8_t* RecordWriter::finish()
+{
+    used = std::min((used + 3) & ~size_t(3), buffer.size());
+    const auto size = static_cast<uint32_t>(used);
+    std::memcpy(buffer.data(), &size, sizeof(size));
+    return buffer.data();
+}
+
+void RecordWriter::put(ArgumentType type, const void* data, size_t size)
+{
+    // The arguments not fitting into the record are dropped, the decoder shows them as missing
+    if (used + 1 + size > buffer.size())
+    {
+        return;
+    }
+    buffer[used++] = static_cast<uint8_t>(type);
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void RecordWriter::putSized(ArgumentType type, std::string_view data)
+{
+    const auto size = std::min(data.size(), maxStringSize);
+    if (used + 2 + size > buffer.size())
+    {
+        return;
+    }
+    buffer[used++] = static_cast<uint8_t>(type);
+    buffer[used++] = static_cast<uint8_t>(size);
+    std::memcpy(buffer.data() + used, data.data(), size);
+    used += size;
+}
+
+size_t formatRecord(const char* format, const uint8_t* arguments, size_t argumentsSize, char* output,
+                    size_t outputSize)
+{
+    if (outputSize == 0)
+    {
+        return 0;
+    }
+    size_t length = 0;
+    size_t position = 0;
+    const auto append = [&](const char* text, size_t size)
+    {
+        const auto copied = std::min(size, outputSize - 1 - std::min(length, outputSize - 1));
+        std::memcpy(output + std::min(length, outputSize - 1), text, copied);
+        length += size;
+    };
+    for (const char* current = format; *current != '\0'; ++current)
+    {
+        if (current[0] != '{' || current[1] != '}')
+        {
+            append(current, 1);
+            continue;
+        }
+        ++current;
+        // The padding after the last argument is zero, which isn't a valid type
+        if (position >= argumentsSize || arguments[position] == 0)
+        {
+            append("{?}", 3);
+            continue;
+        }
+        const auto type = static_cast<ArgumentType>(arguments[position]);
+        const auto* data = arguments + position + 1;
+        const auto available = argumentsSize - position - 1;
+        const auto size = argumentSize(type, data, available);
+        if (size > available)
+        {
+            append("{?}", 3);
+            position = argumentsSize;
+            continue;
+        }
+        const auto offset = std::min(length, outputSize - 1);
+        length += std::max(0, formatArgument(type, data, output + offset, outputSize - offset));
+        position += 1 + size;
+    }
+    output[std::min(length, outputSize - 1)] = '\0';
+    return std::min(length, outputSize - 1);
+}
+
+}
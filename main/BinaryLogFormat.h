@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Record of the binary log: the address of the format string in the firmware image, the time since the boot
+// and the raw arguments. The text is made only by the decoder, the firmware just copies the arguments.
+// The same records are formatted on the chip when the binary mode is off, so both paths print the same text.
+namespace binary_log
+{
+
+constexpr size_t maxRecordSize = 128;
+constexpr size_t maxStringSize = 24;
+// Precedes every record on the wire, so the records can be found among the text output
+constexpr uint8_t frameSync = 0xB7;
+
+enum class ArgumentType : uint8_t
+{
+    Int32 = 1,
+    Int64,
+    UInt32,
+    UInt64,
+    Float,
+    Double,
+    Bool,
+    String,
+    Bytes,
+};
+
+// The size is stored last by the writer of the ring, a non-zero size marks the complete record
+struct RecordHeader
+{
+    uint32_t size;
+    uint32_t format;
+    uint32_t timestamp;
+};
+
+class RecordWriter
+{
+public:
+    RecordWriter(const char* format, uint32_t timestamp);
+
+    template<typename T>
+    void add(const T& value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            put(ArgumentType::Bool, &value, 1);
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            add(static_cast<std::underlying_type_t<T>>(value));
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T> && sizeof(T) <= 4)
+        {
+            const int32_t converted = value;
+            put(ArgumentType::Int32, &converted, sizeof(converted));
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            const int64_t converted = value;
+            put(ArgumentType::Int64, &converted, sizeof(converted));
+        }
+        else if constexpr (std::is_integral_v<T> && sizeof(T) <= 4)
+        {
+            const uint32_t converted = value;
+            put(ArgumentType::UInt32, &converted, sizeof(converted));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            const uint64_t converted = value;
+            put(ArgumentType::UInt64, &converted, sizeof(converted));
+        }
+        else if constexpr (std::is_same_v<T, float>)
+        {
+            put(ArgumentType::Float, &value, sizeof(value));
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            const double converted = value;
+            put(ArgumentType::Double, &converted, sizeof(converted));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            putSized(ArgumentType::String, std::string_view(value));
+        }
+        else
+        {
+            // Byte arrays like the MAC addresses
+            static_assert(sizeof(value[0]) == 1, "Unsupported argument type of the binary log");
+            putSized(ArgumentType::Bytes, std::string_view(reinterpret_cast<const char*>(&value[0]), std::size(value)));
+        }
+    }
+
+    // Pads the record to whole words and stores its size, returns the record
+    const uint8_t* finish();
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(used); }
+
+private:
+    void put(ArgumentType type, const void* data, size_t size);
+    void putSized(ArgumentType type, std::string_view data);
+
+    // Word-aligned for the copy into the ring
+    alignas(4) std::array<uint8_t, maxRecordSize> buffer {};
+    size_t used = sizeof(RecordHeader);
+};
+
+// Formats the arguments of the record into the text by the format, every {} takes the next argument.
+// Returns the length of the text, the output is always null-terminated.
+size_t formatRecord(const char* format, const uint8_t* arguments, size_t argumentsSize, char* output,
+                    size_t outputSize);
+
+template<typename... Args>
+RecordWriter makeRecord(const char* format, uint32_t timestamp, const Args&... args)
+{
+    RecordWriter writer(format, timestamp);
+    (writer.add(args), ...);
+    writer.finish();
+    return writer;
+}
+
+}
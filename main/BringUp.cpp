@@ -0,0 +1,175 @@
+#include "BringUp.h"
+
+#include "Clock.h"
+
+#include <algorithm>
+
+#include "Debug.h"
+
+namespace
+{
+// The Wi-Fi stack init and the drivers of the displays take more than the usual task stack
+constexpr uint32_t jobStackSize = 4096;
+constexpr UBaseType_t jobPriority = 5;
+// The running job gets the time to finish its bus transaction or its wait before it's abandoned
+constexpr TickType_t cancellationGrace = pdMS_TO_TICKS(20);
+
+BringUp::Statistics lastStatistics;
+}
+
+BringUp::~BringUp()
+{
+    if (group)
+    {
+        vEventGroupDelete(group);
+    }
+    if (startLock)
+    {
+        vSemaphoreDelete(startLock);
+    }
+}
+
+BringUp::JobId BringUp::add(const char* name, JobFunction function, void* context,
+                            std::initializer_list<JobId> dependencies)
+{
+    if (jobCount == maxJobs)
+    {
+        DEBUG_LOG("Too many bring-up jobs, " << name << " is dropped")
+        jobDropped = true;
+        return maxJobs;
+    }
+    auto& job = jobs[jobCount];
+    job = Job {this, name, function, context};
+    for (const auto dependency : dependencies)
+    {
+        // Only the jobs added before, so the dependencies can't make a cycle
+        if (dependency < jobCount)
+        {
+            job.dependencies |= bit(dependency);
+        }
+    }
+    return static_cast<JobId>(jobCount++);
+}
+
+bool BringUp::run(TickType_t timeout)
+{
+    if (!group)
+    {
+        group = xEventGroupCreate();
+        startLock = xSemaphoreCreateMutex();
+    }
+    xEventGroupClearBits(group, bit(maxJobs) - 1);
+    cancelled = false;
+    const auto startMicroseconds = clock.monotonicMicroseconds();
+    for (size_t i = 0; i < jobCount; ++i)
+    {
+        xTaskCreate(&BringUp::jobTask, jobs[i].name, jobStackSize, &jobs[i], jobPriority, nullptr);
+    }
+    const auto allJobs = bit(jobCount) - 1;
+    const bool completed = (xEventGroupWaitBits(group, allJobs, pdFALSE, pdTRUE, timeout) & allJobs) == allJobs;
+    if (!completed)
+    {
+        cancel(allJobs);
+    }
+
+    statistics = Statistics {static_cast<uint8_t>(jobCount)};
+    bool succeeded = completed && !jobDropped;
+    for (size_t i = 0; i < jobCount; ++i)
+    {
+        const auto& job = jobs[i];
+        if (!finished(static_cast<JobId>(i)))
+        {
+            DEBUG_LOG("Bring-up of " << job.name << (job.abandoned ? " was abandoned" : " didn't finish"))
+            succeeded = false;
+            continue;
+        }
+        statistics.sequentialMicroseconds += job.endMicroseconds - job.startMicroseconds;
+        statistics.criticalPathMicroseconds = std::max(statistics.criticalPathMicroseconds,
+                                                       job.endMicroseconds - startMicroseconds);
+        succeeded = succeeded && job.succeeded;
+        DEBUG_LOG("Bring-up of " << job.name << (job.succeeded ? "" : " failed") << " from "
+                  << job.startMicroseconds - startMicroseconds << " to " << job.endMicroseconds - startMicroseconds
+                  << " us")
+    }
+    if (!completed)
+    {
+        statistics.criticalPathMicroseconds = clock.monotonicMicroseconds() - startMicroseconds;
+    }
+    DEBUG_LOG("Bring-up took " << statistics.criticalPathMicroseconds << " us, the jobs one after another "
+              << statistics.sequentialMicroseconds << " us")
+    lastStatistics = statistics;
+    return succeeded;
+}
+
+bool BringUp::finished(JobId job) const
+{
+    return job < jobCount && group && (xEventGroupGetBits(group) & bit(job)) != 0;
+}
+
+bool BringUp::abandoned(JobId job) const
+{
+    return job < jobCount && jobs[job].abandoned;
+}
+
+BringUp::Statistics BringUp::getLastStatistics()
+{
+    return lastStatistics;
+}
+
+void BringUp::cancel(EventBits_t allJobs)
+{
+    xSemaphoreTake(startLock, portMAX_DELAY);
+    cancelled = true;
+    xSemaphoreGive(startLock);
+    // The jobs which start from now on see the flag and skip their function
+    xEventGroupWaitBits(group, allJobs, pdFALSE, pdTRUE, cancellationGrace);
+    const auto bits = xEventGroupGetBits(group);
+    for (size_t i = 0; i < jobCount; ++i)
+    {
+        // A job which hasn't started waits for an abandoned dependency, its device was never touched. If the
+        // dependency ends later, the job sees the flag and is skipped.
+        jobs[i].abandoned = (bits & bit(i)) == 0 && jobs[i].started;
+    }
+}
+
+void BringUp::jobTask(void* parameter)
+{
+    auto& job = *static_cast<Job*>(parameter);
+    job.owner->execute(job);
+    vTaskDelete(nullptr);
+}
+
+void BringUp::execute(Job& job)
+{
+    if (job.dependencies != 0)
+    {
+        // A dependency never finishing leaves the job waiting until the deep sleep, it holds nothing meanwhile
+        xEventGroupWaitBits(group, job.dependencies, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    xSemaphoreTake(startLock, portMAX_DELAY);
+    job.started = !cancelled;
+    xSemaphoreGive(startLock);
+    if (!job.started)
+    {
+        DEBUG_LOG("Bring-up of " << job.name << " is cancelled")
+        xEventGroupSetBits(group, bit(&job - jobs.data()));
+        return;
+    }
+    job.startMicroseconds = clock.monotonicMicroseconds();
+    bool dependenciesSucceeded = true;
+    for (size_t i = 0; i < jobCount; ++i)
+    {
+        dependenciesSucceeded = dependenciesSucceeded && ((job.dependencies & bit(i)) == 0 || jobs[i].succeeded);
+    }
+    if (dependenciesSucceeded)
+    {
+        job.succeeded = job.function(job.context);
+    }
+    else
+    {
+        DEBUG_LOG("Bring-up of " << job.name << " is skipped, its dependency failed")
+    }
+    job.endMicroseconds = clock.monotonicMicroseconds();
+    // Sets the memory barrier, the owner reads the result after the bit
+    xEventGroupSetBits(group, bit(&job - jobs.data()));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+class Clock;
+
+// Initialization of the devices of the wake as concurrent jobs. Every job runs in its own task as soon as the jobs
+// it depends on have succeeded, so the waits of one device (the e-paper BUSY, the settling of the step-up, the
+// Wi-Fi stack init) overlap with the work of the others. A job whose dependency failed isn't run and fails too.
+// The jobs left after the timeout are cancelled: the ones which haven't started yet are skipped, the ones still
+// running get a short grace period. A job still running after it is abandoned but not deleted, since a task deleted
+// within a driver call would leave the driver's mutex taken for the rest of the wake. It runs to its end in
+// the background, and its device must not be used in the rest of the wake. run() is called once per wake.
+class BringUp
+{
+public:
+    using JobFunction = bool (*)(void* context);
+    using JobId = uint8_t;
+    static constexpr size_t maxJobs = 8;
+
+    struct Statistics
+    {
+        uint8_t jobs = 0;
+        // From the start of the bring-up to the end of its last job
+        int64_t criticalPathMicroseconds = 0;
+        // Sum of the job durations, the latency of the same jobs run one after another
+        int64_t sequentialMicroseconds = 0;
+    };
+
+    explicit BringUp(const Clock& clock) : clock(clock) {}
+    ~BringUp();
+    BringUp(const BringUp&) = delete;
+    BringUp& operator=(const BringUp&) = delete;
+
+    // The dependencies are the identifiers returned for the jobs added before
+    JobId add(const char* name, JobFunction function, void* context, std::initializer_list<JobId> dependencies = {});
+    // Starts all the jobs and waits for them, returns true if all of them succeeded within the timeout
+    bool run(TickType_t timeout);
+    [[nodiscard]] bool finished(JobId job) const;
+    // The job was still running after the timeout, its device must not be used
+    [[nodiscard]] bool abandoned(JobId job) const;
+
+    [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+    // Statistics of the latest bring-up of the firmware
+    [[nodiscard]] static Statistics getLastStatistics();
+
+private:
+    struct Job
+    {
+        BringUp* owner = nullptr;
+        const char* name = nullptr;
+        JobFunction function = nullptr;
+        void* context = nullptr;
+        EventBits_t dependencies = 0;
+        bool started = false;
+        bool succeeded = false;
+        bool abandoned = false;
+        int64_t startMicroseconds = 0;
+        int64_t endMicroseconds = 0;
+    };
+
+    void cancel(EventBits_t allJobs);
+    static void jobTask(void* parameter);
+    void execute(Job& job);
+    [[nodiscard]] static EventBits_t bit(size_t index) { return EventBits_t(1) << index; }
+
+    const Clock& clock;
+    std::array<Job, maxJobs> jobs {};
+    size_t jobCount = 0;
+    bool jobDropped = false;
+    // Set by the owner on the timeout, read by the jobs before they start. Both sides take startLock, so a job either
+    // sees the flag or is seen started by the owner
+    bool cancelled = false;
+    SemaphoreHandle_t startLock = nullptr;
+    EventGroupHandle_t group = nullptr;
+    Statistics statistics;
+};
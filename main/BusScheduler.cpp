@@ -0,0 +1,126 @@
+#include "BusScheduler.h"
+
+#include "Clock.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+
+#include "Debug.h"
+
+namespace
+{
+BusScheduler::Statistics totalStatistics;
+}
+
+BusScheduler::SensorSet BusScheduler::start(SensorSet sensors)
+{
+    return runWindow(sensors, [](void*, SensorProvider& provider, SensorRegistry::SensorId)
+    {
+        return provider.start();
+    }, nullptr);
+}
+
+BusScheduler::SensorSet BusScheduler::read(SensorSet sensors)
+{
+    SensorSet pending = sensors;
+    SensorSet done = 0;
+    while (pending != 0)
+    {
+        // The earliest ready time opens the window, the sensors ready soon after it join
+        auto first = std::numeric_limits<int64_t>::max();
+        for (SensorRegistry::SensorId id = 0; id < registry.size(); ++id)
+        {
+            if (pending & SensorRegistry::bit(id))
+            {
+                first = std::min(first, registry[id].readyTime());
+            }
+        }
+        SensorSet group = 0;
+        auto last = first;
+        for (SensorRegistry::SensorId id = 0; id < registry.size(); ++id)
+        {
+            if ((pending & SensorRegistry::bit(id)) && registry[id].readyTime() <= first + groupingMicroseconds)
+            {
+                group |= SensorRegistry::bit(id);
+                last = std::max(last, registry[id].readyTime());
+            }
+        }
+        if (group == 0)
+        {
+            // Sensors outside of the registry
+            break;
+        }
+        clock.sleepUntil(last);
+        SensorSet again = 0;
+        done |= runWindow(group, [](void* context, SensorProvider& provider, SensorRegistry::SensorId id)
+        {
+            const auto result = provider.read();
+            if (result == SensorProvider::ReadResult::Pending)
+            {
+                *static_cast<SensorSet*>(context) |= SensorRegistry::bit(id);
+            }
+            return result == SensorProvider::ReadResult::Done;
+        }, &again);
+        pending = static_cast<SensorSet>((pending & ~group) | again);
+    }
+    return done;
+}
+
+BusScheduler::SensorSet BusScheduler::sleep(SensorSet sensors)
+{
+    return runWindow(sensors, [](void*, SensorProvider& provider, SensorRegistry::SensorId)
+    {
+        return provider.sleep();
+    }, nullptr);
+}
+
+void BusScheduler::finishCycle()
+{
+    if (cycle.operations == 0)
+    {
+        return;
+    }
+    DEBUG_LOG("Sensor buses: " << cycle.windows << " windows for " << cycle.operations << " operations, "
+              << cycle.activeMicroseconds << " us active")
+    ++totalStatistics.cycles;
+    totalStatistics.windows += cycle.windows;
+    totalStatistics.operations += cycle.operations;
+    totalStatistics.activeMicroseconds += cycle.activeMicroseconds;
+    cycle = {};
+}
+
+BusScheduler::Statistics BusScheduler::getTotalStatistics()
+{
+    return totalStatistics;
+}
+
+BusScheduler::SensorSet BusScheduler::runWindow(SensorSet sensors, Operation operation, void* context)
+{
+    if (sensors == 0)
+    {
+        return 0;
+    }
+    const PowerLock::Guard guard(windowLock);
+    const auto openTime = clock.monotonicMicroseconds();
+    SensorSet succeeded = 0;
+    for (const auto bus : {SensorProvider::Bus::I2C, SensorProvider::Bus::Uart})
+    {
+        for (SensorRegistry::SensorId id = 0; id < registry.size(); ++id)
+        {
+            auto& provider = registry[id];
+            if ((sensors & SensorRegistry::bit(id)) == 0 || provider.bus() != bus)
+            {
+                continue;
+            }
+            ++cycle.operations;
+            if (operation(context, provider, id))
+            {
+                succeeded |= SensorRegistry::bit(id);
+            }
+        }
+    }
+    ++cycle.windows;
+    cycle.activeMicroseconds += clock.monotonicMicroseconds() - openTime;
+    return succeeded;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PowerManagement.h"
+#include "SensorProvider.h"
+
+#include <cstdint>
+
+class Clock;
+
+// Groups the transactions of the sensors into as few bus windows as possible. The measurements are started back to
+// back in one window, the sensors ready within the grouping interval of the earliest one are read together at the
+// latest of their ready times and the sleep commands share one window again. Within a window the I2C sensors go
+// before the UART ones, so the transactions of a bus follow each other. The chip is kept out of the light sleep for
+// the window and sleeps between the windows.
+class BusScheduler
+{
+public:
+    using SensorSet = SensorRegistry::SensorSet;
+
+    struct Statistics
+    {
+        uint32_t cycles = 0;
+        uint32_t windows = 0;
+        // Starts, reads and sleeps of the sensors, each of them would take its own window without the grouping
+        uint32_t operations = 0;
+        // Time the windows were open
+        int64_t activeMicroseconds = 0;
+    };
+
+    // The data of a sensor may be read so much after its ready time to share the window of another one
+    static constexpr int64_t groupingMicroseconds = 20000;
+
+    BusScheduler(const SensorRegistry& registry, Clock& clock) : registry(registry), clock(clock) {}
+
+    // Returns the set of the sensors started
+    SensorSet start(SensorSet sensors);
+    // Reads the sensors until each of them is done or failed, returns the set of the ones done. A pending sensor
+    // shall move its ready time on.
+    SensorSet read(SensorSet sensors);
+    // Returns the set of the sensors put to sleep
+    SensorSet sleep(SensorSet sensors);
+    // Ends the measurement cycle, its statistics are added to the totals
+    void finishCycle();
+
+    // Totals of the cycles finished since the boot, the deep sleep clears them
+    [[nodiscard]] static Statistics getTotalStatistics();
+
+private:
+    using Operation = bool (*)(void* context, SensorProvider& provider, SensorRegistry::SensorId id);
+
+    // Runs the operation for the sensors in one window, returns the set of the sensors it succeeded for
+    SensorSet runWindow(SensorSet sensors, Operation operation, void* context);
+
+    const SensorRegistry& registry;
+    Clock& clock;
+    PowerLock windowLock {"sensor_bus"};
+    Statistics cycle;
+};
@@ -0,0 +1,83 @@
+#include "ChannelPlan.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+constexpr std::array<uint8_t, 3> nonOverlappingChannels = {1, 6, 11};
+
+struct Candidates
+{
+    std::array<uint8_t, ChannelPlan::maxChannel> channels {};
+    size_t count = 0;
+
+    void add(uint8_t channel)
+    {
+        if (channel == ChannelPlan::unknownChannel || channel > ChannelPlan::maxChannel
+            || std::find(channels.begin(), channels.begin() + count, channel) != channels.begin() + count)
+        {
+            return;
+        }
+        channels[count++] = channel;
+    }
+};
+}
+
+uint8_t ChannelPlan::channelForWake() const
+{
+    Candidates candidates;
+    candidates.add(announcedChannel);
+    candidates.add(workingChannel);
+    if (!isSearching())
+    {
+        return candidates.count != 0 ? candidates.channels[0] : unknownChannel;
+    }
+    candidates.add(accessPointChannel);
+    for (const auto channel : nonOverlappingChannels)
+    {
+        candidates.add(channel);
+    }
+    for (uint8_t channel = 1; channel <= maxChannel; ++channel)
+    {
+        candidates.add(channel);
+    }
+    // The first search wake tries the second candidate, the first one was just missed
+    return candidates.channels[(missedWakes - missedWakesBeforeSearch + 1) % candidates.count];
+}
+
+uint8_t ChannelPlan::channelToAnnounce() const
+{
+    if (accessPointChannel != unknownChannel && accessPointChannel != rejectedChannel)
+    {
+        return accessPointChannel;
+    }
+    return workingChannel;
+}
+
+void ChannelPlan::registerPeerHeard(uint8_t channel)
+{
+    if (announcedChannel != unknownChannel && announcedChannel != channel)
+    {
+        rejectedChannel = announcedChannel;
+    }
+    announcedChannel = unknownChannel;
+    workingChannel = channel;
+    missedWakes = 0;
+}
+
+void ChannelPlan::registerAnnouncementDelivered(uint8_t channel)
+{
+    if (channel != unknownChannel && channel != workingChannel)
+    {
+        announcedChannel = channel;
+    }
+}
+
+void ChannelPlan::registerWakeWithoutPeer()
+{
+    if (missedWakes < UINT8_MAX)
+    {
+        ++missedWakes;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Channel of the ESP-NOW link. Both units shall sit on the same Wi-Fi channel, while the station interface drags
+// the radio to the channel of the access point. The structure is kept in the persistent storage: the working
+// channel is used directly on the next wakes, and when the external unit goes silent the following wakes listen
+// on the likely channels in turn - the one announced to the unit, the last working one, the access point's one,
+// the non-overlapping 1, 6, 11 and then the rest.
+struct ChannelPlan
+{
+    static constexpr uint8_t unknownChannel = 0;
+    static constexpr uint8_t maxChannel = 13;
+    // A single lost message doesn't start the search
+    static constexpr uint8_t missedWakesBeforeSearch = 2;
+
+    uint8_t workingChannel = unknownChannel;
+    uint8_t accessPointChannel = unknownChannel;
+    // The external unit acknowledged the announcement of this channel and shall move there
+    uint8_t announcedChannel = unknownChannel;
+    // The external unit didn't follow the announcement of this channel, it isn't announced again
+    uint8_t rejectedChannel = unknownChannel;
+    uint8_t missedWakes = 0;
+
+    // Channel to listen on during this wake, unknownChannel keeps the current channel of the radio
+    [[nodiscard]] uint8_t channelForWake() const;
+    // Channel for the acknowledgement: the access point's one, so the link can share the radio with the station
+    [[nodiscard]] uint8_t channelToAnnounce() const;
+    [[nodiscard]] bool isSearching() const { return missedWakes >= missedWakesBeforeSearch; }
+
+    void registerPeerHeard(uint8_t channel);
+    void registerAnnouncementDelivered(uint8_t channel);
+    void registerWakeWithoutPeer();
+    void setAccessPointChannel(uint8_t channel) { accessPointChannel = channel; }
+};
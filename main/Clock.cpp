@@ -0,0 +1,57 @@
+#include "Clock.h"
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <soc/rtc.h>
+#include <sys/time.h>
+
+namespace
+{
+SystemClock systemClock;
+Clock* installedClock = &systemClock;
+}
+
+Clock& Clock::instance()
+{
+    return *installedClock;
+}
+
+void Clock::install(Clock* clock)
+{
+    installedClock = clock != nullptr ? clock : &systemClock;
+}
+
+int64_t SystemClock::wallMicroseconds() const
+{
+    timeval tv {};
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+void SystemClock::setWallMicroseconds(int64_t microseconds)
+{
+    const timeval tv {.tv_sec = static_cast<time_t>(microseconds / 1000000),
+                      .tv_usec = static_cast<suseconds_t>(microseconds % 1000000)};
+    settimeofday(&tv, nullptr);
+}
+
+int64_t SystemClock::monotonicMicroseconds() const
+{
+    return esp_timer_get_time();
+}
+
+uint64_t SystemClock::rtcTicks() const
+{
+    return rtc_time_get();
+}
+
+void SystemClock::sleepUntil(int64_t monotonicDeadline)
+{
+    constexpr int64_t tickMicroseconds = portTICK_PERIOD_MS * 1000;
+    // The delay is rounded up to whole ticks
+    if (const auto remaining = monotonicDeadline - esp_timer_get_time(); remaining > 0)
+    {
+        vTaskDelay(static_cast<TickType_t>((remaining + tickMicroseconds - 1) / tickMicroseconds));
+    }
+}
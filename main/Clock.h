@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+// Source of all the time readings and the timed waits of the firmware. The wake scheduling, the clock correction
+// and the tasks of the controller read the time only through the installed clock, so they can run on a virtual one.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    // Wall clock in microseconds since the epoch, set by SNTP or by the correction after the deep sleep
+    [[nodiscard]] virtual int64_t wallMicroseconds() const = 0;
+    virtual void setWallMicroseconds(int64_t microseconds) = 0;
+    // Monotonic time since the boot
+    [[nodiscard]] virtual int64_t monotonicMicroseconds() const = 0;
+    // Counter of the RTC slow clock, it keeps counting through the deep sleep
+    [[nodiscard]] virtual uint64_t rtcTicks() const = 0;
+    // Blocks the calling task until the monotonic time reaches the deadline
+    virtual void sleepUntil(int64_t monotonicDeadline) = 0;
+
+    [[nodiscard]] time_t wallSeconds() const { return static_cast<time_t>(wallMicroseconds() / 1000000); }
+    void sleepFor(int64_t microseconds) { sleepUntil(monotonicMicroseconds() + microseconds); }
+
+    // The clock used by the firmware, the system clock unless another one is installed
+    static Clock& instance();
+    // Installs the clock for the whole firmware, nullptr restores the system clock
+    static void install(Clock* clock);
+};
+
+// Clock of the chip: the time of the C library, esp_timer, the RTC timer and the FreeRTOS delays
+class SystemClock final : public Clock
+{
+public:
+    [[nodiscard]] int64_t wallMicroseconds() const override;
+    void setWallMicroseconds(int64_t microseconds) override;
+    [[nodiscard]] int64_t monotonicMicroseconds() const override;
+    [[nodiscard]] uint64_t rtcTicks() const override;
+    void sleepUntil(int64_t monotonicDeadline) override;
+};
@@ -5,33 +5,95 @@
 #include "PersistentStorage.h"
 
 #include "AnalogPin.h"
+#include "BatteryModel.h"
+#include "HistoryUpload.h"
+#include "SampleAggregation.h"
 #include "esp32-esp-idf/GpioPinDefinition.h"
 
+#include <algorithm>
+#include <cmath>
 #include <driver/rtc_io.h>
+#if __has_include(<esp_adc_cal.h>)
+#include <esp_adc_cal.h>
+#endif
 #include <esp_sntp.h>
 #include <freertos/event_groups.h>
 
 #include "Debug.h"
-#include "Delays.h"
 
 namespace
 {
 const std::string_view viewDataTag = "DMC1";
 const std::string_view controllerDataTag = "DMC2";
+const std::string_view airQualityDataTag = "DMC3";
 constexpr EventBits_t TIME_SYNC_BIT = BIT0;
 constexpr EventBits_t TRANSPORT_COMPLETED_BIT = BIT1;
 constexpr EventBits_t VIEW_COMPLETED_BIT = BIT2;
 constexpr EventBits_t TIME_TASK_COMPLETED_BIT = BIT3;
 constexpr EventBits_t MEASUREMENT_COMPLETED_BIT = BIT4;
 constexpr auto secondsInHour = 60*60;
+constexpr auto secondsInDay = 24 * secondsInHour;
+constexpr uint32_t wifiConnectionTimeoutMs = 20000;
+
+using Activity = WakePlanner::Activity;
+// The wake starts before its planned time to be ready at it, a little more covers the drift of the RTC
+constexpr time_t wakeLeadSeconds = 2;
+constexpr uint32_t pmMeasurementToleranceSeconds = 5 * 60;
+// The synchronization runs in the first hour of the local day
+constexpr uint32_t timeSyncToleranceSeconds = 30 * 60;
+// The minimal pause between the PM measurements
+constexpr time_t pmMeasurementPauseSeconds = 10 * 60;
+// 128 records of the history cover the last 32 hours
+constexpr time_t historyIntervalSeconds = 15 * 60;
+constexpr int64_t uploadTimeoutMs = 10000;
+// Less time left of the time synchronization budget isn't worth the request
+constexpr int64_t minimalUploadTimeoutMs = 200;
+// Activities needing the display, the radio or the Wi-Fi, the others are served by the measurement-only wake
+constexpr WakePlanner::ActivitySet fullWakeActivities = WakePlanner::bit(Activity::Clock)
+        | WakePlanner::bit(Activity::OuterData) | WakePlanner::bit(Activity::TimeSync);
+
+struct JobCompletion
+{
+    WakeBudget::Job job;
+    EventBits_t bit;
+};
+
+constexpr JobCompletion jobCompletions[] = {
+        {WakeBudget::Job::Measurement, MEASUREMENT_COMPLETED_BIT},
+        {WakeBudget::Job::TimeSync, TIME_TASK_COMPLETED_BIT},
+        {WakeBudget::Job::Transport, TRANSPORT_COMPLETED_BIT},
+        {WakeBudget::Job::Display, VIEW_COMPLETED_BIT},
+};
+
+constexpr size_t voltageSamples = 16;
+constexpr float voltageDividerRatio = 0.5f;
+constexpr uint32_t defaultVrefMillivolts = 1100;
+// Current drawn from the battery while the voltage is read: CPU and the idle step-up converter
+constexpr float voltageReadLoadCurrent = 0.05f;
 
 [[nodiscard]]
-int readVoltageRaw(uint8_t pin)
+float readBatteryVoltage(uint8_t pin)
 {
     embedded::GpioPinDefinition voltagePin { pin };
-    const auto voltage = embedded::AnalogPin(voltagePin).singleRead();
-    DEBUG_LOG("VoltageRaw is " << voltage)
-    return voltage;
+    embedded::AnalogPin analogPin(voltagePin);
+    std::array<float, voltageSamples> samples {};
+    for (auto& sample : samples)
+    {
+        sample = float(analogPin.singleRead());
+    }
+    const auto raw = aggregation::trimmedMean(samples, samples.size(), samples.size() / 4);
+    DEBUG_LOG("VoltageRaw is " << raw)
+#if __has_include(<esp_adc_cal.h>)
+    esp_adc_cal_characteristics_t characteristics;
+    if (esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, defaultVrefMillivolts, &characteristics)
+        != ESP_ADC_CAL_VAL_DEFAULT_VREF)
+    {
+        const auto millivolts = esp_adc_cal_raw_to_voltage(static_cast<uint32_t>(raw), &characteristics);
+        // The eFuse calibration already corrects the ADC, the experimental correction is for the raw reading only
+        return float(millivolts) / 1000.f / voltageDividerRatio;
+    }
+#endif
+    return raw * 3.3f / voltageDividerRatio / 4095.f * AppConfig::voltageDividerCorrection;
 }
 
 void initStepUpControl()
@@ -48,7 +110,7 @@ void switchStepUpConversion(bool enable)
     rtc_gpio_set_level(stepUpPin, enable ? 1 : 0);
     if (enable)
     {
-        embedded::delay(20);
+        Clock::instance().sleepFor(20 * 1000);
     }
 }
 
@@ -79,17 +141,24 @@ void DustMonitorController::timeSyncTask(void* pvParameters)
     {
         xEventGroupClearBits(eventGroup, TIME_TASK_COMPLETED_BIT);
         const bool relevantTime = isTimeSyncronized();
-        const auto currentTime = time(nullptr);
-        bool refreshRequired = relevantTime && (controllerData.lastTimeSyncTime + 12 * secondsInHour < currentTime)
-                && getLocalTime(currentTime).tm_hour == 0 && controllerData.sps30Status != SPS30Status::Measuring;
+        bool refreshRequired = relevantTime && isDue(Activity::TimeSync)
+                && controllerData.sps30Status != SPS30Status::Measuring;
+        bool synchronized = false;
 
         if (refreshRequired)
         {
             DEBUG_LOG("Time syncronization is required, waiting for transport completion")
             transport.init({ eventGroup, TRANSPORT_COMPLETED_BIT});
-            xEventGroupWaitBits(eventGroup, TRANSPORT_COMPLETED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+            if (xEventGroupWaitBits(eventGroup, TRANSPORT_COMPLETED_BIT, pdFALSE, pdTRUE,
+                                    wakeBudget.ticksLeft(WakeBudget::Job::Transport)) & TRANSPORT_COMPLETED_BIT)
+            {
+                DEBUG_LOG("Transport completed")
+            }
+            else
+            {
+                wakeBudget.recordOverrun(WakeBudget::Job::Transport);
+            }
             transport.hibernate();
-            DEBUG_LOG("Transport completed")
         }
         if (!relevantTime || refreshRequired)
         {
@@ -106,9 +175,15 @@ void DustMonitorController::timeSyncTask(void* pvParameters)
             {
                 DEBUG_LOG("WiFi manager state: " << static_cast<int>(state))
             }
-            if (wifiManager.waitForConnection(20000))
+            const auto connectionTimeoutMs = static_cast<int>(std::min<int64_t>(
+                    wifiConnectionTimeoutMs, wakeBudget.microsecondsLeft(WakeBudget::Job::TimeSync) / 1000));
+            if (wifiManager.waitForConnection(connectionTimeoutMs))
             {
                 DEBUG_LOG("Connected to AP")
+                if (const auto channel = WiFiManager::getChannel())
+                {
+                    transport.setAccessPointChannel(*channel);
+                }
                 xEventGroupClearBits(eventGroup, TIME_SYNC_BIT);
                 esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
                 esp_sntp_setservername(0, AppConfig::ntpServer.data());
@@ -116,9 +191,19 @@ void DustMonitorController::timeSyncTask(void* pvParameters)
                 esp_sntp_setservername(2, (char*)nullptr);
                 esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
                 esp_sntp_init();
-                xEventGroupWaitBits(eventGroup, TIME_SYNC_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+                if (xEventGroupWaitBits(eventGroup, TIME_SYNC_BIT, pdFALSE, pdTRUE,
+                                        wakeBudget.ticksLeft(WakeBudget::Job::TimeSync)) & TIME_SYNC_BIT)
+                {
+                    controllerData.lastTimeSyncTime = secondsNow();
+                    synchronized = true;
+                }
+                else
+                {
+                    wakeBudget.recordOverrun(WakeBudget::Job::TimeSync);
+                }
                 esp_sntp_stop();
-                controllerData.lastTimeSyncTime = time(nullptr);
+                // The association is paid already, the buffered readings go with it
+                uploadHistory();
             }
             else
             {
@@ -126,13 +211,18 @@ void DustMonitorController::timeSyncTask(void* pvParameters)
             }
             wifiManager.stopSTA();
         }
+        if (refreshRequired || synchronized)
+        {
+            // The failed synchronization waits for the next slot, the clock runs on the calibrated RTC meanwhile
+            controllerData.wakePlanner.complete(Activity::TimeSync, secondsNow());
+        }
         if (!transport.init({ eventGroup, TRANSPORT_COMPLETED_BIT}))
         {
             DEBUG_LOG("Failed to initialize ESP-NOW")
         }
         xEventGroupSetBits(eventGroup, TIME_TASK_COMPLETED_BIT);
 
-        vTaskDelay(24*60*60*1000 / portTICK_PERIOD_MS); // sync every day if there is no deep sleep
+        Clock::instance().sleepFor(24 * 60 * microsecondsInMinute); // sync every day if there is no deep sleep
     }
 }
 
@@ -143,19 +233,23 @@ void DustMonitorController::updateDisplayTask(void* pvParameters)
 
 [[noreturn]] void DustMonitorController::updateDisplayTask()
 {
-    timeval timeVal;
-    gettimeofday(&timeVal, nullptr);
-    const auto timeSeconds = timeVal.tv_sec;
-    if (const auto seconds = timeSeconds % 60; seconds != 0)
+    auto& clock = Clock::instance();
+    const auto wallTime = clock.wallMicroseconds();
+    if (const auto seconds = wallTime / microsecondsInSecond % 60; seconds != 0)
     {
-        vTaskDelay(((60 - seconds)*1000 - timeVal.tv_usec / 1000) / portTICK_PERIOD_MS + 1);
+        clock.sleepFor(microsecondsInMinute - wallTime % microsecondsInMinute + 1000);
     }
-    auto lastUpdateTime = xTaskGetTickCount();
+    auto nextUpdateTime = clock.monotonicMicroseconds();
     while (true)
     {
-        view.updateView();
+        if (isDue(Activity::Clock))
+        {
+            view.updateView();
+            controllerData.wakePlanner.complete(Activity::Clock, secondsNow());
+        }
         xEventGroupSetBits(eventGroup, VIEW_COMPLETED_BIT);
-        xTaskDelayUntil(&lastUpdateTime, 60*1000 / portTICK_PERIOD_MS);
+        nextUpdateTime += microsecondsInMinute;
+        clock.sleepUntil(nextUpdateTime);
     }
 }
 
@@ -166,69 +260,127 @@ void DustMonitorController::measurementTask(void* pvParameters)
 
 [[noreturn]] void DustMonitorController::measurementTask()
 {
+    auto& clock = Clock::instance();
+    const auto pthBit = SensorRegistry::bit(pthSensor);
+    const auto dustBit = SensorRegistry::bit(dustSensor);
     while (true)
     {
-        auto lastUpdateTime = xTaskGetTickCount();
-        const auto currentTime = time(nullptr);
-        if (fullCircle && meteoData.activate())
-        {
-            if (meteoData.doMeasure())
-            {
-                DEBUG_LOG("PTH measurement done")
-                controllerData.lastPTHMeasureTime = currentTime;
-                dustMoinitorViewData.innerData.humidity = meteoData.getHumidity();
-                dustMoinitorViewData.innerData.temperature = meteoData.getTemperature();
-                dustMoinitorViewData.innerData.pressure = meteoData.getPressure();
-                meteoData.hibernate();
-            }
-        }
+        const auto cycleStartTime = clock.monotonicMicroseconds();
+        const auto currentTime = secondsNow();
+        // The other sensors of the registry are read along with the BME280 by the full wake
+        auto toStart = static_cast<SensorRegistry::SensorSet>(fullCircle ? sensors.all() & ~dustBit : 0);
 
         bool shallStartMeasurement = controllerData.sps30Status == SPS30Status::Startup;
         if (!shallStartMeasurement && controllerData.sps30Status != SPS30Status::Measuring)
         {
-            shallStartMeasurement = getLocalTime(time(nullptr)).tm_min == 59;
+            shallStartMeasurement = isDue(Activity::PmMeasurement);
         }
 
-        if (shallStartMeasurement && currentTime - controllerData.lastPMMeasureTime > 10*60)
+        if (shallStartMeasurement && currentTime - controllerData.lastPMMeasureTime <= pmMeasurementPauseSeconds)
+        {
+            controllerData.wakePlanner.scheduleOnce(Activity::PmMeasurement, controllerData.lastPMMeasureTime
+                                                    + pmMeasurementPauseSeconds + 1, pmMeasurementToleranceSeconds);
+        }
+        else if (shallStartMeasurement)
         {
             if (controllerData.sps30Status != SPS30Status::Measuring)
             {
                 switchStepUpConversion(true);
-                const auto voltagePin = (gpio_num_t)AppConfig::voltagePin;
-                const float rawToVolts = 3.3f / 0.5f / 4095.f * AppConfig::voltageDividerCorrection;
-                dustMoinitorViewData.innerData.voltage = float(readVoltageRaw(voltagePin)) * rawToVolts;
-                if (controllerData.sps30Status == SPS30Status::Sleep)
-                {
-                    DEBUG_LOG("Waking up SPS30")
-                    dustData.wakeUp();
-                }
+                const auto voltage = readBatteryVoltage(AppConfig::voltagePin);
+                dustMoinitorViewData.innerData.voltage = voltage;
+                const auto openCircuitVoltage = BatteryModel::openCircuitVoltage(voltage, voltageReadLoadCurrent);
+                controllerData.stateOfCharge = BatteryModel::stateOfCharge(openCircuitVoltage);
+                controllerData.powerTier = BatteryModel::powerTier(controllerData.stateOfCharge, controllerData.powerTier);
+                DEBUG_LOG("Battery charge " << (int)controllerData.stateOfCharge << "%, power tier "
+                          << (int)controllerData.powerTier)
                 DEBUG_LOG("Starting PM measurement")
-                dustData.startMeasure();
-                controllerData.sps30Status = SPS30Status::Measuring;
-                controllerData.lastPMMeasureTime = currentTime;
-                holdStepUpConversion();
+                dustData.setSleeping(controllerData.sps30Status == SPS30Status::Sleep);
+                toStart |= dustBit;
             }
         }
 
-        if (controllerData.sps30Status == SPS30Status::Measuring && currentTime - controllerData.lastPMMeasureTime >= 30)
+        // The BME280 conversion runs while the SPS30 measurement is being started, in the same bus window
+        const auto started = busScheduler.start(toStart);
+        if (toStart & dustBit)
+        {
+            controllerData.sps30Status = SPS30Status::Measuring;
+            controllerData.lastPMMeasureTime = currentTime;
+            holdStepUpConversion();
+            auto& planner = controllerData.wakePlanner;
+            planner.complete(Activity::PmMeasurement, currentTime);
+            // A second more covers the wake starting before its planned time
+            planner.scheduleOnce(Activity::PmReadout,
+                                 currentTime + SPS30DataProvider::convergenceSettings.warmUpSeconds + 1, 0);
+        }
+
+        const auto measuringTime = currentTime - controllerData.lastPMMeasureTime;
+        const bool pmReadout = controllerData.sps30Status == SPS30Status::Measuring
+                               && measuringTime >= SPS30DataProvider::convergenceSettings.warmUpSeconds;
+        if (pmReadout)
         {
             DEBUG_LOG("Attempting to obtain PMx data")
+            dustData.resume(static_cast<uint32_t>(measuringTime));
+        }
+        const auto toRead = static_cast<SensorRegistry::SensorSet>((started & ~dustBit) | (pmReadout ? dustBit : 0));
+        const auto done = busScheduler.read(toRead);
+
+        if (done & pthBit)
+        {
+            DEBUG_LOG("PTH measurement done")
+            controllerData.lastPTHMeasureTime = currentTime;
+            dustMoinitorViewData.innerData.humidity = meteoData.getHumidity();
+            dustMoinitorViewData.innerData.temperature = meteoData.getTemperature();
+            dustMoinitorViewData.innerData.pressure = meteoData.getPressure();
+            dustMoinitorViewData.innerData.dewPoint = meteoData.getDewPoint();
+            dustMoinitorViewData.innerData.pressureTendency = meteoData.getPressureTendency();
+            DEBUG_LOG("Dew point " << meteoData.getDewPoint() << ", absolute humidity " << meteoData.getAbsoluteHumidity()
+                      << " g/m3, sea level pressure " << meteoData.getSeaLevelPressure() / 100.f << " hPa")
+        }
+
+        if (pmReadout)
+        {
             auto &innerData = dustMoinitorViewData.innerData;
-            if (dustData.getMeasureData(innerData.pm01, innerData.pm2p5, innerData.pm10))
+            std::optional<float> measuredPm25;
+            if (const auto& particleData = dustData.getParticleData(); (done & dustBit) && particleData)
             {
+                measuredPm25 = (*particleData)[ParticleData::Mc2p5];
+                dustMoinitorViewData.innerParticles = particleData;
+                innerData.pm01 = (int)std::lround((*particleData)[ParticleData::Mc1p0]);
+                innerData.pm2p5 = (int)std::lround((*particleData)[ParticleData::Mc2p5]);
+                innerData.pm10 = (int)std::lround((*particleData)[ParticleData::Mc10p0]);
                 DEBUG_LOG("PM1 = " << innerData.pm01)
                 DEBUG_LOG("PM2.5 = " << innerData.pm2p5)
                 DEBUG_LOG("PM10 = " << innerData.pm10)
+                DEBUG_LOG("PM4 = " << (*particleData)[ParticleData::Mc4p0]
+                          << ", typical size = " << (*particleData)[ParticleData::TypicalSize])
+                innerData.airQuality = airQualityData.inner.update(currentTime, (*particleData)[ParticleData::Mc2p5],
+                                                                   (*particleData)[ParticleData::Mc10p0]);
+                DEBUG_LOG("Inner AQI = " << innerData.airQuality.usAqi << ", EU level " << (int)innerData.airQuality.euLevel)
             }
-            dustData.hibernate();
+            controllerData.samplingPolicy.registerMeasurement(controllerData.lastPMMeasureTime, measuredPm25,
+                                                              dustData.getLastFanOnSeconds());
+            const auto nextMeasurementTime = controllerData.samplingPolicy.nextMeasurementTime(
+                    currentTime, BatteryModel::measurementIntervalScale(controllerData.powerTier));
+            DEBUG_LOG("Next PM measurement at " << nextMeasurementTime << ", fan-on today "
+                      << controllerData.samplingPolicy.getFanSecondsToday() << " s")
+            controllerData.wakePlanner.complete(Activity::PmReadout, currentTime);
+            controllerData.wakePlanner.scheduleOnce(Activity::PmMeasurement, nextMeasurementTime,
+                                                    pmMeasurementToleranceSeconds);
             DEBUG_LOG("Sending SPS30 to sleep")
+        }
+        // The SPS30 measuring after the start keeps running until the readout
+        busScheduler.sleep(toRead);
+        if (pmReadout)
+        {
             controllerData.sps30Status = SPS30Status::Sleep;
             switchStepUpConversion(false);
         }
+        busScheduler.finishCycle();
 
         xEventGroupSetBits(eventGroup, MEASUREMENT_COMPLETED_BIT);
-        const auto delay = (controllerData.sps30Status == SPS30Status::Measuring ? 30 : 60) * 1000 / portTICK_PERIOD_MS;
-        xTaskDelayUntil(&lastUpdateTime, delay);
+        const auto delaySeconds = controllerData.sps30Status == SPS30Status::Measuring
+                ? SPS30DataProvider::convergenceSettings.warmUpSeconds : 60;
+        clock.sleepUntil(cycleStartTime + delaySeconds * microsecondsInSecond);
     }
 }
 
@@ -244,7 +396,7 @@ void DustMonitorController::externalDataTask(void* pvParameters)
     {
         if (auto message = transport.getLastMessage(3*60*1000))
         {
-            auto currentTime = time(nullptr);
+            auto currentTime = secondsNow();
             controllerData.lastExternalDataTime = currentTime;
             if (!dustMoinitorViewData.outerData)
             {
@@ -254,11 +406,22 @@ void DustMonitorController::externalDataTask(void* pvParameters)
             sensorData.humidity = message->humidity;
             sensorData.temperature = message->temperature;
             sensorData.pressure = message->pressure;
+            sensorData.dewPoint = meteorology::dewPoint(message->temperature, message->humidity);
             sensorData.pm01 = message->pm01;
             sensorData.pm2p5 = message->pm25;
             sensorData.pm10 = message->pm10;
             sensorData.voltage = message->voltage;
-            sensorData.flags = message->flags;
+            using Message = EspNowTransport::DataMessage;
+            sensorData.flags = message->flags & ~(Message::sequencedFlag | Message::statusReportFlag);
+            const auto toSample = [](int16_t value) { return value >= 0 ? std::optional<float>(value) : std::nullopt; };
+            sensorData.airQuality = airQualityData.outer.update(currentTime, toSample(message->pm25),
+                                                                toSample(message->pm10));
+        }
+        else if (dustMoinitorViewData.outerData)
+        {
+            // The missing sample only moves the windows, so the stale data expire
+            dustMoinitorViewData.outerData->airQuality = airQualityData.outer.update(secondsNow(), std::nullopt,
+                                                                                     std::nullopt);
         }
     }
 }
@@ -268,7 +431,6 @@ bool DustMonitorController::setup(bool wakeUp)
     DEBUG_LOG((wakeUp ? "Waking up the controller" : "Initial setup of the controller"))
     initStepUpControl();
     eventGroup = xEventGroupCreate();
-    wifiManager.initWiFiSubsystem();
     if (wakeUp)
     {
         if (auto data = storage.get<DustMonitorViewData>(viewDataTag))
@@ -281,77 +443,289 @@ bool DustMonitorController::setup(bool wakeUp)
             controllerData = *data;
             DEBUG_LOG("Last external message recieved: " << controllerData.lastExternalDataTime)
         }
+        if (auto data = storage.get<AirQualityData>(airQualityDataTag))
+        {
+            airQualityData = *data;
+        }
     }
-    else
-    {
-        switchStepUpConversion(true);
-    }
-    const bool pmSetupResult = dustData.setup(wakeUp);
-    if (pmSetupResult && !wakeUp)
-    {
-        dustData.sleep();
-        switchStepUpConversion(false);
-    }
-    if (wakeUp && isMeasuring())
+    initialSetup = !wakeUp;
+    ++controllerData.wakes;
+    planActivities();
+    wakeActivities = controllerData.wakePlanner.dueActivities(secondsNow() + wakeLeadSeconds);
+    WakePlanner::registerWake(wakeActivities);
+    DEBUG_LOG("Planned activities of the wake: " << static_cast<int>(wakeActivities))
+    if (wakeUp && (wakeActivities & fullWakeActivities) == 0)
     {
+        dustData.setup(wakeUp);
         xTaskCreate(&DustMonitorController::measurementTask, "measurement_task", 2048, this, 5, nullptr);
+        startedJobs = MEASUREMENT_COMPLETED_BIT;
         return true;
     }
+    // Only the full wake needs the buses and the Wi-Fi stack, the measurement-only one reads just the SPS30
     fullCircle = true;
-    const bool meteoSetupResult = meteoData.setup(wakeUp);
-    const bool transportResult = transport.setup(wakeUp);
-    const bool viewResult = view.setup(wakeUp);
-    if (transportResult && viewResult && meteoSetupResult && pmSetupResult)
+    if (bringUpDevices())
     {
-        xTaskCreate(&DustMonitorController::timeSyncTask, "time_sync_task", 2048, this, 5, nullptr);
+        // The readings of the previous wake, the transport sends them before this one measures
+        transport.setStatusReport(makeStatusReport());
+        // The HTTP client of the history upload runs on the stack of the task
+        xTaskCreate(&DustMonitorController::timeSyncTask, "time_sync_task", 4096, this, 5, nullptr);
+        startedJobs = TIME_TASK_COMPLETED_BIT;
         if (!isTimeSyncronized())
         {
-            xEventGroupWaitBits(eventGroup, TIME_SYNC_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+            // The time task completes without the sync if there's no access point
+            xEventGroupWaitBits(eventGroup, TIME_SYNC_BIT | TIME_TASK_COMPLETED_BIT, pdFALSE, pdFALSE,
+                                wakeBudget.ticksLeft(WakeBudget::Job::TimeSync));
+            if (!isTimeSyncronized())
+            {
+                // The measurements and the display need the real time, the next wake tries again
+                if (wakeBudget.microsecondsLeft(WakeBudget::Job::TimeSync) == 0)
+                {
+                    wakeBudget.recordOverrun(WakeBudget::Job::TimeSync);
+                }
+                DEBUG_LOG("Time isn't synchronized")
+                return false;
+            }
         }
         xTaskCreate(&DustMonitorController::measurementTask, "measurement_task", 2048, this, 5, nullptr);
         xTaskCreate(&DustMonitorController::externalDataTask, "external_data_task", 2048, this, 5, nullptr);
         xTaskCreate(&DustMonitorController::updateDisplayTask, "update_display_task", 2048, this, 5, nullptr);
+        startedJobs |= MEASUREMENT_COMPLETED_BIT | TRANSPORT_COMPLETED_BIT | VIEW_COMPLETED_BIT;
         return true;
     }
     return false;
 }
 
-DustMonitorController::ProcessStatus DustMonitorController::process() const
+bool DustMonitorController::bringUpDevices()
 {
-    if (!fullCircle)
+    // The jobs only read the persistent storage, it's written at the hibernation
+    const auto stepUp = bringUp.add("step_up", [](void* context)
+    {
+        // The SPS30 is powered only for its first setup
+        if (static_cast<DustMonitorController*>(context)->initialSetup)
+        {
+            switchStepUpConversion(true);
+        }
+        return true;
+    }, this);
+    bringUp.add("sps30", [](void* context)
+    {
+        auto& controller = *static_cast<DustMonitorController*>(context);
+        const bool result = controller.dustData.setup(!controller.initialSetup);
+        if (result && controller.initialSetup)
+        {
+            controller.dustData.sleep();
+            switchStepUpConversion(false);
+        }
+        return result;
+    }, this, {stepUp});
+    const auto busesReady = bringUp.add("buses", [](void* context)
+    {
+        static_cast<DustMonitorController*>(context)->buses.init();
+        return true;
+    }, this);
+    wifiJob = bringUp.add("wifi", [](void* context)
+    {
+        // Without the Wi-Fi the wake still measures and displays, the transport reports its own failure
+        static_cast<DustMonitorController*>(context)->wifiManager.initWiFiSubsystem();
+        return true;
+    }, this);
+    bringUp.add("bme280", [](void* context)
     {
-        xEventGroupWaitBits(eventGroup, MEASUREMENT_COMPLETED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+        auto& controller = *static_cast<DustMonitorController*>(context);
+        return controller.meteoData.setup(!controller.initialSetup);
+    }, this, {busesReady});
+    transportJob = bringUp.add("transport", [](void* context)
+    {
+        auto& controller = *static_cast<DustMonitorController*>(context);
+        return controller.transport.setup(!controller.initialSetup);
+    }, this);
+    // The e-paper reset and the BUSY wait of its init or wake-up are the longest part
+    const auto display = bringUp.add("display", [](void* context)
+    {
+        auto& controller = *static_cast<DustMonitorController*>(context);
+        return controller.view.setup(!controller.initialSetup);
+    }, this, {busesReady});
+    const bool result = bringUp.run(wakeBudget.ticksLeft(WakeBudget::Job::Display));
+    if (!bringUp.finished(display))
+    {
+        wakeBudget.recordOverrun(WakeBudget::Job::Display);
     }
-    else
+    return result;
+}
+
+DustMonitorController::ProcessStatus DustMonitorController::process()
+{
+    for (const auto& completion : jobCompletions)
     {
-        constexpr auto allBits =
-                MEASUREMENT_COMPLETED_BIT | VIEW_COMPLETED_BIT | TIME_TASK_COMPLETED_BIT | TRANSPORT_COMPLETED_BIT;
-        while ((xEventGroupWaitBits(eventGroup, allBits, pdTRUE, pdTRUE, portMAX_DELAY) & allBits) != allBits);
+        if ((startedJobs & completion.bit) == 0 || wakeBudget.overran(completion.job))
+        {
+            continue;
+        }
+        if ((xEventGroupWaitBits(eventGroup, completion.bit, pdFALSE, pdTRUE, wakeBudget.ticksLeft(completion.job))
+             & completion.bit) == 0)
+        {
+            wakeBudget.recordOverrun(completion.job);
+        }
     }
-    return ProcessStatus::Completed;
+    return wakeBudget.anyOverrun() ? ProcessStatus::DeadlineExceeded : ProcessStatus::Completed;
 }
 
 DustMonitorController::DustMonitorController(embedded::PersistentStorage &storage, embedded::PacketUart &uart,
-                                             embedded::I2CHelper &i2CHelper, embedded::EpdInterface &epdInterface)
+                                             embedded::I2CHelper &i2CHelper, embedded::EpdInterface &epdInterface,
+                                             EpdFrameWriter &frameWriter, RadioInterface &radio,
+                                             ReadingHistory &history,
+                                             PeripheralBuses &buses)
         : meteoData(i2CHelper, storage)
         , dustData(uart)
-        , transport(storage, wifiManager)
+        , pthSensor(sensors.add(meteoData))
+        , dustSensor(sensors.add(dustData))
+        , busScheduler(sensors, Clock::instance())
+        , transport(storage, radio, history)
         , storage(storage)
-        , view(storage, epdInterface, dustMoinitorViewData) {}
+        , buses(buses)
+        , history(history)
+        , view(storage, epdInterface, frameWriter, dustMoinitorViewData)
+        , wakeBudget(Clock::instance())
+        , bringUp(Clock::instance()) {}
 
 void DustMonitorController::hibernate()
 {
     if (fullCircle)
     {
-        view.hibernate();
-        transport.hibernate();
+        // The display which didn't finish its update isn't waited for once more
+        if (!wakeBudget.overran(WakeBudget::Job::Display))
+        {
+            view.hibernate();
+        }
+        if (!bringUp.abandoned(wifiJob) && !bringUp.abandoned(transportJob))
+        {
+            transport.hibernate();
+        }
+        if ((wakeActivities & WakePlanner::bit(Activity::OuterData)) != 0)
+        {
+            controllerData.wakePlanner.complete(Activity::OuterData, secondsNow());
+        }
+        // The records are ordered by the time, so only the synchronized clock is used
+        const auto now = secondsNow();
+        if (isTimeSyncronized() && (history.empty()
+            || now >= static_cast<time_t>(history[history.size() - 1].time) + historyIntervalSeconds))
+        {
+            history.append(makeHistoryRecord());
+        }
+    }
+    // The measurement not started by this wake, e.g. by the failed setup, is retried at the next minute
+    // instead of waking at once
+    if (const auto now = secondsNow(); controllerData.wakePlanner.isDue(Activity::PmMeasurement, now))
+    {
+        controllerData.wakePlanner.postpone(Activity::PmMeasurement, now + 60);
     }
+    // The power tier may have changed by the measurement
+    planActivities();
+    controllerData.lastWakeMilliseconds = static_cast<uint32_t>(Clock::instance().monotonicMicroseconds() / 1000);
+    wakeBudget.accumulate(controllerData.jobOverruns);
     storage.set(viewDataTag, dustMoinitorViewData);
     storage.set(controllerDataTag, controllerData);
+    storage.set(airQualityDataTag, airQualityData);
     DEBUG_LOG("Controller is ready to hibernate")
 }
 
+void DustMonitorController::planActivities()
+{
+    auto& planner = controllerData.wakePlanner;
+    const auto now = secondsNow();
+    const auto displayIntervalMinutes = BatteryModel::displayIntervalMinutes(controllerData.powerTier);
+    planner.setCadence(Activity::Clock, displayIntervalMinutes * 60, 0, now);
+    // The outer data are shown on the display, receiving them more often than it's updated gains nothing
+    planner.setCadence(Activity::OuterData,
+                       std::max(AppConfig::outerDataIntervalMinutes, displayIntervalMinutes) * 60, 0, now);
+    // The synchronization interval is rounded up to whole days, so it stays at the local midnight
+    const auto syncDays = (BatteryModel::timeSyncIntervalHours(controllerData.powerTier) + 23) / 24;
+    const auto localTime = getLocalTime(now);
+    const auto localMidnight = now - (localTime.tm_hour * secondsInHour + localTime.tm_min * 60 + localTime.tm_sec);
+    planner.setCadence(Activity::TimeSync, syncDays * secondsInDay, timeSyncToleranceSeconds, now,
+                       localMidnight + timeSyncToleranceSeconds);
+    if (isMeasuring())
+    {
+        if (!planner.isPlanned(Activity::PmReadout))
+        {
+            planner.scheduleOnce(Activity::PmReadout, controllerData.lastPMMeasureTime
+                                 + SPS30DataProvider::convergenceSettings.warmUpSeconds + 1, 0);
+        }
+    }
+    else if (!planner.isPlanned(Activity::PmMeasurement))
+    {
+        planner.scheduleOnce(Activity::PmMeasurement, controllerData.samplingPolicy.nextMeasurementTime(
+                now, BatteryModel::measurementIntervalScale(controllerData.powerTier)), pmMeasurementToleranceSeconds);
+    }
+}
+
+bool DustMonitorController::isDue(WakePlanner::Activity activity) const
+{
+    return controllerData.wakePlanner.isDue(activity, secondsNow() + wakeLeadSeconds);
+}
+
+StatusReport DustMonitorController::makeStatusReport() const
+{
+    const auto& inner = dustMoinitorViewData.innerData;
+    StatusReport report;
+    report.temperature = inner.temperature;
+    report.humidity = inner.humidity;
+    report.pressure = inner.pressure;
+    report.dewPoint = inner.dewPoint;
+    report.pm01 = static_cast<int16_t>(inner.pm01);
+    report.pm2p5 = static_cast<int16_t>(inner.pm2p5);
+    report.pm10 = static_cast<int16_t>(inner.pm10);
+    report.usAqi = inner.airQuality.usAqi;
+    report.euLevel = inner.airQuality.euLevel;
+    report.stateOfCharge = controllerData.stateOfCharge;
+    report.powerTier = static_cast<uint8_t>(controllerData.powerTier);
+    report.voltage = inner.voltage;
+    report.wakes = controllerData.wakes;
+    report.lastWakeMilliseconds = controllerData.lastWakeMilliseconds;
+    report.jobOverruns = controllerData.jobOverruns;
+    return report;
+}
+
+void DustMonitorController::uploadHistory()
+{
+    if (AppConfig::uploadUrl.empty())
+    {
+        return;
+    }
+    const auto timeoutMs = std::min(uploadTimeoutMs, wakeBudget.microsecondsLeft(WakeBudget::Job::TimeSync) / 1000);
+    if (timeoutMs < minimalUploadTimeoutMs)
+    {
+        DEBUG_LOG("No time left for the history upload")
+        return;
+    }
+    // The failed upload is retried with the next connection, the ring keeps the records meanwhile
+    if (const auto uploadedUntil = history_upload::upload(history, controllerData.historyUploadedUntil,
+                                                          static_cast<int>(timeoutMs)))
+    {
+        controllerData.historyUploadedUntil = *uploadedUntil;
+    }
+}
+
+HistoryRecord DustMonitorController::makeHistoryRecord() const
+{
+    const auto& inner = dustMoinitorViewData.innerData;
+    const auto fixedPoint = [](float value, float scale, long low, long high)
+    {
+        return std::clamp(std::lround(value * scale), low, high);
+    };
+    HistoryRecord record;
+    record.time = static_cast<uint32_t>(secondsNow());
+    record.temperature = static_cast<int16_t>(fixedPoint(inner.temperature, 100, INT16_MIN, INT16_MAX));
+    record.humidity = static_cast<uint16_t>(fixedPoint(inner.humidity, 100, 0, UINT16_MAX));
+    // Pa to 0.1 hPa
+    record.pressure = static_cast<uint16_t>(fixedPoint(inner.pressure, 0.1f, 0, UINT16_MAX));
+    record.pm01 = static_cast<int16_t>(inner.pm01);
+    record.pm2p5 = static_cast<int16_t>(inner.pm2p5);
+    record.pm10 = static_cast<int16_t>(inner.pm10);
+    return record;
+}
+
 bool DustMonitorController::isTimeSyncronized()
 {
-    return (time(nullptr) > 1692025000);
+    return (secondsNow() > 1692025000);
 }
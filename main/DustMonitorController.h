@@ -1,18 +1,35 @@
 #pragma once
 
+#include "AirQuality.h"
+#include "BatteryModel.h"
+#include "BringUp.h"
+#include "BusScheduler.h"
 #include "DustMonitorView.h"
 #include "EspNowTransport.h"
 #include "PTHProvider.h"
+#include "ReadingHistory.h"
+#include "SamplingPolicy.h"
 #include "SPS30DataProvider.h"
+#include "WakeBudget.h"
+#include "WakePlanner.h"
 #include "WiFiManager.h"
 
 #include <ctime>
+#include <optional>
 
 namespace embedded
 {
 class PersistentStorage;
 }
 
+// Buses of the BME280 and the display, brought up only by the wakes using them
+class PeripheralBuses
+{
+public:
+    virtual ~PeripheralBuses() = default;
+    virtual void init() = 0;
+};
+
 class DustMonitorController
 {
 public:
@@ -21,16 +38,29 @@ public:
         AwaitingForSync,
         NeedRefreshClock,
         Completed,
+        // Some jobs missed their deadlines and were abandoned
+        DeadlineExceeded,
     };
     DustMonitorController(embedded::PersistentStorage &storage,
                           embedded::PacketUart &uart,
                           embedded::I2CHelper& i2CHelper,
-                          embedded::EpdInterface& epdInterface);
+                          embedded::EpdInterface& epdInterface,
+                          EpdFrameWriter& frameWriter,
+                          RadioInterface& radio,
+                          ReadingHistory& history,
+                          PeripheralBuses& buses);
     bool setup(bool wakeUp);
-    ProcessStatus process() const;
+    // Waits for the jobs of the wake, each one up to its deadline
+    ProcessStatus process();
 
     bool isMeasuring() const { return controllerData.sps30Status == SPS30Status::Measuring; }
+    bool isFullWake() const { return fullCircle; }
     void hibernate();
+    // The first wake not earlier than the time serving the planned activities
+    std::optional<WakePlanner::Wake> planNextWake(time_t earliest) const
+    {
+        return controllerData.wakePlanner.nextWake(earliest);
+    }
 
 private:
     static bool isTimeSyncronized() ;
@@ -49,19 +79,63 @@ private:
         time_t lastPMMeasureTime = 0;
         time_t lastExternalDataTime = 0;
         time_t lastTimeSyncTime = 0;
+        SamplingPolicy samplingPolicy;
+        PowerTier powerTier = PowerTier::Normal;
+        uint8_t stateOfCharge = 100;
+        WakeBudget::OverrunCounters jobOverruns {};
+        WakePlanner wakePlanner;
+        uint32_t wakes = 0;
+        uint32_t lastWakeMilliseconds = 0;
+        // Time after the last record of the history received by the upload server
+        uint32_t historyUploadedUntil = 0;
+    };
+
+    struct AirQualityData
+    {
+        AirQualityTracker inner;
+        AirQualityTracker outer;
     };
 
     WiFiManager wifiManager;
     PTHProvider meteoData;
     SPS30DataProvider dustData;
+    // New sensors are added to the registry by the constructor and go through the cycle with the built-in ones
+    SensorRegistry sensors;
+    SensorRegistry::SensorId pthSensor;
+    SensorRegistry::SensorId dustSensor;
+    BusScheduler busScheduler;
     EspNowTransport transport;
     embedded::PersistentStorage &storage;
+    PeripheralBuses &buses;
+    ReadingHistory &history;
     DustMonitorViewData dustMoinitorViewData;
     DustMonitorView view;
     ControllerData controllerData;
+    AirQualityData airQualityData;
+    WakeBudget wakeBudget;
+    BringUp bringUp;
+    // The radio isn't powered down by the hibernation while the Wi-Fi stack or the transport abandoned by the
+    // bring-up may still be initializing it
+    BringUp::JobId wifiJob = BringUp::maxJobs;
+    BringUp::JobId transportJob = BringUp::maxJobs;
 
     bool fullCircle = false;
+    bool initialSetup = false;
+    // Completion bits of the jobs started by this wake
+    EventBits_t startedJobs = 0;
+    // Activities the planner woke the unit for
+    WakePlanner::ActivitySet wakeActivities = 0;
     bool timeSyncInitialized = false;
+    // Brings up the devices of the full wake concurrently, returns false if any of them failed
+    bool bringUpDevices();
+    // Registers the cadences of the periodic activities for the current power tier
+    void planActivities();
+    [[nodiscard]] bool isDue(WakePlanner::Activity activity) const;
+    // Inner readings and health of the unit for the acknowledgement to the external unit
+    [[nodiscard]] StatusReport makeStatusReport() const;
+    [[nodiscard]] HistoryRecord makeHistoryRecord() const;
+    // Sends the records not uploaded yet over the connected station
+    void uploadHistory();
     static void updateDisplayTask(void* pvParameters);
     [[noreturn]] void updateDisplayTask();
     static void timeSyncTask(void* pvParameters);
@@ -1,7 +1,10 @@
 #include "DustMonitorView.h"
 
+#include "BinaryLog.h"
+#include "EpdFrameWriter.h"
 #include "PersistentStorage.h"
 #include "BufferedOut.h"
+#include "Meteorology.h"
 #include "TimeFunctions.h"
 
 #include "graphics/BaseGeometry.h"
@@ -45,13 +48,18 @@ Canvas paint(image);
 constexpr Point topLeft { 0, 0 };
 constexpr Size displaySize { Epd3in7Display::epdWidth, Epd3in7Display::epdHeight};
 constexpr Size viewAreaSize { displaySize.width - 2 * topLeft.x, displaySize.height - 2 * topLeft.y};
-constexpr uint16_t timeHeight = 50;
+constexpr uint16_t timeHeight = 60;
 constexpr uint16_t fullWidth = displaySize.width - 2 * topLeft.x;
 
 constexpr Rect internalSensorArea = {topLeft, {fullWidth, (uint16_t )(viewAreaSize.height - timeHeight) / 2}};
 constexpr Rect externalSensorArea = internalSensorArea + Size {0, internalSensorArea.size.height};
 constexpr Rect timeArea = {topLeft + Size {0, viewAreaSize.height - timeHeight},
                            { viewAreaSize.width, timeHeight}};
+// The bottom line is split into the inner AQI, the clock and the outer AQI
+constexpr uint16_t bottomCellWidth = viewAreaSize.width / 3;
+constexpr Rect innerAqiArea = {timeArea.topLeft, {bottomCellWidth, timeHeight}};
+constexpr Rect clockArea = innerAqiArea + Size {bottomCellWidth, 0};
+constexpr Rect outerAqiArea = clockArea + Size {bottomCellWidth, 0};
 
 enum class SensorFlags : uint32_t {
     BatteryFailure = 1 << 0,
@@ -134,6 +142,7 @@ void DustMonitorView::updateView()
         paint.setColor((uint32_t)Color::Black);
     }
 
+    drawAirQuality();
     drawTime();
     refreshScreen(needFullRefresh);
 
@@ -142,17 +151,31 @@ void DustMonitorView::updateView()
 
 void DustMonitorView::drawTime() const
 {
-    tm timeInfo = getLocalTime(time(nullptr));
+    tm timeInfo = getLocalTime(secondsNow());
     std::array<char, 20> string {};
     embedded::BufferedOut bufferedOut(string);
     bufferedOut << embedded::BufferedOut::fill{'0'} << embedded::BufferedOut::width {2}
                 << timeInfo.tm_hour << ":"<< embedded::BufferedOut::width {2} << timeInfo.tm_min;
-    displayText(bufferedOut.asStringView(), timeArea);
+    displayText(bufferedOut.asStringView(), clockArea);
+}
+
+void DustMonitorView::drawAirQuality()
+{
+    auto& displayData = storedData.currentDisplayData;
+    displayData.innerData.airQuality = externalViewData.innerData.airQuality;
+    drawAirQualityIndex(innerAqiArea, displayData.innerData.airQuality);
+    AirQualityIndex outerIndex;
+    if (externalViewData.outerData && displayData.outerData)
+    {
+        displayData.outerData->airQuality = externalViewData.outerData->airQuality;
+        outerIndex = displayData.outerData->airQuality;
+    }
+    drawAirQualityIndex(outerAqiArea, outerIndex);
 }
 
 void DustMonitorView::refreshScreen(const bool needFullRefresh)
 {
-    DEBUG_LOG("Updating screen...")
+    TRACE_LOG("Updating screen...")
     bool partialUpdate = false;
     switch (storedData.updateType)
     {
@@ -171,9 +194,9 @@ void DustMonitorView::refreshScreen(const bool needFullRefresh)
             break;
     }
     const auto startTime = microsecondsNow();
-    epd->displayFrame(paint.getImage(), needFullRefresh || !partialUpdate ?
+    frameWriter.displayFrame(*epd, paint.getImage(), needFullRefresh || !partialUpdate ?
         Epd3in7Display::RefreshMode::FullBW : Epd3in7Display::RefreshMode::PartBW);
-    DEBUG_LOG("Update time:" << (microsecondsNow() - startTime) << " us")
+    TRACE_LOG("Update time: {} us", microsecondsNow() - startTime)
     (void)startTime;
 }
 
@@ -198,7 +221,9 @@ void DustMonitorView::updateSensorArea(const Rect& dataArea, SensorData& storedV
     embedded::BufferedOut bufferedOut(string);
 
     storedValue.humidity = newValue.humidity;
-    bufferedOut << embedded::BufferedOut::precision{0} <<storedValue.humidity << "%";
+    storedValue.dewPoint = newValue.dewPoint;
+    bufferedOut << embedded::BufferedOut::precision{0} <<storedValue.humidity << "%/"
+                << storedValue.dewPoint << "\xB0";
     displayText(bufferedOut.asStringView(), humidityArea);
 
     storedValue.temperature = newValue.temperature;
@@ -214,6 +239,8 @@ void DustMonitorView::updateSensorArea(const Rect& dataArea, SensorData& storedV
     bufferedOut.clear();
     bufferedOut << embedded::BufferedOut::precision{0} << storedValue.pressure / 100.f << " hPa";
     displayText(bufferedOut.asStringView(), pressureArea);
+    storedValue.pressureTendency = newValue.pressureTendency;
+    drawTendencyArrow(pressureArea, storedValue.pressureTendency);
 
 
     storedValue.voltage = newValue.voltage;
@@ -244,6 +271,28 @@ void DustMonitorView::updateSensorArea(const Rect& dataArea, SensorData& storedV
     drawPMData(pm10Area, storedValue.pm10);
 }
 
+void DustMonitorView::drawTendencyArrow(const Rect& area, const std::optional<float>& tendency) const
+{
+    if (!tendency)
+    {
+        return;
+    }
+    const auto direction = PressureTrend::classify(*tendency);
+    if (direction == PressureTrend::Tendency::Steady)
+    {
+        return;
+    }
+    constexpr int arrowHeight = 8;
+    const int centerX = area.topLeft.x + arrowHeight;
+    const int topY = area.topLeft.y + (area.size.height - arrowHeight) / 2;
+    for (int row = 0; row < arrowHeight; ++row)
+    {
+        // Rows widen from the tip of the arrow
+        const int halfWidth = direction == PressureTrend::Tendency::Rising ? row : arrowHeight - 1 - row;
+        paint.drawFilledRectangle(Rect { Point { centerX - halfWidth, topY + row }, Size { 2 * halfWidth + 1, 1 } });
+    }
+}
+
 void
 DustMonitorView::drawPMData(const Rect& pm01Area, int value) const
 {
@@ -260,6 +309,26 @@ DustMonitorView::drawPMData(const Rect& pm01Area, int value) const
     }
 }
 
+void DustMonitorView::drawAirQualityIndex(const Rect& area, const AirQualityIndex& index) const
+{
+    // The US AQI above its category and the European level, e.g. "USG 4"
+    const Size halfSize {area.size.width, area.size.height / 2};
+    const Rect valueArea {area.topLeft, halfSize};
+    const Rect categoryArea = valueArea + Size {0, halfSize.height};
+    drawPMData(valueArea, index.usAqi);
+    std::array<char, 20> string {};
+    embedded::BufferedOut bufferedOut(string);
+    if (index.usAqi >= 0)
+    {
+        bufferedOut << aqi::usCategory(index.usAqi);
+        if (index.euLevel != 0)
+        {
+            bufferedOut << " " << static_cast<int>(index.euLevel);
+        }
+    }
+    displayText(bufferedOut.asStringView(), categoryArea);
+}
+
 void DustMonitorView::hibernate() const
 {
     if (storedData.updateType == UpdateType::DeepSleep)
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "AirQuality.h"
+#include "ParticleData.h"
+
 #include <optional>
 #include <string_view>
 #include <cstdint>
@@ -14,12 +17,17 @@ struct SensorData
     int pm10 = -1;
     float voltage = 0;
     uint32_t flags = 0;
+    AirQualityIndex airQuality;
+    float dewPoint = 0;
+    // Pressure change over 3 hours in hPa
+    std::optional<float> pressureTendency;
 };
 
 struct DustMonitorViewData
 {
     SensorData innerData;
     std::optional<SensorData> outerData;
+    std::optional<ParticleData> innerParticles;
 };
 
 namespace embedded
@@ -31,11 +39,15 @@ class PersistentStorage;
 class EpdInterface;
 }
 
+class EpdFrameWriter;
+
 class DustMonitorView
 {
 public:
-    DustMonitorView(embedded::PersistentStorage& storage, embedded::EpdInterface &epdInterface, const DustMonitorViewData& dustMoinitorViewData)
-            : storage(storage), epdInterface(epdInterface), externalViewData(dustMoinitorViewData) {}
+    DustMonitorView(embedded::PersistentStorage& storage, embedded::EpdInterface &epdInterface,
+                    EpdFrameWriter& frameWriter, const DustMonitorViewData& dustMoinitorViewData)
+            : storage(storage), epdInterface(epdInterface), frameWriter(frameWriter)
+            , externalViewData(dustMoinitorViewData) {}
 
     bool setup(bool wakeUp);
 
@@ -62,12 +74,16 @@ private:
     void updateSensorArea(const embedded::Rect<int>& dataArea, SensorData& storedValue, const SensorData& newValue) const;
     void displayText(std::string_view textString, const embedded::Rect<int>& rectArea) const;
     void drawPMData(const embedded::Rect<int>& pm01Area, int value) const;
+    void drawAirQualityIndex(const embedded::Rect<int>& area, const AirQualityIndex& index) const;
+    void drawTendencyArrow(const embedded::Rect<int>& area, const std::optional<float>& tendency) const;
 
     embedded::PersistentStorage& storage;
     embedded::EpdInterface& epdInterface;
+    EpdFrameWriter& frameWriter;
     const DustMonitorViewData& externalViewData;
     StoredData storedData;
 
     void drawTime() const;
+    void drawAirQuality();
     void refreshScreen(bool needFullRefresh);
 };
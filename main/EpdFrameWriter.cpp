@@ -0,0 +1,76 @@
+#include "EpdFrameWriter.h"
+
+#include "display/EpdInterface.h"
+
+#include <cstring>
+
+#include "Debug.h"
+
+using embedded::Epd3in7Display;
+
+namespace
+{
+// Commands of the SSD1677 controller of the panel
+constexpr uint8_t masterActivationCommand = 0x20;
+constexpr uint8_t updateControlCommand = 0x22;
+constexpr uint8_t writeRamCommand = 0x24;
+constexpr uint8_t ramXCounterCommand = 0x4E;
+constexpr uint8_t ramYCounterCommand = 0x4F;
+// Clock, analog, temperature load, display with the mode 1 or the mode 2 of the partial refresh
+constexpr uint8_t fullUpdateSequence = 0xC7;
+constexpr uint8_t partialUpdateSequence = 0xCF;
+
+size_t copyFrame(void* context, size_t offset, uint8_t* buffer, size_t size)
+{
+    const auto& image = *static_cast<const Image*>(context);
+    std::memcpy(buffer, image.getData() + offset, size);
+    return size;
+}
+}
+
+EpdFrameWriter::EpdFrameWriter(embedded::EpdInterface& epdInterface, SpiDmaStream& stream,
+                               const embedded::GpioPinDefinition& dataCommand,
+                               const embedded::GpioPinDefinition& chipSelect)
+    : epdInterface(epdInterface)
+    , stream(stream)
+    , dataCommandPin(dataCommand)
+    , chipSelectPin(chipSelect)
+{
+}
+
+bool EpdFrameWriter::displayFrame(Epd3in7Display& display, const Image& image, Epd3in7Display::RefreshMode mode)
+{
+    if (!stream.init())
+    {
+        return display.displayFrame(image, mode);
+    }
+    if (!display.waitUntilIdle())
+    {
+        return false;
+    }
+    epdInterface.sendCommand(ramXCounterCommand);
+    epdInterface.sendData(0x00);
+    epdInterface.sendData(0x00);
+    epdInterface.sendCommand(ramYCounterCommand);
+    epdInterface.sendData(0x00);
+    epdInterface.sendData(0x00);
+    epdInterface.sendCommand(writeRamCommand);
+    if (!streamFrame(image))
+    {
+        DEBUG_LOG("Failed to stream the frame")
+        return false;
+    }
+    epdInterface.sendCommand(updateControlCommand);
+    epdInterface.sendData(mode == Epd3in7Display::RefreshMode::PartBW ? partialUpdateSequence : fullUpdateSequence);
+    epdInterface.sendCommand(masterActivationCommand);
+    return true;
+}
+
+bool EpdFrameWriter::streamFrame(const Image& image)
+{
+    dataCommandPin.set();
+    chipSelectPin.reset();
+    const bool success = stream.write(image.getSize(), &copyFrame, const_cast<Image*>(&image));
+    chipSelectPin.set();
+    return success;
+}
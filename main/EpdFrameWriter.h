@@ -0,0 +1,35 @@
+#pragma once
+
+#include "SpiDmaStream.h"
+
+#include "display/Epd3in7Display.h"
+#include "esp32-esp-idf/GpioPinDefinition.h"
+
+class Image;
+
+namespace embedded
+{
+class EpdInterface;
+}
+
+// Frame write of the 3.7 inch panel with the RAM data sent by SpiDmaStream instead of the polling writes of the
+// display driver. The commands go through the EPD interface, the data/command and chip select pins are driven here
+// while the frame is streamed. The driver writes the frame itself when the stream can't be set up.
+class EpdFrameWriter
+{
+public:
+    EpdFrameWriter(embedded::EpdInterface& epdInterface, SpiDmaStream& stream,
+                   const embedded::GpioPinDefinition& dataCommand, const embedded::GpioPinDefinition& chipSelect);
+
+    // The sequence of Epd3in7Display::displayFrame: the RAM address, the frame and the refresh of the mode
+    bool displayFrame(embedded::Epd3in7Display& display, const Image& image,
+                      embedded::Epd3in7Display::RefreshMode mode);
+
+private:
+    bool streamFrame(const Image& image);
+
+    embedded::EpdInterface& epdInterface;
+    SpiDmaStream& stream;
+    embedded::GpioDigitalPin dataCommandPin;
+    embedded::GpioDigitalPin chipSelectPin;
+};
@@ -0,0 +1,110 @@
+#include "EspNowRadio.h"
+#include "WiFiManager.h"
+
+#include <cstring>
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+#include "Debug.h"
+
+namespace
+{
+EspNowRadio* activeRadio = nullptr;
+}
+
+struct EspNowRadioCallbacks
+{
+#if __GNUC__ >= 9
+    static void onDataRecv(const esp_now_recv_info_t* esp_now_info, const uint8_t* incomingData, int len)
+    {
+        RadioInterface::ReceiveInfo info;
+        std::copy(esp_now_info->src_addr, esp_now_info->src_addr + info.source.size(), info.source.begin());
+        info.rssi = static_cast<int8_t>(esp_now_info->rx_ctrl->rssi);
+#else
+    static void onDataRecv(const uint8_t* mac, const uint8_t* incomingData, int len)
+    {
+        RadioInterface::ReceiveInfo info;
+        std::copy(mac, mac + info.source.size(), info.source.begin());
+#endif
+        if (activeRadio && activeRadio->receiveCallback && len >= 0)
+        {
+            activeRadio->receiveCallback(activeRadio->callbackContext, info, incomingData, len);
+        }
+    }
+
+    static void onDataSend(const uint8_t* macAddr, esp_now_send_status_t status)
+    {
+        if (activeRadio && activeRadio->sendCallback)
+        {
+            RadioInterface::MacAddress destination;
+            std::copy(macAddr, macAddr + destination.size(), destination.begin());
+            activeRadio->sendCallback(activeRadio->callbackContext, destination, status == ESP_NOW_SEND_SUCCESS);
+        }
+    }
+};
+
+bool EspNowRadio::init()
+{
+    if (WiFiManager::startWiFi() && esp_now_init() != ESP_OK)
+    {
+        DEBUG_LOG("Error initializing ESP-NOW")
+        return false;
+    }
+    activeRadio = this;
+    if (!initialized)
+    {
+        radioLock.acquire();
+    }
+    initialized = true;
+    return true;
+}
+
+void EspNowRadio::deinit()
+{
+    esp_now_deinit();
+    WiFiManager::stopWiFi();
+    if (initialized)
+    {
+        radioLock.release();
+    }
+    initialized = false;
+    if (activeRadio == this)
+    {
+        activeRadio = nullptr;
+    }
+}
+
+bool EspNowRadio::addPeer(const MacAddress& macAddress)
+{
+    esp_now_peer_info_t peerInfo;
+    std::memset(&peerInfo, 0, sizeof(peerInfo));
+    std::memcpy(peerInfo.peer_addr, macAddress.begin(), macAddress.size());
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    peerInfo.ifidx = WIFI_IF_STA;
+    return esp_now_add_peer(&peerInfo) == ESP_OK;
+}
+
+bool EspNowRadio::send(const MacAddress& destination, const uint8_t* data, size_t size)
+{
+    return initialized && esp_now_send(destination.begin(), data, size) == ESP_OK;
+}
+
+bool EspNowRadio::setCallbacks(void* context, ReceiveCallback onReceive, SendCallback onSend)
+{
+    callbackContext = context;
+    receiveCallback = onReceive;
+    sendCallback = onSend;
+    return esp_now_register_recv_cb(&EspNowRadioCallbacks::onDataRecv) == ESP_OK &&
+           esp_now_register_send_cb(&EspNowRadioCallbacks::onDataSend) == ESP_OK;
+}
+
+bool EspNowRadio::setChannel(uint8_t channel)
+{
+    return initialized && esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) == ESP_OK;
+}
+
+uint8_t EspNowRadio::getChannel() const
+{
+    return WiFiManager::getChannel().value_or(0);
+}
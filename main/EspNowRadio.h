@@ -0,0 +1,29 @@
+#pragma once
+
+#include "PowerManagement.h"
+#include "RadioInterface.h"
+
+// ESP-NOW implementation of the radio interface. ESP-NOW callbacks have no user context,
+// so only one instance may be initialized at a time.
+class EspNowRadio : public RadioInterface
+{
+public:
+    bool init() override;
+    void deinit() override;
+    bool addPeer(const MacAddress& macAddress) override;
+    bool send(const MacAddress& destination, const uint8_t* data, size_t size) override;
+    bool setCallbacks(void* context, ReceiveCallback onReceive, SendCallback onSend) override;
+    // Fails while the station is connected, the radio follows the access point then
+    bool setChannel(uint8_t channel) override;
+    [[nodiscard]] uint8_t getChannel() const override;
+
+private:
+    void* callbackContext = nullptr;
+    ReceiveCallback receiveCallback = nullptr;
+    SendCallback sendCallback = nullptr;
+    bool initialized = false;
+    // The peer's message may come at any time of the listening window, whatever the power save of Wi-Fi
+    PowerLock radioLock {"esp_now"};
+
+    friend struct EspNowRadioCallbacks;
+};
@@ -1,11 +1,17 @@
 #include "EspNowTransport.h"
-#include "WiFiManager.h"
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstring>
-#include <esp_now.h>
+#if __has_include(<esp_random.h>)
+#include <esp_random.h>
+#else
+#include <esp_system.h>
+#endif
 #include <memory>
 
+#include "BinaryLog.h"
 #include "Debug.h"
 #include "TimeFunctions.h"
 #include "PersistentStorage.h"
@@ -13,6 +19,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <variant>
 
 namespace
@@ -21,146 +28,292 @@ namespace
 struct TransportData
 {
     std::array<uint8_t, 6> remoteMac;
+    LinkStatistics linkStatistics;
+    ChannelPlan channelPlan;
+    uint32_t lastSequence;
+    int64_t lastTimestamp;
 };
 
-struct CorrectionMessage
-{
-    int64_t currentMicroseconds;
-    int64_t receiveMicroseconds;
-};
+// Upper limit of the time spent on the acknowledgement retries within one wake. With the backoff of LinkStatistics
+// it delivers 99.5 % at 50 % loss and 93 % at 70 %, a longer one gains little and the external unit repeats the
+// message which isn't acknowledged anyway (see LinkStatisticsTest)
+constexpr int64_t retryBudgetMicroseconds = 300000;
+// The radio stays up after the delivery for the history request the external unit sends on the acknowledgement. The
+// cost of this delay and of the resend timeout is measured by the simulator with --external-listen (see README)
+constexpr int64_t powerDownDelayMicroseconds = 30000;
+// The request or its answer lost is asked again, the external unit not listening answers none of them
+constexpr int64_t resendTimeoutMicroseconds = 50000;
+constexpr uint8_t maxResendRequests = 3;
 
-union
-{
-    CorrectionMessage correctionMessage;
-    std::array<uint8_t, sizeof(correctionMessage)> bytes;
-} correctionData;
+enum class EventType {SendCallback, ReceiveCallback, HistoryCallback, ResendRequest, Exit};
 
-enum class EventType {SendCallback, ReceiveCallback, Exit};
+// Request or acknowledgement of the history transfer
+struct HistoryMessage
+{
+    std::array<uint8_t, history_transfer::maxControlSize> data;
+    uint8_t size;
+};
 
 struct EventData
 {
     EventType type = EventType::Exit;
     std::array<uint8_t, 6> macAddr = {};
-    std::variant<int64_t, esp_now_send_status_t> data;
+    int8_t rssi = 0;
+    uint32_t sequence = 0;
+    uint32_t flags = 0;
+    int64_t timestamp = 0;
+    std::variant<int64_t, bool, HistoryMessage> data;
 };
 
-constexpr std::string_view transportDataTag = "ESPN";
-EspNowTransport::DataMessage measurementDataMessage;
-auto espnowQueue = std::unique_ptr<std::remove_pointer_t<QueueHandle_t>, decltype(&vQueueDelete)>(nullptr, &vQueueDelete);
+EspNowTransport::SequenceStatistics sequenceStatistics;
 
-using macValue = std::array<uint8_t, 6>;
-std::optional<macValue> remoteMac;
+constexpr std::string_view transportDataTag = "ESPN";
 
-bool addPeer(const std::array<uint8_t,6>& macAddr)
+void espnowTask(void *pvParameter)
 {
-    esp_now_peer_info_t peerInfo;
-    std::memset(&peerInfo, 0, sizeof(peerInfo));
-    std::memcpy(peerInfo.peer_addr, macAddr.begin(), macAddr.size());
-    peerInfo.channel = 0;
-    peerInfo.encrypt = false;
-    peerInfo.ifidx = WIFI_IF_STA;
-    return esp_now_add_peer(&peerInfo) == ESP_OK;
+    auto* transport = reinterpret_cast<EspNowTransport*>(pvParameter);
+    transport->threadFunction();
 }
 
-#if __GNUC__ >= 9
-void onDataRecv(const esp_now_recv_info_t * esp_now_info, const uint8_t *incomingData, int len)
-{
-    const auto mac = esp_now_info->src_addr;
-#else
-void onDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len)
+const EventBits_t DATA_RECEIVED_BIT = BIT1;
+}
+
+void EspNowTransport::onReceive(void* context, const RadioInterface::ReceiveInfo& info, const uint8_t* data, size_t size)
 {
-#endif
+    reinterpret_cast<EspNowTransport*>(context)->onReceive(info, data, size);
+}
 
-    if (len != sizeof(EspNowTransport::DataMessage))
+void EspNowTransport::onReceive(const RadioInterface::ReceiveInfo& info, const uint8_t* incomingData, size_t len)
+{
+    if (history_transfer::messageType(incomingData, len))
     {
-        DEBUG_LOG("Received " << len << " bytes, expected " << (int)sizeof(EspNowTransport::DataMessage) << " bytes")
+        // Only the known peer may pull the history
+        if (!remoteMac || *remoteMac != info.source || len > history_transfer::maxControlSize)
+        {
+            TRACE_LOG("History message of {} bytes from {} ignored", len, info.source)
+            return;
+        }
+        HistoryMessage message {};
+        std::memcpy(message.data.data(), incomingData, len);
+        message.size = static_cast<uint8_t>(len);
+        EventData evt;
+        evt.type = EventType::HistoryCallback;
+        evt.macAddr = info.source;
+        evt.data = message;
+        xQueueSend(espnowQueue.get(), &evt, portMAX_DELAY);
+        return;
+    }
+    if (isResendRequest(incomingData, len))
+    {
+        // Only the external unit answers the requests
+        return;
+    }
+    if (len != sizeof(DataMessage))
+    {
+        TRACE_LOG("Received {} bytes, expected {} bytes", len, sizeof(DataMessage))
         return;
     }
-    correctionData.correctionMessage.receiveMicroseconds = microsecondsNow();
+    correctionMessage.receiveMicroseconds = microsecondsNow();
 
     if (!remoteMac)
     {
-        remoteMac.emplace();
-        std::copy(mac, mac + remoteMac->size(), remoteMac->begin());
+        remoteMac.emplace(info.source);
     }
-    if (std::memcmp(remoteMac->begin(), mac, remoteMac->size()) == 0)
+    if (*remoteMac == info.source)
     {
         memcpy(&measurementDataMessage, incomingData, len);
         EventData evt;
         evt.type = EventType::ReceiveCallback;
-        memcpy(evt.macAddr.begin(), mac, evt.macAddr.size());
-        evt.data = correctionData.correctionMessage.receiveMicroseconds;
+        evt.macAddr = info.source;
+        evt.rssi = info.rssi;
+        // The first version left the sequence as indeterminate padding
+        const bool sequenced = (measurementDataMessage.flags & DataMessage::sequencedFlag) != 0;
+        evt.sequence = sequenced ? measurementDataMessage.sequence : 0;
+        evt.flags = measurementDataMessage.flags;
+        evt.timestamp = measurementDataMessage.timestamp;
+        evt.data = correctionMessage.receiveMicroseconds;
         xQueueSend(espnowQueue.get(), &evt, portMAX_DELAY);
     }
     else
     {
-        DEBUG_LOG("Received data from unknown peer")
+        TRACE_LOG("Received data from unknown peer {}", info.source)
     }
 }
 
-void onDataSend(const uint8_t* macAddr, esp_now_send_status_t status) {
+void EspNowTransport::onSend(void* context, const RadioInterface::MacAddress& destination, bool delivered)
+{
+    auto* transport = reinterpret_cast<EspNowTransport*>(context);
     EventData evt;
     evt.type = EventType::SendCallback;
-    memcpy(evt.macAddr.begin(), macAddr, evt.macAddr.size());
-    evt.data = status;
-    xQueueSend(espnowQueue.get(), &evt, portMAX_DELAY);
+    evt.macAddr = destination;
+    evt.data = delivered;
+    xQueueSend(transport->espnowQueue.get(), &evt, portMAX_DELAY);
 }
 
-void espnowTask(void *pvParameter)
+bool EspNowTransport::sendHistory(void* context, const uint8_t* data, size_t size)
 {
-    auto* transport = reinterpret_cast<EspNowTransport*>(pvParameter);
-    transport->threadFunction();
-}
-
-const EventBits_t DATA_RECEIVED_BIT = BIT1;
+    return reinterpret_cast<EspNowTransport*>(context)->sendPacket(data, size, PacketKind::HistoryChunk);
 }
 
 void EspNowTransport::threadFunction()
 {
+    constexpr int64_t historyTimeoutMicroseconds =
+        history_transfer::HistorySender::retransmissionTimeoutMilliseconds * 1000;
     EventData evt;
-    while (xQueueReceive(espnowQueue.get(), &evt, portMAX_DELAY) == pdTRUE) {
+    // The silence of the requester during the history transfer is a timeout of the sender
+    int64_t historyTime = 0;
+    while (true) {
+        // Every expired deadline is serviced on each pass so the history transfer doesn't starve the delivery, the
+        // planned power-down waits for the end of the transfer
+        auto now = Clock::instance().monotonicMicroseconds();
+        if (historySender.isActive() && now >= historyTime)
+        {
+            historySender.onTimeout();
+            historyTime = now + historyTimeoutMicroseconds;
+        }
+        if (retryTime && now >= *retryTime)
+        {
+            retryTime.reset();
+            if (!sendResponce())
+            {
+                completeDelivery(false);
+            }
+        }
+        if (resendTime && now >= *resendTime)
+        {
+            resendTime.reset();
+            if (!peerHeard)
+            {
+                sendResendRequest();
+            }
+        }
+        if (!historySender.isActive() && powerDownTime && now >= *powerDownTime)
+        {
+            powerDownTime.reset();
+            if (powerDown(powerDownSession))
+            {
+                ++sequenceStatistics.earlyPowerDowns;
+                TRACE_LOG("Radio powered down after the delivery")
+            }
+        }
+
+        auto deadline = historySender.isActive() ? std::optional<int64_t>(historyTime) : powerDownTime;
+        for (const auto& time : {resendTime, retryTime})
+        {
+            if (time && (!deadline || *time < *deadline))
+            {
+                deadline = time;
+            }
+        }
+        auto timeout = portMAX_DELAY;
+        if (deadline)
+        {
+            now = Clock::instance().monotonicMicroseconds();
+            const auto left = std::max<int64_t>(0, *deadline - now);
+            timeout = static_cast<TickType_t>(left / 1000 / portTICK_PERIOD_MS + 1);
+        }
+        if (xQueueReceive(espnowQueue.get(), &evt, timeout) != pdTRUE)
+        {
+            continue;
+        }
         switch (evt.type) {
             case EventType::SendCallback:
-                if (std::holds_alternative<esp_now_send_status_t>(evt.data))
+            {
+                if (!std::holds_alternative<bool>(evt.data))
+                {
+                    break;
+                }
+                const auto kind = takeSentPacket().value_or(PacketKind::Acknowledgement);
+                if (kind == PacketKind::HistoryChunk)
+                {
+                    historySender.onSent(std::get<bool>(evt.data));
+                    historyTime = Clock::instance().monotonicMicroseconds() + historyTimeoutMicroseconds;
+                }
+                else if (kind == PacketKind::ResendRequest)
                 {
-                    if (const auto status = std::get<esp_now_send_status_t>(evt.data); status != ESP_NOW_SEND_SUCCESS)
+                    // The external unit not listening sends its message in its period anyway
+                    if (std::get<bool>(evt.data))
                     {
-                        DEBUG_LOG("Last Packet delivery to " << embedded::BytesView(evt.macAddr) << " fail")
-                        if (attemptsCounter < maxAttempts)
-                        {
-                            DEBUG_LOG("Retrying to send packet to " << embedded::BytesView(evt.macAddr) << " attempt " << (attemptsCounter + 1))
-                            if (!sendResponce())
-                            {
-                                DEBUG_LOG("Error sending packet to " << embedded::BytesView(evt.macAddr))
-                                externalEvent.set();
-                            }
-                        }
-                        else
+                        ++sequenceStatistics.requestsDelivered;
+                    }
+                }
+                else
+                {
+                    if (const auto delivered = std::get<bool>(evt.data); !delivered)
+                    {
+                        TRACE_LOG("Last packet delivery to {} failed", evt.macAddr)
+                        if (!retryResponce())
                         {
-                            DEBUG_LOG("Max delivery attempts to " << embedded::BytesView(evt.macAddr) << " reached")
-                            externalEvent.set();
+                            TRACE_LOG("Delivery to {} abandoned after {} attempts", evt.macAddr, attemptsCounter)
+                            completeDelivery(false);
                         }
                     }
                     else
                     {
-                        DEBUG_LOG("Last packet successfully sent to " << embedded::BytesView(evt.macAddr) << " from " << attemptsCounter << " attempt")
-                        externalEvent.set();
-                        attemptsCounter = 0;
+                        TRACE_LOG("Last packet successfully sent to {} from {} attempt", evt.macAddr, attemptsCounter)
+                        channelPlan.registerAnnouncementDelivered(correctionMessage.channel);
+                        completeDelivery(true);
                     }
                 }
                 break;
+            }
             case EventType::ReceiveCallback:
                 if (std::holds_alternative<int64_t>(evt.data))
                 {
                     if (!isPeerInfoUpdated)
                     {
-                        addPeer(*remoteMac);
+                        radio.addPeer(*remoteMac);
                         isPeerInfoUpdated = true;
                     }
-                    xEventGroupSetBits(wifiEventGroup.get(), DATA_RECEIVED_BIT);
+                    if (evt.rssi != 0)
+                    {
+                        linkStatistics.registerRssi(evt.rssi);
+                    }
+                    channelPlan.registerPeerHeard(radio.getChannel());
+                    peerHeard = true;
+                    peerDecodesStatus = (evt.flags & DataMessage::statusReportFlag) != 0;
+                    if (evt.sequence != 0 && evt.sequence == lastSequence && evt.timestamp == lastTimestamp)
+                    {
+                        // The external unit repeated the message, it's acknowledged again to stop the repetitions
+                        ++sequenceStatistics.duplicates;
+                        TRACE_LOG("Message {} from {} received again", evt.sequence, evt.macAddr)
+                    }
+                    else
+                    {
+                        ++sequenceStatistics.freshMessages;
+                        lastSequence = evt.sequence;
+                        lastTimestamp = evt.timestamp;
+                        xEventGroupSetBits(wifiEventGroup.get(), DATA_RECEIVED_BIT);
+                    }
+                    // The acknowledgement of the repeated message takes the place of the planned retry
+                    retryTime.reset();
                     sendResponce();
                 }
                 break;
+            case EventType::HistoryCallback:
+                if (std::holds_alternative<HistoryMessage>(evt.data))
+                {
+                    const auto& message = std::get<HistoryMessage>(evt.data);
+                    historyTime = Clock::instance().monotonicMicroseconds() + historyTimeoutMicroseconds;
+                    if (history_transfer::messageType(message.data.data(), message.size)
+                        == history_transfer::MessageType::Request)
+                    {
+                        historySender.onRequest(message.data.data(), message.size);
+                    }
+                    else
+                    {
+                        historySender.onAcknowledgement(message.data.data(), message.size);
+                    }
+                }
+                break;
+            case EventType::ResendRequest:
+                // A message received since init() makes the request needless
+                resendRequestsSent = 0;
+                if (!peerHeard)
+                {
+                    sendResendRequest();
+                }
+                break;
             case EventType::Exit:
                 return;
         }
@@ -173,6 +326,10 @@ bool EspNowTransport::setup(bool /*wakeup*/)
     {
         remoteMac.emplace();
         std::copy(data->remoteMac.begin(), data->remoteMac.end(), remoteMac->begin());
+        linkStatistics = data->linkStatistics;
+        channelPlan = data->channelPlan;
+        lastSequence = data->lastSequence;
+        lastTimestamp = data->lastTimestamp;
         DEBUG_LOG("Peer mac address loaded: " << data->remoteMac)
     }
     espnowQueue.reset(xQueueCreate(6, sizeof(EventData)));
@@ -184,23 +341,50 @@ bool EspNowTransport::setup(bool /*wakeup*/)
 bool EspNowTransport::init(GroupBitView event)
 {
     externalEvent = event;
-    if (WiFiManager::startWiFi() && esp_now_init() != ESP_OK)
+    xSemaphoreTake(radioMutex.get(), portMAX_DELAY);
+    ++radioSession;
+    radioPowered = true;
+    const bool initialized = radio.init();
+    xSemaphoreGive(radioMutex.get());
+    if (!initialized)
     {
-        DEBUG_LOG("Error initializing ESP-NOW")
         return false;
     }
+    if (const auto channel = channelPlan.channelForWake(); channel != ChannelPlan::unknownChannel)
+    {
+        if (!radio.setChannel(channel))
+        {
+            DEBUG_LOG("Failed to switch to channel " << (int)channel)
+        }
+        else if (channelPlan.isSearching())
+        {
+            DEBUG_LOG("External unit is silent for " << (int)channelPlan.missedWakes << " wakes, trying channel "
+                      << (int)channel)
+        }
+    }
+    listening = true;
 
     if (remoteMac)
     {
-        if (!addPeer(*remoteMac))
+        if (!radio.addPeer(*remoteMac))
         {
             DEBUG_LOG("Error adding peer")
             return false;
         }
         isPeerInfoUpdated = true;
     }
-    return esp_now_register_recv_cb(onDataRecv) == ESP_OK &&
-        esp_now_register_send_cb(onDataSend) == ESP_OK;
+    if (!radio.setCallbacks(this, &EspNowTransport::onReceive, &EspNowTransport::onSend))
+    {
+        return false;
+    }
+    if (remoteMac && !peerHeard)
+    {
+        // The sends are left to the transport task
+        EventData evt;
+        evt.type = EventType::ResendRequest;
+        xQueueSend(espnowQueue.get(), &evt, portMAX_DELAY);
+    }
+    return true;
 }
 
 std::optional<EspNowTransport::DataMessage> EspNowTransport::getLastMessage(uint32_t timeoutMilliseconds) const
@@ -214,24 +398,172 @@ std::optional<EspNowTransport::DataMessage> EspNowTransport::getLastMessage(uint
 
 bool EspNowTransport::sendResponce()
 {
-    correctionData.correctionMessage.currentMicroseconds = microsecondsNow();
-    ++attemptsCounter;
-    return esp_now_send(remoteMac->begin(), correctionData.bytes.begin(), correctionData.bytes.size()) == ESP_OK;
+    correctionMessage.currentMicroseconds = microsecondsNow();
+    correctionMessage.channel = channelPlan.channelToAnnounce();
+    correctionMessage.statusVersion = StatusReport::currentVersion;
+    auto& status = correctionMessage.status;
+    status.deliveredCount = linkStatistics.deliveredCount;
+    status.failedCount = linkStatistics.failedCount;
+    status.deliveryRatio = linkStatistics.deliveryRatio;
+    status.lastRssi = linkStatistics.lastRssi;
+    if (attemptsCounter++ == 0)
+    {
+        deliveryStartTime = Clock::instance().monotonicMicroseconds();
+    }
+    const auto size = peerDecodesStatus ? sizeof(correctionMessage) : CorrectionMessage::firstVersionSize;
+    return sendPacket(reinterpret_cast<const uint8_t*>(&correctionMessage), size, PacketKind::Acknowledgement);
 }
 
-void EspNowTransport::hibernate() const
+void EspNowTransport::sendResendRequest()
 {
-    esp_now_deinit();
-    WiFiManager::stopWiFi();
+    ResendRequest request;
+    request.lastSequence = lastSequence;
+    if (sendPacket(reinterpret_cast<const uint8_t*>(&request), sizeof(request), PacketKind::ResendRequest))
+    {
+        ++sequenceStatistics.resendRequests;
+        TRACE_LOG("Requested the message after {}", lastSequence)
+    }
+    if (++resendRequestsSent < maxResendRequests)
+    {
+        resendTime = Clock::instance().monotonicMicroseconds() + resendTimeoutMicroseconds;
+    }
+}
+
+bool EspNowTransport::sendPacket(const uint8_t* data, size_t size, PacketKind kind)
+{
+    if (!remoteMac || sendsInFlight == maxSendsInFlight || !radio.send(*remoteMac, data, size))
+    {
+        return false;
+    }
+    sendKinds[(firstSend + sendsInFlight) % maxSendsInFlight] = kind;
+    ++sendsInFlight;
+    return true;
+}
+
+std::optional<EspNowTransport::PacketKind> EspNowTransport::takeSentPacket()
+{
+    if (sendsInFlight == 0)
+    {
+        return std::nullopt;
+    }
+    const auto kind = sendKinds[firstSend];
+    firstSend = static_cast<uint8_t>((firstSend + 1) % maxSendsInFlight);
+    --sendsInFlight;
+    return kind;
+}
+
+std::optional<EspNowTransport::CorrectionMessage> EspNowTransport::parseCorrection(const uint8_t* data, size_t size)
+{
+    constexpr auto channelEnd = offsetof(CorrectionMessage, channel) + sizeof(CorrectionMessage::channel);
+    constexpr auto statusEnd = offsetof(CorrectionMessage, status) + sizeof(StatusReport);
+    if (size < channelEnd)
+    {
+        return std::nullopt;
+    }
+    CorrectionMessage message {};
+    // The fields appended by the later versions are skipped
+    std::memcpy(&message, data, std::min(size, sizeof(message)));
+    if (size < statusEnd || message.statusVersion == 0)
+    {
+        message.statusVersion = 0;
+        message.status = StatusReport {};
+    }
+    return message;
+}
+
+bool EspNowTransport::isResendRequest(const uint8_t* data, size_t size)
+{
+    return size == sizeof(ResendRequest) && data[0] == ResendRequest {}.magic[0] && data[1] == ResendRequest {}.magic[1];
+}
+
+EspNowTransport::SequenceStatistics EspNowTransport::getSequenceStatistics()
+{
+    return sequenceStatistics;
+}
+
+bool EspNowTransport::retryResponce()
+{
+    if (attemptsCounter >= linkStatistics.attemptsLimit())
+    {
+        DEBUG_LOG("Attempts limit " << linkStatistics.attemptsLimit() << " reached")
+        return false;
+    }
+    const auto delayMs = LinkStatistics::backoffDelayMs(attemptsCounter, esp_random());
+    const auto elapsed = Clock::instance().monotonicMicroseconds() - deliveryStartTime;
+    if (retryTimeSpent + elapsed + delayMs * 1000ll > retryBudgetMicroseconds)
+    {
+        DEBUG_LOG("Retry time budget exhausted")
+        return false;
+    }
+    // The thread keeps serving the queue during the backoff, the retry is sent on its timeout
+    retryTime = Clock::instance().monotonicMicroseconds() + delayMs * 1000ll;
+    TRACE_LOG("Retrying to send packet, attempt {} in {} ms", attemptsCounter + 1, delayMs)
+    return true;
+}
+
+void EspNowTransport::completeDelivery(bool delivered)
+{
+    retryTimeSpent += Clock::instance().monotonicMicroseconds() - deliveryStartTime;
+    linkStatistics.registerResult(attemptsCounter, delivered);
+    attemptsCounter = 0;
+    if (delivered)
+    {
+        // The session is taken before the event lets the other tasks call init() again
+        powerDownTime = Clock::instance().monotonicMicroseconds() + powerDownDelayMicroseconds;
+        powerDownSession = radioSession;
+    }
+    externalEvent.set();
+}
+
+bool EspNowTransport::powerDown(std::optional<uint32_t> session)
+{
+    xSemaphoreTake(radioMutex.get(), portMAX_DELAY);
+    const bool powered = radioPowered && (!session || *session == radioSession);
+    if (powered)
+    {
+        radio.deinit();
+        radioPowered = false;
+    }
+    xSemaphoreGive(radioMutex.get());
+    return powered;
+}
+
+void EspNowTransport::hibernate()
+{
+    // A wake is counted as missed once, the external unit heard later in the same wake resets the count anyway
+    if (listening && !wakeRegistered)
+    {
+        if (!peerHeard)
+        {
+            channelPlan.registerWakeWithoutPeer();
+        }
+        wakeRegistered = true;
+    }
+    listening = false;
+    powerDown(std::nullopt);
+    DEBUG_LOG("Link statistics: delivered " << linkStatistics.deliveredCount << ", failed " << linkStatistics.failedCount
+              << ", ratio " << embedded::BufferedOut::precision { 2 } << linkStatistics.getDeliveryRatio()
+              << ", RSSI " << (int)linkStatistics.lastRssi)
+    if (const auto& history = historySender.getStatistics(); history.sessions != 0)
+    {
+        DEBUG_LOG("History transfer: sessions " << history.sessions << ", completed " << history.completed
+                  << ", chunks " << history.chunks << ", retransmitted " << history.retransmissions
+                  << ", records " << history.records)
+    }
     if (remoteMac)
     {
-        storage.set(transportDataTag, TransportData{ *remoteMac });
+        storage.set(transportDataTag, TransportData{ *remoteMac, linkStatistics, channelPlan, lastSequence,
+                                                     lastTimestamp });
     }
 }
 
-EspNowTransport::EspNowTransport(embedded::PersistentStorage& storage, WiFiManager &wifiManager)
+EspNowTransport::EspNowTransport(embedded::PersistentStorage& storage, RadioInterface& radio,
+                                 const ReadingHistory& history)
     : storage(storage)
-    , wifiManager(wifiManager)
+    , radio(radio)
     , wifiEventGroup { nullptr, vEventGroupDelete}
+    , espnowQueue { nullptr, vQueueDelete }
+    , radioMutex { xSemaphoreCreateMutex(), vQueueDelete }
+    , historySender(history, &EspNowTransport::sendHistory, this)
 {
 }
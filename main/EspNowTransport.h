@@ -1,16 +1,23 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <memory>
+#include "ChannelPlan.h"
 #include "GroupBitView.h"
+#include "HistoryTransfer.h"
+#include "LinkStatistics.h"
+#include "RadioInterface.h"
+#include "StatusReport.h"
+
+#include <freertos/queue.h>
 
 namespace embedded
 {
     class PersistentStorage;
 }
-class WiFiManager;
 
 class EspNowTransport
 {
@@ -27,23 +34,141 @@ public:
         float voltage;
         int64_t timestamp;
         uint32_t flags = 0;
+        // Counted from 1 by the external unit, the repeated message keeps its number and its timestamp. It took the
+        // padding of the first version, so it's only valid with sequencedFlag set.
+        uint32_t sequence = 0;
+
+        // Set in flags by the units counting the messages, clear of the sensor flags
+        static constexpr uint32_t sequencedFlag = 1u << 31;
+        // Set in flags by the units decoding the status report of the acknowledgement
+        static constexpr uint32_t statusReportFlag = 1u << 30;
+    };
+
+    // Sent by the internal unit right after the radio is up, the listening external unit answers with its latest
+    // data message instead of making the radio wait for the next period. The answer repeating the last sequence
+    // received is acknowledged without being passed on again.
+    struct ResendRequest
+    {
+        std::array<uint8_t, 2> magic = {0xA5, 0x52};
+        uint32_t lastSequence = 0;
+    };
+
+    // Totals since the boot, the deep sleep clears them
+    struct SequenceStatistics
+    {
+        uint32_t resendRequests = 0;
+        // Requests the external unit was listening for
+        uint32_t requestsDelivered = 0;
+        uint32_t freshMessages = 0;
+        uint32_t duplicates = 0;
+        // Wakes the radio was powered down as soon as the data was acknowledged
+        uint32_t earlyPowerDowns = 0;
+    };
+
+    // Acknowledgement of the data message. The first version ended at the channel, the status report is appended
+    // to it, so the acknowledgement stays the only transmission of the internal unit. The units not setting
+    // statusReportFlag may check the length of the first version, they get its 24 bytes without the report.
+    struct CorrectionMessage
+    {
+        // The first version with its padding
+        static constexpr size_t firstVersionSize = 24;
+
+        int64_t currentMicroseconds;
+        int64_t receiveMicroseconds;
+        // Channel the external unit shall use from its next message
+        uint8_t channel;
+        // Zero if there's no status report
+        uint8_t statusVersion;
+        StatusReport status;
     };
 
-    EspNowTransport(embedded::PersistentStorage& storage, WiFiManager &wifiManager);
+    EspNowTransport(embedded::PersistentStorage& storage, RadioInterface& radio, const ReadingHistory& history);
     bool setup(bool wakeup);
     bool init(GroupBitView event);
     std::optional<DataMessage> getLastMessage(uint32_t timeoutMilliseconds) const;
     bool sendResponce();
-    void hibernate() const;
+    // Readings and health of the unit for the next acknowledgements, shall be set before init()
+    void setStatusReport(const StatusReport& report) { correctionMessage.status = report; }
+    // Decodes the acknowledgement of any version, the status report is kept only if it's complete
+    [[nodiscard]] static std::optional<CorrectionMessage> parseCorrection(const uint8_t* data, size_t size);
+    [[nodiscard]] static bool isResendRequest(const uint8_t* data, size_t size);
+    [[nodiscard]] static SequenceStatistics getSequenceStatistics();
+    void hibernate();
+    const LinkStatistics& getLinkStatistics() const { return linkStatistics; }
+    const history_transfer::HistorySender::Statistics& getHistoryStatistics() const
+    {
+        return historySender.getStatistics();
+    }
+    // The channel the station was connected on, announced to the external unit
+    void setAccessPointChannel(uint8_t channel) { channelPlan.setAccessPointChannel(channel); }
 
     void threadFunction();
 private:
+    enum class PacketKind : uint8_t
+    {
+        Acknowledgement,
+        HistoryChunk,
+        ResendRequest,
+    };
+    static constexpr size_t maxSendsInFlight = 32;
+
     embedded::PersistentStorage& storage;
-    WiFiManager &wifiManager;
+    RadioInterface& radio;
     std::unique_ptr<std::remove_pointer<GroupBitView::EventGroupHandleType>::type,
                     void(*)(GroupBitView::EventGroupHandleType)> wifiEventGroup;
+    std::unique_ptr<std::remove_pointer_t<QueueHandle_t>, void(*)(QueueHandle_t)> espnowQueue;
+    // Serializes the power-down of the radio after the delivery with the init() and hibernate() of the other tasks
+    std::unique_ptr<std::remove_pointer_t<QueueHandle_t>, void(*)(QueueHandle_t)> radioMutex;
+    std::optional<RadioInterface::MacAddress> remoteMac;
+    DataMessage measurementDataMessage {};
+    CorrectionMessage correctionMessage {};
     volatile bool isPeerInfoUpdated = false;
     int attemptsCounter = 0;
-    static constexpr int maxAttempts = 10;
+    int64_t deliveryStartTime = 0;
+    int64_t retryTimeSpent = 0;
     GroupBitView externalEvent;
+    LinkStatistics linkStatistics;
+    ChannelPlan channelPlan;
+    // The radio listened during this wake and the external unit was heard
+    bool listening = false;
+    volatile bool peerHeard = false;
+    // The latest message of the external unit announced it decodes the status report
+    bool peerDecodesStatus = false;
+    bool wakeRegistered = false;
+    // The radio sessions are counted over the init() calls, so a power-down planned before the latest one is dropped
+    bool radioPowered = false;
+    uint32_t radioSession = 0;
+    std::optional<int64_t> powerDownTime;
+    uint32_t powerDownSession = 0;
+    // Sequence and timestamp of the latest data message passed on, kept over the wakes. The restarted external unit
+    // counts from 1 again, so the sequence alone could match a new message.
+    uint32_t lastSequence = 0;
+    int64_t lastTimestamp = 0;
+    std::optional<int64_t> resendTime;
+    // The acknowledgement is sent again at this time after its failed delivery
+    std::optional<int64_t> retryTime;
+    uint8_t resendRequestsSent = 0;
+    history_transfer::HistorySender historySender;
+    // Kinds of the packets waiting for the send callback, in the order of sending
+    std::array<PacketKind, maxSendsInFlight> sendKinds {};
+    uint8_t firstSend = 0;
+    uint8_t sendsInFlight = 0;
+
+    // Plans the retry of the failed acknowledgement after the backoff, false if the attempts or the time are used up
+    bool retryResponce();
+    void completeDelivery(bool delivered);
+    void sendResendRequest();
+    bool sendPacket(const uint8_t* data, size_t size, PacketKind kind);
+    std::optional<PacketKind> takeSentPacket();
+    // Powers the radio down, unless init() was called since the given session, true if it was up
+    bool powerDown(std::optional<uint32_t> session);
+    void onReceive(const RadioInterface::ReceiveInfo& info, const uint8_t* incomingData, size_t len);
+    static void onReceive(void* context, const RadioInterface::ReceiveInfo& info, const uint8_t* data, size_t size);
+    static void onSend(void* context, const RadioInterface::MacAddress& destination, bool delivered);
+    static bool sendHistory(void* context, const uint8_t* data, size_t size);
 };
+
+static_assert(sizeof(EspNowTransport::CorrectionMessage) <= RadioInterface::maxPayloadSize,
+              "The acknowledgement shall fit one ESP-NOW packet");
+static_assert(sizeof(EspNowTransport::DataMessage) <= RadioInterface::maxPayloadSize,
+              "The data message shall fit one ESP-NOW packet");
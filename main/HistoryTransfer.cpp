@@ -0,0 +1,457 @@
+#include "HistoryTransfer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace history_transfer
+{
+
+namespace
+{
+constexpr size_t fieldCount = 7;
+// Zigzag varint of a 32 bit delta
+constexpr size_t maxFieldSize = 5;
+static_assert(fieldCount * maxFieldSize == maxEncodedRecordSize);
+
+using Fields = std::array<int64_t, fieldCount>;
+
+Fields toFields(const HistoryRecord& record)
+{
+    return {record.time, record.temperature, record.humidity, record.pressure, record.pm01, record.pm2p5, record.pm10};
+}
+
+HistoryRecord fromFields(const Fields& fields)
+{
+    HistoryRecord record;
+    record.time = static_cast<uint32_t>(fields[0]);
+    record.temperature = static_cast<int16_t>(fields[1]);
+    record.humidity = static_cast<uint16_t>(fields[2]);
+    record.pressure = static_cast<uint16_t>(fields[3]);
+    record.pm01 = static_cast<int16_t>(fields[4]);
+    record.pm2p5 = static_cast<int16_t>(fields[5]);
+    record.pm10 = static_cast<int16_t>(fields[6]);
+    return record;
+}
+
+size_t putVarint(int64_t value, uint8_t* out)
+{
+    auto zigzag = static_cast<uint64_t>(value < 0 ? ((-value - 1) << 1) | 1 : value << 1);
+    size_t size = 0;
+    do
+    {
+        out[size] = static_cast<uint8_t>(zigzag & 0x7F);
+        zigzag >>= 7;
+        if (zigzag != 0)
+        {
+            out[size] |= 0x80;
+        }
+        ++size;
+    } while (zigzag != 0);
+    return size;
+}
+
+bool getVarint(const uint8_t* data, size_t size, size_t& position, int64_t& value)
+{
+    uint64_t zigzag = 0;
+    for (size_t i = 0; i < maxFieldSize; ++i)
+    {
+        if (position == size)
+        {
+            return false;
+        }
+        const auto byte = data[position++];
+        zigzag |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0)
+        {
+            value = (zigzag & 1) != 0 ? -static_cast<int64_t>(zigzag >> 1) - 1 : static_cast<int64_t>(zigzag >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isMessage(const uint8_t* data, size_t size, MessageType type, size_t expectedSize)
+{
+    return size == expectedSize && messageType(data, size) == type;
+}
+}
+
+std::optional<MessageType> messageType(const uint8_t* data, size_t size)
+{
+    if (size < sizeof(Header) || data[0] != magic[0] || data[1] != magic[1])
+    {
+        return std::nullopt;
+    }
+    const auto type = static_cast<MessageType>(data[offsetof(Header, type)]);
+    switch (type)
+    {
+        case MessageType::Request:
+        case MessageType::Chunk:
+        case MessageType::Acknowledgement:
+            return type;
+    }
+    return std::nullopt;
+}
+
+size_t encodeRecords(const ReadingHistory& history, size_t first, size_t end, uint8_t* buffer, size_t capacity,
+                     size_t& encoded)
+{
+    size_t size = 0;
+    encoded = 0;
+    auto previous = toFields(HistoryRecord {});
+    for (size_t i = first; i < end; ++i)
+    {
+        const auto fields = toFields(history[i]);
+        std::array<uint8_t, maxEncodedRecordSize> coded;
+        size_t codedSize = 0;
+        for (size_t field = 0; field < fieldCount; ++field)
+        {
+            codedSize += putVarint(fields[field] - previous[field], coded.data() + codedSize);
+        }
+        if (size + codedSize > capacity)
+        {
+            break;
+        }
+        std::memcpy(buffer + size, coded.data(), codedSize);
+        size += codedSize;
+        previous = fields;
+        ++encoded;
+    }
+    return size;
+}
+
+bool decodeRecords(const uint8_t* data, size_t size, RecordCallback callback, void* context)
+{
+    if (callback != nullptr && !decodeRecords(data, size, nullptr, nullptr))
+    {
+        return false;
+    }
+    auto previous = toFields(HistoryRecord {});
+    size_t position = 0;
+    while (position < size)
+    {
+        for (auto& field : previous)
+        {
+            int64_t delta = 0;
+            if (!getVarint(data, size, position, delta))
+            {
+                return false;
+            }
+            field += delta;
+        }
+        if (callback != nullptr)
+        {
+            callback(context, fromFields(previous));
+        }
+    }
+    return true;
+}
+
+HistorySender::HistorySender(const ReadingHistory& history, SendFunction send, void* context)
+    : history(history)
+    , send(send)
+    , context(context)
+{
+}
+
+void HistorySender::onRequest(const uint8_t* data, size_t size)
+{
+    if (!isMessage(data, size, MessageType::Request, sizeof(Request)))
+    {
+        return;
+    }
+    Request request;
+    std::memcpy(&request, data, sizeof(request));
+    // The repeated request of the running session
+    if (isActive() && request.header.session == session)
+    {
+        return;
+    }
+    // The range is cut into the chunks now, the records appended later wait for the next session
+    const auto first = history.lowerBound(request.fromTime);
+    const auto end = request.toTime == UINT32_MAX ? history.size() : history.lowerBound(request.toTime + 1);
+    std::array<uint8_t, maxChunkPayload> scratch;
+    total = 0;
+    auto start = first;
+    do
+    {
+        chunkStarts[total++] = static_cast<uint8_t>(start);
+        size_t encoded = 0;
+        encodeRecords(history, start, end, scratch.data(), scratch.size(), encoded);
+        start += encoded;
+    } while (start < end);
+    chunkStarts[total] = static_cast<uint8_t>(start);
+
+    session = request.header.session;
+    window = std::clamp<uint8_t>(request.window, 1, maxWindow);
+    base = 0;
+    nextNew = 0;
+    acknowledged = 0;
+    lost = 0;
+    timeouts = 0;
+    ++statistics.sessions;
+    sendNext();
+}
+
+void HistorySender::onAcknowledgement(const uint8_t* data, size_t size)
+{
+    if (!isActive() || !isMessage(data, size, MessageType::Acknowledgement, sizeof(Acknowledgement)))
+    {
+        return;
+    }
+    Acknowledgement acknowledgement;
+    std::memcpy(&acknowledgement, data, sizeof(acknowledgement));
+    if (acknowledgement.header.session != session)
+    {
+        return;
+    }
+    timeouts = 0;
+    uint32_t newestOrder = 0;
+    for (uint16_t sequence = base; sequence < nextNew; ++sequence)
+    {
+        const auto bit = 1u << (sequence - base);
+        const size_t offset = sequence > acknowledgement.base ? sequence - acknowledgement.base - 1 : 0;
+        const bool received = sequence < acknowledgement.base
+                              || (sequence > acknowledgement.base && offset < 32
+                                  && (acknowledgement.received >> offset & 1) != 0);
+        if (received && (acknowledged & bit) == 0)
+        {
+            acknowledged |= bit;
+            lost &= ~bit;
+            newestOrder = std::max(newestOrder, sendOrder[sequence % maxWindow]);
+        }
+    }
+    // The medium keeps the order, so a chunk sent before the newly acknowledged one won't come anymore
+    for (uint16_t sequence = base; sequence < nextNew; ++sequence)
+    {
+        if ((acknowledged >> (sequence - base) & 1) == 0 && sendOrder[sequence % maxWindow] < newestOrder)
+        {
+            markLost(sequence);
+        }
+    }
+    while ((acknowledged & 1) != 0)
+    {
+        acknowledged >>= 1;
+        lost >>= 1;
+        ++base;
+    }
+    if (base == total)
+    {
+        ++statistics.completed;
+        finish();
+        return;
+    }
+    sendNext();
+}
+
+void HistorySender::onSent(bool delivered)
+{
+    const auto sequence = onAir;
+    onAir.reset();
+    if (!isActive())
+    {
+        return;
+    }
+    // The failure reported by the MAC spares waiting for the acknowledgement
+    if (!delivered && sequence)
+    {
+        markLost(*sequence);
+    }
+    sendNext();
+}
+
+void HistorySender::onTimeout()
+{
+    if (!isActive())
+    {
+        return;
+    }
+    if (++timeouts > timeoutLimit)
+    {
+        finish();
+        return;
+    }
+    for (uint16_t sequence = base; sequence < nextNew; ++sequence)
+    {
+        markLost(sequence);
+    }
+    // The send callback may be lost with the radio turned off
+    onAir.reset();
+    sendNext();
+}
+
+void HistorySender::sendNext()
+{
+    if (onAir)
+    {
+        return;
+    }
+    if (lost != 0)
+    {
+        const auto sequence = static_cast<uint16_t>(base + __builtin_ctz(lost));
+        lost &= lost - 1;
+        ++statistics.retransmissions;
+        if (!sendChunk(sequence))
+        {
+            markLost(sequence);
+        }
+    }
+    else if (nextNew < total && nextNew - base < window)
+    {
+        const auto sequence = nextNew++;
+        if (!sendChunk(sequence))
+        {
+            markLost(sequence);
+        }
+    }
+}
+
+bool HistorySender::sendChunk(uint16_t sequence)
+{
+    std::array<uint8_t, RadioInterface::maxPayloadSize> packet;
+    ChunkHeader header;
+    header.header.session = session;
+    header.sequence = sequence;
+    header.total = total;
+    std::memcpy(packet.data(), &header, sizeof(header));
+    size_t encoded = 0;
+    const auto size = encodeRecords(history, chunkStarts[sequence], chunkStarts[sequence + 1],
+                                    packet.data() + sizeof(header), maxChunkPayload, encoded);
+    sendOrder[sequence % maxWindow] = ++sendCounter;
+    ++statistics.chunks;
+    statistics.records += encoded;
+    if (!send(context, packet.data(), sizeof(header) + size))
+    {
+        return false;
+    }
+    onAir = sequence;
+    return true;
+}
+
+void HistorySender::markLost(uint16_t sequence)
+{
+    if (sequence >= base && sequence < nextNew && (acknowledged >> (sequence - base) & 1) == 0)
+    {
+        lost |= 1u << (sequence - base);
+    }
+}
+
+void HistorySender::finish()
+{
+    total = 0;
+}
+
+Request HistoryReceiver::makeRequest(uint8_t session, uint32_t fromTime, uint32_t toTime, uint8_t window)
+{
+    this->session = session;
+    total = 0;
+    base = 0;
+    received = 0;
+    resume = fromTime;
+    sinceAcknowledgement = 0;
+    ++statistics.sessions;
+    Request request;
+    request.header.session = session;
+    request.fromTime = fromTime;
+    request.toTime = toTime;
+    request.window = window;
+    return request;
+}
+
+bool HistoryReceiver::onChunk(const uint8_t* data, size_t size, RecordCallback callback, void* context)
+{
+    if (size < sizeof(ChunkHeader) || messageType(data, size) != MessageType::Chunk)
+    {
+        return false;
+    }
+    ChunkHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.header.session != session || header.total == 0 || (total != 0 && header.total != total)
+        || header.sequence >= header.total)
+    {
+        return false;
+    }
+    total = header.total;
+    const auto sequence = header.sequence;
+    const size_t offset = sequence > base ? sequence - base - 1 : 0;
+    if (sequence < base || (sequence > base && offset < trackedChunks && (received >> offset & 1) != 0))
+    {
+        // The acknowledgement was lost, it's repeated
+        ++statistics.duplicates;
+        sinceAcknowledgement = 0;
+        return true;
+    }
+    if (sequence > base && offset >= trackedChunks)
+    {
+        return false;
+    }
+    const auto* payload = data + sizeof(header);
+    const auto payloadSize = size - sizeof(header);
+    struct Forward
+    {
+        RecordCallback callback;
+        void* context;
+        uint32_t records;
+        uint32_t nextTime;
+    } forward {callback, context, 0, 0};
+    const auto forwardRecord = [](void* forwardContext, const HistoryRecord& record)
+    {
+        auto& forward = *reinterpret_cast<Forward*>(forwardContext);
+        ++forward.records;
+        forward.nextTime = record.time + 1;
+        if (forward.callback != nullptr)
+        {
+            forward.callback(forward.context, record);
+        }
+    };
+    if (!decodeRecords(payload, payloadSize, forwardRecord, &forward))
+    {
+        return false;
+    }
+    ++statistics.chunks;
+    statistics.records += forward.records;
+    statistics.payloadBytes += payloadSize;
+
+    const bool inOrder = sequence == base;
+    if (inOrder)
+    {
+        auto nextTime = forward.nextTime;
+        bool advance = true;
+        while (advance)
+        {
+            if (nextTime != 0)
+            {
+                resume = nextTime;
+            }
+            ++base;
+            advance = (received & 1) != 0;
+            nextTime = resumeTimes[0];
+            received >>= 1;
+            std::rotate(resumeTimes.begin(), resumeTimes.begin() + 1, resumeTimes.end());
+            resumeTimes.back() = 0;
+        }
+    }
+    else
+    {
+        received |= 1u << offset;
+        resumeTimes[offset] = forward.nextTime;
+    }
+    // Every second chunk, a gap and the end are acknowledged at once
+    if (!inOrder || isComplete() || ++sinceAcknowledgement >= 2)
+    {
+        sinceAcknowledgement = 0;
+        return true;
+    }
+    return false;
+}
+
+Acknowledgement HistoryReceiver::makeAcknowledgement() const
+{
+    Acknowledgement acknowledgement;
+    acknowledgement.header.session = session;
+    acknowledgement.base = base;
+    acknowledgement.received = received;
+    return acknowledgement;
+}
+
+}
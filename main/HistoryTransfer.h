@@ -0,0 +1,186 @@
+#pragma once
+
+#include "RadioInterface.h"
+#include "ReadingHistory.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Bulk transfer of the reading history to the external unit. The requester asks for a time range, the unit sends
+// the records in chunks filling the whole packet. The fields of a record are the zigzag varint deltas to the record
+// before, the first record of a chunk is coded against the default one, so every chunk decodes on its own. Up to
+// the window of chunks are sent ahead of the acknowledgement, the requester acknowledges the received ones
+// selectively and only the lost ones are sent again. An interrupted transfer is resumed by a new request starting
+// after the last record received in order. The definitions are shared with the firmware of the external unit.
+namespace history_transfer
+{
+
+// Leads every message, the serial number starting the data message is ASCII
+constexpr std::array<uint8_t, 2> magic {0xA5, 0x48};
+// Limit of the chunks in flight, the acknowledgement covers twice as many
+constexpr uint8_t maxWindow = 16;
+
+enum class MessageType : uint8_t
+{
+    Request = 1,
+    Chunk,
+    Acknowledgement,
+};
+
+struct Header
+{
+    std::array<uint8_t, 2> magic;
+    MessageType type;
+    // Chosen by the requester, the messages of the other sessions are ignored
+    uint8_t session;
+};
+
+struct Request
+{
+    Header header {magic, MessageType::Request, 0};
+    // Range of the record times, both ends included
+    uint32_t fromTime = 0;
+    uint32_t toTime = UINT32_MAX;
+    // Chunks the unit may send ahead of the acknowledgement
+    uint8_t window = maxWindow;
+};
+
+struct Acknowledgement
+{
+    Header header {magic, MessageType::Acknowledgement, 0};
+    // All the chunks before it are received
+    uint16_t base = 0;
+    // Bit i is set if the chunk base + 1 + i is received
+    uint32_t received = 0;
+};
+
+struct ChunkHeader
+{
+    Header header {magic, MessageType::Chunk, 0};
+    uint16_t sequence = 0;
+    // Chunks of the session, an empty range is sent as one empty chunk
+    uint16_t total = 0;
+};
+
+constexpr size_t maxChunkPayload = RadioInterface::maxPayloadSize - sizeof(ChunkHeader);
+// Longest code of a record, the seven fields as zigzag varints of 32 bit deltas
+constexpr size_t maxEncodedRecordSize = 7 * 5;
+// Size of the control messages, the chunks only go to the requester
+constexpr size_t maxControlSize = sizeof(Request) > sizeof(Acknowledgement) ? sizeof(Request) : sizeof(Acknowledgement);
+
+using RecordCallback = void (*)(void* context, const HistoryRecord& record);
+
+// The type if the data is a message of the transfer
+[[nodiscard]] std::optional<MessageType> messageType(const uint8_t* data, size_t size);
+// Codes the records from the first one while they fit the buffer, returns the size and the number of the records
+size_t encodeRecords(const ReadingHistory& history, size_t first, size_t end, uint8_t* buffer, size_t capacity,
+                     size_t& encoded);
+// Passes the records to the callback, returns false if the data is malformed. No record is passed then, the null
+// callback only checks the data.
+bool decodeRecords(const uint8_t* data, size_t size, RecordCallback callback, void* context);
+
+// The side of the unit keeping the history. Only one chunk is handed to the radio at a time, the next one follows
+// the send callback of the previous one.
+class HistorySender
+{
+public:
+    using SendFunction = bool (*)(void* context, const uint8_t* data, size_t size);
+
+    struct Statistics
+    {
+        uint32_t sessions = 0;
+        uint32_t completed = 0;
+        uint32_t chunks = 0;
+        uint32_t retransmissions = 0;
+        uint32_t records = 0;
+    };
+
+    // Time without any acknowledgement after which the unacknowledged chunks are sent again
+    static constexpr uint32_t retransmissionTimeoutMilliseconds = 50;
+    // The session is abandoned after so many timeouts in a row
+    static constexpr uint8_t timeoutLimit = 5;
+
+    HistorySender(const ReadingHistory& history, SendFunction send, void* context);
+
+    void onRequest(const uint8_t* data, size_t size);
+    void onAcknowledgement(const uint8_t* data, size_t size);
+    // The radio finished the chunk handed to it
+    void onSent(bool delivered);
+    void onTimeout();
+
+    [[nodiscard]] bool isActive() const { return total != 0; }
+    [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
+private:
+    void sendNext();
+    bool sendChunk(uint16_t sequence);
+    void markLost(uint16_t sequence);
+    void finish();
+
+    const ReadingHistory& history;
+    SendFunction send;
+    void* context;
+    // The records of the chunk i are [chunkStarts[i], chunkStarts[i + 1])
+    std::array<uint8_t, ReadingHistory::capacity + 1> chunkStarts {};
+    // Zero if there's no session
+    uint16_t total = 0;
+    uint8_t session = 0;
+    uint8_t window = 0;
+    // The first unacknowledged chunk and the first one never sent
+    uint16_t base = 0;
+    uint16_t nextNew = 0;
+    // Bit i is for the chunk base + i
+    uint32_t acknowledged = 0;
+    uint32_t lost = 0;
+    // Order of the latest transmission of the chunks in flight, a chunk sent before an acknowledged one is lost
+    std::array<uint32_t, maxWindow> sendOrder {};
+    uint32_t sendCounter = 0;
+    std::optional<uint16_t> onAir;
+    uint8_t timeouts = 0;
+    Statistics statistics;
+};
+
+// The side of the requester
+class HistoryReceiver
+{
+public:
+    struct Statistics
+    {
+        uint32_t sessions = 0;
+        uint32_t chunks = 0;
+        uint32_t duplicates = 0;
+        uint32_t records = 0;
+        uint32_t payloadBytes = 0;
+    };
+
+    // Starts the session, an unfinished one is abandoned
+    [[nodiscard]] Request makeRequest(uint8_t session, uint32_t fromTime, uint32_t toTime = UINT32_MAX,
+                                      uint8_t window = maxWindow);
+    // Passes the new records to the callback, returns true if the acknowledgement shall be sent now
+    bool onChunk(const uint8_t* data, size_t size, RecordCallback callback, void* context);
+    [[nodiscard]] Acknowledgement makeAcknowledgement() const;
+
+    [[nodiscard]] bool isComplete() const { return total != 0 && base == total; }
+    // Start of the request resuming the transfer, after the last record of the chunks received in order
+    [[nodiscard]] uint32_t resumeTime() const { return resume; }
+    [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
+private:
+    static constexpr size_t trackedChunks = 32;
+
+    uint8_t session = 0;
+    // Zero until the first chunk
+    uint16_t total = 0;
+    uint16_t base = 0;
+    // Bit i is for the chunk base + 1 + i
+    uint32_t received = 0;
+    // Time after the last record of the chunks received out of order, zero if the chunk is empty
+    std::array<uint32_t, trackedChunks> resumeTimes {};
+    uint32_t resume = 0;
+    uint8_t sinceAcknowledgement = 0;
+    Statistics statistics;
+};
+
+}
@@ -0,0 +1,87 @@
+#include "HistoryUpload.h"
+
+#include "AppConfig.h"
+
+#include <cstring>
+#include <esp_http_client.h>
+#include <memory>
+
+#include "Debug.h"
+
+namespace history_upload
+{
+
+size_t makeBatch(const ReadingHistory& history, size_t first, uint8_t* buffer, size_t capacity)
+{
+    if (capacity < sizeof(BatchHeader))
+    {
+        return 0;
+    }
+    size_t encoded = 0;
+    const auto size = history_transfer::encodeRecords(history, first, history.size(), buffer + sizeof(BatchHeader),
+                                                      capacity - sizeof(BatchHeader), encoded);
+    BatchHeader header;
+    header.records = static_cast<uint16_t>(encoded);
+    std::memcpy(buffer, &header, sizeof(header));
+    return sizeof(header) + size;
+}
+
+bool parseBatch(const uint8_t* data, size_t size, history_transfer::RecordCallback callback, void* context)
+{
+    BatchHeader header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != BatchHeader {}.magic)
+    {
+        return false;
+    }
+    size_t records = 0;
+    const auto countRecord = [](void* counter, const HistoryRecord&) { ++*reinterpret_cast<size_t*>(counter); };
+    // The number of the records is checked before any of them is passed on
+    if (!history_transfer::decodeRecords(data + sizeof(header), size - sizeof(header), countRecord, &records)
+        || records != header.records)
+    {
+        return false;
+    }
+    return history_transfer::decodeRecords(data + sizeof(header), size - sizeof(header), callback, context);
+}
+
+std::optional<uint32_t> upload(const ReadingHistory& history, uint32_t fromTime, int timeoutMs)
+{
+    const auto first = history.lowerBound(fromTime);
+    if (first == history.size())
+    {
+        return fromTime;
+    }
+    // The batch is too big for the stack of the task
+    const auto capacity = sizeof(BatchHeader) + (history.size() - first) * history_transfer::maxEncodedRecordSize;
+    std::unique_ptr<uint8_t[]> batch(new uint8_t[capacity]);
+    const auto size = makeBatch(history, first, batch.get(), capacity);
+
+    esp_http_client_config_t config {};
+    config.url = AppConfig::uploadUrl.data();
+    config.method = HTTP_METHOD_POST;
+    config.timeout_ms = timeoutMs;
+    const auto client = esp_http_client_init(&config);
+    if (client == nullptr)
+    {
+        return std::nullopt;
+    }
+    esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+    esp_http_client_set_post_field(client, reinterpret_cast<const char*>(batch.get()), static_cast<int>(size));
+    const auto result = esp_http_client_perform(client);
+    const auto status = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+    if (result != ESP_OK || status < 200 || status >= 300)
+    {
+        DEBUG_LOG("History upload failed, error " << result << ", status " << status)
+        return std::nullopt;
+    }
+    DEBUG_LOG("Uploaded " << history.size() - first << " records in " << size << " bytes")
+    return history[history.size() - 1].time + 1;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "HistoryTransfer.h"
+#include "ReadingHistory.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Store-and-forward upload of the reading history over the station connection of the time synchronization. All the
+// records not uploaded yet go in one POST request coded like the chunks of the history transfer, so the association
+// with the access point and the connection to the server are paid once per batch instead of once per reading.
+// The definitions of the batch are shared with the server.
+namespace history_upload
+{
+
+struct BatchHeader
+{
+    std::array<char, 4> magic {'D', 'M', 'H', '1'};
+    uint16_t records = 0;
+    uint16_t reserved = 0;
+};
+
+// The whole ring, every field in its longest code
+constexpr size_t maxBatchSize = sizeof(BatchHeader) + ReadingHistory::capacity * history_transfer::maxEncodedRecordSize;
+
+// Codes the records from the first one, returns the size of the batch
+size_t makeBatch(const ReadingHistory& history, size_t first, uint8_t* buffer, size_t capacity);
+// Passes the records of the batch to the callback, returns false if the batch is malformed
+bool parseBatch(const uint8_t* data, size_t size, history_transfer::RecordCallback callback, void* context);
+
+// Posts the records not older than the time to AppConfig::uploadUrl, returns the time after the last record uploaded,
+// none if the request failed
+[[nodiscard]] std::optional<uint32_t> upload(const ReadingHistory& history, uint32_t fromTime, int timeoutMs);
+
+}
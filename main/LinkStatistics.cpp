@@ -0,0 +1,54 @@
+#include "LinkStatistics.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr int ratioWeightShift = 3; // the last sample weights 1/8
+constexpr uint8_t badLinkFailures = 3;
+constexpr int badLinkAttempts = 2;
+constexpr uint32_t baseBackoffMs = 4;
+constexpr uint32_t maxBackoffMs = 128;
+}
+
+void LinkStatistics::registerResult(int attempts, bool delivered)
+{
+    const int sample = delivered ? fullDeliveryRatio : 0;
+    deliveryRatio = static_cast<uint8_t>(
+            (int(deliveryRatio) * ((1 << ratioWeightShift) - 1) + sample) >> ratioWeightShift);
+    if (delivered)
+    {
+        ++deliveredCount;
+        consecutiveFailures = 0;
+        const auto index = std::clamp(attempts, 1, maxAttempts) - 1;
+        if (attemptsHistogram[index] < UINT16_MAX)
+        {
+            ++attemptsHistogram[index];
+        }
+    }
+    else
+    {
+        ++failedCount;
+        if (consecutiveFailures < UINT8_MAX)
+        {
+            ++consecutiveFailures;
+        }
+    }
+}
+
+int LinkStatistics::attemptsLimit() const
+{
+    if (consecutiveFailures >= badLinkFailures)
+    {
+        return badLinkAttempts;
+    }
+    const int scaled = 1 + (maxAttempts - 1) * deliveryRatio / fullDeliveryRatio;
+    return std::clamp(scaled, badLinkAttempts, maxAttempts);
+}
+
+uint32_t LinkStatistics::backoffDelayMs(int attempt, uint32_t randomValue)
+{
+    const auto shift = std::clamp(attempt - 1, 0, 16);
+    const auto ceiling = std::min(baseBackoffMs << shift, maxBackoffMs);
+    return ceiling / 2 + randomValue % (ceiling / 2 + 1);
+}
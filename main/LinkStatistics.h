@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Rolling statistics of the acknowledgement delivery to the external unit.
+// The structure is kept in the persistent storage, so it's updated across deep sleeps.
+struct LinkStatistics
+{
+    static constexpr int maxAttempts = 10;
+    static constexpr uint8_t fullDeliveryRatio = 255;
+
+    uint32_t deliveredCount = 0;
+    uint32_t failedCount = 0;
+    // Number of successful deliveries by the attempt they succeeded on
+    std::array<uint16_t, maxAttempts> attemptsHistogram {};
+    // Exponentially weighted delivery ratio scaled to 0..255
+    uint8_t deliveryRatio = fullDeliveryRatio;
+    uint8_t consecutiveFailures = 0;
+    int8_t lastRssi = 0;
+
+    void registerResult(int attempts, bool delivered);
+    void registerRssi(int8_t rssi) { lastRssi = rssi; }
+
+    // Maximum number of attempts for the next delivery, lower when the link is known to be bad
+    [[nodiscard]] int attemptsLimit() const;
+    // Jittered exponential delay before the retry with the given number, randomValue is a uniform random number
+    [[nodiscard]] static uint32_t backoffDelayMs(int attempt, uint32_t randomValue);
+    [[nodiscard]] float getDeliveryRatio() const { return float(deliveryRatio) / fullDeliveryRatio; }
+};
@@ -0,0 +1,112 @@
+#include "Meteorology.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float magnusB = 17.62f;
+constexpr float magnusC = 243.12f;
+constexpr float tendencyThreshold = 1.0f;
+constexpr float secondsIn3Hours = 3 * 60 * 60;
+
+float saturationVaporPressure(float temperature)
+{
+    return 6.112f * std::exp(magnusB * temperature / (magnusC + temperature));
+}
+}
+
+namespace meteorology
+{
+float dewPoint(float temperature, float relativeHumidity)
+{
+    const auto gamma = std::log(std::max(relativeHumidity, 0.1f) / 100.f) + magnusB * temperature / (magnusC + temperature);
+    return magnusC * gamma / (magnusB - gamma);
+}
+
+float absoluteHumidity(float temperature, float relativeHumidity)
+{
+    // 216.7 is the water vapour molar mass divided by the gas constant, in g*K/J
+    return 216.7f * saturationVaporPressure(temperature) * relativeHumidity / 100.f / (273.15f + temperature);
+}
+
+float seaLevelPressure(float stationPressure, float temperature, float altitude)
+{
+    const auto temperatureGradient = 0.0065f * altitude;
+    return stationPressure * std::pow(1.f - temperatureGradient / (temperature + temperatureGradient + 273.15f), -5.257f);
+}
+}
+
+void PressureTrend::update(time_t now, float pressurePa)
+{
+    const auto slot = static_cast<uint32_t>(now / slotSeconds);
+    if (filledSlots == 0 || slot < currentSlot || slot - currentSlot >= slotsCount)
+    {
+        *this = {};
+        baseSlot = slot;
+    }
+    else
+    {
+        for (auto i = currentSlot + 1; i <= slot; ++i)
+        {
+            removeSlot(i % slotsCount);
+        }
+    }
+    currentSlot = slot;
+    const auto index = slot % slotsCount;
+    removeSlot(index);
+
+    const auto steps = std::lround((pressurePa - float(pressureOffset)) / float(pressureStep));
+    const auto value = static_cast<uint16_t>(std::clamp<long>(steps, 1, UINT16_MAX));
+    const int64_t x = slot - baseSlot;
+    slots[index] = value;
+    ++filledSlots;
+    sumX += x;
+    sumY += value;
+    sumXX += x * x;
+    sumXY += x * value;
+}
+
+std::optional<float> PressureTrend::getTendency() const
+{
+    if (filledSlots < minSlots)
+    {
+        return std::nullopt;
+    }
+    const auto denominator = int64_t(filledSlots) * sumXX - sumX * sumX;
+    if (denominator == 0)
+    {
+        return std::nullopt;
+    }
+    const auto slopePerSlot = float(int64_t(filledSlots) * sumXY - sumX * sumY) / float(denominator);
+    return slopePerSlot * float(pressureStep) * (secondsIn3Hours / slotSeconds) / 100.f;
+}
+
+PressureTrend::Tendency PressureTrend::classify(float tendency)
+{
+    if (tendency > tendencyThreshold)
+    {
+        return Tendency::Rising;
+    }
+    if (tendency < -tendencyThreshold)
+    {
+        return Tendency::Falling;
+    }
+    return Tendency::Steady;
+}
+
+void PressureTrend::removeSlot(size_t index)
+{
+    if (const auto value = slots[index]; value != 0)
+    {
+        // The slot position is restored from the ring index relative to the current slot
+        const auto age = (currentSlot % slotsCount + slotsCount - index) % slotsCount;
+        const int64_t x = int64_t(currentSlot - age) - baseSlot;
+        sumX -= x;
+        sumY -= value;
+        sumXX -= x * x;
+        sumXY -= x * value;
+        slots[index] = 0;
+        --filledSlots;
+    }
+}
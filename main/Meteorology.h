@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+namespace meteorology
+{
+// Dew point in Celsius by the Magnus formula, the error is below 0.1 C for -30..50 C and below 0.16 C down to -40 C
+[[nodiscard]] float dewPoint(float temperature, float relativeHumidity);
+// Absolute humidity in g/m3
+[[nodiscard]] float absoluteHumidity(float temperature, float relativeHumidity);
+// Pressure reduced to the sea level by the international barometric formula, in the units of the station pressure
+[[nodiscard]] float seaLevelPressure(float stationPressure, float temperature, float altitude);
+}
+
+// Pressure tendency over the last 3 hours estimated by the linear regression over 10-minute slots.
+// The regression sums are kept in integers, so update is O(1) and there is no accumulated rounding error.
+// The object is trivially copyable and is kept in the persistent storage.
+class PressureTrend
+{
+public:
+    enum class Tendency : int8_t
+    {
+        Falling = -1,
+        Steady = 0,
+        Rising = 1,
+    };
+
+    void update(time_t now, float pressurePa);
+    // Change of the pressure over 3 hours in hPa, available when the samples cover at least an hour
+    [[nodiscard]] std::optional<float> getTendency() const;
+    [[nodiscard]] static Tendency classify(float tendency);
+
+private:
+    static constexpr size_t slotsCount = 18;
+    static constexpr uint32_t slotSeconds = 10 * 60;
+    static constexpr size_t minSlots = 6;
+    // 30 to 110 kPa in steps of 2 Pa, the station pressure from the mountains to below the sea level
+    static constexpr int32_t pressureOffset = 30000;
+    static constexpr int32_t pressureStep = 2;
+
+    void removeSlot(size_t index);
+
+    // Pressure above the offset in the steps, zero marks the empty slot
+    std::array<uint16_t, slotsCount> slots {};
+    uint32_t baseSlot = 0;
+    uint32_t currentSlot = 0;
+    uint16_t filledSlots = 0;
+    int64_t sumX = 0;
+    int64_t sumY = 0;
+    int64_t sumXX = 0;
+    int64_t sumXY = 0;
+};
@@ -1,27 +1,75 @@
 #include "PTHProvider.h"
 
+#include "AppConfig.h"
 #include "BME280/BME280.h"
-
-#include "Delays.h"
+#include "Clock.h"
+#include "PersistentStorage.h"
 
 #include "Debug.h"
 
 namespace
 {
 constexpr std::string_view calibrationDataName = "PTHD";
+constexpr std::string_view trendDataName = "PTHT";
+constexpr int maxStatusPolls = 10;
+constexpr int64_t statusPollMicroseconds = 1000;
+constexpr uint8_t humidityControlRegister = 0xF2;
+constexpr uint8_t measurementControlRegister = 0xF4;
+constexpr uint8_t configRegister = 0xF5;
+constexpr uint8_t forcedMode = 0x01;
+
+// Register code of the oversampling: 0 skips the channel, 1 to 16 are coded as 1 to 5
+constexpr uint8_t oversamplingCode(uint8_t oversampling)
+{
+    uint8_t code = 0;
+    for (uint32_t factor = 1; factor <= oversampling && code < 5; factor *= 2)
+    {
+        ++code;
+    }
+    return code;
+}
+
+// Register code of the IIR filter: 0 is off, the coefficients 2 to 16 are coded as 1 to 4
+constexpr uint8_t filterCode(uint8_t coefficient)
+{
+    uint8_t code = 0;
+    for (uint32_t factor = 2; factor <= coefficient && code < 4; factor *= 2)
+    {
+        ++code;
+    }
+    return code;
 }
 
-bool PTHProvider::activate()
+static_assert(oversamplingCode(0) == 0 && oversamplingCode(1) == 1 && oversamplingCode(4) == 3
+              && oversamplingCode(16) == 5);
+static_assert(filterCode(0) == 0 && filterCode(2) == 1 && filterCode(16) == 4);
+
+// The maximum times given by the datasheet for the oversampling x1 (weather monitoring) and x16 of all channels
+static_assert(PTHProvider::measurementTimeMicroseconds(BmeProfile {}) == 9300);
+static_assert(PTHProvider::measurementTimeMicroseconds(BmeProfile {16, 16, 16, 0}) == 112800);
+}
+
+bool PTHProvider::start()
 {
-    return bme.startMeasurement();
+    statusPolls = 0;
+    readyAt = Clock::instance().monotonicMicroseconds() + measurementTimeMicroseconds(profile);
+    // The register pairs go in one transaction, ctrl_hum takes effect with the following write of ctrl_meas
+    const uint8_t configuration[] = {
+            humidityControlRegister, oversamplingCode(profile.humidityOversampling),
+            configRegister, static_cast<uint8_t>(filterCode(profile.iirFilterCoefficient) << 2),
+            measurementControlRegister, static_cast<uint8_t>(oversamplingCode(profile.temperatureOversampling) << 5
+                                                             | oversamplingCode(profile.pressureOversampling) << 2
+                                                             | forcedMode)};
+    return i2CHelper.write(configuration, sizeof(configuration));
 }
 
-bool PTHProvider::hibernate()
+bool PTHProvider::sleep()
 {
     if (!calibrationDataPresent)
     {
         bme.saveCalibrationData(storage, calibrationDataName);
     }
+    storage.set(trendDataName, pressureTrend);
     return bme.stopMeasurement();
 }
 
@@ -42,22 +90,39 @@ bool PTHProvider::setup(bool wakeUp)
             return setup(false);
         }
         DEBUG_LOG("BME280 calibration data loaded")
+        if (auto trend = storage.get<PressureTrend>(trendDataName))
+        {
+            pressureTrend = *trend;
+        }
         return true;
     }
 }
 
-bool PTHProvider::doMeasure()
+SensorProvider::ReadResult PTHProvider::read()
 {
-    while (bme.isMeasuring())
+    // The computed time is the maximum one, so the status check is only a safeguard
+    if (statusPolls < maxStatusPolls)
     {
-        embedded::delay(1);
+        if (bme.isMeasuring())
+        {
+            ++statusPolls;
+            readyAt += statusPollMicroseconds;
+            return ReadResult::Pending;
+        }
     }
 
     if (auto fixedResult = bme.getMeasureData())
     {
         measurementData = *fixedResult;
-        return true;
+        DEBUG_LOG("BME280 measurement done after " << static_cast<int>(statusPolls) << " status polls")
+        const auto temperature = getTemperature();
+        const auto humidity = getHumidity();
+        dewPoint = meteorology::dewPoint(temperature, humidity);
+        absoluteHumidity = meteorology::absoluteHumidity(temperature, humidity);
+        seaLevelPressure = meteorology::seaLevelPressure(getPressure(), temperature, AppConfig::altitude);
+        pressureTrend.update(Clock::instance().wallSeconds(), getPressure());
+        return ReadResult::Done;
     }
 
-    return false;
+    return ReadResult::Failed;
 }
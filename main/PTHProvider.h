@@ -2,16 +2,59 @@
 
 #include "BME280/BME280.h"
 #include "BME280/I2CHelper.h"
+#include "Meteorology.h"
+#include "SensorProvider.h"
 
-class PTHProvider {
+#include <cstdint>
+
+// Oversampling (0 - skipped, 1, 2, 4, 8, 16) and IIR filter settings of the forced measurement
+struct BmeProfile
+{
+    uint8_t temperatureOversampling = 1;
+    uint8_t pressureOversampling = 1;
+    uint8_t humidityOversampling = 1;
+    uint8_t iirFilterCoefficient = 0;
+};
+
+class PTHProvider : public SensorProvider
+{
 public:
-    PTHProvider(embedded::I2CHelper& i2CHelper, embedded::PersistentStorage &storage)
-        : bme(i2CHelper)
+    // Weather monitoring of the datasheet, section 3.5.1
+    static constexpr BmeProfile weatherMonitoring {};
+
+    // Maximum measurement time from the BME280 datasheet, section 9.1: 1.25 ms, 2.3 ms per temperature sample and
+    // 2.3 ms per pressure and humidity sample with 0.575 ms for each of the two measured
+    static constexpr uint32_t measurementTimeMicroseconds(const BmeProfile& bmeProfile)
+    {
+        uint32_t time = 1250 + 2300 * bmeProfile.temperatureOversampling;
+        if (bmeProfile.pressureOversampling != 0)
+        {
+            time += 2300 * bmeProfile.pressureOversampling + 575;
+        }
+        if (bmeProfile.humidityOversampling != 0)
+        {
+            time += 2300 * bmeProfile.humidityOversampling + 575;
+        }
+        return time;
+    }
+
+    PTHProvider(embedded::I2CHelper& i2CHelper, embedded::PersistentStorage &storage,
+                const BmeProfile& profile = weatherMonitoring)
+        : profile(profile)
+        , i2CHelper(i2CHelper)
+        , bme(i2CHelper)
         , storage(storage) {};
     bool setup(bool wakeUp);
-    bool activate();
-    bool hibernate();
-    bool doMeasure();
+
+    [[nodiscard]] const char* name() const override { return "bme280"; }
+    [[nodiscard]] Bus bus() const override { return Bus::I2C; }
+    // Writes the profile and triggers the forced measurement
+    bool start() override;
+    [[nodiscard]] int64_t readyTime() const override { return readyAt; }
+    // Reads the data in a single burst, pending while the status still shows the conversion
+    ReadResult read() override;
+    // Saves the calibration and the pressure trend
+    bool sleep() override;
 
     float getPressure() const
     {
@@ -28,9 +71,23 @@ public:
         return static_cast<float>(measurementData.humidity) / 1024.f;
     }
 
+    // Derived values are updated on every measurement
+    float getDewPoint() const { return dewPoint; }
+    float getAbsoluteHumidity() const { return absoluteHumidity; }
+    float getSeaLevelPressure() const { return seaLevelPressure; }
+    std::optional<float> getPressureTendency() const { return pressureTrend.getTendency(); }
+
 private:
+    const BmeProfile profile;
     embedded::BMPE280::MeasurementData measurementData{};
     bool calibrationDataPresent = false;
+    int64_t readyAt = 0;
+    uint8_t statusPolls = 0;
+    float dewPoint = 0;
+    float absoluteHumidity = 0;
+    float seaLevelPressure = 0;
+    PressureTrend pressureTrend;
+    embedded::I2CHelper& i2CHelper;
     embedded::BMPE280 bme;
     embedded::PersistentStorage &storage;
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Full set of the SPS30 channels: mass concentrations in ug/m3, number concentrations in #/cm3
+// and typical particle size in um.
+struct ParticleData
+{
+    enum Channel : size_t
+    {
+        Mc1p0,
+        Mc2p5,
+        Mc4p0,
+        Mc10p0,
+        Nc0p5,
+        Nc1p0,
+        Nc2p5,
+        Nc4p0,
+        Nc10p0,
+        TypicalSize,
+        ChannelsCount
+    };
+
+    std::array<float, ChannelsCount> values {};
+
+    float operator[](Channel channel) const { return values[channel]; }
+    float& operator[](Channel channel) { return values[channel]; }
+};
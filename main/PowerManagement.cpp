@@ -0,0 +1,120 @@
+#include "PowerManagement.h"
+
+#include <esp_attr.h>
+
+#include <cstdio>
+
+#include "Debug.h"
+
+namespace
+{
+// The CPU keeps the configured 80 MHz while it works and falls back to the 40 MHz crystal when only waiting
+constexpr int maxFrequencyMHz = 80;
+constexpr int minFrequencyMHz = 40;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Updated by the idle task with the scheduler stopped
+volatile int64_t lightSleepMicroseconds = 0;
+volatile uint32_t lightSleeps = 0;
+
+IRAM_ATTR esp_err_t onLightSleepExit(int64_t sleepMicroseconds, void* /*argument*/)
+{
+    lightSleepMicroseconds = lightSleepMicroseconds + sleepMicroseconds;
+    lightSleeps = lightSleeps + 1;
+    return ESP_OK;
+}
+#endif
+}
+
+bool power_management::init()
+{
+#if __GNUC__ >= 9
+    esp_pm_config_t config {};
+#else
+    esp_pm_config_esp32_t config {};
+#endif
+    config.max_freq_mhz = maxFrequencyMHz;
+    config.min_freq_mhz = minFrequencyMHz;
+    config.light_sleep_enable = true;
+    if (const auto result = esp_pm_configure(&config); result != ESP_OK)
+    {
+        DEBUG_LOG("Automatic light sleep isn't available, error " << result)
+        return false;
+    }
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    lightSleepMicroseconds = 0;
+    lightSleeps = 0;
+    esp_pm_sleep_cbs_register_config_t callbacks {};
+    callbacks.exit_cb = &onLightSleepExit;
+    if (esp_pm_light_sleep_register_cbs(&callbacks) != ESP_OK)
+    {
+        DEBUG_LOG("Light sleep time isn't measured")
+    }
+#endif
+    return true;
+}
+
+power_management::Statistics power_management::getStatistics()
+{
+    Statistics statistics;
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    statistics.measured = true;
+    // The 64-bit counter isn't read atomically, a torn read is repeated
+    do
+    {
+        statistics.lightSleeps = lightSleeps;
+        statistics.lightSleepMicroseconds = lightSleepMicroseconds;
+    }
+    while (statistics.lightSleeps != lightSleeps);
+#endif
+    return statistics;
+}
+
+void power_management::report()
+{
+    const auto statistics = getStatistics();
+    if (!statistics.measured)
+    {
+        DEBUG_LOG("The light sleep isn't measured")
+#if CONFIG_PM_PROFILING
+        // The time spent in every power mode since the boot, the light sleep among them
+        esp_pm_dump_locks(stdout);
+#endif
+        return;
+    }
+    DEBUG_LOG("Light sleep " << statistics.lightSleepMicroseconds << " us in " << statistics.lightSleeps
+              << " periods")
+}
+
+PowerLock::PowerLock(const char* name)
+{
+    // Fails without CONFIG_PM_ENABLE, the lock does nothing then
+    if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, name, &handle) != ESP_OK)
+    {
+        handle = nullptr;
+    }
+}
+
+PowerLock::~PowerLock()
+{
+    if (handle)
+    {
+        esp_pm_lock_delete(handle);
+    }
+}
+
+void PowerLock::acquire()
+{
+    if (handle)
+    {
+        esp_pm_lock_acquire(handle);
+    }
+}
+
+void PowerLock::release()
+{
+    if (handle)
+    {
+        esp_pm_lock_release(handle);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include <esp_pm.h>
+
+// Automatic light sleep within the wake: whenever all the tasks wait (the alignment to the minute, the SPS30
+// polling interval, the e-paper refresh) the tickless idle puts the chip into the light sleep until the next
+// timer, unless a power lock is held. The I2C, SPI and Wi-Fi drivers hold their own locks, the peripherals
+// without one shall be covered by PowerLock. Without CONFIG_PM_ENABLE nothing changes.
+namespace power_management
+{
+
+struct Statistics
+{
+    // False if the light sleep isn't measured by the build, the time below is zero then
+    bool measured = false;
+    int64_t lightSleepMicroseconds = 0;
+    uint32_t lightSleeps = 0;
+};
+
+// Enables the frequency scaling and the automatic light sleep, returns false if the build doesn't support them.
+// The statistics are counted from here.
+bool init();
+[[nodiscard]] Statistics getStatistics();
+// Logs the light sleep time of the wake so far, the awake time is logged by the caller
+void report();
+
+}
+
+// Keeps the chip out of the light sleep and the APB clock at its full frequency while a peripheral without its own
+// lock is busy, e.g. the UART which loses the received bytes with its clock stopped and derives the baud rate from
+// the APB clock. The acquisitions are counted, so the scopes may nest.
+class PowerLock
+{
+public:
+    explicit PowerLock(const char* name);
+    ~PowerLock();
+    PowerLock(const PowerLock&) = delete;
+    PowerLock& operator=(const PowerLock&) = delete;
+
+    void acquire();
+    void release();
+
+    // Holds the lock for the scope
+    class Guard
+    {
+    public:
+        explicit Guard(PowerLock& lock) : lock(lock) { lock.acquire(); }
+        ~Guard() { lock.release(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        PowerLock& lock;
+    };
+
+private:
+    esp_pm_lock_handle_t handle = nullptr;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Abstraction of the connectionless packet radio used by the transport.
+// Callbacks may be called from the radio's own context, so they shall only queue the events.
+class RadioInterface
+{
+public:
+    using MacAddress = std::array<uint8_t, 6>;
+    static constexpr size_t maxPayloadSize = 250;
+
+    struct ReceiveInfo
+    {
+        MacAddress source {};
+        int8_t rssi = 0;
+    };
+
+    using ReceiveCallback = void (*)(void* context, const ReceiveInfo& info, const uint8_t* data, size_t size);
+    using SendCallback = void (*)(void* context, const MacAddress& destination, bool delivered);
+
+    virtual ~RadioInterface() = default;
+
+    virtual bool init() = 0;
+    virtual void deinit() = 0;
+    virtual bool addPeer(const MacAddress& macAddress) = 0;
+    virtual bool send(const MacAddress& destination, const uint8_t* data, size_t size) = 0;
+    virtual bool setCallbacks(void* context, ReceiveCallback onReceive, SendCallback onSend) = 0;
+    // Wi-Fi channel of the radio, both units shall use the same one
+    virtual bool setChannel(uint8_t channel) = 0;
+    [[nodiscard]] virtual uint8_t getChannel() const = 0;
+};
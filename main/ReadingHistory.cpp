@@ -0,0 +1,36 @@
+#include "ReadingHistory.h"
+
+void ReadingHistory::append(const HistoryRecord& record)
+{
+    records[head] = record;
+    head = static_cast<uint16_t>((head + 1) % capacity);
+    if (count < capacity)
+    {
+        ++count;
+    }
+}
+
+const HistoryRecord& ReadingHistory::operator[](size_t index) const
+{
+    return records[(head + capacity - count + index) % capacity];
+}
+
+size_t ReadingHistory::lowerBound(uint32_t time) const
+{
+    // The records are appended in the time order
+    size_t first = 0;
+    size_t last = count;
+    while (first < last)
+    {
+        const auto middle = first + (last - first) / 2;
+        if ((*this)[middle].time < time)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    return first;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Inner readings of one moment in the fixed point units of the history
+struct HistoryRecord
+{
+    // Unix time in seconds
+    uint32_t time = 0;
+    // 0.01 C
+    int16_t temperature = 0;
+    // 0.01 %
+    uint16_t humidity = 0;
+    // 0.1 hPa
+    uint16_t pressure = 0;
+    // ug/m3, -1 if there's no data
+    int16_t pm01 = -1;
+    int16_t pm2p5 = -1;
+    int16_t pm10 = -1;
+};
+
+// Ring of the latest inner readings kept over the deep sleeps for the transfer to the external unit, the oldest
+// record is overwritten by the new one. The object is trivially copyable and valid when zero-initialized, so it
+// may be placed in the RTC memory.
+class ReadingHistory
+{
+public:
+    static constexpr size_t capacity = 128;
+
+    void append(const HistoryRecord& record);
+    void clear() { count = 0; }
+
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+    // The oldest record first
+    [[nodiscard]] const HistoryRecord& operator[](size_t index) const;
+    // Index of the first record not older than the time, size() if there's none
+    [[nodiscard]] size_t lowerBound(uint32_t time) const;
+
+private:
+    std::array<HistoryRecord, capacity> records {};
+    // Position of the next record
+    uint16_t head = 0;
+    uint16_t count = 0;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+// Sliding-window mean over BucketsCount buckets of BucketSeconds each. The window mean is the mean of the bucket means,
+// so sparse samples are weighted by time rather than by count. Both update and query are O(1) except for the
+// expiration of the skipped buckets, which is bounded by the window size.
+// The values are kept with 0.1 resolution to fit the state into the persistent storage.
+template<size_t BucketsCount, uint32_t BucketSeconds>
+class RollingAverage
+{
+public:
+    // Moves the window to the given time, the buckets left behind are expired, all of them if the time goes back
+    void advance(time_t now)
+    {
+        const auto bucket = static_cast<uint32_t>(now / BucketSeconds);
+        if (currentBucket == 0 || bucket < currentBucket)
+        {
+            // The buckets ahead of the clock set back can't be placed in the window, the window starts over
+            *this = {};
+            currentBucket = bucket;
+            return;
+        }
+        const auto steps = std::min<uint32_t>(bucket - currentBucket, BucketsCount);
+        for (uint32_t i = 1; i <= steps; ++i)
+        {
+            expire(buckets[(currentBucket + i) % BucketsCount]);
+        }
+        currentBucket = bucket;
+    }
+
+    void add(time_t now, float value)
+    {
+        advance(now);
+        auto& bucket = buckets[currentBucket % BucketsCount];
+        const auto scaled = static_cast<uint32_t>(std::clamp(value, 0.f, maxValue) * scale + 0.5f);
+        if (bucket.count == 0)
+        {
+            bucket.mean = static_cast<uint16_t>(scaled);
+            bucket.count = 1;
+            sumOfMeans += scaled;
+            ++filledBuckets;
+            return;
+        }
+        const auto newMean = (uint32_t(bucket.mean) * bucket.count + scaled) / (bucket.count + 1u);
+        sumOfMeans = sumOfMeans - bucket.mean + newMean;
+        bucket.mean = static_cast<uint16_t>(newMean);
+        bucket.count = static_cast<uint8_t>(std::min(bucket.count + 1, 255));
+    }
+
+    // Mean of the window if at least minBuckets buckets have data, advance shall be called before
+    [[nodiscard]] std::optional<float> mean(size_t minBuckets = 1) const
+    {
+        if (filledBuckets == 0 || filledBuckets < minBuckets)
+        {
+            return std::nullopt;
+        }
+        return float(sumOfMeans) / float(filledBuckets) / scale;
+    }
+
+    [[nodiscard]] size_t getFilledBuckets() const { return filledBuckets; }
+
+private:
+    static constexpr float scale = 10.f;
+    static constexpr float maxValue = 6500.f;
+
+    struct Bucket
+    {
+        uint16_t mean = 0;
+        uint8_t count = 0;
+    };
+
+    void expire(Bucket& bucket)
+    {
+        if (bucket.count != 0)
+        {
+            sumOfMeans -= bucket.mean;
+            --filledBuckets;
+            bucket = {};
+        }
+    }
+
+    std::array<Bucket, BucketsCount> buckets {};
+    uint32_t currentBucket = 0;
+    uint32_t sumOfMeans = 0;
+    uint16_t filledBuckets = 0;
+};
@@ -1,11 +1,24 @@
 #include "SPS30DataProvider.h"
+#include "Clock.h"
+#include "TimeFunctions.h"
 #include "Debug.h"
 
 #include <esp_attr.h>
 
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
 namespace
 {
-    RTC_DATA_ATTR uint32_t measurementsCounter = 0;
+    constexpr time_t fanCleaningPeriod = 7 * 24 * 60 * 60;
+    RTC_DATA_ATTR time_t lastFanCleaningTime = 0;
+    RTC_DATA_ATTR uint32_t lastFanOnSeconds = 0;
+    RTC_DATA_ATTR uint32_t fanOnSecondsTotal = 0;
+    RTC_DATA_ATTR uint32_t measurements = 0;
+    // The measurements ended by the readings converging and by the hard cap
+    RTC_DATA_ATTR uint32_t convergedMeasurements = 0;
+    RTC_DATA_ATTR uint32_t cappedMeasurements = 0;
 }
 
 using embedded::Sps30Error;
@@ -16,6 +29,7 @@ bool SPS30DataProvider::setup(bool wakeUp)
     {
         return true;
     }
+    const PowerLock::Guard uartGuard(uartLock);
     auto spsInitResult = sps30.probe();
     if (spsInitResult != Sps30Error::Success)
     {
@@ -64,12 +78,21 @@ bool SPS30DataProvider::setup(bool wakeUp)
     return spsInitResult == Sps30Error::Success;
 }
 
-bool SPS30DataProvider::startMeasure()
+bool SPS30DataProvider::start()
 {
+    const PowerLock::Guard uartGuard(uartLock);
+    if (sleeping)
+    {
+        DEBUG_LOG("Waking up SPS30")
+        sleeping = sps30.wakeUp() != Sps30Error::Success;
+    }
     if (auto result = sps30.startMeasurement(true); result == Sps30Error::Success)
     {
-        if (measurementsCounter++ % 168 == 0)
+        measuring = true;
+        beginPolling(Clock::instance().monotonicMicroseconds());
+        if (const auto now = Clock::instance().wallSeconds(); now - lastFanCleaningTime >= fanCleaningPeriod)
         {
+            lastFanCleaningTime = now;
             if (auto cleaningResult = sps30.startManualFanCleaning(); cleaningResult != Sps30Error::Success)
             {
                 DEBUG_LOG("Cleaning start failed with the code " << (int)cleaningResult)
@@ -82,35 +105,137 @@ bool SPS30DataProvider::startMeasure()
 
 bool SPS30DataProvider::wakeUp()
 {
+    const PowerLock::Guard uartGuard(uartLock);
     return sps30.wakeUp() == Sps30Error::Success;
 }
 
-bool SPS30DataProvider::hibernate()
+bool SPS30DataProvider::sleep()
+{
+    const PowerLock::Guard uartGuard(uartLock);
+    if (measuring)
+    {
+        sps30.stopMeasurement();
+        measuring = false;
+    }
+    sleeping = sps30.sleep() == Sps30Error::Success;
+    return sleeping;
+}
+
+void SPS30DataProvider::resume(uint32_t elapsedSeconds)
+{
+    measuring = true;
+    beginPolling(Clock::instance().monotonicMicroseconds() - int64_t(elapsedSeconds) * microsecondsInSecond);
+}
+
+void SPS30DataProvider::beginPolling(int64_t startTime)
+{
+    samples.clear();
+    lastSample.reset();
+    particleData.reset();
+    stableCounter = 0;
+    measurementStartTime = startTime;
+    nextPollTime = std::max(Clock::instance().monotonicMicroseconds(),
+                            startTime + int64_t(convergenceSettings.warmUpSeconds) * microsecondsInSecond);
+    // The first sample is due at the first poll
+    lastSampleTime = nextPollTime - microsecondsInSecond;
+}
+
+SensorProvider::ReadResult SPS30DataProvider::read()
+{
+    constexpr int64_t pollInterval = int64_t(convergenceSettings.pollMilliseconds) * 1000;
+    // A failed read is taken as the sample not being ready yet, the hard cap ends the retries
+    const auto sample = readSample();
+    const auto now = Clock::instance().monotonicMicroseconds();
+    if (sample)
+    {
+        lastSampleTime = now;
+        stableCounter = lastSample && isStable(*lastSample, *sample) ? stableCounter + 1 : 0;
+        lastSample = sample;
+        samples.add(*sample);
+    }
+    const auto fanOnTime = now - measurementStartTime;
+    const bool converged = samples.size() != 0 && stableCounter + 1 >= convergenceSettings.stableSamples;
+    if (!converged && fanOnTime + pollInterval < int64_t(convergenceSettings.maxSeconds) * microsecondsInSecond)
+    {
+        // The next sample is due a second after the last one, a sensor not answering in time is asked once a second
+        const bool due = now - lastSampleTime < 2 * microsecondsInSecond;
+        nextPollTime = now + (sample ? microsecondsInSecond - pollInterval : due ? pollInterval : microsecondsInSecond);
+        return ReadResult::Pending;
+    }
+    lastFanOnSeconds = static_cast<uint32_t>((fanOnTime + microsecondsInSecond / 2) / microsecondsInSecond);
+    if (converged)
+    {
+        ++convergedMeasurements;
+        DEBUG_LOG("SPS30 readings converged after " << lastFanOnSeconds << " s")
+    }
+    else
+    {
+        ++cappedMeasurements;
+    }
+    fanOnSecondsTotal += lastFanOnSeconds;
+    ++measurements;
+    DEBUG_LOG("Fan-on time " << lastFanOnSeconds << " s, average " << getAverageFanOnSeconds() << " s, "
+              << (int)samples.size() << " samples aggregated, " << convergedMeasurements << " converged and "
+              << cappedMeasurements << " capped measurements")
+    if (samples.size() == 0)
+    {
+        return ReadResult::Failed;
+    }
+    particleData = samples.aggregate();
+    return ReadResult::Done;
+}
+
+uint32_t SPS30DataProvider::getLastFanOnSeconds() const
+{
+    return lastFanOnSeconds;
+}
+
+uint32_t SPS30DataProvider::getAverageFanOnSeconds() const
+{
+    return measurements ? fanOnSecondsTotal / measurements : 0;
+}
+
+uint32_t SPS30DataProvider::getConvergedMeasurements()
 {
-    sps30.stopMeasurement();
-    return sps30.sleep() == Sps30Error::Success;
+    return convergedMeasurements;
 }
 
-bool SPS30DataProvider::getMeasureData(int &pm1, int &pm25, int &pm10)
+uint32_t SPS30DataProvider::getCappedMeasurements()
 {
+    return cappedMeasurements;
+}
+
+std::optional<ParticleData> SPS30DataProvider::readSample()
+{
+    const PowerLock::Guard uartGuard(uartLock);
     const auto result = sps30.readMeasurement();
     if (std::holds_alternative<embedded::Sps30MeasurementData>(result))
     {
         const auto& measurementData = std::get<embedded::Sps30MeasurementData>(result);
-        if (measurementData.measureInFloat)
-        {
-            pm1 = (int)measurementData.floatData.mc_1p0;
-            pm25 = (int)measurementData.floatData.mc_2p5;
-            pm10 = (int)measurementData.floatData.mc_10p0;
-            return true;
-        }
-        else
+        const auto fill = [](const auto& data, float particleSizeScale)
         {
-            pm1 = measurementData.unsignedData.mc_1p0;
-            pm25 = measurementData.unsignedData.mc_2p5;
-            pm10 = measurementData.unsignedData.mc_10p0;
-        }
-        return true;
+            return ParticleData { { float(data.mc_1p0), float(data.mc_2p5), float(data.mc_4p0), float(data.mc_10p0),
+                                    float(data.nc_0p5), float(data.nc_1p0), float(data.nc_2p5), float(data.nc_4p0),
+                                    float(data.nc_10p0), float(data.typical_particle_size) * particleSizeScale } };
+        };
+        // The integer format reports the typical particle size in nm
+        return measurementData.measureInFloat ? fill(measurementData.floatData, 1.f)
+                                              : fill(measurementData.unsignedData, 0.001f);
     }
-    return false;
+    return std::nullopt;
+}
+
+bool SPS30DataProvider::isStable(const ParticleData& previous, const ParticleData& current)
+{
+    const auto withinTolerance = [&previous, &current](ParticleData::Channel channel)
+    {
+        const auto a = previous[channel];
+        const auto b = current[channel];
+        const auto tolerance = std::max(convergenceSettings.absoluteTolerance,
+                                        convergenceSettings.relativeTolerance * std::max(a, b));
+        return std::fabs(a - b) <= tolerance;
+    };
+    return withinTolerance(ParticleData::Mc1p0)
+           && withinTolerance(ParticleData::Mc2p5)
+           && withinTolerance(ParticleData::Mc10p0);
 }
@@ -1,26 +1,77 @@
 #pragma once
 
+#include "ParticleData.h"
+#include "PowerManagement.h"
+#include "SampleAggregation.h"
+#include "SensorProvider.h"
 #include "SPS30/Sps30Uart.h"
 
-class SPS30DataProvider
+#include <optional>
+
+// Adaptive measurement: samples are read as the sensor produces them after the warm-up until the mass
+// concentrations stay within the tolerance for the required number of samples or the hard cap is reached.
+struct Sps30ConvergenceSettings
+{
+    uint32_t warmUpSeconds = 10;
+    uint32_t maxSeconds = 30;
+    // The sensor has a new sample every second, it's polled this often while the sample is due
+    uint32_t pollMilliseconds = 100;
+    float relativeTolerance = 0.05f;
+    float absoluteTolerance = 1.0f;
+    int stableSamples = 3;
+};
+
+class SPS30DataProvider : public SensorProvider
 {
 public:
+    static constexpr Sps30ConvergenceSettings convergenceSettings {};
+
     explicit SPS30DataProvider(embedded::PacketUart& packetUart)
     : sps30(packetUart)
     {
     }
 
     bool setup(bool wakeUp);
-    bool startMeasure();
     bool wakeUp();
 
-    bool sleep()
-    {
-        return sps30.sleep() == embedded::Sps30Error::Success;
-    }
+    [[nodiscard]] const char* name() const override { return "sps30"; }
+    [[nodiscard]] Bus bus() const override { return Bus::Uart; }
+    // Wakes the sleeping sensor up and starts the measurement, the data is ready after the warm-up
+    bool start() override;
+    [[nodiscard]] int64_t readyTime() const override { return nextPollTime; }
+    // Reads the new samples until the readings converge, the result is aggregated from the latest samples
+    ReadResult read() override;
+    // Stops the measurement if it runs
+    bool sleep() override;
 
-    bool hibernate();
-    bool getMeasureData(int& pm1, int& pm25, int& pm10);
+    // Continues the measurement started by an earlier wake elapsedSeconds ago, the samples are read from now on
+    void resume(uint32_t elapsedSeconds);
+    // The state kept by the controller over the deep sleep, start() wakes the sleeping sensor up
+    void setSleeping(bool isSleeping) { sleeping = isSleeping; }
+    [[nodiscard]] const std::optional<ParticleData>& getParticleData() const { return particleData; }
+    uint32_t getLastFanOnSeconds() const;
+    uint32_t getAverageFanOnSeconds() const;
+    // Measurements since the power-on ended by the converged readings and by the hard cap
+    static uint32_t getConvergedMeasurements();
+    static uint32_t getCappedMeasurements();
 private:
+    static constexpr size_t aggregatedSamples = 8;
+
+    std::optional<ParticleData> readSample();
+    static bool isStable(const ParticleData& previous, const ParticleData& current);
+    // Starts collecting the samples of the measurement started at the given monotonic time
+    void beginPolling(int64_t startTime);
+
     embedded::Sps30Uart sps30;
+    // The answers of the sensor are lost if the chip sleeps during the exchange, the polling interval may sleep
+    PowerLock uartLock {"sps30"};
+    aggregation::ParticleSamples<aggregatedSamples> samples;
+    std::optional<ParticleData> lastSample;
+    std::optional<ParticleData> particleData;
+    int stableCounter = 0;
+    int64_t measurementStartTime = 0;
+    int64_t nextPollTime = 0;
+    int64_t lastSampleTime = 0;
+    bool sleeping = false;
+    bool measuring = false;
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ParticleData.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace aggregation
+{
+
+// Median of the first count values, the order of the values is changed
+template<size_t N>
+float median(std::array<float, N>& values, size_t count)
+{
+    if (count == 0)
+    {
+        return 0.f;
+    }
+    const auto middle = values.begin() + count / 2;
+    std::nth_element(values.begin(), middle, values.begin() + count);
+    if (count % 2 != 0)
+    {
+        return *middle;
+    }
+    const auto lower = *std::max_element(values.begin(), middle);
+    return (lower + *middle) / 2;
+}
+
+// Mean of the first count values without trimCount lowest and trimCount highest ones, the order of the values is changed
+template<size_t N>
+float trimmedMean(std::array<float, N>& values, size_t count, size_t trimCount)
+{
+    if (count == 0)
+    {
+        return 0.f;
+    }
+    if (2 * trimCount >= count)
+    {
+        return median(values, count);
+    }
+    std::sort(values.begin(), values.begin() + count);
+    float sum = 0;
+    for (auto i = trimCount; i < count - trimCount; ++i)
+    {
+        sum += values[i];
+    }
+    return sum / float(count - 2 * trimCount);
+}
+
+// Fixed-size buffer keeping the latest N samples of all the particle channels
+template<size_t N>
+class ParticleSamples
+{
+public:
+    void add(const ParticleData& sample)
+    {
+        samples[next] = sample;
+        next = (next + 1) % N;
+        count = std::min(count + 1, N);
+    }
+
+    void clear()
+    {
+        next = 0;
+        count = 0;
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+
+    // Concentrations are aggregated by the mean trimmed by a quarter from each side, the particle size by the median
+    [[nodiscard]] ParticleData aggregate() const
+    {
+        ParticleData result;
+        std::array<float, N> channelValues {};
+        for (size_t channel = 0; channel < ParticleData::ChannelsCount; ++channel)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                channelValues[i] = samples[i].values[channel];
+            }
+            result.values[channel] = channel == ParticleData::TypicalSize
+                    ? median(channelValues, count)
+                    : trimmedMean(channelValues, count, count / 4);
+        }
+        return result;
+    }
+
+private:
+    std::array<ParticleData, N> samples {};
+    size_t next = 0;
+    size_t count = 0;
+};
+
+} // namespace aggregation
@@ -0,0 +1,81 @@
+#include "SamplingPolicy.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr time_t secondsInMinute = 60;
+constexpr time_t secondsInDay = 24 * 60 * 60;
+
+int32_t dayNumber(time_t time)
+{
+    return static_cast<int32_t>(time / secondsInDay);
+}
+}
+
+void SamplingPolicy::registerMeasurement(time_t time, std::optional<float> pm25, uint32_t fanOnSeconds)
+{
+    if (dayNumber(time) != budgetDay)
+    {
+        budgetDay = dayNumber(time);
+        fanSecondsToday = 0;
+    }
+    fanSecondsToday += fanOnSeconds;
+    if (fanOnSeconds > 0)
+    {
+        averageFanSeconds = (averageFanSeconds * 3 + fanOnSeconds) / 4;
+    }
+    lastMeasureTime = time;
+    if (pm25)
+    {
+        previousPm25 = lastPm25;
+        lastPm25 = *pm25;
+    }
+}
+
+time_t SamplingPolicy::nextMeasurementTime(time_t now, uint32_t intervalScale) const
+{
+#ifdef FIXED_PM_INTERVAL_MINUTES
+    // The fixed schedule the policy is compared with in the host simulation
+    return lastMeasureTime + static_cast<time_t>(FIXED_PM_INTERVAL_MINUTES) * secondsInMinute;
+#else
+    auto interval = std::clamp(trendIntervalMinutes() * intervalScale, settings.minIntervalMinutes,
+                               settings.maxIntervalMinutes * intervalScale);
+    // The cap doesn't apply to the budget, an exhausted one waits for the next day
+    interval = std::max(interval, budgetIntervalMinutes(now));
+    return lastMeasureTime + static_cast<time_t>(interval) * secondsInMinute;
+#endif
+}
+
+uint32_t SamplingPolicy::trendIntervalMinutes() const
+{
+    if (lastPm25 < 0)
+    {
+        return settings.baseIntervalMinutes;
+    }
+    const bool rising = previousPm25 >= 0 && lastPm25 - previousPm25 > settings.risingDelta;
+    if (rising || lastPm25 >= settings.highPm25)
+    {
+        return settings.minIntervalMinutes;
+    }
+    const bool stable = previousPm25 >= 0 && previousPm25 - lastPm25 < settings.risingDelta;
+    if (stable && lastPm25 < settings.cleanPm25)
+    {
+        return settings.baseIntervalMinutes * 2;
+    }
+    return settings.baseIntervalMinutes;
+}
+
+uint32_t SamplingPolicy::budgetIntervalMinutes(time_t now) const
+{
+    const uint32_t spentToday = dayNumber(now) == budgetDay ? fanSecondsToday : 0;
+    if (spentToday >= settings.dailyFanBudgetSeconds)
+    {
+        // The budget is exhausted, wait for the next day
+        return static_cast<uint32_t>((secondsInDay - now % secondsInDay) / secondsInMinute + 1);
+    }
+    const auto measurementsLeft = std::max<uint32_t>(
+            (settings.dailyFanBudgetSeconds - spentToday) / std::max<uint32_t>(averageFanSeconds, 1), 1);
+    const auto secondsLeft = static_cast<uint32_t>(secondsInDay - now % secondsInDay);
+    return secondsLeft / measurementsLeft / secondsInMinute;
+}
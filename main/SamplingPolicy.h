@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+struct SamplingPolicySettings
+{
+    uint32_t baseIntervalMinutes = 60;
+    uint32_t minIntervalMinutes = 15;
+    uint32_t maxIntervalMinutes = 240;
+    float highPm25 = 25.f;
+    float cleanPm25 = 10.f;
+    float risingDelta = 5.f;
+    uint32_t dailyFanBudgetSeconds = 24 * 30;
+};
+
+// Chooses the time of the next PM measurement from the power tier's interval scale, the recent PM trend
+// and the daily fan-on time budget. The object is trivially copyable and is kept in the persistent storage.
+class SamplingPolicy
+{
+public:
+    static constexpr SamplingPolicySettings settings {};
+
+    // A failed readout has no PM2.5, its fan-on time is still taken from the budget
+    void registerMeasurement(time_t time, std::optional<float> pm25, uint32_t fanOnSeconds);
+    [[nodiscard]] time_t nextMeasurementTime(time_t now, uint32_t intervalScale) const;
+    [[nodiscard]] uint32_t getFanSecondsToday() const { return fanSecondsToday; }
+
+private:
+    [[nodiscard]] uint32_t trendIntervalMinutes() const;
+    [[nodiscard]] uint32_t budgetIntervalMinutes(time_t now) const;
+
+    time_t lastMeasureTime = 0;
+    int32_t budgetDay = -1;
+    uint32_t fanSecondsToday = 0;
+    uint32_t averageFanSeconds = 30;
+    float lastPm25 = -1.f;
+    float previousPm25 = -1.f;
+};
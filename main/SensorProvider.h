@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Common lifecycle of the sensors of the measurement cycle: the measurement is started, its data is read from the
+// ready time on and the sensor is put to sleep until the next cycle. The transactions of all the sensors are grouped
+// by BusScheduler, so a new sensor only implements this and is added to the registry.
+class SensorProvider
+{
+public:
+    enum class Bus : uint8_t
+    {
+        I2C,
+        Uart,
+    };
+
+    enum class ReadResult : uint8_t
+    {
+        Done,
+        Failed,
+        // The data isn't final yet, it's read again from the new ready time
+        Pending,
+    };
+
+    virtual ~SensorProvider() = default;
+
+    [[nodiscard]] virtual const char* name() const = 0;
+    [[nodiscard]] virtual Bus bus() const = 0;
+    // Starts the measurement, other work may be done until the ready time
+    virtual bool start() = 0;
+    // Monotonic time from which the data of the started measurement can be read
+    [[nodiscard]] virtual int64_t readyTime() const = 0;
+    virtual ReadResult read() = 0;
+    // Puts the sensor into its lowest power state until the next start
+    virtual bool sleep() = 0;
+};
+
+// Sensors known to the measurement cycle, the sets of them are bit masks of their identifiers
+class SensorRegistry
+{
+public:
+    using SensorId = uint8_t;
+    using SensorSet = uint8_t;
+    static constexpr size_t capacity = 8;
+
+    // Returns capacity if the registry is full
+    SensorId add(SensorProvider& provider)
+    {
+        if (count == capacity)
+        {
+            return capacity;
+        }
+        sensors[count] = &provider;
+        return static_cast<SensorId>(count++);
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] SensorSet all() const { return static_cast<SensorSet>((1u << count) - 1); }
+    [[nodiscard]] SensorProvider& operator[](size_t id) const { return *sensors[id]; }
+    [[nodiscard]] static SensorSet bit(SensorId id) { return id < capacity ? SensorSet(1u << id) : 0; }
+
+private:
+    std::array<SensorProvider*, capacity> sensors {};
+    size_t count = 0;
+};
@@ -0,0 +1,161 @@
+#include "SpiDmaStream.h"
+
+#include "BinaryLog.h"
+#include "Clock.h"
+
+#include <algorithm>
+#include <esp_heap_caps.h>
+
+#include "Debug.h"
+
+float SpiDmaStream::Statistics::getThroughput() const
+{
+    // Bytes per microsecond are megabytes per second, the result is in kB/s
+    return totalMicroseconds > 0 ? float(bytes) * 1000.0f / float(totalMicroseconds) : 0.0f;
+}
+
+SpiDmaStream::SpiDmaStream(spi_host_device_t host, int clockHz, bool queued)
+    : host(host)
+    , clockHz(clockHz)
+    , queued(queued)
+{
+}
+
+SpiDmaStream::~SpiDmaStream()
+{
+    deinit();
+}
+
+bool SpiDmaStream::init()
+{
+    if (device != nullptr)
+    {
+        return true;
+    }
+    spi_device_interface_config_t config {};
+    config.clock_speed_hz = clockHz;
+    config.mode = 0;
+    // The chip select is driven by the owner of the display interface
+    config.spics_io_num = -1;
+    config.queue_size = static_cast<int>(buffers.size());
+    if (spi_bus_add_device(host, &config, &device) != ESP_OK)
+    {
+        DEBUG_LOG("Failed to add the DMA stream device")
+        device = nullptr;
+        return false;
+    }
+    for (auto& buffer : buffers)
+    {
+        buffer = static_cast<uint8_t*>(heap_caps_malloc(chunkSize, MALLOC_CAP_DMA));
+        if (buffer == nullptr)
+        {
+            DEBUG_LOG("Failed to allocate the DMA buffer")
+            deinit();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SpiDmaStream::deinit()
+{
+    if (!drain())
+    {
+        // The DMA may still read the queued chunks, the buffers and the device are kept for the next attempt
+        DEBUG_LOG("SPI stream transfers still queued, the buffers are kept")
+        return;
+    }
+    for (auto& buffer : buffers)
+    {
+        heap_caps_free(buffer);
+        buffer = nullptr;
+    }
+    if (device != nullptr)
+    {
+        spi_bus_remove_device(device);
+        device = nullptr;
+    }
+}
+
+bool SpiDmaStream::write(size_t size, Producer producer, void* context)
+{
+    // The chunks left queued by a failed write still own the buffers
+    if (device == nullptr || !drain())
+    {
+        return false;
+    }
+    auto& clock = Clock::instance();
+    const auto startTime = clock.monotonicMicroseconds();
+    int64_t waitMicroseconds = 0;
+    size_t offset = 0;
+    size_t index = 0;
+    bool success = true;
+    while (offset < size && success)
+    {
+        // The chunk is refilled only after its previous transfer is done
+        if (inFlight == buffers.size())
+        {
+            const auto waitStart = clock.monotonicMicroseconds();
+            success = waitForResult();
+            waitMicroseconds += clock.monotonicMicroseconds() - waitStart;
+            if (!success)
+            {
+                break;
+            }
+        }
+        const auto produced = producer(context, offset, buffers[index], std::min(chunkSize, size - offset));
+        if (produced == 0)
+        {
+            break;
+        }
+        success = send(transactions[index], buffers[index], produced);
+        offset += produced;
+        index = (index + 1) % buffers.size();
+    }
+    const auto waitStart = clock.monotonicMicroseconds();
+    success = drain() && success;
+    waitMicroseconds += clock.monotonicMicroseconds() - waitStart;
+
+    const auto elapsed = clock.monotonicMicroseconds() - startTime;
+    statistics.bytes += offset;
+    statistics.totalMicroseconds += elapsed;
+    statistics.cpuBusyMicroseconds += elapsed - waitMicroseconds;
+    TRACE_LOG("SPI stream of {} bytes in {} us, CPU busy {} us", offset, elapsed, elapsed - waitMicroseconds)
+    return success && offset == size;
+}
+
+bool SpiDmaStream::send(spi_transaction_t& transaction, uint8_t* buffer, size_t size)
+{
+    transaction = {};
+    transaction.length = size * 8;
+    transaction.tx_buffer = buffer;
+    if (!queued)
+    {
+        return spi_device_polling_transmit(device, &transaction) == ESP_OK;
+    }
+    if (spi_device_queue_trans(device, &transaction, portMAX_DELAY) != ESP_OK)
+    {
+        return false;
+    }
+    ++inFlight;
+    return true;
+}
+
+bool SpiDmaStream::waitForResult()
+{
+    spi_transaction_t* done = nullptr;
+    if (spi_device_get_trans_result(device, &done, portMAX_DELAY) != ESP_OK)
+    {
+        return false;
+    }
+    --inFlight;
+    return true;
+}
+
+bool SpiDmaStream::drain()
+{
+    while (inFlight != 0 && waitForResult())
+    {
+    }
+    return inFlight == 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <driver/spi_master.h>
+
+// Long write to an SPI device through the queued DMA transactions of two ping-pong chunks: the producer fills
+// one chunk while the other is on the bus, and the calling task blocks on the transfer results, so the CPU
+// can idle instead of spinning in the transfer. The chip select and the data/command pins stay with the caller.
+// Without the queued mode every chunk is sent by the polling transmit, e.g. on a bus without the DMA channel.
+class SpiDmaStream
+{
+public:
+    // A DMA descriptor carries up to 4092 bytes
+    static constexpr size_t chunkSize = 4092;
+
+    // Fills the buffer with the bytes starting at the offset of the stream, returns the number of bytes put
+    using Producer = size_t (*)(void* context, size_t offset, uint8_t* buffer, size_t size);
+
+    struct Statistics
+    {
+        size_t bytes = 0;
+        int64_t totalMicroseconds = 0;
+        // Time the CPU was running the producer and queueing, the rest is the wait for the bus
+        int64_t cpuBusyMicroseconds = 0;
+
+        [[nodiscard]] float getThroughput() const;
+    };
+
+    SpiDmaStream(spi_host_device_t host, int clockHz, bool queued);
+    ~SpiDmaStream();
+
+    bool init();
+    // Keeps the buffers and the device while the transfers queued by a failed write can't be completed
+    void deinit();
+    // Writes size bytes made by the producer, returns false if the transfer failed
+    bool write(size_t size, Producer producer, void* context);
+
+    [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
+private:
+    bool send(spi_transaction_t& transaction, uint8_t* buffer, size_t size);
+    bool waitForResult();
+    // Waits for all the queued transfers, returns false if some of them are still on the bus
+    bool drain();
+
+    spi_host_device_t host;
+    int clockHz;
+    bool queued;
+    spi_device_handle_t device = nullptr;
+    std::array<uint8_t*, 2> buffers {};
+    std::array<spi_transaction_t, 2> transactions {};
+    size_t inFlight = 0;
+    Statistics statistics;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "WakeBudget.h"
+
+#include <cstdint>
+#include <type_traits>
+
+// Readings and health of the internal unit carried by the acknowledgement of the external unit's message, so the
+// external unit forwarding the data to the logging learns them without a transmission of its own. The later
+// versions only append the fields, the receiver reads the ones of the version it knows.
+struct StatusReport
+{
+    static constexpr uint8_t currentVersion = 1;
+
+    // Latest inner readings, the same defaults as in SensorData mean no data
+    float temperature = 0;
+    float humidity = 0;
+    float pressure = 0;
+    float dewPoint = 0;
+    int16_t pm01 = -1;
+    int16_t pm2p5 = -1;
+    int16_t pm10 = -1;
+    int16_t usAqi = -1;
+    uint8_t euLevel = 0;
+    // Battery
+    uint8_t stateOfCharge = 0;
+    uint8_t powerTier = 0;
+    float voltage = 0;
+    // Wakes since the first boot, the boot to sleep time of the previous one and the jobs abandoned so far
+    uint32_t wakes = 0;
+    uint32_t lastWakeMilliseconds = 0;
+    WakeBudget::OverrunCounters jobOverruns {};
+    // Delivery of the acknowledgements to the external unit
+    uint32_t deliveredCount = 0;
+    uint32_t failedCount = 0;
+    uint8_t deliveryRatio = 0;
+    int8_t lastRssi = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<StatusReport>, "The report is sent as is");
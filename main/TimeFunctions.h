@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Clock.h"
+
 #include <cstdint>
 #include <sys/time.h>
 
@@ -13,9 +15,12 @@ inline constexpr int64_t microsecondsFromTimeval(const timeval &tv)
 
 inline int64_t microsecondsNow()
 {
-    timeval tv {};
-    gettimeofday(&tv, nullptr);
-    return microsecondsFromTimeval(tv);
+    return Clock::instance().wallMicroseconds();
+}
+
+inline time_t secondsNow()
+{
+    return Clock::instance().wallSeconds();
 }
 
 inline tm getLocalTime(time_t time)
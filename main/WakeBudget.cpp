@@ -0,0 +1,101 @@
+#include "WakeBudget.h"
+
+#include "AppConfig.h"
+#include "TimeFunctions.h"
+
+#include <algorithm>
+
+#include "Debug.h"
+
+namespace
+{
+constexpr int64_t microsecondsInTick = 1000 * portTICK_PERIOD_MS;
+// Left after the last deadline for the hibernation of the controller and the storing of the data
+constexpr uint32_t hibernationReserveSeconds = 2;
+
+uint32_t deadlineSeconds(WakeBudget::Job job)
+{
+    switch (job)
+    {
+        case WakeBudget::Job::TimeSync:
+            return WakeBudget::deadlines.timeSyncSeconds;
+        case WakeBudget::Job::Transport:
+            return WakeBudget::deadlines.transportSeconds;
+        case WakeBudget::Job::Measurement:
+            return WakeBudget::deadlines.measurementSeconds;
+        case WakeBudget::Job::Display:
+            return WakeBudget::deadlines.displaySeconds;
+    }
+    return 0;
+}
+
+uint8_t jobBit(WakeBudget::Job job)
+{
+    return static_cast<uint8_t>(1u << static_cast<uint8_t>(job));
+}
+}
+
+int64_t WakeBudget::deadline(Job job) const
+{
+    const auto budgetSeconds = AppConfig::wakeBudgetSeconds - std::min(AppConfig::wakeBudgetSeconds,
+                                                                       hibernationReserveSeconds);
+    return std::min(deadlineSeconds(job), budgetSeconds) * microsecondsInSecond;
+}
+
+int64_t WakeBudget::microsecondsLeft(Job job) const
+{
+    return std::max<int64_t>(0, deadline(job) - clock.monotonicMicroseconds());
+}
+
+TickType_t WakeBudget::ticksLeft(Job job) const
+{
+    return static_cast<TickType_t>((microsecondsLeft(job) + microsecondsInTick - 1) / microsecondsInTick);
+}
+
+void WakeBudget::recordOverrun(Job job)
+{
+    if ((__atomic_fetch_or(&overruns, jobBit(job), __ATOMIC_RELAXED) & jobBit(job)) == 0)
+    {
+        DEBUG_LOG("Job " << name(job) << " missed its deadline at " << clock.monotonicMicroseconds()
+                  << " us, abandoned")
+    }
+}
+
+bool WakeBudget::overran(Job job) const
+{
+    return (__atomic_load_n(&overruns, __ATOMIC_RELAXED) & jobBit(job)) != 0;
+}
+
+bool WakeBudget::anyOverrun() const
+{
+    return __atomic_load_n(&overruns, __ATOMIC_RELAXED) != 0;
+}
+
+void WakeBudget::accumulate(OverrunCounters& counters) const
+{
+    for (size_t i = 0; i < jobCount; ++i)
+    {
+        const auto job = static_cast<Job>(i);
+        if (overran(job) && counters[i] < UINT16_MAX)
+        {
+            ++counters[i];
+            DEBUG_LOG("Job " << name(job) << " overran " << counters[i] << " times")
+        }
+    }
+}
+
+const char* WakeBudget::name(Job job)
+{
+    switch (job)
+    {
+        case Job::TimeSync:
+            return "time sync";
+        case Job::Transport:
+            return "transport";
+        case Job::Measurement:
+            return "measurement";
+        case Job::Display:
+            return "display";
+    }
+    return "unknown";
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+
+class Clock;
+
+// Deadlines of the jobs in seconds from the boot
+struct WakeDeadlines
+{
+    // The connection, DHCP and the SNTP answer
+    uint32_t timeSyncSeconds = 45;
+    // The external unit sends every minute, the wake starts shortly before it
+    uint32_t transportSeconds = 75;
+    // The SPS30 start or read and the BME280 measurement
+    uint32_t measurementSeconds = 30;
+    // The display is updated at the start of the next minute and the full refresh takes a few seconds
+    uint32_t displaySeconds = 75;
+};
+
+// Deadlines of the jobs of one wake, counted from the boot. A job not done by its deadline is abandoned and
+// recorded as overrun, so the chip reaches the deep sleep within the budget whatever the peer, the access point
+// or the peripherals do.
+class WakeBudget
+{
+public:
+    enum class Job : uint8_t
+    {
+        TimeSync,
+        Transport,
+        Measurement,
+        Display,
+    };
+    static constexpr size_t jobCount = 4;
+
+    static constexpr WakeDeadlines deadlines {};
+
+    // Overruns per job, kept in the persistent storage
+    using OverrunCounters = std::array<uint16_t, jobCount>;
+
+    explicit WakeBudget(const Clock& clock) : clock(clock) {}
+
+    // Monotonic time of the deadline of the job, never beyond the budget of the whole wake
+    [[nodiscard]] int64_t deadline(Job job) const;
+    [[nodiscard]] int64_t microsecondsLeft(Job job) const;
+    // Ticks for the FreeRTOS waits of the job, zero after its deadline
+    [[nodiscard]] TickType_t ticksLeft(Job job) const;
+
+    // Can be called from any task
+    void recordOverrun(Job job);
+    [[nodiscard]] bool overran(Job job) const;
+    [[nodiscard]] bool anyOverrun() const;
+    // Adds the overruns of this wake to the counters and logs them
+    void accumulate(OverrunCounters& counters) const;
+
+    [[nodiscard]] static const char* name(Job job);
+
+private:
+    const Clock& clock;
+    uint8_t overruns = 0;
+};
@@ -0,0 +1,147 @@
+#include "WakePlanner.h"
+
+#include <algorithm>
+
+namespace
+{
+WakePlanner::ActivitySet lastWakeActivities = 0;
+
+constexpr size_t index(WakePlanner::Activity activity)
+{
+    return static_cast<size_t>(activity);
+}
+}
+
+void WakePlanner::setCadence(Activity activity, uint32_t periodSeconds, uint32_t toleranceSeconds, time_t now,
+                             time_t phaseSeconds)
+{
+    if (periodSeconds == 0)
+    {
+        cancel(activity);
+        return;
+    }
+    auto& entry = entries[index(activity)];
+    const auto period = static_cast<time_t>(periodSeconds);
+    const auto phase = (phaseSeconds % period + period) % period;
+    const bool changed = entry.period != periodSeconds || entry.phase != phase;
+    entry.period = periodSeconds;
+    entry.tolerance = toleranceSeconds;
+    entry.phase = phase;
+    if (changed || entry.due == 0)
+    {
+        entry.due = nextSlot(entry, now);
+    }
+}
+
+void WakePlanner::scheduleOnce(Activity activity, time_t time, uint32_t toleranceSeconds)
+{
+    entries[index(activity)] = Entry {time, 0, toleranceSeconds};
+}
+
+void WakePlanner::postpone(Activity activity, time_t time)
+{
+    if (auto& entry = entries[index(activity)]; entry.due != 0 && entry.period == 0)
+    {
+        entry.due = time;
+    }
+}
+
+void WakePlanner::cancel(Activity activity)
+{
+    entries[index(activity)] = Entry {};
+}
+
+void WakePlanner::complete(Activity activity, time_t now)
+{
+    auto& entry = entries[index(activity)];
+    if (entry.period == 0)
+    {
+        entry = Entry {};
+        return;
+    }
+    entry.due = nextSlot(entry, std::max(entry.due, now) + 1);
+}
+
+bool WakePlanner::isPlanned(Activity activity) const
+{
+    return entries[index(activity)].due != 0;
+}
+
+bool WakePlanner::isDue(Activity activity, time_t now) const
+{
+    const auto& entry = entries[index(activity)];
+    return entry.due != 0 && now >= entry.due - static_cast<time_t>(entry.tolerance);
+}
+
+WakePlanner::ActivitySet WakePlanner::dueActivities(time_t now) const
+{
+    ActivitySet activities = 0;
+    for (size_t i = 0; i < activityCount; ++i)
+    {
+        if (isDue(static_cast<Activity>(i), now))
+        {
+            activities |= bit(static_cast<Activity>(i));
+        }
+    }
+    return activities;
+}
+
+std::optional<WakePlanner::Wake> WakePlanner::nextWake(time_t earliest) const
+{
+    // The most urgent activity is the one whose tolerance window closes first, waking at its end
+    // gives the others the longest time to join
+    std::optional<Wake> wake;
+    for (const auto& entry : entries)
+    {
+        if (entry.due == 0)
+        {
+            continue;
+        }
+        const auto windowEnd = std::max(dueNotBefore(entry, earliest) + static_cast<time_t>(entry.tolerance), earliest);
+        if (!wake || windowEnd < wake->time)
+        {
+            wake = Wake {windowEnd};
+        }
+    }
+    if (wake)
+    {
+        for (size_t i = 0; i < activityCount; ++i)
+        {
+            const auto& entry = entries[i];
+            if (entry.due != 0
+                && dueNotBefore(entry, earliest) - static_cast<time_t>(entry.tolerance) <= wake->time)
+            {
+                wake->activities |= bit(static_cast<Activity>(i));
+            }
+        }
+    }
+    return wake;
+}
+
+void WakePlanner::registerWake(ActivitySet activities)
+{
+    lastWakeActivities = activities;
+}
+
+WakePlanner::ActivitySet WakePlanner::getLastWakeActivities()
+{
+    return lastWakeActivities;
+}
+
+time_t WakePlanner::dueNotBefore(const Entry& entry, time_t earliest)
+{
+    if (entry.period != 0 && entry.due + static_cast<time_t>(entry.tolerance) < earliest)
+    {
+        return nextSlot(entry, earliest - static_cast<time_t>(entry.tolerance));
+    }
+    return entry.due;
+}
+
+time_t WakePlanner::nextSlot(const Entry& entry, time_t time)
+{
+    const auto period = static_cast<time_t>(entry.period);
+    const auto sincePhase = time - entry.phase;
+    // Rounds up, the time before the phase included
+    const auto slots = sincePhase >= 0 ? (sincePhase + period - 1) / period : -(-sincePhase / period);
+    return entry.phase + slots * period;
+}
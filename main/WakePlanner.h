@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+// Plans the deep sleep wakes from the activities of the unit. Each activity is either periodic, due at the
+// multiples of its period shifted by a phase, or planned once for a given time, and may be served anywhere within
+// its tolerance around the due time. The next wake is put at the latest time still serving the most urgent
+// activity and serves all the activities whose tolerance window is open by then, so the activities with
+// compatible tolerances share one wake. A periodic activity missed past its tolerance moves to its next slot.
+// The object is trivially copyable and is kept in the persistent storage.
+class WakePlanner
+{
+public:
+    enum class Activity : uint8_t
+    {
+        // Update of the clock and the data on the display
+        Clock,
+        // Reception of the message of the external unit
+        OuterData,
+        // Synchronization of the time over the Wi-Fi
+        TimeSync,
+        // Start of the PM measurement
+        PmMeasurement,
+        // Reading of the PM data after the warm-up of the SPS30
+        PmReadout,
+    };
+    static constexpr size_t activityCount = 5;
+    // Bit mask of the activities
+    using ActivitySet = uint8_t;
+
+    struct Wake
+    {
+        time_t time = 0;
+        ActivitySet activities = 0;
+    };
+
+    [[nodiscard]] static constexpr ActivitySet bit(Activity activity)
+    {
+        return static_cast<ActivitySet>(1u << static_cast<size_t>(activity));
+    }
+
+    // Makes the activity periodic, due at phase + k * period. The due time is kept while the cadence doesn't change,
+    // the zero period removes the activity.
+    void setCadence(Activity activity, uint32_t periodSeconds, uint32_t toleranceSeconds, time_t now,
+                    time_t phaseSeconds = 0);
+    // Plans the activity once, replaces its previous plan
+    void scheduleOnce(Activity activity, time_t time, uint32_t toleranceSeconds);
+    // Moves the activity planned once to the time, keeps its tolerance
+    void postpone(Activity activity, time_t time);
+    void cancel(Activity activity);
+    // The periodic activity moves to its next slot after the time, the one planned once is removed
+    void complete(Activity activity, time_t now);
+
+    [[nodiscard]] bool isPlanned(Activity activity) const;
+    // True if the wake at the time serves the activity
+    [[nodiscard]] bool isDue(Activity activity, time_t now) const;
+    [[nodiscard]] ActivitySet dueActivities(time_t now) const;
+    // The first wake not earlier than the given time, none if no activity is planned
+    [[nodiscard]] std::optional<Wake> nextWake(time_t earliest) const;
+
+    // Records the activities served by the wake for the statistics of the firmware
+    static void registerWake(ActivitySet activities);
+    // Activities served by the latest wake of the firmware
+    [[nodiscard]] static ActivitySet getLastWakeActivities();
+
+private:
+    struct Entry
+    {
+        // Zero if the activity isn't planned
+        time_t due = 0;
+        // Zero for the activity planned once
+        uint32_t period = 0;
+        uint32_t tolerance = 0;
+        time_t phase = 0;
+    };
+
+    // The due time of the slot serving the activity not earlier than the time
+    [[nodiscard]] static time_t dueNotBefore(const Entry& entry, time_t earliest);
+    [[nodiscard]] static time_t nextSlot(const Entry& entry, time_t time);
+
+    std::array<Entry, activityCount> entries {};
+};
@@ -4,6 +4,7 @@
 #include <esp_wifi.h>
 #include <cstring>
 #include <freertos/event_groups.h>
+#include <nvs_flash.h>
 
 #include "Debug.h"
 
@@ -32,6 +33,13 @@ bool WiFiManager::initWiFiSubsystem()
 {
     if (state == State::NotInitialized)
     {
+        // The Wi-Fi stack is the only user of NVS, so it's brought up only with it
+        if (const auto ret = nvs_flash_init();
+            ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+        {
+            ESP_ERROR_CHECK(nvs_flash_erase());
+            ESP_ERROR_CHECK(nvs_flash_init());
+        }
         ESP_ERROR_CHECK(esp_netif_init());
         ESP_ERROR_CHECK(esp_event_loop_create_default());
         defaultStaInterface = esp_netif_create_default_wifi_sta();
@@ -94,6 +102,13 @@ void WiFiManager::eventHandler(esp_event_base_t event_base, int32_t event_id, vo
                 xEventGroupSetBits(wifiEventGroup, DISCONNECTED_BIT);
                 break;
             case WIFI_EVENT_STA_STOP:
+                // ESP-NOW stops the radio right before the station is started, its late event would leave the
+                // connection without the start
+                if (state == State::Connecting && !stopRequested)
+                {
+                    break;
+                }
+                stopRequested = false;
                 esp_wifi_disconnect();
                 state = State::Stopped;
                 xEventGroupSetBits(wifiEventGroup, STOPPED_BIT);
@@ -146,6 +161,7 @@ bool WiFiManager::stopSTA()
 {
     if (state == State::Connected || state == State::Connecting)
     {
+        stopRequested = true;
         if (stopWiFi())
         {
             if ((xEventGroupWaitBits(wifiEventGroup, STOPPED_BIT, pdTRUE, pdTRUE, portMAX_DELAY) & STOPPED_BIT) != 0)
@@ -178,4 +194,15 @@ bool WiFiManager::waitForDisconnect(int timeoutMs)
     return state == State::Disconnected || xEventGroupWaitBits(wifiEventGroup, DISCONNECTED_BIT, pdTRUE, pdTRUE, pdMS_TO_TICKS(timeoutMs)) & DISCONNECTED_BIT;
 }
 
+std::optional<uint8_t> WiFiManager::getChannel()
+{
+    uint8_t primary = 0;
+    wifi_second_chan_t second;
+    if (esp_wifi_get_channel(&primary, &second) != ESP_OK)
+    {
+        return std::nullopt;
+    }
+    return primary;
+}
+
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <optional>
 #include <string_view>
 struct esp_netif_obj;
 
@@ -27,11 +28,15 @@ public:
     State getState() const volatile { return state; }
     bool waitForConnection(int timeoutMs);
     bool waitForDisconnect(int timeoutMs);
+    // Channel of the radio, the one of the access point while connected
+    static std::optional<uint8_t> getChannel();
 private:
     static void eventHandler(void* arg, const char* event_base,
                               int32_t event_id, void* event_data);
     void eventHandler(const char* event_base, int32_t event_id, void* event_data);
     int numberOfRetries = 0;
+    // Set by stopSTA, the other stops come from the radio of ESP-NOW
+    volatile bool stopRequested = false;
     volatile State state = State::NotInitialized;
     esp_netif_obj* defaultStaInterface = nullptr;
 };